@@ -0,0 +1,821 @@
+// Headless microbenchmarks for the solar system's CPU-side code. Needs no window or GPU.
+//
+// Linux:   g++ -O2 -std=c++17 -I Dependencies/include Benchmark/Benchmark.cpp -o solar_bench -lpthread
+//          ./solar_bench --assets SolarSystem --out bench.json
+// Windows: build the Benchmark project in SolarSystem.sln.
+//
+// Every benchmark is calibrated so one repetition runs for at least --min-time seconds, then repeated
+// --repetitions times. Results are written as JSON (per-call time in ns: mean, median, stddev, min, max).
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../SolarSystem/Camera.h"
+#include "../SolarSystem/Sphere.h"
+#include "../SolarSystem/Planet.h"
+#include "../SolarSystem/ModelMatrixBatch.h"
+#include "../SolarSystem/SinCos.h"
+#include "../SolarSystem/AsteroidBelt.h"
+#include "../SolarSystem/ImpactFragments.h"
+#include "../SolarSystem/FrameArena.h"
+#include "../SolarSystem/MortonOrder.h"
+#include "../SolarSystem/ParticleCollisions.h"
+#include "../SolarSystem/Random.h"
+#include "../SolarSystem/RingParticles.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../SolarSystem/stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BenchmarkOptions {
+    int repetitions = 10;
+    double minTime = 0.05;
+    std::string filter;
+    std::string assets = "../SolarSystem";
+    std::string out;
+};
+
+struct BenchmarkResult {
+    std::string name;
+    long long iterations;
+    double itemsPerCall;
+    std::vector<double> nsPerCall; // one entry per repetition
+};
+
+// keeps the optimizer from discarding a computed value
+template <typename T>
+inline void doNotOptimize(const T& value)
+{
+#if defined(_MSC_VER)
+    static volatile char sink;
+    sink = *reinterpret_cast<const volatile char*>(&value);
+#else
+    asm volatile("" : : "g"(&value) : "memory");
+#endif
+}
+
+class BenchmarkRunner {
+public:
+    BenchmarkOptions options;
+    std::vector<BenchmarkResult> results;
+
+    BenchmarkRunner(const BenchmarkOptions& options) : options(options) {}
+
+    // times body(); itemsPerCall scales the reported items_per_second
+    void run(const std::string& name, const std::function<void()>& body, double itemsPerCall = 1.0)
+    {
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+            return;
+
+        // warm up and find an iteration count that fills minTime
+        long long iterations = 1;
+        while (true) {
+            double elapsed = time(body, iterations);
+            if (elapsed >= options.minTime || iterations >= (1LL << 30))
+                break;
+            double scale = elapsed > 0.0 ? options.minTime / elapsed * 1.2 : 10.0;
+            iterations = std::max(iterations + 1, (long long)(iterations * std::min(scale, 10.0)));
+        }
+
+        BenchmarkResult result{ name, iterations, itemsPerCall, {} };
+        for (int r = 0; r < options.repetitions; ++r)
+            result.nsPerCall.push_back(time(body, iterations) * 1e9 / iterations);
+        results.push_back(result);
+
+        std::vector<double> sorted = result.nsPerCall;
+        std::sort(sorted.begin(), sorted.end());
+        std::cerr << name << ": " << sorted[sorted.size() / 2] << " ns (median of " << options.repetitions << " x " << iterations << ")" << std::endl;
+    }
+
+    void writeJson(std::ostream& out) const
+    {
+        out << "{\n  \"context\": {\n";
+        out << "    \"date\": " << (long long)std::time(nullptr) << ",\n";
+        out << "    \"compiler\": \"" << compilerName() << "\",\n";
+        out << "    \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+        out << "    \"repetitions\": " << options.repetitions << ",\n";
+        out << "    \"min_time\": " << options.minTime << "\n  },\n";
+        out << "  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const BenchmarkResult& r = results[i];
+            std::vector<double> sorted = r.nsPerCall;
+            std::sort(sorted.begin(), sorted.end());
+            double mean = 0.0;
+            for (double v : sorted) mean += v;
+            mean /= sorted.size();
+            double variance = 0.0;
+            for (double v : sorted) variance += (v - mean) * (v - mean);
+            double stddev = sorted.size() > 1 ? std::sqrt(variance / (sorted.size() - 1)) : 0.0;
+            double median = sorted.size() % 2 ? sorted[sorted.size() / 2] : 0.5 * (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]);
+
+            out << (i ? "," : "") << "\n    {\"name\": \"" << r.name << "\", \"unit\": \"ns\", \"iterations\": " << r.iterations
+                << ", \"repetitions\": " << sorted.size()
+                << ", \"mean\": " << mean << ", \"median\": " << median << ", \"stddev\": " << stddev
+                << ", \"cv\": " << (mean > 0.0 ? stddev / mean : 0.0)
+                << ", \"min\": " << sorted.front() << ", \"max\": " << sorted.back()
+                << ", \"items_per_second\": " << (median > 0.0 ? r.itemsPerCall * 1e9 / median : 0.0) << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+private:
+    static double time(const std::function<void()>& body, long long iterations)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < iterations; ++i)
+            body();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    static const char* compilerName()
+    {
+#if defined(__clang__)
+        return "clang " __clang_version__;
+#elif defined(__GNUC__)
+        return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+        return "msvc";
+#else
+        return "unknown";
+#endif
+    }
+};
+
+void benchmarkSphere(BenchmarkRunner& runner)
+{
+    const int tessellations[] = { 10, 20, 40, 80, 160 };
+    for (int divisions : tessellations) {
+        runner.run("sphere/generateSphereData/" + std::to_string(divisions) + "x" + std::to_string(divisions), [divisions]() {
+            std::vector<float> vertices;
+            std::vector<unsigned int> indices;
+            Sphere::generateSphereData(vertices, indices, divisions, divisions, 1.0f);
+            doNotOptimize(vertices.data());
+            doNotOptimize(indices.data());
+        });
+    }
+}
+
+void benchmarkCamera(BenchmarkRunner& runner)
+{
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+    runner.run("camera/GetViewMatrix", [&camera]() {
+        glm::mat4 view = camera.GetViewMatrix();
+        doNotOptimize(view);
+    });
+
+    float direction = 1.0f;
+    runner.run("camera/ProcessMouseMovement", [&camera, &direction]() {
+        direction = -direction; // alternate so pitch never saturates at the clamp
+        camera.ProcessMouseMovement(3.0f * direction, 2.0f * direction);
+        doNotOptimize(camera.Front);
+    });
+}
+
+void benchmarkPlanets(BenchmarkRunner& runner)
+{
+    float simTimeInDays = 0.0f;
+    runner.run("planets/planetOrbitPosition", [&simTimeInDays]() {
+        simTimeInDays += 0.01f;
+        for (const Planet& planet : SOLAR_SYSTEM_PLANETS) {
+            glm::vec3 position = planetOrbitPosition(planet, simTimeInDays);
+            doNotOptimize(position);
+        }
+    }, PLANET_COUNT);
+
+    float time = 0.0f;
+    runner.run("planets/planetModelMatrix", [&time]() {
+        time += 0.01f;
+        for (const Planet& planet : SOLAR_SYSTEM_PLANETS) {
+            glm::mat4 model = planetModelMatrix(planet, time, time, 1.0f, 1.0f);
+            doNotOptimize(model);
+        }
+    }, PLANET_COUNT);
+}
+
+// translate/rotate/scale through glm against the closed-form batch kernels, over a belt-sized crowd of bodies
+void benchmarkModelMatrices(BenchmarkRunner& runner)
+{
+    const size_t count = 100000;
+    TrsBatch batch;
+    batch.resize(count);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 axis = glm::normalize(glm::vec3(uniform(random), uniform(random), uniform(random)) + glm::vec3(0.0f, 0.01f, 0.0f));
+        batch.x[i] = 30.0f * uniform(random);
+        batch.y[i] = uniform(random);
+        batch.z[i] = 30.0f * uniform(random);
+        batch.axisX[i] = axis.x;
+        batch.axisY[i] = axis.y;
+        batch.axisZ[i] = axis.z;
+        batch.angle[i] = 100.0f * uniform(random);
+        batch.scale[i] = 0.01f + 0.01f * uniform(random);
+    }
+    std::vector<glm::mat4> reference(count), models(count);
+    auto glmPath = [&batch, &reference, count]() {
+        for (size_t i = 0; i < count; ++i) {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(batch.x[i], batch.y[i], batch.z[i]));
+            model = glm::rotate(model, batch.angle[i], glm::vec3(batch.axisX[i], batch.axisY[i], batch.axisZ[i]));
+            reference[i] = glm::scale(model, glm::vec3(batch.scale[i]));
+        }
+        doNotOptimize(reference.data());
+    };
+    glmPath();
+    // the kernels have to agree with glm before their times mean anything
+    auto check = [&reference, &models, count](const char* name) {
+        float worst = 0.0f;
+        for (size_t i = 0; i < count; ++i)
+            for (int c = 0; c < 4; ++c)
+                for (int r = 0; r < 4; ++r)
+                    worst = std::max(worst, std::abs(models[i][c][r] - reference[i][c][r]));
+        if (worst > 1e-4f)
+            std::cerr << "ERROR::BENCHMARK::MISMATCH: " << name << " is off from glm by " << worst << std::endl;
+    };
+
+    runner.run("models/glm_translate_rotate_scale/100000", glmPath, (double)count);
+    buildModelMatricesScalar(batch, 0, count, &models[0][0][0]);
+    check("closed_form_scalar");
+    runner.run("models/closed_form_scalar/100000", [&batch, &models, count]() {
+        buildModelMatricesScalar(batch, 0, count, &models[0][0][0]);
+        doNotOptimize(models.data());
+    }, (double)count);
+#ifdef SOLAR_HAS_AVX2_KERNELS
+    if (cpuHasAvx2()) {
+        std::fill(models.begin(), models.end(), glm::mat4(0.0f));
+        buildModelMatricesAvx2(batch, 0, count, &models[0][0][0]);
+        check("closed_form_avx2");
+        runner.run("models/closed_form_avx2/100000", [&batch, &models, count]() {
+            buildModelMatricesAvx2(batch, 0, count, &models[0][0][0]);
+            doNotOptimize(models.data());
+        }, (double)count);
+    }
+    else {
+        std::cerr << "skipping models/closed_form_avx2: no AVX2 on this CPU" << std::endl;
+    }
+#endif
+}
+
+// Speed of every sincos tier and kernel against the C library, and an accuracy table: the worst absolute error
+// against double sin and cos over angles in a few ranges, the last one past the Cody-Waite reduction.
+void benchmarkSinCos(BenchmarkRunner& runner)
+{
+    const size_t count = 100000;
+    const char* tierNames[] = { "fast", "medium", "full" };
+    const SinCosPrecision tiers[] = { SinCosPrecision::Fast, SinCosPrecision::Medium, SinCosPrecision::Full };
+    std::vector<float> angles(count), sines(count), cosines(count);
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> uniform(-glm::pi<float>(), glm::pi<float>());
+    for (float& angle : angles)
+        angle = uniform(random);
+
+    runner.run("sincos/std/100000", [&angles, &sines, &cosines, count]() {
+        for (size_t i = 0; i < count; ++i) {
+            sines[i] = std::sin(angles[i]);
+            cosines[i] = std::cos(angles[i]);
+        }
+        doNotOptimize(sines.data());
+        doNotOptimize(cosines.data());
+    }, (double)count);
+    for (int t = 0; t < 3; ++t) {
+        SinCosPrecision precision = tiers[t];
+        runner.run(std::string("sincos/scalar_") + tierNames[t] + "/100000", [&angles, &sines, &cosines, count, precision]() {
+            for (size_t i = 0; i < count; ++i)
+                sinCos(angles[i], sines[i], cosines[i], precision);
+            doNotOptimize(sines.data());
+            doNotOptimize(cosines.data());
+        }, (double)count);
+        runner.run(std::string("sincos/float4_") + tierNames[t] + "/100000", [&angles, &sines, &cosines, count, t]() {
+            if (t == 0) sinCosFloat4<SinCosPrecision::Fast>(angles.data(), sines.data(), cosines.data(), count);
+            else if (t == 1) sinCosFloat4<SinCosPrecision::Medium>(angles.data(), sines.data(), cosines.data(), count);
+            else sinCosFloat4<SinCosPrecision::Full>(angles.data(), sines.data(), cosines.data(), count);
+            doNotOptimize(sines.data());
+            doNotOptimize(cosines.data());
+        }, (double)count);
+#ifdef SOLAR_HAS_AVX2_KERNELS
+        if (cpuHasAvx2()) {
+            runner.run(std::string("sincos/avx2_") + tierNames[t] + "/100000", [&angles, &sines, &cosines, count, t]() {
+                if (t == 0) sinCosAvx2<SinCosPrecision::Fast>(angles.data(), sines.data(), cosines.data(), count);
+                else if (t == 1) sinCosAvx2<SinCosPrecision::Medium>(angles.data(), sines.data(), cosines.data(), count);
+                else sinCosAvx2<SinCosPrecision::Full>(angles.data(), sines.data(), cosines.data(), count);
+                doNotOptimize(sines.data());
+                doNotOptimize(cosines.data());
+            }, (double)count);
+        }
+#endif
+    }
+
+    if (!runner.options.filter.empty() && std::string("sincos/accuracy").find(runner.options.filter) == std::string::npos)
+        return;
+    const float ranges[] = { glm::pi<float>(), 100.0f, SINCOS_REDUCTION_LIMIT, 1e6f };
+    std::cerr << "sincos/accuracy: max abs error against double, angles in [-range, range]" << std::endl;
+    std::cerr << std::setw(10) << "range" << std::setw(12) << "std" << std::setw(12) << "fast" << std::setw(12) << "medium" << std::setw(12) << "full" << std::endl;
+    for (float range : ranges) {
+        std::uniform_real_distribution<float> spread(-range, range);
+        for (float& angle : angles)
+            angle = spread(random);
+        auto worst = [&angles, &sines, &cosines, count]() {
+            double error = 0.0;
+            for (size_t i = 0; i < count; ++i) {
+                double angle = angles[i];
+                error = std::max(error, std::abs(sines[i] - std::sin(angle)));
+                error = std::max(error, std::abs(cosines[i] - std::cos(angle)));
+            }
+            return error;
+        };
+        for (size_t i = 0; i < count; ++i) {
+            sines[i] = std::sin(angles[i]);
+            cosines[i] = std::cos(angles[i]);
+        }
+        std::cerr << std::setw(10) << range << std::setprecision(3) << std::setw(12) << worst();
+        for (SinCosPrecision precision : tiers) {
+            sinCos(angles.data(), sines.data(), cosines.data(), count, precision);
+            std::cerr << std::setw(12) << worst();
+        }
+        std::cerr << std::setprecision(6) << std::endl;
+    }
+}
+
+// filling the entity store, and the belt's propagation system at a million asteroids: it reads the orbit, spin
+// and size columns and never the shapes
+void benchmarkEntities(BenchmarkRunner& runner)
+{
+    runner.run("entities/create/100000", []() {
+        EntityStore store;
+        store.reserve<CircularOrbit, Spin, BodySize, BodyShape>(100000);
+        for (int i = 0; i < 100000; ++i)
+            store.create(CircularOrbit{ 20.0f, 0.1f, 0.0f, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) }, Spin{ glm::vec3(0.0f, 1.0f, 0.0f), 1.0f }, BodySize{ 0.01f }, BodyShape{ i % 6 });
+        doNotOptimize(store.size());
+    }, 100000.0);
+
+    if (!runner.options.filter.empty() && std::string("entities/belt_modelMatrices/1000000").find(runner.options.filter) == std::string::npos)
+        return;
+    AsteroidBelt belt;
+    belt.generate(1000000);
+    std::vector<float> models(belt.asteroids.size() * 16);
+    double simTime = 0.0;
+    runner.run("entities/belt_modelMatrices/1000000", [&belt, &models, &simTime]() {
+        simTime += 0.016;
+        belt.modelMatrices(simTime, 1.0f, 1.0f, 40.0f, models.data());
+        doNotOptimize(models.data());
+    }, 1000000.0);
+}
+
+// Positions of a million belt bodies, as generated (in no order in space) and sorted by Morton code, run through
+// two kernels that read them by location: a neighbour sum over a uniform grid, the inner loop of a short-range
+// force, and a frustum cull that tests blocks of 64 consecutive bodies before the bodies in them. Both do the
+// same arithmetic either way; the difference is how often they wait on memory, and for the cull how many blocks
+// are tight enough to skip.
+struct BodyPositions {
+    std::vector<float> x, y, z;
+
+    void resize(size_t count) {
+        x.resize(count);
+        y.resize(count);
+        z.resize(count);
+    }
+};
+
+// bodies of positions in a grid of cells of the given size: cell c holds bodies[cellStart[c]] up to
+// bodies[cellStart[c + 1]], in the order they're stored
+struct BodyGrid {
+    glm::vec3 origin;
+    float cellSize;
+    int nx, ny, nz;
+    std::vector<int> cellStart;
+    std::vector<int> bodies;
+
+    BodyGrid(const BodyPositions& positions, float size) : cellSize(size) {
+        size_t count = positions.x.size();
+        glm::vec3 boxMin(3.4e38f), boxMax(-3.4e38f);
+        for (size_t i = 0; i < count; ++i) {
+            boxMin = glm::min(boxMin, glm::vec3(positions.x[i], positions.y[i], positions.z[i]));
+            boxMax = glm::max(boxMax, glm::vec3(positions.x[i], positions.y[i], positions.z[i]));
+        }
+        origin = boxMin;
+        nx = (int)((boxMax.x - boxMin.x) / cellSize) + 1;
+        ny = (int)((boxMax.y - boxMin.y) / cellSize) + 1;
+        nz = (int)((boxMax.z - boxMin.z) / cellSize) + 1;
+        cellStart.assign((size_t)nx * ny * nz + 1, 0);
+        std::vector<int> cells(count);
+        for (size_t i = 0; i < count; ++i) {
+            cells[i] = cell(positions.x[i], positions.y[i], positions.z[i]);
+            ++cellStart[cells[i] + 1];
+        }
+        for (size_t c = 1; c < cellStart.size(); ++c)
+            cellStart[c] += cellStart[c - 1];
+        std::vector<int> next(cellStart.begin(), cellStart.end() - 1);
+        bodies.resize(count);
+        for (size_t i = 0; i < count; ++i)
+            bodies[next[cells[i]]++] = (int)i;
+    }
+
+    int cell(float x, float y, float z) const {
+        int cx = std::min(nx - 1, (int)((x - origin.x) / cellSize));
+        int cy = std::min(ny - 1, (int)((y - origin.y) / cellSize));
+        int cz = std::min(nz - 1, (int)((z - origin.z) / cellSize));
+        return (cz * ny + cy) * nx + cx;
+    }
+};
+
+// softened inverse-square pull on every body from the bodies in its own and the 26 cells around it
+inline float neighbourForces(const BodyPositions& positions, const BodyGrid& grid, std::vector<glm::vec3>& forces)
+{
+    const float softening = 1e-4f;
+    float sum = 0.0f;
+    for (size_t i = 0; i < positions.x.size(); ++i) {
+        glm::vec3 p(positions.x[i], positions.y[i], positions.z[i]);
+        int cx = std::min(grid.nx - 1, (int)((p.x - grid.origin.x) / grid.cellSize));
+        int cy = std::min(grid.ny - 1, (int)((p.y - grid.origin.y) / grid.cellSize));
+        int cz = std::min(grid.nz - 1, (int)((p.z - grid.origin.z) / grid.cellSize));
+        glm::vec3 force(0.0f);
+        for (int z = std::max(cz - 1, 0); z <= std::min(cz + 1, grid.nz - 1); ++z)
+            for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, grid.ny - 1); ++y) {
+                int row = (z * grid.ny + y) * grid.nx;
+                int first = grid.cellStart[row + std::max(cx - 1, 0)], last = grid.cellStart[row + std::min(cx + 1, grid.nx - 1) + 1];
+                for (int k = first; k < last; ++k) {
+                    int j = grid.bodies[k];
+                    glm::vec3 d(positions.x[j] - p.x, positions.y[j] - p.y, positions.z[j] - p.z);
+                    float r2 = glm::dot(d, d) + softening;
+                    force += d / (r2 * std::sqrt(r2));
+                }
+            }
+        forces[i] = force;
+        sum += force.x;
+    }
+    return sum;
+}
+
+const size_t CULL_BLOCK = 64;
+
+// the box around each block of CULL_BLOCK consecutive bodies, grown by radius
+inline void blockBounds(const BodyPositions& positions, float radius, std::vector<glm::vec3>& boxMin, std::vector<glm::vec3>& boxMax)
+{
+    size_t count = positions.x.size(), blocks = (count + CULL_BLOCK - 1) / CULL_BLOCK;
+    boxMin.assign(blocks, glm::vec3(3.4e38f));
+    boxMax.assign(blocks, glm::vec3(-3.4e38f));
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 p(positions.x[i], positions.y[i], positions.z[i]);
+        boxMin[i / CULL_BLOCK] = glm::min(boxMin[i / CULL_BLOCK], p - radius);
+        boxMax[i / CULL_BLOCK] = glm::max(boxMax[i / CULL_BLOCK], p + radius);
+    }
+}
+
+// bodies inside the frustum's planes; blocks whose box is outside one are skipped whole. tested counts the
+// bodies that had to be looked at one by one.
+inline size_t cullBlocks(const BodyPositions& positions, float radius, const std::vector<glm::vec3>& boxMin, const std::vector<glm::vec3>& boxMax,
+                         const glm::vec4* planes, size_t& tested)
+{
+    size_t visible = 0;
+    tested = 0;
+    for (size_t b = 0; b < boxMin.size(); ++b) {
+        bool outside = false;
+        for (int k = 0; k < 6 && !outside; ++k) {
+            // the box corner furthest along the plane's normal
+            glm::vec3 corner(planes[k].x > 0.0f ? boxMax[b].x : boxMin[b].x, planes[k].y > 0.0f ? boxMax[b].y : boxMin[b].y, planes[k].z > 0.0f ? boxMax[b].z : boxMin[b].z);
+            outside = glm::dot(glm::vec3(planes[k]), corner) + planes[k].w < 0.0f;
+        }
+        if (outside) continue;
+        size_t last = std::min(positions.x.size(), (b + 1) * CULL_BLOCK);
+        tested += last - b * CULL_BLOCK;
+        for (size_t i = b * CULL_BLOCK; i < last; ++i) {
+            bool inside = true;
+            for (int k = 0; k < 6 && inside; ++k)
+                inside = planes[k].x * positions.x[i] + planes[k].y * positions.y[i] + planes[k].z * positions.z[i] + planes[k].w >= -radius;
+            visible += inside;
+        }
+    }
+    return visible;
+}
+
+void benchmarkMorton(BenchmarkRunner& runner)
+{
+    const char* names[] = { "morton/radix_sort/1000000", "morton/belt_sortByLocation/1000000", "morton/forces/unsorted/1000000",
+                            "morton/forces/sorted/1000000", "morton/cull/unsorted/1000000", "morton/cull/sorted/1000000" };
+    if (!runner.options.filter.empty() && std::none_of(std::begin(names), std::end(names), [&runner](const char* name) { return std::string(name).find(runner.options.filter) != std::string::npos; }))
+        return;
+    const size_t count = 1000000;
+    AsteroidBelt belt;
+    belt.generate((int)count);
+    std::vector<float> models(count * 16);
+    belt.modelMatrices(100.0, 1.0f, 1.0f, 40.0f, models.data());
+
+    BodyPositions unsorted, sorted;
+    unsorted.x = belt.transforms.x;
+    unsorted.y = belt.transforms.y;
+    unsorted.z = belt.transforms.z;
+    glm::vec3 boxMin(3.4e38f), boxMax(-3.4e38f);
+    for (size_t i = 0; i < count; ++i) {
+        boxMin = glm::min(boxMin, glm::vec3(unsorted.x[i], unsorted.y[i], unsorted.z[i]));
+        boxMax = glm::max(boxMax, glm::vec3(unsorted.x[i], unsorted.y[i], unsorted.z[i]));
+    }
+    MortonGrid mortonGrid(boxMin, boxMax);
+    std::vector<uint64_t> codes(count), keys(count), keyScratch(count);
+    std::vector<uint32_t> order(count), orderScratch(count);
+    for (size_t i = 0; i < count; ++i)
+        codes[i] = mortonGrid.code(unsorted.x[i], unsorted.y[i], unsorted.z[i]);
+    ThreadPool pool;
+    runner.run("morton/radix_sort/1000000", [&]() {
+        std::copy(codes.begin(), codes.end(), keys.begin());
+        for (size_t i = 0; i < count; ++i)
+            order[i] = (uint32_t)i;
+        radixSortByKey(keys.data(), order.data(), keyScratch.data(), orderScratch.data(), count, MORTON_BITS, &pool);
+        doNotOptimize(order.data());
+    }, (double)count);
+    runner.run("morton/belt_sortByLocation/1000000", [&]() {
+        belt.sortByLocation(&pool);
+        doNotOptimize(belt.SortedSpacing);
+    }, (double)count);
+
+    std::copy(codes.begin(), codes.end(), keys.begin());
+    for (size_t i = 0; i < count; ++i)
+        order[i] = (uint32_t)i;
+    radixSortByKey(keys.data(), order.data(), keyScratch.data(), orderScratch.data(), count, MORTON_BITS, &pool);
+    sorted.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        sorted.x[i] = unsorted.x[order[i]];
+        sorted.y[i] = unsorted.y[order[i]];
+        sorted.z[i] = unsorted.z[order[i]];
+    }
+    std::cerr << "morton: mean spacing of consecutive bodies " << meanNeighbourSpacing(unsorted.x.data(), unsorted.y.data(), unsorted.z.data(), 0, count)
+              << " unsorted, " << meanNeighbourSpacing(sorted.x.data(), sorted.y.data(), sorted.z.data(), 0, count) << " sorted" << std::endl;
+
+    // about one body a cell
+    const float cellSize = 0.15f;
+    BodyGrid unsortedGrid(unsorted, cellSize), sortedGrid(sorted, cellSize);
+    std::vector<glm::vec3> forces(count);
+    runner.run("morton/forces/unsorted/1000000", [&]() {
+        doNotOptimize(neighbourForces(unsorted, unsortedGrid, forces));
+    }, (double)count);
+    runner.run("morton/forces/sorted/1000000", [&]() {
+        doNotOptimize(neighbourForces(sorted, sortedGrid, forces));
+    }, (double)count);
+
+    // looking along the belt from just inside it
+    glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f) *
+                               glm::lookAt(glm::vec3(0.0f, 2.0f, -22.0f), glm::vec3(15.0f, 0.0f, -15.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::vec4 planes[6];
+    for (int axis = 0; axis < 3; ++axis) {
+        glm::vec4 row(viewProjection[0][axis], viewProjection[1][axis], viewProjection[2][axis], viewProjection[3][axis]);
+        glm::vec4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+        planes[2 * axis] = w + row;
+        planes[2 * axis + 1] = w - row;
+    }
+    for (glm::vec4& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+    const float radius = 0.01f;
+    std::vector<glm::vec3> unsortedMin, unsortedMax, sortedMin, sortedMax;
+    blockBounds(unsorted, radius, unsortedMin, unsortedMax);
+    blockBounds(sorted, radius, sortedMin, sortedMax);
+    size_t visible = 0, unsortedTested = 0, sortedTested = 0;
+    runner.run("morton/cull/unsorted/1000000", [&]() {
+        visible = cullBlocks(unsorted, radius, unsortedMin, unsortedMax, planes, unsortedTested);
+        doNotOptimize(visible);
+    }, (double)count);
+    runner.run("morton/cull/sorted/1000000", [&]() {
+        visible = cullBlocks(sorted, radius, sortedMin, sortedMax, planes, sortedTested);
+        doNotOptimize(visible);
+    }, (double)count);
+    std::cerr << "morton/cull: " << visible << " visible; " << unsortedTested << " bodies tested one by one unsorted, " << sortedTested << " sorted" << std::endl;
+}
+
+// One step of a million small spheres drifting about in a thin slab, as in a ring, with each response, on 1, 2
+// and 4 threads. Every call starts from the same state. Throughput is reported as candidate pairs (found by the
+// grid, then swept) and collisions per second.
+void benchmarkCollisions(BenchmarkRunner& runner)
+{
+    const CollisionResponse responses[] = { COLLISION_MERGE, COLLISION_BOUNCE, COLLISION_FRAGMENT };
+    const int threadCounts[] = { 1, 2, 4 };
+    std::vector<std::string> names;
+    for (CollisionResponse response : responses)
+        for (int threads : threadCounts)
+            names.push_back(std::string("collisions/") + collisionResponseName(response) + "/threads_" + std::to_string(threads) + "/1000000");
+    if (!runner.options.filter.empty() && std::none_of(names.begin(), names.end(), [&runner](const std::string& name) { return name.find(runner.options.filter) != std::string::npos; }))
+        return;
+
+    const size_t count = 1000000;
+    const float dt = 0.05f;
+    CollisionParticles initial;
+    std::mt19937 random(3);
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 position(100.0f * uniform(random), uniform(random), 100.0f * uniform(random));
+        glm::vec3 velocity(uniform(random) - 0.5f, 0.1f * (uniform(random) - 0.5f), uniform(random) - 0.5f);
+        float radius = 0.01f + 0.01f * uniform(random);
+        initial.push_back(position, velocity, radius, radius * radius * radius);
+    }
+    CollisionParticles particles;
+    particles.reserve(count * 11 / 10);
+
+    size_t name = 0;
+    for (CollisionResponse response : responses)
+        for (int threads : threadCounts) {
+            std::unique_ptr<ThreadPool> pool(threads > 1 ? new ThreadPool(threads - 1) : nullptr);
+            ParticleCollisions collisions;
+            collisions.Response = response;
+            collisions.MinFragmentRadius = 0.004f;
+            size_t results = runner.results.size();
+            runner.run(names[name++], [&]() {
+                particles = initial;
+                collisions.step(particles, dt, pool.get());
+                doNotOptimize(particles.x.data());
+            }, (double)count);
+            if (runner.results.size() == results) continue;
+            std::vector<double> sorted = runner.results.back().nsPerCall;
+            std::sort(sorted.begin(), sorted.end());
+            double seconds = sorted[sorted.size() / 2] * 1e-9;
+            std::cerr << runner.results.back().name << ": " << collisions.CandidatePairs / seconds << " candidate pairs/s, " << collisions.Collisions / seconds
+                      << " collisions/s (" << collisions.CandidatePairs << " pairs, " << collisions.Contacts << " contacts, " << collisions.Collisions
+                      << " collisions, " << particles.size() << " particles after the step)" << std::endl;
+        }
+}
+
+// Saturn's rings: placing a million and four million particles for a frame, on 1 and 4 threads, as the renderer
+// does into its mapped buffer, and a collision step of a million with the bouncing response. The ring keeps
+// turning from one call to the next, and the collisions carry on from the last call's.
+void benchmarkRings(BenchmarkRunner& runner)
+{
+    const size_t counts[] = { 1000000, 4000000 };
+    const int threadCounts[] = { 1, 4 };
+    std::vector<std::string> names;
+    for (size_t count : counts)
+        for (int threads : threadCounts)
+            names.push_back("rings/place/threads_" + std::to_string(threads) + "/" + std::to_string(count));
+    names.push_back("rings/collide/bounce/1000000");
+    if (!runner.options.filter.empty() && std::none_of(names.begin(), names.end(), [&runner](const std::string& name) { return name.find(runner.options.filter) != std::string::npos; }))
+        return;
+
+    const float spin = SOLAR_SYSTEM_PLANETS[4].rotationSpeed * std::pow(1.86f, 1.5f); // as SaturnRings has it
+    size_t name = 0;
+    std::vector<float> out;
+    for (size_t count : counts) {
+        RingParticles rings;
+        rings.generate((int)count, spin);
+        out.resize(count * 4);
+        for (int threads : threadCounts) {
+            std::unique_ptr<ThreadPool> pool(threads > 1 ? new ThreadPool(threads - 1) : nullptr);
+            double time = 0.0;
+            runner.run(names[name++], [&]() {
+                time += 1.0 / 60.0;
+                rings.update(time, count, out.data(), pool.get());
+                doNotOptimize(out.data());
+            }, (double)count);
+        }
+    }
+
+    if (!runner.options.filter.empty() && names.back().find(runner.options.filter) == std::string::npos)
+        return;
+    RingParticles rings;
+    rings.generate(1000000, spin);
+    rings.Collisions = true;
+    rings.collisions.Response = COLLISION_BOUNCE;
+    double time = 0.0;
+    rings.update(time, 0, nullptr);
+    size_t results = runner.results.size();
+    runner.run(names.back(), [&]() {
+        time += rings.MaxCollisionStep;
+        rings.update(time, 0, nullptr);
+        doNotOptimize(&rings.collisions.Collisions);
+    }, 1000000.0);
+    if (runner.results.size() > results)
+        std::cerr << names.back() << ": " << rings.collisions.CandidatePairs << " pairs, " << rings.collisions.Contacts << " contacts, "
+                  << rings.collisions.Collisions << " collisions in the last step" << std::endl;
+}
+
+// a steady stream of 10000 impact fragments a frame, each living ten frames: spawning, expiring and the matrices
+// of the hundred thousand alive. Once the pool has grown to that, a frame shouldn't allocate at all.
+void benchmarkSlotMap(BenchmarkRunner& runner)
+{
+    SlotMap<int> handles;
+    handles.reserve(10000);
+    runner.run("slotmap/insert_erase/10000", [&handles]() {
+        for (int i = 0; i < 10000; ++i)
+            handles.insert(i);
+        for (size_t i = handles.size(); i > 0; --i)
+            handles.eraseAt(i - 1);
+        doNotOptimize(handles.data());
+    }, 10000.0);
+
+    if (!runner.options.filter.empty() && std::string("slotmap/impact_frame/10000").find(runner.options.filter) == std::string::npos)
+        return;
+    ImpactFragments impacts;
+    impacts.Lifetime = 0.16f;
+    std::vector<float> models;
+    double simTime = 0.0;
+    auto frame = [&impacts, &models, &simTime]() {
+        simTime += 0.016;
+        impacts.expire(simTime);
+        impacts.spawn(glm::vec3(26.0f, 0.0f, 0.0f), 0.4f, glm::vec3(-1.0f, 0.0f, 0.0f), 10000, simTime);
+        models.resize(impacts.fragments.size() * 16);
+        impacts.modelMatrices(simTime, models.data());
+        doNotOptimize(models.data());
+    };
+    for (int i = 0; i < 20; ++i)
+        frame();
+    int growths = impacts.fragments.Growths;
+    runner.run("slotmap/impact_frame/10000", frame, 10000.0);
+    std::cerr << "slotmap/impact_frame/10000: " << impacts.fragments.size() << " live, pool grew " << impacts.fragments.Growths - growths
+              << " times after warming up" << std::endl;
+}
+
+// a frame's worth of small temporary lists, grown without reserving, from the heap and from the frame arena
+void benchmarkFrameArena(BenchmarkRunner& runner)
+{
+    runner.run("arena/std_vector/100x100", []() {
+        for (int list = 0; list < 100; ++list) {
+            std::vector<int> values;
+            for (int i = 0; i < 100; ++i)
+                values.push_back(i);
+            doNotOptimize(values.data());
+        }
+    }, 10000.0);
+    runner.run("arena/frame_vector/100x100", []() {
+        beginFrameArenas();
+        for (int list = 0; list < 100; ++list) {
+            FrameVector<int> values = frameVector<int>();
+            for (int i = 0; i < 100; ++i)
+                values.push_back(i);
+            doNotOptimize(values.data());
+        }
+    }, 10000.0);
+}
+
+void benchmarkTextures(BenchmarkRunner& runner)
+{
+    std::vector<const char*> files(PLANET_TEXTURES, PLANET_TEXTURES + PLANET_COUNT);
+    files.push_back(SUN_TEXTURE);
+    for (const char* file : files) {
+        std::ifstream in(runner.options.assets + "/" + file, std::ios::binary);
+        if (!in) {
+            std::cerr << "skipping texture/decode/" << file << ": not found in " << runner.options.assets << std::endl;
+            continue;
+        }
+        // decode from memory so disk IO isn't part of the measurement
+        std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        runner.run(std::string("texture/decode/") + file, [&bytes]() {
+            int width, height, nrComponents;
+            unsigned char* data = stbi_load_from_memory(bytes.data(), (int)bytes.size(), &width, &height, &nrComponents, 0);
+            doNotOptimize(data);
+            stbi_image_free(data);
+        });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--repetitions" && hasValue) options.repetitions = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--min-time" && hasValue) options.minTime = std::atof(argv[++i]);
+        else if (arg == "--filter" && hasValue) options.filter = argv[++i];
+        else if (arg == "--assets" && hasValue) options.assets = argv[++i];
+        else if (arg == "--out" && hasValue) options.out = argv[++i];
+        else {
+            std::cout << "usage: " << argv[0] << " [--repetitions N] [--min-time seconds] [--filter substring] [--assets dir] [--out file.json]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    BenchmarkRunner runner(options);
+    benchmarkSphere(runner);
+    benchmarkCamera(runner);
+    benchmarkPlanets(runner);
+    benchmarkModelMatrices(runner);
+    benchmarkSinCos(runner);
+    benchmarkEntities(runner);
+    benchmarkMorton(runner);
+    benchmarkCollisions(runner);
+    benchmarkRings(runner);
+    benchmarkSlotMap(runner);
+    benchmarkFrameArena(runner);
+    benchmarkTextures(runner);
+
+    if (options.out.empty()) {
+        runner.writeJson(std::cout);
+    }
+    else {
+        std::ofstream out(options.out);
+        if (!out) {
+            std::cout << "ERROR::BENCHMARK::CANNOT_WRITE: " << options.out << std::endl;
+            return 1;
+        }
+        runner.writeJson(out);
+    }
+    return 0;
+}
@@ -0,0 +1,227 @@
+#pragma once
+#ifndef ASTEROID_BELT_H
+#define ASTEROID_BELT_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "Sphere.h"
+#include "ModelMatrixBatch.h"
+#include "EntityStore.h"
+#include "BodyComponents.h"
+#include "MemoryLedger.h"
+#include "MortonOrder.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Rocks between the orbits of Mars and Jupiter, each on its own slightly tilted circular orbit and tumbling
+// around its own axis. They come in a handful of lumpy shapes, which makes them the scene's many small draws of
+// differing meshes. Generated from a seed, so every run draws the same belt. Rocks on neighbouring orbits drift
+// apart, so the belt is re-sorted now and then to keep rocks that are close in space close in memory.
+class AsteroidBelt {
+
+public:
+    static const int SHAPE_COUNT = 6;
+
+    // One entity per rock, each with a CircularOrbit, Spin, BodySize and BodyShape, created in order of shape so
+    // consecutive asteroids can share an instanced draw. They all share one archetype, so every query over them
+    // visits them in that same order; sortByLocation reorders them within each shape.
+    EntityStore asteroids;
+    // the asteroids' transforms at the last modelMatrices; the spin axes are set once by generate
+    TrsBatch transforms;
+    // for the orbits and the spins; a millionth of the belt's radius is far below a pixel
+    SinCosPrecision Precision = SinCosPrecision::Medium;
+    // updateOrder sorts the belt again once the mean distance between consecutive asteroids has grown to
+    // ResortFactor times what the last sort left, measuring it every LocalityCheckInterval calls
+    float ResortFactor = 1.5f;
+    int LocalityCheckInterval = 60;
+    int Sorts = 0;
+    float SortedSpacing = 0.0f; // right after the last sort
+    float Spacing = 0.0f;       // at the last check
+
+    // unit-sized rock meshes: low-poly spheres pushed in and out by a few smooth lobes. The lobes don't depend on
+    // the divisions, so each shape keeps its look at every level of detail.
+    static std::vector<SphereMesh> generateShapes(int latitudeDivisions = 6, int longitudeDivisions = 8) {
+        MemoryScope scope(MEMORY_MESHES);
+        std::vector<SphereMesh> shapes;
+        std::mt19937 random(7);
+        for (int s = 0; s < SHAPE_COUNT; ++s) {
+            shapes.emplace_back(latitudeDivisions, longitudeDivisions);
+            glm::vec3 lobes[4];
+            float heights[4];
+            for (int l = 0; l < 4; ++l) {
+                lobes[l] = randomDirection(random);
+                heights[l] = 0.9f * uniform(random) - 0.4f;
+            }
+            // displacement depends only on the position, so the seam and pole vertices stay together
+            std::vector<float>& vertices = shapes.back().vertices;
+            for (size_t v = 0; v < vertices.size(); v += 5) {
+                glm::vec3 p(vertices[v], vertices[v + 1], vertices[v + 2]);
+                float radius = 1.0f;
+                for (int l = 0; l < 4; ++l) {
+                    float d = std::max(0.0f, glm::dot(p, lobes[l]));
+                    radius += heights[l] * d * d;
+                }
+                vertices[v] = p.x * radius;
+                vertices[v + 1] = p.y * radius;
+                vertices[v + 2] = p.z * radius;
+            }
+        }
+        return shapes;
+    }
+
+    void generate(int count, unsigned int seed = 1) {
+        MemoryScope scope(MEMORY_ASTEROIDS);
+        positionsValid = false;
+        Sorts = 0;
+        SortedSpacing = Spacing = 0.0f;
+        checkCountdown = 0;
+        asteroids.clear();
+        asteroids.reserve<CircularOrbit, Spin, BodySize, BodyShape>(std::max(count, 0));
+        std::mt19937 random(seed);
+        for (int i = 0; i < count; ++i) {
+            CircularOrbit orbit;
+            // denser towards the middle of the belt
+            orbit.radius = 18.0f + 4.0f * (uniform(random) + uniform(random));
+            orbit.turnsPerDay = std::pow(5.0f / orbit.radius, 1.5f); // Kepler, with the earth's orbit at 5
+            orbit.phase = uniform(random) * glm::two_pi<float>();
+            float inclination = (uniform(random) - 0.5f) * 0.12f;
+            float node = uniform(random) * glm::two_pi<float>();
+            glm::vec3 nodeAxis(std::cos(node), 0.0f, std::sin(node));
+            glm::mat3 tilt = glm::mat3(glm::rotate(glm::mat4(1.0f), inclination, nodeAxis));
+            orbit.u = tilt * glm::vec3(1.0f, 0.0f, 0.0f);
+            orbit.v = tilt * glm::vec3(0.0f, 0.0f, 1.0f);
+            Spin spin;
+            spin.axis = randomDirection(random);
+            spin.turnsPerSecond = 0.2f + 2.0f * uniform(random);
+            BodySize size = { 0.0015f + 0.0045f * uniform(random) * uniform(random) };
+            BodyShape shape = { (int)((size_t)i * SHAPE_COUNT / count) };
+            asteroids.create(orbit, spin, size, shape);
+        }
+        transforms.resize(asteroids.size());
+        copySpinAxes();
+        // everything the sorts need, so they never allocate
+        orbitAngles.resize(asteroids.size());
+        sortKeys.resize(asteroids.size());
+        sortKeyScratch.resize(asteroids.size());
+        sortOrder.resize(asteroids.size());
+        sortOrderScratch.resize(asteroids.size());
+        rowScratch.resize(asteroids.size() * sizeof(CircularOrbit)); // the largest component
+    }
+
+    // Sorts the asteroids of each shape by the Morton code of where they were at the last modelMatrices, so a pass
+    // over consecutive asteroids stays within one part of the belt for a while. Keeps the shapes in order, and so
+    // the draw batches as they are. Entity handles stay valid.
+    void sortByLocation(ThreadPool* pool = nullptr) {
+        size_t count = asteroids.size();
+        if (!positionsValid || count < 2) return;
+        glm::vec3 boxMin(transforms.x[0], transforms.y[0], transforms.z[0]), boxMax = boxMin;
+        for (size_t i = 1; i < count; ++i) {
+            glm::vec3 p(transforms.x[i], transforms.y[i], transforms.z[i]);
+            boxMin = glm::min(boxMin, p);
+            boxMax = glm::max(boxMax, p);
+        }
+        MortonGrid grid(boxMin, boxMax);
+        for (size_t i = 0; i < count; ++i) {
+            sortKeys[i] = grid.code(transforms.x[i], transforms.y[i], transforms.z[i]);
+            sortOrder[i] = (uint32_t)i;
+        }
+        size_t first = 0;
+        asteroids.eachChunk<BodyShape>([&](size_t rows, const Entity*, const BodyShape* shapes) {
+            for (size_t begin = 0; begin < rows;) {
+                size_t end = begin + 1;
+                while (end < rows && shapes[end].mesh == shapes[begin].mesh) ++end;
+                size_t at = first + begin;
+                radixSortByKey(&sortKeys[at], &sortOrder[at], &sortKeyScratch[at], &sortOrderScratch[at], end - begin, MORTON_BITS, pool);
+                begin = end;
+            }
+            first += rows;
+        });
+        asteroids.permute<CircularOrbit, Spin, BodySize, BodyShape>(sortOrder.data(), rowScratch);
+        // the positions go along, for measuring; the rest of the transforms are rebuilt from the components
+        for (std::vector<float>* component : { &transforms.x, &transforms.y, &transforms.z }) {
+            for (size_t i = 0; i < count; ++i)
+                orbitAngles[i] = (*component)[sortOrder[i]];
+            std::copy(orbitAngles.begin(), orbitAngles.begin() + count, component->begin());
+        }
+        copySpinAxes();
+        SortedSpacing = Spacing = meanNeighbourSpacing(transforms.x.data(), transforms.y.data(), transforms.z.data(), 0, count);
+        ++Sorts;
+    }
+
+    // call once a frame before modelMatrices: sorts the belt once modelMatrices has placed it, and again whenever
+    // the asteroids have drifted too far out of order
+    void updateOrder(ThreadPool* pool = nullptr) {
+        if (!positionsValid) return;
+        if (Sorts == 0) {
+            sortByLocation(pool);
+            return;
+        }
+        if (--checkCountdown > 0) return;
+        checkCountdown = LocalityCheckInterval;
+        Spacing = meanNeighbourSpacing(transforms.x.data(), transforms.y.data(), transforms.z.data(), 0, asteroids.size());
+        if (Spacing > SortedSpacing * ResortFactor)
+            sortByLocation(pool);
+    }
+
+    // model matrices simTime seconds into the sim, with the same time scales as bodyModelMatrices; written to
+    // out as buildModelMatrices does, one every stride floats
+    void modelMatrices(double simTime, float timeScaleDaysPerSecond, float timeScaleRotation, float planetScale, float* out, size_t stride = 16) {
+        double simTimeInDays = simTime / timeScaleDaysPerSecond, spinTime = simTime * timeScaleRotation;
+        MemoryScope scope(MEMORY_ASTEROIDS);
+        orbitAngles.resize(asteroids.size());
+        orbitSines.resize(asteroids.size());
+        orbitCosines.resize(asteroids.size());
+        size_t first = 0;
+        asteroids.eachChunk<CircularOrbit, Spin, BodySize>([&](size_t rows, const Entity*, const CircularOrbit* orbits, const Spin* spins, const BodySize* sizes) {
+            for (size_t i = 0; i < rows; ++i) {
+                orbitAngles[first + i] = orbits[i].phase + turnsToRadians(simTimeInDays * orbits[i].turnsPerDay);
+                transforms.angle[first + i] = turnsToRadians(spinTime * spins[i].turnsPerSecond);
+                transforms.scale[first + i] = sizes[i].scale * planetScale;
+            }
+            first += rows;
+        });
+        sinCos(orbitAngles.data(), orbitSines.data(), orbitCosines.data(), asteroids.size(), Precision);
+        first = 0;
+        asteroids.eachChunk<CircularOrbit>([&](size_t rows, const Entity*, const CircularOrbit* orbits) {
+            for (size_t i = 0; i < rows; ++i) {
+                const CircularOrbit& orbit = orbits[i];
+                glm::vec3 position = orbit.radius * (orbitSines[first + i] * orbit.u + orbitCosines[first + i] * orbit.v);
+                transforms.x[first + i] = position.x;
+                transforms.y[first + i] = position.y;
+                transforms.z[first + i] = position.z;
+            }
+            first += rows;
+        });
+        buildModelMatrices(transforms, out, stride, Precision);
+        positionsValid = true;
+    }
+
+private:
+    std::vector<float> orbitAngles, orbitSines, orbitCosines;
+    // the sorts' keys and order of rows, and a copy of each, and room for the largest column of the store
+    std::vector<uint64_t> sortKeys, sortKeyScratch;
+    std::vector<uint32_t> sortOrder, sortOrderScratch;
+    std::vector<unsigned char> rowScratch;
+    bool positionsValid = false; // transforms holds the positions of the belt as it is stored
+    int checkCountdown = 0;
+
+    void copySpinAxes() {
+        size_t first = 0;
+        asteroids.eachChunk<Spin>([this, &first](size_t rows, const Entity*, const Spin* spins) {
+            for (size_t i = 0; i < rows; ++i) {
+                transforms.axisX[first + i] = spins[i].axis.x;
+                transforms.axisY[first + i] = spins[i].axis.y;
+                transforms.axisZ[first + i] = spins[i].axis.z;
+            }
+            first += rows;
+        });
+    }
+};
+
+#endif // !ASTEROID_BELT_H
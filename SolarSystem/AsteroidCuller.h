@@ -0,0 +1,330 @@
+#pragma once
+#ifndef ASTEROID_CULLER_H
+#define ASTEROID_CULLER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "AsteroidBelt.h"
+#include "MeshBuffer.h"
+#include "Shader.h"
+#include "Sphere.h"
+#include "Texture.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Draws the asteroid belt with no per-asteroid work on the CPU. The orbits are uploaded once; every frame a
+// transform feedback pass moves each asteroid, tests its bounding sphere against the view frustum, measures its
+// projected size and writes the survivors into the buffer region of their shape and level of detail. The draws
+// then take their instance counts from the passes' queries. Needs GL 3.3 only; from GL 4.4 on the counts are
+// copied into indirect draw commands on the GPU and one multi-draw takes every region, without the CPU ever
+// waiting for the passes.
+class AsteroidCuller {
+
+public:
+    static const int LOD_COUNT = 3;
+
+    // projected radius in pixels where each level of detail takes over from the next coarser one; asteroids
+    // under MinPixels are dropped, at that size they'd mostly fall between pixel centers anyway
+    float DetailPixels = 8.0f;
+    float CoarsePixels = 2.0f;
+    float MinPixels = 0.25f;
+
+    // of the last render
+    int DrawCalls = 0;
+    int CullPasses = 0;
+    bool IndirectCounts = false; // the counts stay on the GPU
+
+    // the shape meshes at each level of detail, finest first; level 1 matches AsteroidBelt::generateShapes()
+    static std::vector<std::vector<SphereMesh>> generateLodShapes() {
+        std::vector<std::vector<SphereMesh>> lods;
+        for (int lod = 0; lod < LOD_COUNT; ++lod)
+            lods.push_back(AsteroidBelt::generateShapes(12 >> lod, 16 >> lod));
+        return lods;
+    }
+
+    // belt has to be generated already; its orbits are copied to the GPU once, here
+    bool create(const AsteroidBelt& belt, const std::vector<std::vector<SphereMesh>>& lodShapes, const TextureImage& textureImage) {
+        MemoryScope scope(MEMORY_ASTEROIDS);
+        if ((int)lodShapes.size() != LOD_COUNT) {
+            std::cout << "ERROR::ASTEROID_CULLER::LOD_COUNT: expected " << LOD_COUNT << " levels of detail, got " << lodShapes.size() << std::endl;
+            return false;
+        }
+        asteroidCount = (GLuint)belt.asteroids.size();
+        IndirectCounts = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4);
+
+        // the belt is sorted by shape, so each shape is one run of points for the cull pass
+        shapeFirst.assign(AsteroidBelt::SHAPE_COUNT, 0);
+        shapeCount.assign(AsteroidBelt::SHAPE_COUNT, 0);
+        belt.asteroids.eachChunk<BodyShape>([this](size_t rows, const Entity*, const BodyShape* shapes) {
+            for (size_t i = 0; i < rows; ++i)
+                ++shapeCount[shapes[i].mesh];
+        });
+        for (int s = 1; s < AsteroidBelt::SHAPE_COUNT; ++s)
+            shapeFirst[s] = shapeFirst[s - 1] + shapeCount[s - 1];
+
+        MeshBuffer meshes;
+        boundingRadius.assign(AsteroidBelt::SHAPE_COUNT, 0.0f);
+        for (int lod = 0; lod < LOD_COUNT; ++lod) {
+            for (int s = 0; s < AsteroidBelt::SHAPE_COUNT; ++s) {
+                const SphereMesh& mesh = lodShapes[lod][s];
+                regionMeshes.push_back(meshes.add(mesh.vertices, mesh.indices));
+                for (size_t v = 0; v < mesh.vertices.size(); v += MeshBuffer::VERTEX_FLOATS)
+                    boundingRadius[s] = std::max(boundingRadius[s], glm::length(glm::vec3(mesh.vertices[v], mesh.vertices[v + 1], mesh.vertices[v + 2])));
+            }
+        }
+
+        std::vector<float> orbits;
+        orbits.reserve(asteroidCount * ORBIT_FLOATS);
+        belt.asteroids.eachChunk<CircularOrbit, Spin, BodySize>([&orbits](size_t rows, const Entity*, const CircularOrbit* circles, const Spin* spins, const BodySize* sizes) {
+            for (size_t i = 0; i < rows; ++i) {
+                const CircularOrbit& c = circles[i];
+                const Spin& spin = spins[i];
+                float orbit[ORBIT_FLOATS] = { c.radius, c.turnsPerDay, c.phase, spin.turnsPerSecond,
+                                              c.u.x, c.u.y, c.u.z, sizes[i].scale,
+                                              c.v.x, c.v.y, c.v.z, 0.0f,
+                                              spin.axis.x, spin.axis.y, spin.axis.z, 0.0f };
+                orbits.insert(orbits.end(), orbit, orbit + ORBIT_FLOATS);
+            }
+        });
+
+        glBindVertexArray(0);
+        glGenBuffers(1, &orbitBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, orbitBuffer);
+        glBufferData(GL_ARRAY_BUFFER, orbits.size() * sizeof(float), orbits.data(), GL_STATIC_DRAW);
+        gpuMemory().record(GPU_BUFFER, orbitBuffer, MEMORY_ASTEROIDS, "asteroid orbits", orbits.size() * sizeof(float));
+        // every region holds as many asteroids as its shape has, so no pass can overflow it
+        glGenBuffers(1, &instanceBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, std::max<GLuint>(asteroidCount, 1) * LOD_COUNT * INSTANCE_BYTES, nullptr, GL_DYNAMIC_COPY);
+        gpuMemory().record(GPU_BUFFER, instanceBuffer, MEMORY_ASTEROIDS, "asteroid culled instances", (size_t)std::max<GLuint>(asteroidCount, 1) * LOD_COUNT * INSTANCE_BYTES);
+
+        glGenVertexArrays(1, &cullVertexArray);
+        glBindVertexArray(cullVertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, orbitBuffer);
+        for (GLuint column = 0; column < 4; ++column) {
+            glVertexAttribPointer(column, 4, GL_FLOAT, GL_FALSE, ORBIT_FLOATS * sizeof(float), (void*)(column * sizeof(glm::vec4)));
+            glEnableVertexAttribArray(column);
+        }
+
+        glGenBuffers(1, &vertexBuffer);
+        glGenBuffers(1, &indexBuffer);
+        glGenVertexArrays(1, &drawVertexArray);
+        glBindVertexArray(drawVertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, meshes.vertices.size() * sizeof(float), meshes.vertices.data(), GL_STATIC_DRAW);
+        gpuMemory().record(GPU_BUFFER, vertexBuffer, MEMORY_MESHES, "asteroid lod vertices", meshes.vertices.size() * sizeof(float));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, meshes.indices.size() * sizeof(unsigned int), meshes.indices.data(), GL_STATIC_DRAW);
+        gpuMemory().record(GPU_BUFFER, indexBuffer, MEMORY_MESHES, "asteroid lod indices", meshes.indices.size() * sizeof(unsigned int));
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, MeshBuffer::VERTEX_FLOATS * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, MeshBuffer::VERTEX_FLOATS * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        for (GLuint location = INSTANCE_LOCATION; location < INSTANCE_LOCATION + 2; ++location) {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+        // the indirect commands find their region by base instance; without them the pointers move per draw
+        pointInstancesAt(0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        int regionCount = LOD_COUNT * AsteroidBelt::SHAPE_COUNT;
+        queries.resize(regionCount);
+        glGenQueries(regionCount, queries.data());
+        regionCounts.assign(regionCount, 0);
+        if (IndirectCounts) {
+            std::vector<DrawCommand> commands(regionCount);
+            for (int r = 0; r < regionCount; ++r) {
+                commands[r].count = regionMeshes[r].indexCount;
+                commands[r].instanceCount = 0; // written by the cull pass's query
+                commands[r].firstIndex = regionMeshes[r].firstIndex;
+                commands[r].baseVertex = regionMeshes[r].baseVertex;
+                commands[r].baseInstance = regionFirst(r);
+            }
+            glGenBuffers(1, &commandBuffer);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_DYNAMIC_COPY);
+            gpuMemory().record(GPU_BUFFER, commandBuffer, MEMORY_ASTEROIDS, "asteroid draw commands", commands.size() * sizeof(DrawCommand));
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+
+        std::vector<const char*> varyings = { "outPositionScale", "outRotation" };
+        cullShader.reset(new Shader("asteroid_cull.vs", "asteroid_cull.gs", varyings));
+        drawShader.reset(new Shader("asteroid.vs", "shader.fs"));
+        drawShader->use();
+        drawShader->setInt("texture1", 0);
+        texture = Texture(textureImage).textureID;
+        return true;
+    }
+
+    // culls and draws the belt as it is simTime seconds into the sim, into the bound framebuffer, with the same
+    // time scales as AsteroidBelt::modelMatrices
+    void render(const glm::mat4& view, const glm::mat4& projection, double simTime, float timeScaleDaysPerSecond, float timeScaleRotation, float planetScale) {
+        DrawCalls = 0;
+        CullPasses = 0;
+        if (asteroidCount == 0) return;
+
+        // Gribb-Hartmann: each plane is the last row of the view-projection matrix plus or minus another row
+        glm::mat4 viewProjection = projection * view;
+        glm::vec4 planes[6];
+        for (int axis = 0; axis < 3; ++axis) {
+            glm::vec4 row(viewProjection[0][axis], viewProjection[1][axis], viewProjection[2][axis], viewProjection[3][axis]);
+            glm::vec4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+            planes[2 * axis] = w + row;
+            planes[2 * axis + 1] = w - row;
+        }
+        for (glm::vec4& plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        float time = static_cast<float>(simTime);
+
+        cullShader->use();
+        cullShader->setFloat("simTimeInDays", time / timeScaleDaysPerSecond);
+        cullShader->setFloat("rotationTime", time * timeScaleRotation);
+        cullShader->setFloat("planetScale", planetScale);
+        glUniform4fv(glGetUniformLocation(cullShader->ID, "frustumPlanes"), 6, &planes[0][0]);
+        cullShader->setVec3("cameraPosition", glm::vec3(glm::inverse(view)[3]));
+        cullShader->setFloat("pixelsPerUnit", projection[1][1] * viewport[3] * 0.5f);
+        float lodStart[LOD_COUNT + 1] = { 3.4e38f, DetailPixels, CoarsePixels, MinPixels };
+
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBindVertexArray(cullVertexArray);
+        for (int lod = 0; lod < LOD_COUNT; ++lod) {
+            cullShader->setVec2("lodPixelRange", lodStart[lod + 1], lodStart[lod]);
+            for (int s = 0; s < AsteroidBelt::SHAPE_COUNT; ++s) {
+                if (shapeCount[s] == 0) continue;
+                int region = lod * AsteroidBelt::SHAPE_COUNT + s;
+                cullShader->setFloat("boundingRadius", boundingRadius[s]);
+                glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, instanceBuffer, (GLintptr)regionFirst(region) * INSTANCE_BYTES, (GLsizeiptr)shapeCount[s] * INSTANCE_BYTES);
+                glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, queries[region]);
+                glBeginTransformFeedback(GL_POINTS);
+                glDrawArrays(GL_POINTS, (GLint)shapeFirst[s], (GLsizei)shapeCount[s]);
+                glEndTransformFeedback();
+                glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+                ++CullPasses;
+            }
+        }
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glDisable(GL_RASTERIZER_DISCARD);
+
+        glEnable(GL_DEPTH_TEST);
+        drawShader->use();
+        drawShader->setMat4("projection", projection);
+        drawShader->setMat4("view", view);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glBindVertexArray(drawVertexArray);
+        int regionCount = LOD_COUNT * AsteroidBelt::SHAPE_COUNT;
+        if (IndirectCounts) {
+            // the queries write straight into the commands' instance counts, after the passes finish on the GPU
+            glBindBuffer(GL_QUERY_BUFFER, commandBuffer);
+            for (int r = 0; r < regionCount; ++r) {
+                if (shapeCount[r % AsteroidBelt::SHAPE_COUNT] == 0) continue;
+                glGetQueryObjectuiv(queries[r], GL_QUERY_RESULT, (GLuint*)(r * sizeof(DrawCommand) + offsetof(DrawCommand, instanceCount)));
+            }
+            glBindBuffer(GL_QUERY_BUFFER, 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, regionCount, 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            ++DrawCalls;
+        }
+        else {
+            // reading a result waits for its pass to finish; the passes were all queued first, so that is one wait
+            for (int r = 0; r < regionCount; ++r) {
+                GLuint visible = 0;
+                if (shapeCount[r % AsteroidBelt::SHAPE_COUNT] > 0)
+                    glGetQueryObjectuiv(queries[r], GL_QUERY_RESULT, &visible);
+                regionCounts[r] = visible;
+                if (visible == 0) continue;
+                pointInstancesAt(regionFirst(r));
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)regionMeshes[r].indexCount, GL_UNSIGNED_INT,
+                                                  (void*)(regionMeshes[r].firstIndex * sizeof(unsigned int)), (GLsizei)visible, regionMeshes[r].baseVertex);
+                ++DrawCalls;
+            }
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // asteroids drawn at each level of detail by the last render; with IndirectCounts this reads them back
+    // from the GPU, so it's for stats, not for every frame
+    std::vector<unsigned int> lodCounts() {
+        int regionCount = LOD_COUNT * AsteroidBelt::SHAPE_COUNT;
+        if (IndirectCounts && asteroidCount > 0) {
+            std::vector<DrawCommand> commands(regionCount);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawCommand), commands.data());
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            for (int r = 0; r < regionCount; ++r)
+                regionCounts[r] = commands[r].instanceCount;
+        }
+        std::vector<unsigned int> counts(LOD_COUNT, 0);
+        for (int r = 0; r < regionCount; ++r)
+            counts[r / AsteroidBelt::SHAPE_COUNT] += regionCounts[r];
+        return counts;
+    }
+
+    void DeleteBuffers() {
+        if (!cullShader) return;
+        glDeleteProgram(cullShader->ID);
+        glDeleteProgram(drawShader->ID);
+        cullShader.reset();
+        drawShader.reset();
+        glDeleteTextures(1, &texture);
+        gpuMemory().release(GPU_TEXTURE, texture);
+        glDeleteQueries((GLsizei)queries.size(), queries.data());
+        glDeleteVertexArrays(1, &cullVertexArray);
+        glDeleteVertexArrays(1, &drawVertexArray);
+        GLuint buffers[] = { orbitBuffer, instanceBuffer, vertexBuffer, indexBuffer, commandBuffer };
+        glDeleteBuffers(5, buffers);
+        gpuMemory().release(GPU_BUFFER, 5, buffers);
+    }
+
+private:
+    // DrawElementsIndirectCommand
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    static const int ORBIT_FLOATS = 16;           // aOrbit, aOrbitU, aOrbitV, aSpinAxis in asteroid_cull.vs
+    static const GLuint INSTANCE_BYTES = 32;      // outPositionScale, outRotation in asteroid_cull.gs
+    static const GLuint INSTANCE_LOCATION = 2;    // aPositionScale, then aRotation, in asteroid.vs
+
+    GLuint asteroidCount = 0;
+    std::vector<GLuint> shapeFirst, shapeCount;
+    std::vector<float> boundingRadius;   // by shape, over all its levels of detail
+    std::vector<MeshRange> regionMeshes; // by region: lod * SHAPE_COUNT + shape
+    std::vector<GLuint> queries;         // by region
+    std::vector<GLuint> regionCounts;    // by region, of the last render
+
+    std::unique_ptr<Shader> cullShader, drawShader;
+    GLuint texture = 0;
+    GLuint orbitBuffer = 0, instanceBuffer = 0, vertexBuffer = 0, indexBuffer = 0, commandBuffer = 0;
+    GLuint cullVertexArray = 0, drawVertexArray = 0;
+
+    // region r of the instance buffer, in instances: its level of detail's copy of its shape's run
+    GLuint regionFirst(int region) const {
+        return (GLuint)(region / AsteroidBelt::SHAPE_COUNT) * asteroidCount + shapeFirst[region % AsteroidBelt::SHAPE_COUNT];
+    }
+
+    // the instance attributes of the bound draw vertex array, starting at instance first
+    void pointInstancesAt(GLuint first) {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glVertexAttribPointer(INSTANCE_LOCATION, 4, GL_FLOAT, GL_FALSE, INSTANCE_BYTES, (void*)((size_t)first * INSTANCE_BYTES));
+        glVertexAttribPointer(INSTANCE_LOCATION + 1, 4, GL_FLOAT, GL_FALSE, INSTANCE_BYTES, (void*)((size_t)first * INSTANCE_BYTES + sizeof(glm::vec4)));
+    }
+};
+
+#endif // !ASTEROID_CULLER_H
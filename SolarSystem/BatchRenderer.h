@@ -0,0 +1,163 @@
+#pragma once
+#ifndef BATCH_RENDERER_H
+#define BATCH_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+#include "Scene.h"
+#include "Framebuffer.h"
+#include "HeadlessContext.h"
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// one still of a batch: the sim epochDays in, seen from a camera pose, written to outputPath (.png, otherwise PPM)
+struct BatchJob {
+    double epochDays;
+    glm::vec3 position;
+    float yaw, pitch, zoom;
+    int width, height;
+    std::string outputPath;
+};
+
+// Job files have one still per line, '#' starts a comment:
+// epoch_days  x y z  yaw pitch zoom  width height  output
+inline bool loadBatchJobs(const std::string& path, std::vector<BatchJob>& jobs)
+{
+    std::ifstream in(path);
+    if (!in) {
+        std::cout << "ERROR::BATCH::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        std::istringstream fields(line);
+        BatchJob job;
+        if (!(fields >> job.epochDays >> job.position.x >> job.position.y >> job.position.z >> job.yaw >> job.pitch >> job.zoom
+                     >> job.width >> job.height >> job.outputPath) || job.width <= 0 || job.height <= 0) {
+            std::cout << "ERROR::BATCH::BAD_JOB: " << path << ":" << lineNumber << std::endl;
+            return false;
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+// Renders a list of stills on several threads, each with its own surfaceless GL context, scene and framebuffer.
+// The decoded textures and sphere mesh are shared read-only by every scene, so only the GL upload is per
+// context. Workers pull the next job from a shared counter, so long and short jobs balance out.
+class BatchRenderer {
+
+public:
+    struct WorkerStats {
+        int frames = 0;
+        double setupSeconds = 0.0; // shader compile and texture/mesh upload of the worker's context
+        double seconds = 0.0;      // rendering and writing its stills
+    };
+    std::vector<WorkerStats> workerStats;
+    int failedJobs = 0;
+
+    bool run(const std::vector<BatchJob>& jobs, int workerCount, const SceneAssets& assets, float planetScale) {
+        workerCount = std::max(1, std::min(workerCount, (int)jobs.size()));
+#ifdef SOLAR_HAS_EGL
+        // llvmpipe gives every context a full set of rasterizer threads; split the cores between the workers
+        // instead (0 rasterizes on the worker thread itself), unless the user chose a count
+        if (workerCount > 1 && !std::getenv("LP_NUM_THREADS")) {
+            int threadsPerWorker = std::max(1, (int)std::thread::hardware_concurrency() / workerCount);
+            setenv("LP_NUM_THREADS", std::to_string(threadsPerWorker == 1 ? 0 : threadsPerWorker).c_str(), 0);
+        }
+#endif
+        std::vector<std::unique_ptr<HeadlessContext>> contexts;
+        for (int i = 0; i < workerCount; ++i) {
+            contexts.emplace_back(new HeadlessContext());
+            if (!contexts.back()->create(3, 3))
+                return false;
+        }
+        // the GL entry points are the same for every context of the display, so glad is loaded once
+        if (!contexts[0]->makeCurrent() || !gladLoadGLLoader((GLADloadproc)HeadlessContext::getProcAddress)) {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return false;
+        }
+        std::cout << "Renderer: " << glGetString(GL_RENDERER) << ", " << workerCount << " workers" << std::endl;
+        contexts[0]->releaseCurrent();
+
+        workerStats.assign(workerCount, WorkerStats());
+        failedJobs = 0;
+        std::atomic<size_t> nextJob(0);
+        std::atomic<int> failed(0);
+        std::mutex logMutex;
+        std::vector<std::thread> workers;
+        for (int worker = 0; worker < workerCount; ++worker) {
+            workers.emplace_back([&, worker]() {
+                HeadlessContext& context = *contexts[worker];
+                if (!context.makeCurrent()) {
+                    std::lock_guard<std::mutex> lock(logMutex);
+                    std::cout << "ERROR::BATCH::MAKE_CURRENT_FAILED: worker " << worker << std::endl;
+                    return;
+                }
+                auto start = std::chrono::steady_clock::now();
+                glEnable(GL_DEPTH_TEST);
+                Scene scene(assets);
+                scene.planetScale = planetScale;
+                Framebuffer framebuffer;
+                std::vector<unsigned char> pixels;
+                glFinish();
+                auto setupDone = std::chrono::steady_clock::now();
+                workerStats[worker].setupSeconds = std::chrono::duration<double>(setupDone - start).count();
+
+                for (size_t index = nextJob++; index < jobs.size(); index = nextJob++) {
+                    const BatchJob& job = jobs[index];
+                    if ((framebuffer.width != job.width || framebuffer.height != job.height) && !framebuffer.create(job.width, job.height)) {
+                        ++failed;
+                        continue;
+                    }
+                    Camera camera(job.position, glm::vec3(0.0f, 1.0f, 0.0f), job.yaw, job.pitch);
+                    camera.Zoom = job.zoom;
+                    framebuffer.bind();
+                    scene.render(camera.GetViewMatrix(), Scene::projectionMatrix(camera, (float)job.width / (float)job.height),
+                                 job.epochDays * scene.timeScaleDaysPerSecond);
+
+                    pixels.resize((size_t)job.width * job.height * 3);
+                    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+                    glReadPixels(0, 0, job.width, job.height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+                    const std::string& path = job.outputPath;
+                    bool png = path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0;
+                    bool written = png ? writePNG(path, job.width, job.height, 3, pixels.data()) : writePPM(path, job.width, job.height, pixels.data());
+                    if (written)
+                        workerStats[worker].frames++;
+                    else
+                        ++failed;
+                }
+
+                workerStats[worker].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - setupDone).count();
+                scene.DeleteBuffers();
+                framebuffer.DeleteBuffers();
+                context.releaseCurrent();
+            });
+        }
+        for (std::thread& worker : workers)
+            worker.join();
+        failedJobs = failed;
+        return failedJobs == 0;
+    }
+};
+
+#endif // !BATCH_RENDERER_H
@@ -0,0 +1,35 @@
+#pragma once
+#ifndef BODY_COMPONENTS_H
+#define BODY_COMPONENTS_H
+
+#include <glm/glm.hpp>
+
+// Components of the bodies kept in an EntityStore. A body has only the ones that apply to it, so a system that
+// moves orbits never pulls meshes or sizes through the cache.
+
+// a circle around whatever the body orbits: radius * (sin(angle) * u + cos(angle) * v), the angle starting at
+// phase and going round turnsPerDay times per earth day
+struct CircularOrbit {
+    float radius;
+    float turnsPerDay;
+    float phase;
+    glm::vec3 u, v;
+};
+
+// rotations per sim second around a unit axis, at timeScaleRotation = 1
+struct Spin {
+    glm::vec3 axis;
+    float turnsPerSecond;
+};
+
+// uniform scale of the unit-sized mesh, at planet scale 1
+struct BodySize {
+    float scale;
+};
+
+// which of its kind's meshes the body is drawn with
+struct BodyShape {
+    int mesh;
+};
+
+#endif // !BODY_COMPONENTS_H
@@ -0,0 +1,89 @@
+#pragma once
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// An authored camera flight: keyframes of position, yaw, pitch and zoom interpolated with a Catmull-Rom spline.
+//
+// File format, one keyframe per line (lines starting with # are comments), times in seconds and increasing:
+//   <time> <x> <y> <z> <yaw> <pitch> <zoom>
+class CameraPath {
+
+public:
+    struct Keyframe {
+        float time;
+        glm::vec3 position;
+        float yaw;
+        float pitch;
+        float zoom;
+    };
+
+    std::vector<Keyframe> keyframes;
+
+    bool load(const std::string& path) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cout << "ERROR::CAMERA_PATH::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+            return false;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            std::istringstream fields(line);
+            Keyframe key{};
+            if (fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch >> key.zoom)
+                keyframes.push_back(key);
+        }
+        if (keyframes.size() < 2) {
+            std::cout << "ERROR::CAMERA_PATH::NEEDS_TWO_KEYFRAMES: " << path << std::endl;
+            return false;
+        }
+        std::sort(keyframes.begin(), keyframes.end(), [](const Keyframe& a, const Keyframe& b) { return a.time < b.time; });
+        return true;
+    }
+
+    float duration() const {
+        return keyframes.empty() ? 0.0f : keyframes.back().time;
+    }
+
+    // moves the camera to where the path is at time t (clamped to the path's ends)
+    void apply(Camera& camera, float t) const {
+        t = glm::clamp(t, keyframes.front().time, keyframes.back().time);
+        size_t i = 0;
+        while (i + 2 < keyframes.size() && keyframes[i + 1].time <= t)
+            ++i;
+        const Keyframe& k0 = keyframes[i > 0 ? i - 1 : i];
+        const Keyframe& k1 = keyframes[i];
+        const Keyframe& k2 = keyframes[i + 1];
+        const Keyframe& k3 = keyframes[std::min(i + 2, keyframes.size() - 1)];
+        float span = k2.time - k1.time;
+        float s = span > 0.0f ? (t - k1.time) / span : 0.0f;
+
+        camera.Position = catmullRom(k0.position, k1.position, k2.position, k3.position, s);
+        camera.Yaw = catmullRom(k0.yaw, k1.yaw, k2.yaw, k3.yaw, s);
+        camera.Pitch = glm::clamp(catmullRom(k0.pitch, k1.pitch, k2.pitch, k3.pitch, s), -89.0f, 89.0f);
+        camera.Zoom = glm::clamp(catmullRom(k0.zoom, k1.zoom, k2.zoom, k3.zoom, s), 1.0f, 45.0f);
+        // a zero mouse movement recomputes the camera vectors from the new angles
+        camera.ProcessMouseMovement(0.0f, 0.0f);
+    }
+
+private:
+    template <typename T>
+    static T catmullRom(const T& p0, const T& p1, const T& p2, const T& p3, float s) {
+        float s2 = s * s;
+        float s3 = s2 * s;
+        return 0.5f * ((2.0f * p1) + (p2 - p0) * s + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * s2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * s3);
+    }
+};
+
+#endif // !CAMERA_PATH_H
@@ -0,0 +1,332 @@
+#pragma once
+#ifndef ENTITY_STORE_H
+#define ENTITY_STORE_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// A handle to an entity in an EntityStore. It stays valid while other entities come and go, and stops being
+// alive once its own entity is destroyed, even after the slot is reused.
+struct Entity {
+    uint32_t index = 0xffffffffu;
+    uint32_t generation = 0;
+
+    bool operator==(const Entity& other) const {
+        return index == other.index && generation == other.generation;
+    }
+    bool operator!=(const Entity& other) const {
+        return !(*this == other);
+    }
+};
+
+// bit i set for the component type with componentId() i
+typedef uint64_t ComponentMask;
+const int MAX_COMPONENT_TYPES = 64;
+
+// bytes per element of each component type, by componentId()
+inline std::vector<size_t>& componentSizes()
+{
+    static std::vector<size_t> sizes;
+    return sizes;
+}
+
+// a small number for each component type, handed out on its first use
+template <typename T>
+inline int componentId()
+{
+    static_assert(std::is_trivially_copyable<T>::value, "components are moved between archetypes as bytes");
+    static const int id = [] {
+        std::vector<size_t>& sizes = componentSizes();
+        // past the mask's bits every shift by the id would be undefined, in release builds too
+        if (sizes.size() >= (size_t)MAX_COMPONENT_TYPES) {
+            std::cout << "ERROR::ENTITY_STORE::TOO_MANY_COMPONENT_TYPES: masks hold " << MAX_COMPONENT_TYPES << std::endl;
+            std::abort();
+        }
+        sizes.push_back(sizeof(T));
+        return (int)sizes.size() - 1;
+    }();
+    return id;
+}
+
+template <typename... Components>
+inline ComponentMask componentMask()
+{
+    ComponentMask mask = 0;
+    int bits[] = { 0, (mask |= ComponentMask(1) << componentId<Components>(), 0)... };
+    (void)bits;
+    return mask;
+}
+
+// All the entities with exactly the same component types. Each type has a column of its own, contiguous, and
+// row i of every column belongs to entities[i], so a system reads only the columns it asks for.
+struct Archetype {
+    ComponentMask mask = 0;
+    std::vector<int> components; // componentId of each column, ascending
+    std::vector<std::vector<unsigned char>> columns;
+    std::vector<Entity> entities;
+
+    explicit Archetype(ComponentMask mask) : mask(mask) {
+        for (int id = 0; id < MAX_COMPONENT_TYPES; ++id) {
+            if (!(mask & (ComponentMask(1) << id))) continue;
+            components.push_back(id);
+            columns.emplace_back();
+        }
+    }
+
+    size_t size() const {
+        return entities.size();
+    }
+
+    int column(int component) const {
+        for (size_t c = 0; c < components.size(); ++c)
+            if (components[c] == component) return (int)c;
+        return -1;
+    }
+
+    template <typename T>
+    T* data() {
+        return reinterpret_cast<T*>(columns[column(componentId<T>())].data());
+    }
+    template <typename T>
+    const T* data() const {
+        return reinterpret_cast<const T*>(columns[column(componentId<T>())].data());
+    }
+
+    unsigned char* element(size_t c, size_t row) {
+        return columns[c].data() + row * componentSizes()[components[c]];
+    }
+
+    void reserve(size_t rows) {
+        for (size_t c = 0; c < columns.size(); ++c)
+            columns[c].reserve(rows * componentSizes()[components[c]]);
+        entities.reserve(rows);
+    }
+
+    // a zeroed row for entity at the end of every column
+    size_t append(Entity entity) {
+        for (size_t c = 0; c < columns.size(); ++c)
+            columns[c].resize(columns[c].size() + componentSizes()[components[c]], 0);
+        entities.push_back(entity);
+        return entities.size() - 1;
+    }
+
+    // fills row with the last row and drops the last; returns the entity that moved, if one did
+    bool removeSwap(size_t row, Entity& moved) {
+        size_t last = entities.size() - 1;
+        for (size_t c = 0; c < columns.size(); ++c) {
+            size_t bytes = componentSizes()[components[c]];
+            if (row != last) std::memcpy(element(c, row), element(c, last), bytes);
+            columns[c].resize(columns[c].size() - bytes);
+        }
+        bool swapped = row != last;
+        if (swapped) entities[row] = entities[last];
+        entities.pop_back();
+        moved = swapped ? entities[row] : Entity();
+        return swapped;
+    }
+};
+
+// Entities and their components, stored by archetype. Adding or removing a component moves the entity's row to
+// the archetype of its new set of types. Queries visit the archetypes that have all the asked-for types, in the
+// order they were first used, and their rows in order; a query with the same types and no entities created,
+// destroyed, changed or permuted in between visits the entities in the same order again. Components have to be
+// trivially copyable.
+class EntityStore {
+
+public:
+    // creates an entity with the given components
+    template <typename... Components>
+    Entity create(const Components&... values) {
+        Entity entity = allocate();
+        int a = archetypeIndex(componentMask<Components...>());
+        Archetype& archetype = *archetypes[a];
+        size_t row = archetype.append(entity);
+        records[entity.index].archetype = a;
+        records[entity.index].row = row;
+        int copies[] = { 0, (archetype.data<Components>()[row] = values, 0)... };
+        (void)copies;
+        return entity;
+    }
+
+    // room for count entities in all, count of them with exactly Components, without reallocating
+    template <typename... Components>
+    void reserve(size_t count) {
+        archetypes[archetypeIndex(componentMask<Components...>())]->reserve(count);
+        records.reserve(count);
+    }
+
+    void destroy(Entity entity) {
+        if (!alive(entity)) return;
+        Record& record = records[entity.index];
+        Entity moved;
+        if (archetypes[record.archetype]->removeSwap(record.row, moved))
+            records[moved.index].row = record.row;
+        record.archetype = -1;
+        ++record.generation;
+        freeIndices.push_back(entity.index);
+        --aliveCount;
+    }
+
+    bool alive(Entity entity) const {
+        return entity.index < records.size() && records[entity.index].generation == entity.generation && records[entity.index].archetype >= 0;
+    }
+
+    // the entity's component, or nullptr when it's dead or doesn't have one; valid until the store next changes
+    template <typename T>
+    T* get(Entity entity) {
+        if (!alive(entity)) return nullptr;
+        const Record& record = records[entity.index];
+        Archetype& archetype = *archetypes[record.archetype];
+        if (archetype.column(componentId<T>()) < 0) return nullptr;
+        return archetype.data<T>() + record.row;
+    }
+
+    // gives the entity a component, or sets the one it has
+    template <typename T>
+    void add(Entity entity, const T& value) {
+        if (!alive(entity)) return;
+        move(entity, archetypes[records[entity.index].archetype]->mask | componentMask<T>());
+        *get<T>(entity) = value;
+    }
+
+    template <typename T>
+    void remove(Entity entity) {
+        if (!alive(entity)) return;
+        move(entity, archetypes[records[entity.index].archetype]->mask & ~componentMask<T>());
+    }
+
+    // Reorders the entities with exactly Components: row i gets the entity that was in row order[i], order being a
+    // permutation of their rows. Handles stay valid, as they find their rows through the records. Every column
+    // goes through scratch, which grows to the largest one unless it's already that big, and can be kept for next
+    // time.
+    template <typename... Components>
+    void permute(const uint32_t* order, std::vector<unsigned char>& scratch) {
+        auto found = archetypeByMask.find(componentMask<Components...>());
+        if (found == archetypeByMask.end()) return;
+        Archetype& archetype = *archetypes[found->second];
+        size_t rows = archetype.size();
+        for (size_t c = 0; c < archetype.columns.size(); ++c)
+            permuteBytes(archetype.columns[c].data(), componentSizes()[archetype.components[c]], rows, order, scratch);
+        permuteBytes(reinterpret_cast<unsigned char*>(archetype.entities.data()), sizeof(Entity), rows, order, scratch);
+        for (size_t row = 0; row < rows; ++row)
+            records[archetype.entities[row].index].row = row;
+    }
+
+    // fn(size_t count, const Entity* entities, Components*... columns) for every archetype with all of Components
+    template <typename... Components, typename Fn>
+    void eachChunk(Fn fn) {
+        ComponentMask mask = componentMask<Components...>();
+        for (std::unique_ptr<Archetype>& archetype : archetypes)
+            if ((archetype->mask & mask) == mask && archetype->size() > 0)
+                fn(archetype->size(), archetype->entities.data(), archetype->template data<Components>()...);
+    }
+    template <typename... Components, typename Fn>
+    void eachChunk(Fn fn) const {
+        ComponentMask mask = componentMask<Components...>();
+        for (const std::unique_ptr<Archetype>& archetype : archetypes)
+            if ((archetype->mask & mask) == mask && archetype->size() > 0)
+                fn(archetype->size(), archetype->entities.data(), static_cast<const Archetype&>(*archetype).template data<Components>()...);
+    }
+
+    // fn(Entity, Components&...) for every entity with all of Components
+    template <typename... Components, typename Fn>
+    void each(Fn fn) {
+        eachChunk<Components...>([&fn](size_t count, const Entity* entities, Components*... columns) {
+            for (size_t i = 0; i < count; ++i)
+                fn(entities[i], columns[i]...);
+        });
+    }
+
+    // entities with all of Components
+    template <typename... Components>
+    size_t count() const {
+        ComponentMask mask = componentMask<Components...>();
+        size_t total = 0;
+        for (const std::unique_ptr<Archetype>& archetype : archetypes)
+            if ((archetype->mask & mask) == mask) total += archetype->size();
+        return total;
+    }
+
+    // entities alive
+    size_t size() const {
+        return aliveCount;
+    }
+
+    void clear() {
+        archetypes.clear();
+        archetypeByMask.clear();
+        records.clear();
+        freeIndices.clear();
+        aliveCount = 0;
+    }
+
+private:
+    struct Record {
+        int archetype = -1; // -1 while the index is free
+        size_t row = 0;
+        uint32_t generation = 0;
+    };
+
+    std::vector<std::unique_ptr<Archetype>> archetypes;
+    std::unordered_map<ComponentMask, int> archetypeByMask;
+    std::vector<Record> records; // by Entity::index
+    std::vector<uint32_t> freeIndices;
+    size_t aliveCount = 0;
+
+    Entity allocate() {
+        Entity entity;
+        if (!freeIndices.empty()) {
+            entity.index = freeIndices.back();
+            freeIndices.pop_back();
+        }
+        else {
+            entity.index = (uint32_t)records.size();
+            records.emplace_back();
+        }
+        entity.generation = records[entity.index].generation;
+        ++aliveCount;
+        return entity;
+    }
+
+    int archetypeIndex(ComponentMask mask) {
+        auto found = archetypeByMask.find(mask);
+        if (found != archetypeByMask.end()) return found->second;
+        archetypes.emplace_back(new Archetype(mask));
+        archetypeByMask[mask] = (int)archetypes.size() - 1;
+        return (int)archetypes.size() - 1;
+    }
+
+    static void permuteBytes(unsigned char* elements, size_t bytes, size_t count, const uint32_t* order, std::vector<unsigned char>& scratch) {
+        if (scratch.size() < count * bytes) scratch.resize(count * bytes);
+        for (size_t i = 0; i < count; ++i)
+            std::memcpy(scratch.data() + i * bytes, elements + (size_t)order[i] * bytes, bytes);
+        std::memcpy(elements, scratch.data(), count * bytes);
+    }
+
+    // moves the entity's row to the archetype of mask, keeping the components both have
+    void move(Entity entity, ComponentMask mask) {
+        Record& record = records[entity.index];
+        if (archetypes[record.archetype]->mask == mask) return;
+        int to = archetypeIndex(mask);
+        Archetype& source = *archetypes[record.archetype];
+        Archetype& target = *archetypes[to];
+        size_t row = target.append(entity);
+        for (size_t c = 0; c < target.components.size(); ++c) {
+            int from = source.column(target.components[c]);
+            if (from >= 0) std::memcpy(target.element(c, row), source.element(from, record.row), componentSizes()[target.components[c]]);
+        }
+        Entity moved;
+        if (source.removeSwap(record.row, moved))
+            records[moved.index].row = record.row;
+        record.archetype = to;
+        record.row = row;
+    }
+};
+
+#endif // !ENTITY_STORE_H
@@ -0,0 +1,179 @@
+#pragma once
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Keeps the last few seconds of frame times and scope timings in memory and dumps a
+// chrome://tracing (Trace Event Format) file around any frame that takes much longer than the median.
+class FlightRecorder {
+
+public:
+    struct FrameSample {
+        long long frame;
+        double start;      // seconds since the recorder was created
+        float deltaTime;   // deltaTime computed by the main loop
+    };
+    struct ScopeSample {
+        const char* name;  // must be a string literal
+        long long frame;
+        double start;
+        double duration;
+    };
+
+    // RAII helper that records one named scope of the current frame
+    class Scope {
+    public:
+        Scope(FlightRecorder& recorder, const char* name) : recorder(recorder), name(name), start(recorder.now()) {}
+        ~Scope() { recorder.addScope(name, start, recorder.now() - start); }
+    private:
+        FlightRecorder& recorder;
+        const char* name;
+        double start;
+    };
+
+    // recorder options
+    bool Enabled = true;
+    float SpikeFactor = 2.0f;       // a frame is a spike when deltaTime > SpikeFactor * median
+    int MedianWindow = 120;         // number of recent frames the median is taken over
+    int FramesBefore = 120;         // frames written before the spike
+    int FramesAfter = 60;           // frames written after the spike
+    float CooldownSeconds = 10.0f;  // minimum time between two dumps
+    std::string OutputDirectory = ".";
+
+    // stats for the ui
+    int DumpCount = 0;
+    std::string LastDumpPath;
+    float LastMedian = 0.0f;
+
+    FlightRecorder(int frameCapacity = 600, int scopeCapacity = 8192)
+        : frames(frameCapacity), scopes(scopeCapacity), origin(std::chrono::steady_clock::now())
+    {
+        medianScratch.reserve(frameCapacity);
+    }
+
+    ~FlightRecorder() {
+        if (writer.joinable())
+            writer.join();
+    }
+
+    // seconds since the recorder was created
+    double now() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    // call once per frame right after deltaTime has been computed
+    void beginFrame(float deltaTime) {
+        if (!Enabled) return;
+        ++currentFrame;
+        frames[frameHead % frames.size()] = { currentFrame, now(), deltaTime };
+        ++frameHead;
+
+        if (pendingSpikeFrame >= 0 && currentFrame >= pendingSpikeFrame + FramesAfter) {
+            dump(pendingSpikeFrame);
+            pendingSpikeFrame = -1;
+        }
+
+        LastMedian = median();
+        if (pendingSpikeFrame < 0 && frameHead > (long long)MedianWindow && deltaTime > SpikeFactor * LastMedian) {
+            double t = now();
+            if (lastDumpTime < 0.0 || t - lastDumpTime >= CooldownSeconds) {
+                pendingSpikeFrame = currentFrame;
+                lastDumpTime = t;
+            }
+        }
+    }
+
+    void addScope(const char* name, double start, double duration) {
+        if (!Enabled) return;
+        scopes[scopeHead % scopes.size()] = { name, currentFrame, start, duration };
+        ++scopeHead;
+    }
+
+private:
+    std::vector<FrameSample> frames;
+    std::vector<ScopeSample> scopes;
+    std::vector<float> medianScratch;
+    long long frameHead = 0;
+    long long scopeHead = 0;
+    long long currentFrame = 0;
+    long long pendingSpikeFrame = -1;
+    double lastDumpTime = -1.0;
+    std::chrono::steady_clock::time_point origin;
+    std::thread writer;
+
+    // median of the previous MedianWindow frames, excluding the current one
+    float median() {
+        long long count = std::min<long long>({ (long long)MedianWindow, frameHead - 1, (long long)frames.size() - 1 });
+        if (count <= 0) return 0.0f;
+        medianScratch.clear();
+        for (long long i = frameHead - 1 - count; i < frameHead - 1; ++i)
+            medianScratch.push_back(frames[i % frames.size()].deltaTime);
+        std::nth_element(medianScratch.begin(), medianScratch.begin() + count / 2, medianScratch.end());
+        return medianScratch[count / 2];
+    }
+
+    // copies the window around the spike and writes it on a background thread so the dump itself doesn't hitch
+    void dump(long long spikeFrame) {
+        long long first = spikeFrame - FramesBefore;
+        long long last = spikeFrame + FramesAfter;
+
+        std::vector<FrameSample> frameCopy;
+        for (long long i = std::max(0LL, frameHead - (long long)frames.size()); i < frameHead; ++i) {
+            const FrameSample& f = frames[i % frames.size()];
+            if (f.frame >= first && f.frame <= last)
+                frameCopy.push_back(f);
+        }
+        std::vector<ScopeSample> scopeCopy;
+        for (long long i = std::max(0LL, scopeHead - (long long)scopes.size()); i < scopeHead; ++i) {
+            const ScopeSample& s = scopes[i % scopes.size()];
+            if (s.frame >= first && s.frame <= last)
+                scopeCopy.push_back(s);
+        }
+
+        std::string path = OutputDirectory + "/flight_" + std::to_string((long long)std::time(nullptr)) + "_frame" + std::to_string(spikeFrame) + ".json";
+        LastDumpPath = path;
+        ++DumpCount;
+
+        if (writer.joinable())
+            writer.join();
+        writer = std::thread([path, spikeFrame, frameCopy = std::move(frameCopy), scopeCopy = std::move(scopeCopy)]() {
+            writeTrace(path, spikeFrame, frameCopy, scopeCopy);
+        });
+    }
+
+    static void writeTrace(const std::string& path, long long spikeFrame, const std::vector<FrameSample>& frameSamples, const std::vector<ScopeSample>& scopeSamples) {
+        std::ofstream out(path);
+        if (!out) {
+            std::cout << "ERROR::FLIGHT_RECORDER::CANNOT_WRITE: " << path << std::endl;
+            return;
+        }
+        out << "{\"traceEvents\":[\n";
+        bool firstEvent = true;
+        auto separator = [&]() { out << (firstEvent ? "" : ",\n"); firstEvent = false; };
+        // a frame sample is recorded at the start of the frame and covers the previous deltaTime
+        for (const FrameSample& f : frameSamples) {
+            separator();
+            out << "{\"name\":\"frame " << f.frame << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":0"
+                << ",\"ts\":" << (long long)((f.start - f.deltaTime) * 1e6) << ",\"dur\":" << (long long)(f.deltaTime * 1e6)
+                << ",\"args\":{\"deltaTime\":" << f.deltaTime << (f.frame == spikeFrame ? ",\"spike\":true" : "") << "}}";
+        }
+        for (const ScopeSample& s : scopeSamples) {
+            separator();
+            out << "{\"name\":\"" << s.name << "\",\"cat\":\"scope\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+                << ",\"ts\":" << (long long)(s.start * 1e6) << ",\"dur\":" << (long long)(s.duration * 1e6)
+                << ",\"args\":{\"frame\":" << s.frame << "}}";
+        }
+        out << "\n]}\n";
+        std::cout << "Flight recorder wrote " << path << std::endl;
+    }
+};
+
+#endif // !FLIGHT_RECORDER_H
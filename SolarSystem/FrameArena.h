@@ -0,0 +1,155 @@
+#pragma once
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "MemoryLedger.h"
+
+// Bump allocator for data that only lives for a frame: allocating moves a pointer along one block, freeing does
+// nothing, and reset() makes the whole block free again. When a frame needs more than the block, the rest comes
+// from extra blocks off the heap, and the next reset replaces them all with one block big enough for that frame,
+// so a steady frame loop only touches the heap while it warms up.
+class FrameArena {
+
+public:
+    // times a frame outgrew the block
+    int Overflows = 0;
+
+    explicit FrameArena(size_t capacity = 256 * 1024) {
+        grow(capacity);
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // alignment is a power of two
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.get());
+        size_t start = (size_t)(((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+        if (start + bytes <= blockSize) {
+            offset = start + bytes;
+            used += bytes;
+            return block.get() + start;
+        }
+        // the block's spent for this frame; this one's only good until the next reset
+        ++Overflows;
+        used += bytes;
+        MemoryScope scope(MEMORY_FRAME_ARENAS);
+        overflow.emplace_back(new unsigned char[bytes + alignment]);
+        uintptr_t address = reinterpret_cast<uintptr_t>(overflow.back().get());
+        return reinterpret_cast<void*>((address + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    }
+
+    template <typename T>
+    T* allocate(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // everything allocated since the last reset is gone
+    void reset() {
+        peak = std::max(peak, used);
+        if (!overflow.empty()) {
+            overflow.clear();
+            // with some slack, so a frame a little bigger than the last doesn't overflow again
+            grow(peak + peak / 4);
+        }
+        offset = 0;
+        used = 0;
+    }
+
+    // bytes handed out since the last reset
+    size_t bytesUsed() const { return used; }
+    // most bytes handed out in one frame so far
+    size_t peakBytes() const { return std::max(peak, used); }
+    size_t capacity() const { return blockSize; }
+
+private:
+    std::unique_ptr<unsigned char[]> block;
+    size_t blockSize = 0;
+    size_t offset = 0;
+    size_t used = 0;
+    size_t peak = 0;
+    std::vector<std::unique_ptr<unsigned char[]>> overflow;
+
+    void grow(size_t capacity) {
+        MemoryScope scope(MEMORY_FRAME_ARENAS);
+        block.reset(new unsigned char[capacity]);
+        blockSize = capacity;
+    }
+};
+
+// Lets a standard container take its memory from a FrameArena. Deallocating is a no-op, so a container that
+// grows leaves its old storage behind until the arena is reset; reserve up front where the size is known. The
+// container's contents must not outlive the frame. Assigning a container takes the other's arena along, so one
+// kept across frames can be handed a fresh one each frame.
+template <typename T>
+struct ArenaAllocator {
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    FrameArena* arena = nullptr; // none: the container has to be assigned one before it can hold anything
+
+    ArenaAllocator() {}
+    explicit ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) {
+        return arena->allocate<T>(count);
+    }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+// bumped by beginFrameArenas; each thread's arena empties when it first sees a new value
+inline std::atomic<unsigned>& frameArenaEpoch()
+{
+    static std::atomic<unsigned> epoch(0);
+    return epoch;
+}
+
+// Call on the main thread at the start of every frame, once nothing is left running from the last one. Every
+// thread's frameArena() is emptied the next time that thread asks for it.
+inline void beginFrameArenas()
+{
+    ++frameArenaEpoch();
+}
+
+// The calling thread's arena: the main thread's and each pool worker's are separate, so jobs allocate from them
+// without locking. What's allocated is valid until the end of the frame.
+inline FrameArena& frameArena()
+{
+    thread_local FrameArena arena;
+    thread_local unsigned epoch = 0;
+    unsigned current = frameArenaEpoch().load(std::memory_order_relaxed);
+    if (epoch != current) {
+        arena.reset();
+        epoch = current;
+    }
+    return arena;
+}
+
+// an empty vector on the calling thread's arena
+template <typename T>
+inline FrameVector<T> frameVector()
+{
+    return FrameVector<T>(ArenaAllocator<T>(frameArena()));
+}
+
+#endif // !FRAME_ARENA_H
@@ -0,0 +1,131 @@
+#pragma once
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Per-frame CPU, GPU and total frame timings with percentile summaries. GPU time comes from GL_TIME_ELAPSED
+// queries that are read back a few frames late so the CPU never waits on them.
+// Software rasterizers such as llvmpipe only rasterize when the frame is flushed at swap, so their GPU time
+// reads close to zero; frame time (begin of frame to after swap, without vsync) is the number to compare there.
+class FrameStats {
+
+public:
+    struct Frame {
+        double cpuMs;
+        double gpuMs;   // negative until the query result has been read back
+        double frameMs;
+    };
+
+    std::vector<Frame> frames;
+
+    // call with a current GL context, unless gpuTimers is off (renderers that don't use GL)
+    void init(bool gpuTimers = true) {
+        useQueries = gpuTimers;
+        if (useQueries)
+            glGenQueries(QUERY_LATENCY, queries);
+    }
+
+    void beginFrame() {
+        cpuStart = std::chrono::steady_clock::now();
+        if (!useQueries) return;
+        collect(false);
+        glBeginQuery(GL_TIME_ELAPSED, queries[frames.size() % QUERY_LATENCY]);
+    }
+
+    // call before swapping buffers, so waiting for vsync isn't counted as CPU time
+    void endFrame() {
+        if (useQueries)
+            glEndQuery(GL_TIME_ELAPSED);
+        double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
+        frames.push_back({ cpuMs, -1.0, cpuMs });
+    }
+
+    // call right after swapping buffers
+    void framePresented() {
+        frames.back().frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
+    }
+
+    // reads back the outstanding queries and frees them
+    void finish() {
+        if (!useQueries) return;
+        collect(true);
+        glDeleteQueries(QUERY_LATENCY, queries);
+    }
+
+    void writeCsv(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out) {
+            std::cout << "ERROR::FRAME_STATS::CANNOT_WRITE: " << path << std::endl;
+            return;
+        }
+        out << "frame,cpu_ms,gpu_ms,frame_ms\n";
+        for (size_t i = 0; i < frames.size(); ++i)
+            out << i << "," << frames[i].cpuMs << "," << frames[i].gpuMs << "," << frames[i].frameMs << "\n";
+    }
+
+    // percentile summary of each series as a single JSON object
+    void writeSummary(std::ostream& out, int skipFrames = 0) const {
+        std::vector<double> cpu, gpu, frame;
+        for (size_t i = std::min<size_t>(skipFrames, frames.size()); i < frames.size(); ++i) {
+            cpu.push_back(frames[i].cpuMs);
+            frame.push_back(frames[i].frameMs);
+            if (frames[i].gpuMs >= 0.0)
+                gpu.push_back(frames[i].gpuMs);
+        }
+        out << "{\"frames\": " << cpu.size() << ", \"cpu_ms\": ";
+        writePercentiles(out, cpu);
+        out << ", \"gpu_ms\": ";
+        writePercentiles(out, gpu);
+        out << ", \"frame_ms\": ";
+        writePercentiles(out, frame);
+        out << "}" << std::endl;
+    }
+
+private:
+    static const int QUERY_LATENCY = 4;
+    GLuint queries[QUERY_LATENCY] = {};
+    bool useQueries = true;
+    size_t collected = 0;
+    std::chrono::steady_clock::time_point cpuStart;
+
+    // fills in gpuMs for frames whose query is old enough (or all of them when waiting)
+    void collect(bool wait) {
+        while (collected < frames.size()) {
+            if (!wait && frames.size() - collected < QUERY_LATENCY - 1)
+                break;
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(queries[collected % QUERY_LATENCY], GL_QUERY_RESULT, &elapsed);
+            frames[collected].gpuMs = elapsed / 1e6;
+            ++collected;
+        }
+    }
+
+    static double percentile(const std::vector<double>& sorted, double p) {
+        if (sorted.empty()) return 0.0;
+        double rank = p * (sorted.size() - 1);
+        size_t lo = (size_t)rank;
+        size_t hi = std::min(lo + 1, sorted.size() - 1);
+        return sorted[lo] + (sorted[hi] - sorted[lo]) * (rank - lo);
+    }
+
+    static void writePercentiles(std::ostream& out, std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        double mean = 0.0;
+        for (double v : values) mean += v;
+        mean = values.empty() ? 0.0 : mean / values.size();
+        out << "{\"mean\": " << mean << ", \"p50\": " << percentile(values, 0.50) << ", \"p90\": " << percentile(values, 0.90)
+            << ", \"p95\": " << percentile(values, 0.95) << ", \"p99\": " << percentile(values, 0.99)
+            << ", \"max\": " << (values.empty() ? 0.0 : values.back()) << "}";
+    }
+};
+
+#endif // !FRAME_STATS_H
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+#include "MemoryLedger.h"
+
+// An offscreen render target: RGBA8 color texture plus a depth renderbuffer.
+class Framebuffer {
+
+public:
+    unsigned int FBO = 0;
+    unsigned int colorTexture = 0;
+    unsigned int depthRenderbuffer = 0;
+    int width = 0;
+    int height = 0;
+
+    // (re)creates the attachments at the given size; returns false if the framebuffer is incomplete
+    bool create(int w, int h) {
+        DeleteBuffers();
+        width = w;
+        height = h;
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+        glGenTextures(1, &colorTexture);
+        glBindTexture(GL_TEXTURE_2D, colorTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        gpuMemory().record(GPU_TEXTURE, colorTexture, MEMORY_RENDERER, "framebuffer color", estimateTextureBytes(width, height, 4, false));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+
+        glGenRenderbuffers(1, &depthRenderbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        gpuMemory().record(GPU_RENDERBUFFER, depthRenderbuffer, MEMORY_RENDERER, "framebuffer depth", estimateTextureBytes(width, height, 4, false));
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        if (!complete)
+            std::cout << "ERROR::FRAMEBUFFER::INCOMPLETE " << width << "x" << height << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return complete;
+    }
+
+    // binds the framebuffer for drawing and sets the viewport to cover it
+    void bind() const {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(0, 0, width, height);
+    }
+
+    void DeleteBuffers() {
+        if (FBO) glDeleteFramebuffers(1, &FBO);
+        if (colorTexture) glDeleteTextures(1, &colorTexture);
+        if (depthRenderbuffer) glDeleteRenderbuffers(1, &depthRenderbuffer);
+        gpuMemory().release(GPU_TEXTURE, colorTexture);
+        gpuMemory().release(GPU_RENDERBUFFER, depthRenderbuffer);
+        FBO = colorTexture = depthRenderbuffer = 0;
+    }
+};
+
+#endif // !FRAMEBUFFER_H
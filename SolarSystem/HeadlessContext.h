@@ -0,0 +1,115 @@
+#pragma once
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+// Windowless OpenGL context for render servers: a surfaceless EGL context (Mesa's surfaceless platform
+// when available, otherwise the default display), so rendering has to go into a Framebuffer.
+// EGL is only available on Linux here; elsewhere create() reports that headless mode is unsupported.
+#if defined(__linux__) && !defined(SOLAR_NO_EGL)
+#define SOLAR_HAS_EGL 1
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <iostream>
+
+class HeadlessContext {
+
+public:
+    HeadlessContext() {}
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+    ~HeadlessContext() { destroy(); }
+
+#ifdef SOLAR_HAS_EGL
+    // creates a core profile context of at least the given version; does not make it current
+    bool create(int major = 3, int minor = 3) {
+        EGLDisplay display = sharedDisplay();
+        if (display == EGL_NO_DISPLAY) {
+            std::cout << "ERROR::HEADLESS::NO_EGL_DISPLAY" << std::endl;
+            return false;
+        }
+        const EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+            EGL_DEPTH_SIZE, 24,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount < 1) {
+            std::cout << "ERROR::HEADLESS::NO_EGL_CONFIG" << std::endl;
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API)) {
+            std::cout << "ERROR::HEADLESS::NO_DESKTOP_GL" << std::endl;
+            return false;
+        }
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, major,
+            EGL_CONTEXT_MINOR_VERSION, minor,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+        if (context == EGL_NO_CONTEXT) {
+            std::cout << "ERROR::HEADLESS::CONTEXT_CREATION_FAILED: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // binds the context to the calling thread without any surface (EGL_KHR_surfaceless_context)
+    bool makeCurrent() {
+        return eglMakeCurrent(sharedDisplay(), EGL_NO_SURFACE, EGL_NO_SURFACE, context) == EGL_TRUE;
+    }
+
+    void releaseCurrent() {
+        eglMakeCurrent(sharedDisplay(), EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+
+    void destroy() {
+        if (context != EGL_NO_CONTEXT) {
+            eglDestroyContext(sharedDisplay(), context);
+            context = EGL_NO_CONTEXT;
+        }
+    }
+
+    // loader for gladLoadGLLoader
+    static void* getProcAddress(const char* name) {
+        return (void*)eglGetProcAddress(name);
+    }
+
+private:
+    EGLContext context = EGL_NO_CONTEXT;
+
+    // one EGL display per process, shared by every headless context
+    static EGLDisplay sharedDisplay() {
+        static EGLDisplay display = []() {
+            EGLDisplay d = EGL_NO_DISPLAY;
+            PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+            if (getPlatformDisplay)
+                d = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (d == EGL_NO_DISPLAY)
+                d = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            EGLint major, minor;
+            if (d != EGL_NO_DISPLAY && !eglInitialize(d, &major, &minor))
+                d = EGL_NO_DISPLAY;
+            return d;
+        }();
+        return display;
+    }
+#else
+    bool create(int major = 3, int minor = 3) {
+        std::cout << "ERROR::HEADLESS::NOT_SUPPORTED: headless mode needs EGL (Linux)" << std::endl;
+        return false;
+    }
+    bool makeCurrent() { return false; }
+    void releaseCurrent() {}
+    void destroy() {}
+    static void* getProcAddress(const char* name) { return nullptr; }
+#endif
+};
+
+#endif // !HEADLESS_CONTEXT_H
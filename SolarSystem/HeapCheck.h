@@ -0,0 +1,145 @@
+#pragma once
+#ifndef HEAP_CHECK_H
+#define HEAP_CHECK_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include "MemoryLedger.h"
+
+// Counts the allocations made through the global operator new, to check that the frame loop allocates nothing
+// once it has warmed up. Only builds with SOLAR_HEAP_CHECK defined (the Debug configurations) count; elsewhere
+// heapAllocations() stays at 0. The same operators keep the per-tag byte counts of MemoryLedger.h, which
+// SOLAR_MEMORY_TRACKING turns on by itself. They replace the global ones, so exactly one translation unit
+// defines HEAP_CHECK_IMPLEMENTATION before including this file. On Linux the GL driver's own C++ allocations
+// land here too (Mesa compiles shader variants the first time a state combination is drawn), so a warm-up there
+// has to last until every variant has been seen.
+
+inline std::atomic<size_t>& heapAllocationCounter()
+{
+    static std::atomic<size_t> count(0);
+    return count;
+}
+
+// allocations since the start of the program, on every thread
+inline size_t heapAllocations()
+{
+    return heapAllocationCounter().load(std::memory_order_relaxed);
+}
+
+inline bool heapCheckEnabled()
+{
+#ifdef SOLAR_HEAP_CHECK
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Reports every frame after the warm-up that made heap allocations. Fatal turns the report into a failed assert,
+// for runs whose settings don't change along the way (headless); interactive ones can legitimately allocate when
+// a setting grows something.
+class FrameHeapCheck {
+
+public:
+    int WarmupFrames = 10;
+    bool Fatal = false;
+    // of the frames after the warm-up
+    int FramesAllocating = 0;
+    size_t Allocations = 0;
+
+    void beginFrame() {
+        before = heapAllocations();
+    }
+
+    void endFrame() {
+        size_t allocations = heapAllocations() - before;
+        if (heapCheckEnabled() && frame >= WarmupFrames && allocations > 0) {
+            ++FramesAllocating;
+            Allocations += allocations;
+            std::cout << "ERROR::FRAME::HEAP_ALLOCATION: frame " << frame << " made " << allocations << " heap allocations" << std::endl;
+            assert(!Fatal && "no heap allocations after the warm-up");
+        }
+        ++frame;
+    }
+
+private:
+    size_t before = 0;
+    int frame = 0;
+};
+
+#if (defined(SOLAR_HEAP_CHECK) || defined(SOLAR_MEMORY_TRACKING)) && defined(HEAP_CHECK_IMPLEMENTATION)
+
+// GCC pairs operator new with its builtin and flags the free() below; the two here go together
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+#ifdef SOLAR_HEAP_CHECK
+    heapAllocationCounter().fetch_add(1, std::memory_order_relaxed);
+#endif
+    void* block = std::malloc(size + HEAP_BLOCK_HEADER);
+    return block ? trackHeapBlock(block, size) : nullptr;
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void* operator new(size_t size)
+{
+    if (void* p = operator new(size, std::nothrow))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    if (p) std::free(untrackHeapBlock(p));
+}
+
+void operator delete[](void* p) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    operator delete(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
+
+#endif // !HEAP_CHECK_H
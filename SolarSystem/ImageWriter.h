@@ -0,0 +1,383 @@
+#pragma once
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Writes 8-bit RGB pixels as a binary PPM. Rows are expected bottom-up, the way glReadPixels returns them.
+inline bool writePPM(const std::string& path, int width, int height, const unsigned char* rgb)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        std::cout << "ERROR::IMAGE_WRITER::CANNOT_WRITE: " << path << std::endl;
+        return false;
+    }
+    out << "P6\n" << width << " " << height << "\n255\n";
+    for (int y = height - 1; y >= 0; --y)
+        out.write(reinterpret_cast<const char*>(rgb + (size_t)y * width * 3), (std::streamsize)width * 3);
+    return (bool)out;
+}
+
+// Reads a binary 8-bit PPM like writePPM writes, with rows bottom-up again
+inline bool readPPM(const std::string& path, int& width, int& height, std::vector<unsigned char>& rgb)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::string magic;
+    int maxValue = 0;
+    if (!(in >> magic >> width >> height >> maxValue) || magic != "P6" || maxValue != 255 || width <= 0 || height <= 0) {
+        std::cout << "ERROR::IMAGE_WRITER::NOT_A_PPM: " << path << std::endl;
+        return false;
+    }
+    in.get();
+    rgb.resize((size_t)width * height * 3);
+    for (int y = height - 1; y >= 0; --y)
+        in.read(reinterpret_cast<char*>(&rgb[(size_t)y * width * 3]), (std::streamsize)width * 3);
+    if (!in) {
+        std::cout << "ERROR::IMAGE_WRITER::TRUNCATED_PPM: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// CRC-32 of PNG chunks
+inline unsigned int crc32Update(unsigned int crc, const unsigned char* data, size_t length)
+{
+    static const std::vector<unsigned int> table = []() {
+        std::vector<unsigned int> t(256);
+        for (unsigned int n = 0; n < 256; ++n) {
+            unsigned int c = n;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+// Adler-32 checksum that ends a zlib stream; start with 1
+inline unsigned int adler32Update(unsigned int adler, const unsigned char* data, size_t length)
+{
+    unsigned int a = adler & 0xffff, b = adler >> 16;
+    while (length > 0) {
+        // largest run that can't overflow 32 bits before the modulo
+        size_t run = std::min<size_t>(length, 5552);
+        length -= run;
+        while (run--) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+// Compresses data as deflate blocks with the fixed Huffman code and a hash-chain LZ77 matcher, appending to out.
+// Each call is independent (matches never reach into earlier calls), so chunks can be compressed in parallel and
+// concatenated. Without finalBlock the output ends with an empty stored block, aligning it to a byte boundary.
+inline void deflateFixed(const unsigned char* data, size_t length, bool finalBlock, std::vector<unsigned char>& out)
+{
+    static const int lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const int lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static const int distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static const int distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    const int WINDOW = 32768, MIN_MATCH = 3, MAX_MATCH = 258, MAX_CHAIN = 32, HASH_BITS = 15;
+
+    unsigned int bitBuffer = 0;
+    int bitCount = 0;
+    auto writeBits = [&](unsigned int bits, int count) {
+        bitBuffer |= bits << bitCount;
+        bitCount += count;
+        while (bitCount >= 8) {
+            out.push_back((unsigned char)bitBuffer);
+            bitBuffer >>= 8;
+            bitCount -= 8;
+        }
+    };
+    // Huffman codes are stored most significant bit first
+    auto writeCode = [&](unsigned int code, int codeLength) {
+        unsigned int reversed = 0;
+        for (int i = 0; i < codeLength; ++i)
+            reversed |= ((code >> i) & 1) << (codeLength - 1 - i);
+        writeBits(reversed, codeLength);
+    };
+    auto writeSymbol = [&](int symbol) {
+        if (symbol < 144) writeCode(0x30 + symbol, 8);
+        else if (symbol < 256) writeCode(0x190 + symbol - 144, 9);
+        else if (symbol < 280) writeCode(symbol - 256, 7);
+        else writeCode(0xc0 + symbol - 280, 8);
+    };
+
+    writeBits(finalBlock ? 1 : 0, 1);
+    writeBits(1, 2); // fixed Huffman block
+
+    std::vector<int> head((size_t)1 << HASH_BITS, -1);
+    std::vector<int> previous(WINDOW, -1);
+    auto hashAt = [&](size_t i) {
+        unsigned int v = (unsigned int)data[i] << 16 | (unsigned int)data[i + 1] << 8 | data[i + 2];
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    };
+    auto insert = [&](size_t i) {
+        unsigned int h = hashAt(i);
+        previous[i % WINDOW] = head[h];
+        head[h] = (int)i;
+    };
+
+    size_t i = 0;
+    while (i < length) {
+        int bestLength = 0, bestDistance = 0;
+        if (i + MIN_MATCH <= length) {
+            int maxLength = (int)std::min<size_t>(MAX_MATCH, length - i);
+            int candidate = head[hashAt(i)];
+            for (int chain = 0; candidate >= 0 && (int)i - candidate <= WINDOW && chain < MAX_CHAIN; ++chain) {
+                const unsigned char* a = data + candidate;
+                const unsigned char* b = data + i;
+                int matched = 0;
+                while (matched < maxLength && a[matched] == b[matched])
+                    ++matched;
+                if (matched > bestLength) {
+                    bestLength = matched;
+                    bestDistance = (int)i - candidate;
+                    if (matched == maxLength) break;
+                }
+                int next = previous[candidate % WINDOW];
+                if (next >= candidate) break; // the slot was reused by a newer position
+                candidate = next;
+            }
+            insert(i);
+        }
+        if (bestLength >= MIN_MATCH) {
+            int code = (int)(std::upper_bound(lengthBase, lengthBase + 29, bestLength) - lengthBase) - 1;
+            writeSymbol(257 + code);
+            writeBits(bestLength - lengthBase[code], lengthExtra[code]);
+            code = (int)(std::upper_bound(distanceBase, distanceBase + 30, bestDistance) - distanceBase) - 1;
+            writeCode(code, 5);
+            writeBits(bestDistance - distanceBase[code], distanceExtra[code]);
+            for (size_t j = i + 1; j < i + bestLength && j + MIN_MATCH <= length; ++j)
+                insert(j);
+            i += bestLength;
+        }
+        else {
+            writeSymbol(data[i]);
+            ++i;
+        }
+    }
+    writeSymbol(256); // end of block
+
+    if (!finalBlock) {
+        writeBits(0, 3); // empty stored block
+        if (bitCount > 0) writeBits(0, 8 - bitCount);
+        const unsigned char storedLength[4] = { 0x00, 0x00, 0xff, 0xff };
+        out.insert(out.end(), storedLength, storedLength + 4);
+    }
+    else if (bitCount > 0) {
+        writeBits(0, 8 - bitCount);
+    }
+}
+
+// PNG row filtering: tries every filter type and keeps the one with the smallest sum of absolute residuals.
+// previousRow is null for the first row of the image. Writes the filter type byte and rowBytes filtered bytes;
+// scratch is reused between calls.
+inline void filterPngRow(const unsigned char* row, const unsigned char* previousRow, int rowBytes, int bytesPerPixel, unsigned char* out, std::vector<unsigned char>& scratch)
+{
+    scratch.assign((size_t)rowBytes * 6, 0);
+    unsigned char* candidates = scratch.data();
+    if (previousRow == nullptr)
+        previousRow = candidates + (size_t)rowBytes * 5; // zeros
+    unsigned char* none = candidates;
+    unsigned char* sub = candidates + rowBytes;
+    unsigned char* up = candidates + (size_t)rowBytes * 2;
+    unsigned char* average = candidates + (size_t)rowBytes * 3;
+    unsigned char* paeth = candidates + (size_t)rowBytes * 4;
+    for (int x = 0; x < rowBytes; ++x) {
+        int left = x >= bytesPerPixel ? row[x - bytesPerPixel] : 0;
+        int above = previousRow[x];
+        int aboveLeft = x >= bytesPerPixel ? previousRow[x - bytesPerPixel] : 0;
+        int p = left + above - aboveLeft;
+        int pa = std::abs(p - left), pb = std::abs(p - above), pc = std::abs(p - aboveLeft);
+        int predicted = (pa <= pb && pa <= pc) ? left : (pb <= pc ? above : aboveLeft);
+        none[x] = row[x];
+        sub[x] = (unsigned char)(row[x] - left);
+        up[x] = (unsigned char)(row[x] - above);
+        average[x] = (unsigned char)(row[x] - (left + above) / 2);
+        paeth[x] = (unsigned char)(row[x] - predicted);
+    }
+    int bestType = 0;
+    long long bestCost = -1;
+    for (int type = 0; type < 5; ++type) {
+        const unsigned char* candidate = candidates + (size_t)rowBytes * type;
+        long long cost = 0;
+        for (int x = 0; x < rowBytes; ++x)
+            cost += std::abs((int)(signed char)candidate[x]);
+        if (bestCost < 0 || cost < bestCost) {
+            bestCost = cost;
+            bestType = type;
+        }
+    }
+    out[0] = (unsigned char)bestType;
+    std::memcpy(out + 1, candidates + (size_t)rowBytes * bestType, rowBytes);
+}
+
+// Streams an 8-bit grey/RGB/RGBA PNG to disk a band of rows at a time, so images larger than memory can be
+// written as they are produced. Every band becomes its own IDAT chunk.
+class PngWriter {
+
+public:
+    ~PngWriter() {
+        if (file) std::fclose(file);
+    }
+
+    bool open(const std::string& path, int w, int h, int channelCount) {
+        static const unsigned char colorTypes[5] = { 0, 0, 4, 2, 6 };
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            std::cout << "ERROR::IMAGE_WRITER::CANNOT_WRITE: " << path << std::endl;
+            return false;
+        }
+        width = w;
+        height = h;
+        channels = channelCount;
+        rowsWritten = 0;
+        adler = 1;
+        bytesWritten = 0;
+        lastRow.clear();
+        zlibHeaderWritten = false;
+
+        const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        std::fwrite(signature, 1, 8, file);
+        bytesWritten += 8;
+        unsigned char header[13];
+        putBigEndian(header, (unsigned int)width);
+        putBigEndian(header + 4, (unsigned int)height);
+        header[8] = 8; // bit depth
+        header[9] = colorTypes[channels];
+        header[10] = header[11] = header[12] = 0; // deflate, adaptive filtering, no interlace
+        writeChunk("IHDR", header, 13);
+        return true;
+    }
+
+    // appends the next rowCount rows from the top; row r starts at firstRow + r * rowStride, so a negative stride
+    // reads bottom-up GL images. With a pool, bands of rows are filtered and compressed in parallel.
+    bool writeRows(const unsigned char* firstRow, std::ptrdiff_t rowStride, int rowCount, ThreadPool* pool = nullptr) {
+        if (!file || rowCount <= 0) return file != nullptr;
+        const int rowBytes = width * channels;
+        const int bandRows = std::max(16, pool ? rowCount / ((pool->threadCount() + 1) * 2) : rowCount);
+        const int bandCount = (rowCount + bandRows - 1) / bandRows;
+        std::vector<std::vector<unsigned char>> filtered(bandCount), compressed(bandCount);
+
+        auto compressBands = [&](int begin, int end) {
+            for (int band = begin; band < end; ++band) {
+                int first = band * bandRows;
+                int last = std::min(first + bandRows, rowCount);
+                filtered[band].resize((size_t)(last - first) * (rowBytes + 1));
+                std::vector<unsigned char> scratch;
+                for (int r = first; r < last; ++r) {
+                    const unsigned char* row = firstRow + r * rowStride;
+                    const unsigned char* previousRow = r > 0 ? row - rowStride : (lastRow.empty() ? nullptr : lastRow.data());
+                    filterPngRow(row, previousRow, rowBytes, channels, filtered[band].data() + (size_t)(r - first) * (rowBytes + 1), scratch);
+                }
+                deflateFixed(filtered[band].data(), filtered[band].size(), false, compressed[band]);
+            }
+        };
+        if (pool) pool->parallelFor(bandCount, compressBands);
+        else compressBands(0, bandCount);
+
+        for (int band = 0; band < bandCount; ++band) {
+            adler = adler32Update(adler, filtered[band].data(), filtered[band].size());
+            writeIdat(compressed[band]);
+        }
+        const unsigned char* lastInput = firstRow + (rowCount - 1) * rowStride;
+        lastRow.assign(lastInput, lastInput + rowBytes);
+        rowsWritten += rowCount;
+        return !std::ferror(file);
+    }
+
+    // finishes the zlib stream and the file; every row must have been written
+    bool close() {
+        if (!file) return false;
+        bool complete = rowsWritten == height;
+        if (!complete)
+            std::cout << "ERROR::IMAGE_WRITER::INCOMPLETE_PNG: " << rowsWritten << " of " << height << " rows" << std::endl;
+        // an empty final block, then the checksum of the uncompressed data
+        std::vector<unsigned char> tail = { 0x03, 0x00, 0, 0, 0, 0 };
+        putBigEndian(tail.data() + 2, adler);
+        writeIdat(tail);
+        writeChunk("IEND", nullptr, 0);
+        complete = complete && !std::ferror(file);
+        std::fclose(file);
+        file = nullptr;
+        return complete;
+    }
+
+    size_t fileSize() const {
+        return bytesWritten;
+    }
+
+private:
+    std::FILE* file = nullptr;
+    int width = 0;
+    int height = 0;
+    int channels = 4;
+    int rowsWritten = 0;
+    unsigned int adler = 1;
+    size_t bytesWritten = 0;
+    bool zlibHeaderWritten = false;
+    std::vector<unsigned char> lastRow;
+
+    static void putBigEndian(unsigned char* out, unsigned int value) {
+        out[0] = (unsigned char)(value >> 24);
+        out[1] = (unsigned char)(value >> 16);
+        out[2] = (unsigned char)(value >> 8);
+        out[3] = (unsigned char)value;
+    }
+
+    void writeIdat(std::vector<unsigned char>& data) {
+        if (!zlibHeaderWritten) {
+            const unsigned char zlibHeader[2] = { 0x78, 0x01 };
+            data.insert(data.begin(), zlibHeader, zlibHeader + 2);
+            zlibHeaderWritten = true;
+        }
+        writeChunk("IDAT", data.data(), data.size());
+    }
+
+    void writeChunk(const char* type, const unsigned char* data, size_t length) {
+        unsigned char lengthBytes[4];
+        putBigEndian(lengthBytes, (unsigned int)length);
+        std::fwrite(lengthBytes, 1, 4, file);
+        std::fwrite(type, 1, 4, file);
+        if (length > 0)
+            std::fwrite(data, 1, length, file);
+        unsigned int crc = crc32Update(0, (const unsigned char*)type, 4);
+        crc = crc32Update(crc, data, length);
+        unsigned char crcBytes[4];
+        putBigEndian(crcBytes, crc);
+        std::fwrite(crcBytes, 1, 4, file);
+        bytesWritten += length + 12;
+    }
+};
+
+// Writes a whole image as PNG. Rows are expected bottom-up, the way glReadPixels returns them.
+inline bool writePNG(const std::string& path, int width, int height, int channels, const unsigned char* pixels, ThreadPool* pool = nullptr)
+{
+    PngWriter png;
+    if (!png.open(path, width, height, channels))
+        return false;
+    const std::ptrdiff_t rowBytes = (std::ptrdiff_t)width * channels;
+    png.writeRows(pixels + (height - 1) * rowBytes, -rowBytes, height, pool);
+    return png.close();
+}
+
+#endif // !IMAGE_WRITER_H
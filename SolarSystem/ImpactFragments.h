@@ -0,0 +1,109 @@
+#pragma once
+#ifndef IMPACT_FRAGMENTS_H
+#define IMPACT_FRAGMENTS_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "SlotMap.h"
+#include "ModelMatrixBatch.h"
+#include "AsteroidBelt.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Rocks thrown off a body's surface, as if by an impact, that fly out in straight lines and vanish after
+// Lifetime sim seconds. They're spawned and despawned by the thousand every frame, so they live in a SlotMap:
+// after the first second or so of a steady stream, nothing is allocated anymore. They're drawn with the asteroid
+// shapes.
+class ImpactFragments {
+
+public:
+    struct Fragment {
+        glm::vec3 origin;   // where it left the surface
+        glm::vec3 velocity; // scene units per sim second
+        glm::vec3 spinAxis;
+        float spinSpeed;    // turns per sim second
+        float scale;
+        int shape;          // an AsteroidBelt shape
+        double bornAt;      // sim seconds
+    };
+
+    // sim seconds a fragment lives
+    float Lifetime = 1.5f;
+
+    SlotMap<Fragment> fragments;
+    // fragments of each shape at the last modelMatrices, which puts them in this order
+    size_t ShapeCounts[AsteroidBelt::SHAPE_COUNT] = {};
+
+    // room for a steady stream of perFrame fragments every frameSeconds, so that it never has to grow
+    void reserve(int perFrame, float frameSeconds) {
+        if (perFrame <= 0 || frameSeconds <= 0.0f) return;
+        size_t count = (size_t)perFrame * ((size_t)std::ceil(Lifetime / frameSeconds) + 1);
+        fragments.reserve(count);
+        transforms.reserve(count);
+    }
+
+    // count fragments from the point of a body of the given radius (in scene units) centred at center that faces
+    // along normal, in a cone around it, at a few body radii per sim second
+    void spawn(const glm::vec3& center, float radius, const glm::vec3& normal, int count, double simTime) {
+        glm::vec3 site = center + normal * radius;
+        for (int i = 0; i < count; ++i) {
+            Fragment f;
+            f.origin = site;
+            f.velocity = glm::normalize(normal + 0.7f * randomDirection(random)) * radius * (0.5f + 2.5f * uniform(random));
+            f.spinAxis = randomDirection(random);
+            f.spinSpeed = 0.5f + 3.0f * uniform(random);
+            f.scale = radius * (0.01f + 0.04f * uniform(random) * uniform(random));
+            f.shape = std::min((int)(uniform(random) * AsteroidBelt::SHAPE_COUNT), AsteroidBelt::SHAPE_COUNT - 1);
+            f.bornAt = simTime;
+            fragments.insert(f);
+        }
+    }
+
+    // despawns the fragments older than Lifetime, and any from after simTime (the sim was rewound)
+    void expire(double simTime) {
+        for (size_t i = fragments.size(); i > 0; --i) {
+            double age = simTime - fragments[i - 1].bornAt;
+            if (age > Lifetime || age < 0.0)
+                fragments.eraseAt(i - 1);
+        }
+    }
+
+    // every fragment's model matrix, one every stride floats as buildModelMatrices writes them, grouped by
+    // shape so that consecutive fragments can share an instanced draw; ShapeCounts says how many of each
+    void modelMatrices(double simTime, float* out, size_t stride = 16) {
+        size_t next[AsteroidBelt::SHAPE_COUNT];
+        std::fill(ShapeCounts, ShapeCounts + AsteroidBelt::SHAPE_COUNT, 0);
+        for (const Fragment& f : fragments)
+            ++ShapeCounts[f.shape];
+        next[0] = 0;
+        for (int s = 1; s < AsteroidBelt::SHAPE_COUNT; ++s)
+            next[s] = next[s - 1] + ShapeCounts[s - 1];
+        // shrinking keeps the capacity, so this allocates only while the stream is still growing
+        transforms.resize(fragments.size());
+        for (const Fragment& f : fragments) {
+            size_t i = next[f.shape]++;
+            float age = static_cast<float>(simTime - f.bornAt);
+            glm::vec3 position = f.origin + f.velocity * age;
+            transforms.x[i] = position.x;
+            transforms.y[i] = position.y;
+            transforms.z[i] = position.z;
+            transforms.axisX[i] = f.spinAxis.x;
+            transforms.axisY[i] = f.spinAxis.y;
+            transforms.axisZ[i] = f.spinAxis.z;
+            transforms.angle[i] = turnsToRadians((double)age * f.spinSpeed);
+            transforms.scale[i] = f.scale;
+        }
+        buildModelMatrices(transforms, out, stride, SinCosPrecision::Medium);
+    }
+
+private:
+    TrsBatch transforms;
+    std::mt19937 random{ 11 };
+};
+
+#endif // !IMPACT_FRAGMENTS_H
@@ -0,0 +1,156 @@
+#pragma once
+#ifndef INPUT_RECORDER_H
+#define INPUT_RECORDER_H
+
+#include <GLFW/glfw3.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// keys that can be recorded, bit i of a frame's key mask is RECORDED_KEYS[i]
+const int RECORDED_KEYS[] = { GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_TAB, GLFW_KEY_ESCAPE, GLFW_KEY_F12 };
+
+// Records the keys, mouse and scroll events and deltaTime of every frame to a text file, and plays such a
+// file back frame by frame so the camera flies exactly the same path with the same sim time.
+//
+// File format, one frame line followed by the events delivered at the end of that frame:
+//   frame <deltaTime> <key mask> <planet scale> <days per second> <rotation time scale>
+//   mouse <x> <y>
+//   scroll <y offset>
+class InputRecorder {
+
+public:
+    enum Mode { OFF, RECORD, REPLAY };
+    enum EventType { MOUSE, SCROLL };
+
+    struct Frame {
+        float deltaTime;
+        unsigned int keys;
+        float planetScale;
+        float timeScaleDaysPerSecond;
+        float timeScaleRotation;
+        size_t firstEvent;
+        size_t eventCount;
+    };
+    struct Event {
+        EventType type;
+        double x;
+        double y;
+    };
+
+    Mode mode = OFF;
+
+    bool startRecording(const std::string& path) {
+        out.open(path);
+        if (!out) {
+            std::cout << "ERROR::INPUT_RECORDER::CANNOT_WRITE: " << path << std::endl;
+            return false;
+        }
+        // enough digits that replaying reproduces the recorded floats exactly
+        out.precision(9);
+        pending.precision(17);
+        out << "# solar system input recording v1\n";
+        mode = RECORD;
+        return true;
+    }
+
+    bool loadReplay(const std::string& path) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cout << "ERROR::INPUT_RECORDER::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+            return false;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string tag;
+            fields >> tag;
+            if (tag == "frame") {
+                Frame frame{};
+                fields >> frame.deltaTime >> frame.keys >> frame.planetScale >> frame.timeScaleDaysPerSecond >> frame.timeScaleRotation;
+                frame.firstEvent = events.size();
+                frames.push_back(frame);
+            }
+            else if ((tag == "mouse" || tag == "scroll") && !frames.empty()) {
+                Event event{ tag == "mouse" ? MOUSE : SCROLL, 0.0, 0.0 };
+                if (event.type == MOUSE)
+                    fields >> event.x >> event.y;
+                else
+                    fields >> event.y;
+                events.push_back(event);
+                frames.back().eventCount++;
+            }
+        }
+        mode = REPLAY;
+        replayFrame = -1;
+        return true;
+    }
+
+    // starts the next frame; when replaying returns false once the recording is exhausted
+    bool beginFrame(float deltaTime, float planetScale, float timeScaleDaysPerSecond, float timeScaleRotation) {
+        if (mode == REPLAY)
+            return ++replayFrame < (long long)frames.size();
+        if (mode == RECORD)
+            recording = { deltaTime, 0, planetScale, timeScaleDaysPerSecond, timeScaleRotation, 0, 0 };
+        return true;
+    }
+
+    // the frame being replayed
+    const Frame& frame() const {
+        return frames[replayFrame];
+    }
+    const Event* frameEvents() const {
+        return events.data() + frames[replayFrame].firstEvent;
+    }
+    size_t replayFrameCount() const {
+        return frames.size();
+    }
+
+    // live key state when recording, recorded key state when replaying
+    bool isKeyPressed(GLFWwindow* window, int key) {
+        int bit = keyBit(key);
+        if (mode == REPLAY)
+            return bit >= 0 && (frame().keys & (1u << bit));
+        bool pressed = glfwGetKey(window, key) == GLFW_PRESS;
+        if (mode == RECORD && pressed && bit >= 0)
+            recording.keys |= 1u << bit;
+        return pressed;
+    }
+
+    void recordMouse(double x, double y) {
+        if (mode == RECORD)
+            pending << "mouse " << x << " " << y << "\n";
+    }
+    void recordScroll(double yoffset) {
+        if (mode == RECORD)
+            pending << "scroll " << yoffset << "\n";
+    }
+
+    // writes the frame when recording; call after the frame's events have been polled
+    void endFrame() {
+        if (mode != RECORD) return;
+        out << "frame " << recording.deltaTime << " " << recording.keys << " " << recording.planetScale << " "
+            << recording.timeScaleDaysPerSecond << " " << recording.timeScaleRotation << "\n" << pending.str();
+        pending.str("");
+    }
+
+private:
+    std::ofstream out;
+    std::ostringstream pending;
+    Frame recording{};
+    std::vector<Frame> frames;
+    std::vector<Event> events;
+    long long replayFrame = -1;
+
+    static int keyBit(int key) {
+        for (int i = 0; i < (int)(sizeof(RECORDED_KEYS) / sizeof(RECORDED_KEYS[0])); ++i)
+            if (RECORDED_KEYS[i] == key)
+                return i;
+        return -1;
+    }
+};
+
+#endif // !INPUT_RECORDER_H
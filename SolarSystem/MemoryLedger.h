@@ -0,0 +1,327 @@
+#pragma once
+#ifndef MEMORY_LEDGER_H
+#define MEMORY_LEDGER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Where the RAM and VRAM go, by subsystem. Heap allocations are tagged with the calling thread's current
+// MemoryTag (set by a MemoryScope) and counted by the global operator new of HeapCheck.h, in builds with
+// SOLAR_MEMORY_TRACKING or SOLAR_HEAP_CHECK defined. GPU memory can't be asked for portably, so every GL
+// allocation site records an estimate in the gpuMemory() ledger instead, and releases it where the object is
+// deleted.
+
+enum MemoryTag {
+    MEMORY_UNTAGGED,
+    MEMORY_TEXTURES,
+    MEMORY_MESHES,
+    MEMORY_SCENE,
+    MEMORY_ASTEROIDS,
+    MEMORY_RENDERER,
+    MEMORY_FRAME_ARENAS,
+    MEMORY_UI,
+    MEMORY_RINGS,
+    MEMORY_TAG_COUNT
+};
+
+inline const char* memoryTagName(MemoryTag tag)
+{
+    static const char* names[MEMORY_TAG_COUNT] = { "untagged", "textures", "meshes", "scene", "asteroids", "renderer", "frame_arenas", "ui", "rings" };
+    return tag >= 0 && tag < MEMORY_TAG_COUNT ? names[tag] : "invalid";
+}
+
+// the tag heap allocations on this thread are counted under
+inline MemoryTag& currentMemoryTag()
+{
+    thread_local MemoryTag tag = MEMORY_UNTAGGED;
+    return tag;
+}
+
+// tags this thread's heap allocations until it goes out of scope
+class MemoryScope {
+
+public:
+    explicit MemoryScope(MemoryTag tag) : previous(currentMemoryTag()) {
+        currentMemoryTag() = tag;
+    }
+    ~MemoryScope() {
+        currentMemoryTag() = previous;
+    }
+
+    MemoryScope(const MemoryScope&) = delete;
+    MemoryScope& operator=(const MemoryScope&) = delete;
+
+private:
+    MemoryTag previous;
+};
+
+struct HeapTagUsage {
+    std::atomic<long long> bytes{ 0 };
+    std::atomic<long long> peakBytes{ 0 };
+    std::atomic<long long> allocations{ 0 }; // live
+};
+
+inline HeapTagUsage* heapTagUsage()
+{
+    static HeapTagUsage usage[MEMORY_TAG_COUNT];
+    return usage;
+}
+
+inline bool heapTrackingEnabled()
+{
+#if defined(SOLAR_MEMORY_TRACKING) || defined(SOLAR_HEAP_CHECK)
+    return true;
+#else
+    return false;
+#endif
+}
+
+// live heap bytes over every tag
+inline long long heapBytes()
+{
+    long long total = 0;
+    for (int t = 0; t < MEMORY_TAG_COUNT; ++t)
+        total += heapTagUsage()[t].bytes.load(std::memory_order_relaxed);
+    return total;
+}
+
+// bytes in front of every tracked block, keeping malloc's alignment for what follows
+const size_t HEAP_BLOCK_HEADER = 16;
+
+// for the operator new of HeapCheck.h: block has HEAP_BLOCK_HEADER bytes more than size; returns where the
+// caller's bytes start
+inline void* trackHeapBlock(void* block, size_t size)
+{
+    MemoryTag tag = currentMemoryTag();
+    size_t* header = static_cast<size_t*>(block);
+    header[0] = size;
+    header[1] = (size_t)tag;
+    HeapTagUsage& usage = heapTagUsage()[tag];
+    long long bytes = usage.bytes.fetch_add((long long)size, std::memory_order_relaxed) + (long long)size;
+    long long peak = usage.peakBytes.load(std::memory_order_relaxed);
+    while (bytes > peak && !usage.peakBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {}
+    usage.allocations.fetch_add(1, std::memory_order_relaxed);
+    return static_cast<unsigned char*>(block) + HEAP_BLOCK_HEADER;
+}
+
+// undoes trackHeapBlock; returns the block to free
+inline void* untrackHeapBlock(void* p)
+{
+    void* block = static_cast<unsigned char*>(p) - HEAP_BLOCK_HEADER;
+    const size_t* header = static_cast<const size_t*>(block);
+    HeapTagUsage& usage = heapTagUsage()[header[1]];
+    usage.bytes.fetch_sub((long long)header[0], std::memory_order_relaxed);
+    usage.allocations.fetch_sub(1, std::memory_order_relaxed);
+    return block;
+}
+
+enum GpuObjectKind {
+    GPU_BUFFER,
+    GPU_TEXTURE,
+    GPU_RENDERBUFFER
+};
+
+// Estimated GPU memory of every live GL buffer, texture and renderbuffer. GL names are only unique within a
+// context, and each context here lives on one thread, so objects are told apart by the thread too.
+class GpuMemoryLedger {
+
+public:
+    struct Object {
+        GpuObjectKind kind;
+        unsigned int name;
+        std::thread::id thread;
+        MemoryTag tag;
+        char label[48]; // cut short if longer
+        size_t bytes;
+    };
+
+    GpuMemoryLedger() {
+        objects.reserve(64);
+    }
+
+    // highest total so far
+    size_t PeakBytes = 0;
+
+    // sets the size of the object, e.g. at every glBufferData on it; the label is only taken the first time.
+    // Doesn't allocate while there are fewer than 64 objects, so it's safe in the frame loop.
+    void record(GpuObjectKind kind, unsigned int name, MemoryTag tag, const char* label, size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::thread::id thread = std::this_thread::get_id();
+        size_t i = find(kind, name, thread);
+        if (i == objects.size()) {
+            Object object = { kind, name, thread, tag, {}, 0 };
+            std::snprintf(object.label, sizeof(object.label), "%s", label);
+            objects.push_back(object);
+        }
+        total += bytes - objects[i].bytes;
+        objects[i].bytes = bytes;
+        objects[i].tag = tag;
+        PeakBytes = std::max(PeakBytes, total);
+    }
+
+    // forgets objects that were deleted; names that were never recorded are skipped
+    void release(GpuObjectKind kind, int count, const unsigned int* names) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::thread::id thread = std::this_thread::get_id();
+        for (int n = 0; n < count; ++n) {
+            size_t i = find(kind, names[n], thread);
+            if (i == objects.size()) continue;
+            total -= objects[i].bytes;
+            objects[i] = objects.back();
+            objects.pop_back();
+        }
+    }
+    void release(GpuObjectKind kind, unsigned int name) {
+        release(kind, 1, &name);
+    }
+
+    size_t totalBytes() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return total;
+    }
+
+    size_t bytes(MemoryTag tag) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t sum = 0;
+        for (const Object& object : objects)
+            if (object.tag == tag) sum += object.bytes;
+        return sum;
+    }
+
+    size_t objectCount() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return objects.size();
+    }
+
+    // calls f(const Object&) for every object, in no particular order, with the ledger locked; copies nothing
+    template <typename F>
+    void eachObject(F f) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const Object& object : objects)
+            f(object);
+    }
+
+    // a copy, largest first
+    std::vector<Object> snapshot() const {
+        std::vector<Object> copy;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            copy = objects;
+        }
+        std::sort(copy.begin(), copy.end(), [](const Object& a, const Object& b) { return a.bytes > b.bytes; });
+        return copy;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::vector<Object> objects;
+    size_t total = 0;
+
+    size_t find(GpuObjectKind kind, unsigned int name, std::thread::id thread) const {
+        for (size_t i = 0; i < objects.size(); ++i)
+            if (objects[i].kind == kind && objects[i].name == name && objects[i].thread == thread) return i;
+        return objects.size();
+    }
+};
+
+inline GpuMemoryLedger& gpuMemory()
+{
+    static GpuMemoryLedger ledger;
+    return ledger;
+}
+
+// what a width x height texture of bytesPerTexel takes, with its whole mip chain if it has one; drivers keep RGB8
+// as RGBA8, so pass 4 for it
+inline size_t estimateTextureBytes(int width, int height, int bytesPerTexel, bool mipmapped)
+{
+    size_t bytes = 0;
+    while (true) {
+        bytes += (size_t)width * height * bytesPerTexel;
+        if (!mipmapped || (width == 1 && height == 1)) return bytes;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+}
+
+inline const char* gpuObjectKindName(GpuObjectKind kind)
+{
+    return kind == GPU_BUFFER ? "buffer" : kind == GPU_TEXTURE ? "texture" : "renderbuffer";
+}
+
+// heap by tag and the GPU ledger, object by object, as one JSON object
+inline void writeMemoryReport(std::ostream& out, double seconds)
+{
+    out << "{\n  \"seconds\": " << seconds << ",\n  \"heap\": {\"tracked\": " << (heapTrackingEnabled() ? "true" : "false") << ", \"tags\": {";
+    for (int t = 0; t < MEMORY_TAG_COUNT; ++t) {
+        const HeapTagUsage& usage = heapTagUsage()[t];
+        out << (t ? ", " : "") << "\"" << memoryTagName((MemoryTag)t) << "\": {\"bytes\": " << usage.bytes.load() << ", \"peak_bytes\": " << usage.peakBytes.load()
+            << ", \"allocations\": " << usage.allocations.load() << "}";
+    }
+    out << "}, \"total_bytes\": " << heapBytes() << "},\n";
+
+    GpuMemoryLedger& ledger = gpuMemory();
+    std::vector<GpuMemoryLedger::Object> objects = ledger.snapshot();
+    size_t tagBytes[MEMORY_TAG_COUNT] = {};
+    for (const GpuMemoryLedger::Object& object : objects)
+        tagBytes[object.tag] += object.bytes;
+    out << "  \"gpu\": {\"total_bytes\": " << ledger.totalBytes() << ", \"peak_bytes\": " << ledger.PeakBytes << ", \"tags\": {";
+    for (int t = 0; t < MEMORY_TAG_COUNT; ++t)
+        out << (t ? ", " : "") << "\"" << memoryTagName((MemoryTag)t) << "\": " << tagBytes[t];
+    out << "},\n    \"objects\": [";
+    for (size_t i = 0; i < objects.size(); ++i)
+        out << (i ? ",\n      " : "\n      ") << "{\"kind\": \"" << gpuObjectKindName(objects[i].kind) << "\", \"name\": " << objects[i].name << ", \"tag\": \""
+            << memoryTagName(objects[i].tag) << "\", \"label\": \"" << objects[i].label << "\", \"bytes\": " << objects[i].bytes << "}";
+    out << "\n    ]}\n}\n";
+}
+
+// one line for the end of a run
+inline void writeMemorySummary(std::ostream& out)
+{
+    GpuMemoryLedger& ledger = gpuMemory();
+    out << "Memory: " << ledger.totalBytes() / (1024.0 * 1024.0) << " MB on the GPU (estimated, peak " << ledger.PeakBytes / (1024.0 * 1024.0)
+        << " MB) in " << ledger.objectCount() << " objects";
+    if (heapTrackingEnabled())
+        out << ", " << heapBytes() / (1024.0 * 1024.0) << " MB on the heap";
+    out << std::endl;
+}
+
+// Writes the memory report to Path every IntervalSeconds, replacing the last one, so a kiosk can be watched from
+// outside. Writing allocates, so call update outside any code that should be allocation-free.
+class MemoryReportWriter {
+
+public:
+    std::string Path; // empty: never writes
+    double IntervalSeconds = 10.0;
+    int ReportsWritten = 0;
+
+    void update(double seconds) {
+        if (Path.empty() || (ReportsWritten > 0 && seconds - lastWrite < IntervalSeconds)) return;
+        write(seconds);
+    }
+
+    bool write(double seconds) {
+        lastWrite = seconds;
+        std::ofstream out(Path);
+        if (!out) {
+            std::cout << "ERROR::MEMORY_LEDGER::CANNOT_WRITE: " << Path << std::endl;
+            return false;
+        }
+        writeMemoryReport(out, seconds);
+        ++ReportsWritten;
+        return true;
+    }
+
+private:
+    double lastWrite = 0.0;
+};
+
+#endif // !MEMORY_LEDGER_H
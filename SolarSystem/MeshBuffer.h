@@ -0,0 +1,50 @@
+#pragma once
+#ifndef MESH_BUFFER_H
+#define MESH_BUFFER_H
+
+#include "RenderBackend.h"
+
+#include <vector>
+
+// where a mesh lives in a MeshBuffer: its indices, and the vertex they count from
+struct MeshRange {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    int baseVertex;
+};
+
+// Every mesh the scene draws, packed one after the other into a single vertex array (position + UV) and a single
+// index array. They all share one pipeline, so any mix of meshes can go out in one multi-draw call, and drawing
+// another kind of mesh costs no extra binds.
+class MeshBuffer {
+
+public:
+    static const int VERTEX_FLOATS = 5;
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+
+    // appends a mesh whose indices count from its own first vertex
+    MeshRange add(const std::vector<float>& meshVertices, const std::vector<unsigned int>& meshIndices) {
+        MeshRange range;
+        range.firstIndex = (unsigned int)indices.size();
+        range.indexCount = (unsigned int)meshIndices.size();
+        range.baseVertex = (int)(vertices.size() / VERTEX_FLOATS);
+        vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+        indices.insert(indices.end(), meshIndices.begin(), meshIndices.end());
+        return range;
+    }
+
+    // uploads the buffers and creates the pipeline drawing from them with program
+    PipelineHandle createPipeline(RenderBackend& backend, ProgramHandle program) const {
+        PipelineDesc desc;
+        desc.program = program;
+        desc.vertexBuffer = backend.createBuffer(VERTEX_BUFFER, vertices.data(), vertices.size() * sizeof(float));
+        desc.indexBuffer = backend.createBuffer(INDEX_BUFFER, indices.data(), indices.size() * sizeof(unsigned int));
+        desc.attributes = { { 0, 3, 0 }, { 1, 2, 3 * sizeof(float) } }; // position, UV
+        desc.stride = VERTEX_FLOATS * sizeof(float);
+        return backend.createPipeline(desc);
+    }
+};
+
+#endif // !MESH_BUFFER_H
@@ -0,0 +1,146 @@
+#pragma once
+#ifndef MODEL_MATRIX_BATCH_H
+#define MODEL_MATRIX_BATCH_H
+
+#include "Simd.h"
+#include "SinCos.h"
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Translation, spin and scale of many bodies, one array per component, so a kernel can load the same component
+// of eight bodies at once.
+struct TrsBatch {
+    std::vector<float> x, y, z;             // translation
+    std::vector<float> axisX, axisY, axisZ; // spin axis, unit length
+    std::vector<float> angle;               // radians around the axis
+    std::vector<float> scale;               // uniform
+
+    size_t size() const {
+        return x.size();
+    }
+
+    void resize(size_t count) {
+        for (std::vector<float>* component : { &x, &y, &z, &axisX, &axisY, &axisZ, &angle, &scale })
+            component->resize(count);
+    }
+
+    void reserve(size_t count) {
+        for (std::vector<float>* component : { &x, &y, &z, &axisX, &axisY, &axisZ, &angle, &scale })
+            component->reserve(count);
+    }
+};
+
+// What glm::scale(glm::rotate(glm::translate(glm::mat4(1), position), angle, axis), glm::vec3(scale)) builds in
+// three 4x4 multiplies, written out: the rotation is Rodrigues' formula, scaled column by column, with the
+// translation as the last column. Bodies [first, first + count) of batch go to out, column-major, each stride
+// floats after the one before, so they can land straight in a larger per-draw struct.
+inline void buildModelMatricesScalar(const TrsBatch& batch, size_t first, size_t count, float* out, size_t stride = 16, SinCosPrecision precision = SinCosPrecision::Full)
+{
+    for (size_t i = first; i < first + count; ++i, out += stride) {
+        float ax = batch.axisX[i], ay = batch.axisY[i], az = batch.axisZ[i];
+        float s, c;
+        sinCos(batch.angle[i], s, c, precision);
+        float t = 1.0f - c, k = batch.scale[i];
+        out[0] = (t * ax * ax + c) * k;
+        out[1] = (t * ax * ay + s * az) * k;
+        out[2] = (t * ax * az - s * ay) * k;
+        out[3] = 0.0f;
+        out[4] = (t * ax * ay - s * az) * k;
+        out[5] = (t * ay * ay + c) * k;
+        out[6] = (t * ay * az + s * ax) * k;
+        out[7] = 0.0f;
+        out[8] = (t * ax * az + s * ay) * k;
+        out[9] = (t * ay * az - s * ax) * k;
+        out[10] = (t * az * az + c) * k;
+        out[11] = 0.0f;
+        out[12] = batch.x[i];
+        out[13] = batch.y[i];
+        out[14] = batch.z[i];
+        out[15] = 1.0f;
+    }
+}
+
+#ifdef SOLAR_HAS_AVX2_KERNELS
+// rows[r] holds element r of eight matrices; afterwards rows[m] holds eight consecutive elements of matrix m
+SOLAR_TARGET_AVX2 inline void transpose8x8(__m256 rows[8])
+{
+    __m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]), t1 = _mm256_unpackhi_ps(rows[0], rows[1]);
+    __m256 t2 = _mm256_unpacklo_ps(rows[2], rows[3]), t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+    __m256 t4 = _mm256_unpacklo_ps(rows[4], rows[5]), t5 = _mm256_unpackhi_ps(rows[4], rows[5]);
+    __m256 t6 = _mm256_unpacklo_ps(rows[6], rows[7]), t7 = _mm256_unpackhi_ps(rows[6], rows[7]);
+    __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)), u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)), u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0)), u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0)), u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+    rows[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+    rows[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+    rows[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+    rows[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+    rows[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+    rows[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+    rows[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+    rows[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+}
+
+// buildModelMatricesScalar eight bodies at a time: the sixteen elements are computed for eight bodies side by
+// side, then turned around with two 8x8 transposes into eight whole matrices. The tail goes through the scalar
+// version. Only call when cpuHasAvx2().
+template <SinCosPrecision P>
+SOLAR_TARGET_AVX2 inline void buildModelMatricesAvx2(const TrsBatch& batch, size_t first, size_t count, float* out, size_t stride)
+{
+    size_t end = first + count, i = first;
+    const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+    for (; i + 8 <= end; i += 8, out += 8 * stride) {
+        __m256 s, c;
+        sinCosAvx2<P>(_mm256_loadu_ps(&batch.angle[i]), s, c);
+        __m256 t = _mm256_sub_ps(one, c);
+        __m256 ax = _mm256_loadu_ps(&batch.axisX[i]), ay = _mm256_loadu_ps(&batch.axisY[i]), az = _mm256_loadu_ps(&batch.axisZ[i]);
+        __m256 k = _mm256_loadu_ps(&batch.scale[i]);
+        __m256 tx = _mm256_mul_ps(t, ax), ty = _mm256_mul_ps(t, ay), tz = _mm256_mul_ps(t, az);
+        __m256 sx = _mm256_mul_ps(s, ax), sy = _mm256_mul_ps(s, ay), sz = _mm256_mul_ps(s, az);
+        __m256 txy = _mm256_mul_ps(tx, ay), txz = _mm256_mul_ps(tx, az), tyz = _mm256_mul_ps(ty, az);
+
+        __m256 low[8] = { // columns 0 and 1
+            _mm256_mul_ps(_mm256_fmadd_ps(tx, ax, c), k), _mm256_mul_ps(_mm256_add_ps(txy, sz), k), _mm256_mul_ps(_mm256_sub_ps(txz, sy), k), zero,
+            _mm256_mul_ps(_mm256_sub_ps(txy, sz), k), _mm256_mul_ps(_mm256_fmadd_ps(ty, ay, c), k), _mm256_mul_ps(_mm256_add_ps(tyz, sx), k), zero
+        };
+        __m256 high[8] = { // columns 2 and 3
+            _mm256_mul_ps(_mm256_add_ps(txz, sy), k), _mm256_mul_ps(_mm256_sub_ps(tyz, sx), k), _mm256_mul_ps(_mm256_fmadd_ps(tz, az, c), k), zero,
+            _mm256_loadu_ps(&batch.x[i]), _mm256_loadu_ps(&batch.y[i]), _mm256_loadu_ps(&batch.z[i]), one
+        };
+        transpose8x8(low);
+        transpose8x8(high);
+        for (int m = 0; m < 8; ++m) {
+            _mm256_storeu_ps(out + m * stride, low[m]);
+            _mm256_storeu_ps(out + m * stride + 8, high[m]);
+        }
+    }
+    buildModelMatricesScalar(batch, i, end - i, out, stride, P);
+}
+
+inline void buildModelMatricesAvx2(const TrsBatch& batch, size_t first, size_t count, float* out, size_t stride = 16, SinCosPrecision precision = SinCosPrecision::Full)
+{
+    switch (precision) {
+    case SinCosPrecision::Fast: buildModelMatricesAvx2<SinCosPrecision::Fast>(batch, first, count, out, stride); break;
+    case SinCosPrecision::Medium: buildModelMatricesAvx2<SinCosPrecision::Medium>(batch, first, count, out, stride); break;
+    default: buildModelMatricesAvx2<SinCosPrecision::Full>(batch, first, count, out, stride); break;
+    }
+}
+#endif
+
+// every body of batch into out, with the widest kernel the CPU runs
+inline void buildModelMatrices(const TrsBatch& batch, float* out, size_t stride = 16, SinCosPrecision precision = SinCosPrecision::Full)
+{
+#ifdef SOLAR_HAS_AVX2_KERNELS
+    static const bool avx2 = cpuHasAvx2();
+    if (avx2) {
+        buildModelMatricesAvx2(batch, 0, batch.size(), out, stride, precision);
+        return;
+    }
+#endif
+    buildModelMatricesScalar(batch, 0, batch.size(), out, stride, precision);
+}
+
+#endif // !MODEL_MATRIX_BATCH_H
@@ -0,0 +1,124 @@
+#pragma once
+#ifndef MOONS_H
+#define MOONS_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Planet.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+struct Moon {
+    const char* name;    // nullptr for the generated small ones
+    int planet;          // index into SOLAR_SYSTEM_PLANETS
+    float orbitRadius;   // semi-major axis, in radii of the planet
+    float period;        // earth days; negative for retrograde orbits
+    float radius;        // in radii of the planet
+    float inclination;   // degrees to the planet's orbit
+    float node;          // radians, where the orbit crosses the planet's orbital plane
+    float phase;         // radians along the orbit at day 0
+};
+
+// mean radius of each of SOLAR_SYSTEM_PLANETS, for turning moon sizes in km into planet radii
+const float PLANET_RADIUS_KM[] = { 6371.0f, 6052.0f, 3390.0f, 69911.0f, 58232.0f, 25362.0f, 24622.0f, 2440.0f };
+// moons known for each of SOLAR_SYSTEM_PLANETS
+const int KNOWN_MOON_COUNTS[] = { 1, 0, 2, 95, 146, 28, 16, 0 };
+
+// the large and the well-known moons; the rest of the known ones are small irregulars, generated
+const Moon MAJOR_MOONS[] = {
+    { "Moon",      0, 60.3f,   27.32f, 0.2727f,  5.1f, 0.0f, 0.0f },
+    { "Phobos",    2, 2.76f,   0.319f, 0.0033f,  1.1f, 0.3f, 1.0f },
+    { "Deimos",    2, 6.92f,   1.263f, 0.0018f,  1.8f, 2.1f, 4.0f },
+    { "Amalthea",  3, 2.54f,   0.498f, 0.0012f,  0.4f, 1.0f, 2.5f },
+    { "Io",        3, 5.90f,   1.769f, 0.0260f,  0.05f, 0.0f, 0.0f },
+    { "Europa",    3, 9.40f,   3.551f, 0.0223f,  0.47f, 0.5f, 1.6f },
+    { "Ganymede",  3, 15.0f,   7.155f, 0.0377f,  0.2f, 1.2f, 3.3f },
+    { "Callisto",  3, 26.3f,   16.69f, 0.0345f,  0.19f, 2.3f, 5.0f },
+    { "Himalia",   3, 163.0f,  250.6f, 0.0012f,  27.5f, 4.0f, 0.7f },
+    { "Mimas",     4, 3.10f,   0.942f, 0.0034f,  1.6f, 0.0f, 0.4f },
+    { "Enceladus", 4, 4.10f,   1.370f, 0.0043f,  0.02f, 0.6f, 2.2f },
+    { "Tethys",    4, 5.00f,   1.888f, 0.0091f,  1.1f, 1.1f, 3.9f },
+    { "Dione",     4, 6.50f,   2.737f, 0.0096f,  0.02f, 1.9f, 5.5f },
+    { "Rhea",      4, 9.10f,   4.518f, 0.0131f,  0.35f, 2.6f, 1.2f },
+    { "Titan",     4, 21.0f,   15.95f, 0.0442f,  0.35f, 3.0f, 0.0f },
+    { "Hyperion",  4, 25.4f,   21.28f, 0.0023f,  0.43f, 3.7f, 2.8f },
+    { "Iapetus",   4, 61.0f,   79.32f, 0.0126f,  15.5f, 4.4f, 4.6f },
+    { "Phoebe",    4, 222.0f, -550.6f, 0.0018f,  5.1f, 5.2f, 0.9f },
+    { "Miranda",   5, 5.10f,   1.413f, 0.0093f,  97.8f, 2.9f, 0.2f },
+    { "Ariel",     5, 7.50f,   2.520f, 0.0228f,  97.8f, 2.9f, 1.9f },
+    { "Umbriel",   5, 10.4f,   4.144f, 0.0231f,  97.8f, 2.9f, 3.1f },
+    { "Titania",   5, 17.1f,   8.706f, 0.0311f,  97.8f, 2.9f, 4.4f },
+    { "Oberon",    5, 22.8f,   13.46f, 0.0300f,  97.8f, 2.9f, 5.8f },
+    { "Proteus",   6, 4.75f,   1.122f, 0.0085f,  0.5f, 0.8f, 3.0f },
+    { "Triton",    6, 14.3f,  -5.877f, 0.0550f,  23.0f, 1.5f, 0.0f },
+    { "Nereid",    6, 224.0f,  360.1f, 0.0069f,  7.2f, 3.3f, 2.0f },
+};
+const int MAJOR_MOON_COUNT = sizeof(MAJOR_MOONS) / sizeof(MAJOR_MOONS[0]);
+
+// The major moons, and with allKnown as many generated irregulars again as it takes to reach every planet's
+// known count: a few km across, far out, on tilted and mostly retrograde orbits, the periods following Kepler
+// from the planet's first major moon. Generated from a seed, so every run has the same moons.
+inline std::vector<Moon> moonCatalogue(bool allKnown, unsigned int seed = 3)
+{
+    std::vector<Moon> moons(MAJOR_MOONS, MAJOR_MOONS + MAJOR_MOON_COUNT);
+    if (!allKnown) return moons;
+    std::mt19937 random(seed);
+    for (int p = 0; p < PLANET_COUNT; ++p) {
+        const Moon* reference = nullptr;
+        int count = 0;
+        for (const Moon& moon : MAJOR_MOONS) {
+            if (moon.planet != p) continue;
+            if (!reference) reference = &moon;
+            ++count;
+        }
+        for (; reference && count < KNOWN_MOON_COUNTS[p]; ++count) {
+            Moon moon;
+            moon.name = nullptr;
+            moon.planet = p;
+            moon.orbitRadius = 100.0f * std::pow(8.0f, uniform(random));
+            moon.period = std::abs(reference->period) * std::pow(moon.orbitRadius / reference->orbitRadius, 1.5f);
+            if (uniform(random) < 0.7f) moon.period = -moon.period;
+            moon.radius = (1.0f + 20.0f * uniform(random) * uniform(random) * uniform(random)) / PLANET_RADIUS_KM[p];
+            moon.inclination = 60.0f * uniform(random);
+            moon.node = uniform(random) * glm::two_pi<float>();
+            moon.phase = uniform(random) * glm::two_pi<float>();
+            moons.push_back(moon);
+        }
+    }
+    return moons;
+}
+
+// Distances squeezed so that every moon system fits between the planets at any planet scale: the orbit starts at
+// the scaled planet's surface, and the height above it grows with the square root of the real one.
+inline float moonOrbitRadius(const Moon& moon, float planetScale)
+{
+    float planetRadius = SOLAR_SYSTEM_PLANETS[moon.planet].scale;
+    return planetRadius * planetScale + 2.0f * planetRadius * std::sqrt(std::max(0.0f, moon.orbitRadius - 1.0f));
+}
+
+// the moon's local transform relative to its planet's orbit position after simTimeInDays: on its tilted circle,
+// turning to keep one face to the planet, at its size next to the scaled planet
+inline void moonLocalTransform(const Moon& moon, double simTimeInDays, float planetScale, glm::vec3& position, glm::quat& rotation, float& scale)
+{
+    // the planets' orbit speeds have the earth going round once per sim day, so the moons' periods keep pace
+    // relative to a 365.25 day year. Phobos goes round a thousand times a sim day; counting its orbits in double
+    // and keeping only the fraction (turnsToRadians) stops it from stuttering a few minutes in.
+    float angle = moon.phase + turnsToRadians(simTimeInDays * (365.25 / moon.period));
+    float nodeSin, nodeCos, orbitSin, orbitCos, halfSin, halfCos;
+    sinCos(moon.node, nodeSin, nodeCos);
+    sinCos(angle, orbitSin, orbitCos);
+    sinCos(0.5f * angle, halfSin, halfCos);
+    glm::quat tilt = glm::angleAxis(glm::radians(moon.inclination), glm::vec3(nodeCos, 0.0f, nodeSin));
+    glm::vec3 planar(orbitSin, 0.0f, orbitCos);
+    position = tilt * (planar * moonOrbitRadius(moon, planetScale));
+    rotation = tilt * glm::quat(halfCos, 0.0f, halfSin, 0.0f);
+    scale = SOLAR_SYSTEM_PLANETS[moon.planet].scale * moon.radius * planetScale;
+}
+
+#endif // !MOONS_H
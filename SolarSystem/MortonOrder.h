@@ -0,0 +1,136 @@
+#pragma once
+#ifndef MORTON_ORDER_H
+#define MORTON_ORDER_H
+
+#include <glm/glm.hpp>
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Keeping bodies that are near each other in space near each other in memory. A body's Morton (Z-order) code
+// interleaves the bits of its quantized x, y and z, so sorting by it lays the bodies out along a curve that stays
+// within one octant of space before moving on to the next, at every scale. A neighbour search, a tree build or a
+// cull over blocks of consecutive bodies then reads memory that's mostly in the cache already. Bodies that move
+// drift out of that order again, so it has to be redone now and then; meanNeighbourSpacing measures how far it
+// has gone.
+
+const int MORTON_BITS_PER_AXIS = 21;
+const int MORTON_BITS = 3 * MORTON_BITS_PER_AXIS; // 63
+
+// the low 21 bits of v, moved to every third bit
+inline uint64_t mortonSpread(uint64_t v)
+{
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8) & 0x100f00f00f00f00full;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+}
+
+// Quantizes points in the box from boxMin to boxMax to 21 bits per axis. Each axis is stretched over the whole
+// range on its own, so a flat belt still gets all 21 bits in y.
+struct MortonGrid {
+    glm::vec3 origin;
+    glm::vec3 cellsPerUnit;
+
+    MortonGrid(const glm::vec3& boxMin, const glm::vec3& boxMax) : origin(boxMin) {
+        const float cells = (float)((1 << MORTON_BITS_PER_AXIS) - 1);
+        glm::vec3 extent = glm::max(boxMax - boxMin, glm::vec3(1e-20f));
+        cellsPerUnit = cells / extent;
+    }
+
+    // 63-bit code; points outside the box are clamped to it
+    uint64_t code(float x, float y, float z) const {
+        const float cells = (float)((1 << MORTON_BITS_PER_AXIS) - 1);
+        uint64_t ix = (uint64_t)std::min(std::max((x - origin.x) * cellsPerUnit.x, 0.0f), cells);
+        uint64_t iy = (uint64_t)std::min(std::max((y - origin.y) * cellsPerUnit.y, 0.0f), cells);
+        uint64_t iz = (uint64_t)std::min(std::max((z - origin.z) * cellsPerUnit.z, 0.0f), cells);
+        return mortonSpread(ix) | mortonSpread(iy) << 1 | mortonSpread(iz) << 2;
+    }
+};
+
+// Sorts count keys ascending, moving values along with them; stable. Least significant digit first, 8 bits a pass
+// up to keyBits; a pass where every key has the same digit is skipped. keyScratch and valueScratch hold count
+// each, and the result ends up in keys and values. With a pool, each pass counts and scatters a chunk of the keys
+// per thread: every chunk's digits get their own slots, laid out chunk after chunk within a digit, so the threads
+// never write to the same place and the order stays stable. Allocates nothing.
+inline void radixSortByKey(uint64_t* keys, uint32_t* values, uint64_t* keyScratch, uint32_t* valueScratch, size_t count, int keyBits = 64, ThreadPool* pool = nullptr)
+{
+    const int MAX_CHUNKS = 16;
+    const size_t MIN_CHUNK = 16384; // smaller chunks cost more in counts than they save
+    size_t offsets[MAX_CHUNKS][256];
+    int chunks = pool ? std::min(MAX_CHUNKS, pool->threadCount() + 1) : 1;
+    chunks = (int)std::max<size_t>(1, std::min<size_t>(chunks, count / MIN_CHUNK));
+    size_t chunkSize = (count + chunks - 1) / std::max(chunks, 1);
+    uint64_t* const keysOut = keys;
+    uint32_t* const valuesOut = values;
+
+    for (int shift = 0; shift < keyBits; shift += 8) {
+        auto countChunks = [&](int begin, int end) {
+            for (int c = begin; c < end; ++c) {
+                size_t* histogram = offsets[c];
+                std::fill(histogram, histogram + 256, (size_t)0);
+                size_t last = std::min(count, (c + 1) * chunkSize);
+                for (size_t i = c * chunkSize; i < last; ++i)
+                    ++histogram[(keys[i] >> shift) & 0xff];
+            }
+        };
+        if (pool) pool->parallelFor(chunks, countChunks);
+        else countChunks(0, chunks);
+
+        size_t offset = 0;
+        bool oneDigit = false;
+        for (int digit = 0; digit < 256; ++digit) {
+            size_t digitCount = 0;
+            for (int c = 0; c < chunks; ++c) {
+                size_t n = offsets[c][digit];
+                offsets[c][digit] = offset;
+                offset += n;
+                digitCount += n;
+            }
+            oneDigit |= digitCount == count;
+        }
+        if (oneDigit) continue;
+
+        auto scatterChunks = [&](int begin, int end) {
+            for (int c = begin; c < end; ++c) {
+                size_t* next = offsets[c];
+                size_t last = std::min(count, (c + 1) * chunkSize);
+                for (size_t i = c * chunkSize; i < last; ++i) {
+                    size_t to = next[(keys[i] >> shift) & 0xff]++;
+                    keyScratch[to] = keys[i];
+                    valueScratch[to] = values[i];
+                }
+            }
+        };
+        if (pool) pool->parallelFor(chunks, scatterChunks);
+        else scatterChunks(0, chunks);
+        std::swap(keys, keyScratch);
+        std::swap(values, valueScratch);
+    }
+    if (keys != keysOut) {
+        std::copy(keys, keys + count, keysOut);
+        std::copy(values, values + count, valuesOut);
+    }
+}
+
+// Mean distance between bodies [first, last) and the next one in memory, which a sort by Morton code brings
+// down to about the spacing of the bodies in space. Grows as they drift out of that order.
+inline float meanNeighbourSpacing(const float* x, const float* y, const float* z, size_t first, size_t last)
+{
+    if (last - first < 2) return 0.0f;
+    double sum = 0.0;
+    for (size_t i = first + 1; i < last; ++i) {
+        float dx = x[i] - x[i - 1], dy = y[i] - y[i - 1], dz = z[i] - z[i - 1];
+        sum += std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+    return (float)(sum / (last - first - 1));
+}
+
+#endif // !MORTON_ORDER_H
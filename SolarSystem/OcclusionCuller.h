@@ -0,0 +1,176 @@
+#pragma once
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "MemoryLedger.h"
+#include "Shader.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// Skips the bodies hidden behind the sun or a big planet. The sun and every body large on screen are drawn
+// first as occluders. The bounding box of each other body is then drawn, with color and depth writes off, inside
+// a GL_ANY_SAMPLES_PASSED query. The body's draw in the next frame is conditional on that query, without waiting
+// for it: the GPU drops the draw when no sample of the box passed the depth test, and draws it anyway if the
+// result isn't in yet. Neither the CPU nor the GPU ever waits on a query. A body that wasn't tested last frame is
+// drawn unconditionally. The stats read a frame's results during the next frame, once they're in.
+class OcclusionCuller {
+
+public:
+    // projected radius in pixels from which a body is drawn up front as an occluder instead of being tested
+    float OccluderPixels = 64.0f;
+
+    // bodies tested and hidden in the last frame whose results came in
+    int Tested = 0;
+    int Hidden = 0;
+    // summed over every frame whose results came in
+    long long TotalTested = 0;
+    long long TotalHidden = 0;
+    int FramesCounted = 0;
+
+    bool create() {
+        // a unit cube around the unit sphere mesh; the body's model matrix sizes and turns it
+        const float corners[] = { -1, -1, -1,  1, -1, -1,  1, 1, -1,  -1, 1, -1,
+                                  -1, -1,  1,  1, -1,  1,  1, 1,  1,  -1, 1,  1 };
+        const unsigned int faces[] = { 0, 2, 1, 0, 3, 2,  4, 5, 6, 4, 6, 7,  0, 1, 5, 0, 5, 4,
+                                       3, 6, 2, 3, 7, 6,  0, 4, 7, 0, 7, 3,  1, 2, 6, 1, 6, 5 };
+        glGenVertexArrays(1, &proxyVertexArray);
+        glGenBuffers(1, &proxyVertexBuffer);
+        glGenBuffers(1, &proxyIndexBuffer);
+        glBindVertexArray(proxyVertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, proxyVertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        gpuMemory().record(GPU_BUFFER, proxyVertexBuffer, MEMORY_RENDERER, "occlusion proxy vertices", sizeof(corners));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, proxyIndexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(faces), faces, GL_STATIC_DRAW);
+        gpuMemory().record(GPU_BUFFER, proxyIndexBuffer, MEMORY_RENDERER, "occlusion proxy indices", sizeof(faces));
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        proxyShader.reset(new Shader("occlusion_proxy.vs", "occlusion_proxy.fs"));
+        return true;
+    }
+
+    // picks this frame's occluders among the bodies (models[0] is the sun) and counts the previous frame's results
+    void beginFrame(const glm::mat4& view, const glm::mat4& projection, const std::vector<glm::mat4>& models) {
+        collectStats(false);
+        current = 1 - current;
+        std::vector<GLuint>& queries = querySets[current];
+        if (queries.size() < models.size()) {
+            size_t had = queries.size();
+            queries.resize(models.size());
+            glGenQueries((GLsizei)(models.size() - had), queries.data() + had);
+        }
+        tested[current].assign(models.size(), 0);
+        pending[current] = false;
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        float pixelsPerUnit = projection[1][1] * viewport[3] * 0.5f;
+        float zNear = projection[3][2] / (projection[2][2] - 1.0f);
+        glm::vec3 cameraPosition = glm::vec3(glm::inverse(view)[3]);
+        for (size_t i = 1; i < models.size(); ++i) {
+            float radius = glm::length(glm::vec3(models[i][0]));
+            float distance = glm::length(glm::vec3(models[i][3]) - cameraPosition);
+            // a box the near plane cuts into may show no samples while the body is right in front of the camera
+            if (distance < radius * 1.7321f + zNear) continue;
+            if (radius * pixelsPerUnit / distance >= OccluderPixels) continue;
+            tested[current][i] = 1;
+            pending[current] = true;
+        }
+    }
+
+    // body i's box is queried this frame, so its draw goes after drawProxies(); otherwise it's an occluder
+    bool isTested(size_t body) const {
+        return tested[current][body] != 0;
+    }
+
+    // the query body i's draw is conditional on this frame: the last frame's, if it was tested then too; 0 draws
+    // it unconditionally
+    GLuint query(size_t body) const {
+        int previous = 1 - current;
+        if (!tested[current][body] || body >= tested[previous].size() || !tested[previous][body])
+            return 0;
+        return querySets[previous][body];
+    }
+
+    // call after drawing the occluders: queries the tested bodies' boxes against their depth
+    void drawProxies(const glm::mat4& view, const glm::mat4& projection, const std::vector<glm::mat4>& models) {
+        if (!pending[current]) return;
+        proxyShader->use();
+        proxyShader->setMat4("viewProjection", projection * view);
+        glEnable(GL_DEPTH_TEST);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        glBindVertexArray(proxyVertexArray);
+        for (size_t i = 0; i < models.size(); ++i) {
+            if (!tested[current][i]) continue;
+            proxyShader->setMat4("model", models[i]);
+            glBeginQuery(GL_ANY_SAMPLES_PASSED, querySets[current][i]);
+            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, (void*)0);
+            glEndQuery(GL_ANY_SAMPLES_PASSED);
+        }
+        glBindVertexArray(0);
+        glDepthMask(GL_TRUE);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+
+    // counts the last frame's results into the stats; without wait, only if they're already in
+    void collectStats(bool wait) {
+        int set = current;
+        if (!pending[set]) return;
+        // results come in in order, so the last query issued stands for all of them
+        size_t last = tested[set].size();
+        while (last > 0 && !tested[set][last - 1])
+            --last;
+        GLuint available = GL_TRUE;
+        if (!wait)
+            glGetQueryObjectuiv(querySets[set][last - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) return;
+        Tested = 0;
+        Hidden = 0;
+        for (size_t i = 0; i < last; ++i) {
+            if (!tested[set][i]) continue;
+            GLuint anySamples = 0;
+            glGetQueryObjectuiv(querySets[set][i], GL_QUERY_RESULT, &anySamples);
+            ++Tested;
+            if (!anySamples) ++Hidden;
+        }
+        TotalTested += Tested;
+        TotalHidden += Hidden;
+        ++FramesCounted;
+        pending[set] = false;
+    }
+
+    void DeleteBuffers() {
+        for (std::vector<GLuint>& queries : querySets) {
+            if (!queries.empty()) glDeleteQueries((GLsizei)queries.size(), queries.data());
+            queries.clear();
+        }
+        if (proxyShader) glDeleteProgram(proxyShader->ID);
+        proxyShader.reset();
+        glDeleteVertexArrays(1, &proxyVertexArray);
+        glDeleteBuffers(1, &proxyVertexBuffer);
+        glDeleteBuffers(1, &proxyIndexBuffer);
+        gpuMemory().release(GPU_BUFFER, proxyVertexBuffer);
+        gpuMemory().release(GPU_BUFFER, proxyIndexBuffer);
+    }
+
+private:
+    // this frame's queries and the previous frame's, which this frame's draws are conditional on and whose results
+    // are still being counted; by body
+    std::vector<GLuint> querySets[2];
+    std::vector<unsigned char> tested[2];
+    bool pending[2] = { false, false }; // has queries whose results aren't counted yet
+    int current = 0;
+
+    std::unique_ptr<Shader> proxyShader;
+    GLuint proxyVertexArray = 0, proxyVertexBuffer = 0, proxyIndexBuffer = 0;
+};
+
+#endif // !OCCLUSION_CULLER_H
@@ -0,0 +1,359 @@
+#pragma once
+#ifndef PARTICLE_COLLISIONS_H
+#define PARTICLE_COLLISIONS_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "Random.h"
+#include "SpatialHash.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Small spheres moving in straight lines over a step, one component per array.
+struct CollisionParticles {
+    std::vector<float> x, y, z;    // position
+    std::vector<float> vx, vy, vz; // velocity, per sim second
+    std::vector<float> radius;
+    std::vector<float> mass;
+
+    size_t size() const {
+        return x.size();
+    }
+
+    void resize(size_t count) {
+        for (std::vector<float>* component : { &x, &y, &z, &vx, &vy, &vz, &radius, &mass })
+            component->resize(count);
+    }
+
+    void reserve(size_t count) {
+        for (std::vector<float>* component : { &x, &y, &z, &vx, &vy, &vz, &radius, &mass })
+            component->reserve(count);
+    }
+
+    void push_back(const glm::vec3& position, const glm::vec3& velocity, float r, float m) {
+        x.push_back(position.x);
+        y.push_back(position.y);
+        z.push_back(position.z);
+        vx.push_back(velocity.x);
+        vy.push_back(velocity.y);
+        vz.push_back(velocity.z);
+        radius.push_back(r);
+        mass.push_back(m);
+    }
+
+    glm::vec3 position(size_t i) const {
+        return glm::vec3(x[i], y[i], z[i]);
+    }
+
+    glm::vec3 velocity(size_t i) const {
+        return glm::vec3(vx[i], vy[i], vz[i]);
+    }
+
+    void set(size_t i, const glm::vec3& position, const glm::vec3& velocity) {
+        x[i] = position.x;
+        y[i] = position.y;
+        z[i] = position.z;
+        vx[i] = velocity.x;
+        vy[i] = velocity.y;
+        vz[i] = velocity.z;
+    }
+};
+
+// When two spheres a distance p apart, closing at relative velocity v, first touch within [0, dt]: t is when.
+// Spheres that already overlap count as touching at 0 while they still close in; ones moving apart never touch.
+inline bool sweptSphereContact(const glm::vec3& p, const glm::vec3& v, float touchingDistance, float dt, float& t)
+{
+    float b = glm::dot(p, v);
+    if (b >= 0.0f) return false;
+    float c = glm::dot(p, p) - touchingDistance * touchingDistance;
+    if (c <= 0.0f) {
+        t = 0.0f;
+        return true;
+    }
+    float a = glm::dot(v, v);
+    float discriminant = b * b - a * c;
+    if (discriminant < 0.0f) return false;
+    t = (-b - std::sqrt(discriminant)) / a;
+    return t <= dt;
+}
+
+enum CollisionResponse {
+    COLLISION_MERGE,    // the two become one sphere of their combined mass and volume
+    COLLISION_BOUNCE,   // they push each other apart, losing some of the closing speed
+    COLLISION_FRAGMENT  // each breaks into FragmentPieces smaller ones; too small to break, they bounce
+};
+
+inline const char* collisionResponseName(CollisionResponse response)
+{
+    return response == COLLISION_MERGE ? "merge" : response == COLLISION_BOUNCE ? "bounce" : "fragment";
+}
+
+// false for a name that's none of merge, bounce and fragment
+inline bool parseCollisionResponse(const std::string& name, CollisionResponse& response)
+{
+    for (CollisionResponse r : { COLLISION_MERGE, COLLISION_BOUNCE, COLLISION_FRAGMENT })
+        if (name == collisionResponseName(r)) {
+            response = r;
+            return true;
+        }
+    return false;
+}
+
+// Collisions among CollisionParticles over a step. The broad phase is a SpatialHashGrid with cells wide enough
+// that any two spheres that can touch within the step are in neighbouring cells, rebuilt each step; the narrow
+// phase sweeps each candidate pair over the step's motion. Both run on the pool. The contacts are then resolved
+// on the calling thread in order of time, each sphere in at most one per step, and everything moves on to the end
+// of the step. The results don't depend on the number of threads.
+class ParticleCollisions {
+
+public:
+    CollisionResponse Response = COLLISION_BOUNCE;
+    float Restitution = 0.5f;        // of the closing speed along the contact normal, for bounces
+    int FragmentPieces = 4;
+    float MinFragmentRadius = 0.0f;  // smallest piece a fragmenting sphere may leave
+    float FragmentSpread = 0.3f;     // of the closing speed, given to the pieces outwards
+    // the fastest any two neighbours close in on each other, which sets how far the grid has to look; 0 takes
+    // twice the speed of the fastest particle. Particles that move together, like a ring's, set it far lower,
+    // and pairs closing faster than it may be missed.
+    float RelativeSpeedLimit = 0.0f;
+
+    // of the last step
+    size_t CandidatePairs = 0; // pairs in neighbouring cells, swept against each other
+    size_t Contacts = 0;       // of those, the pairs that touch within the step
+    size_t Collisions = 0;     // contacts resolved; the rest involved a sphere that had already collided
+
+    // finds and resolves the collisions of the step and moves every particle dt on. Merges remove particles and
+    // fragmentation adds them at the end, so reserve room for those to keep the step from allocating.
+    void step(CollisionParticles& particles, float dt, ThreadPool* pool = nullptr) {
+        collide(particles, dt, pool);
+        drift(particles, dt, pool);
+    }
+
+    // step without the drift, for callers that move the particles themselves: every particle that collided is
+    // left where it would have had to start, at its new velocity, to be where the collision left it
+    void collide(CollisionParticles& particles, float dt, ThreadPool* pool = nullptr) {
+        detect(particles, dt, pool);
+        resolve(particles);
+    }
+
+    // room for count contacts in a step, with some to spare for however they fall between the threads, so that
+    // steps with up to about that many don't allocate for them
+    void reserveContacts(size_t count) {
+        contacts.reserve(count);
+        for (std::vector<Contact>& found : chunkContacts)
+            found.reserve(2 * count / CHUNKS + 16);
+    }
+
+private:
+    struct Contact {
+        uint32_t a, b; // a < b
+        float time;
+    };
+
+    // a particle copied to its sorted position, so the particles of a cell are next to each other in memory
+    struct SortedParticle {
+        glm::vec3 position;
+        float radius;
+        glm::vec3 velocity;
+        uint32_t index;
+    };
+
+    // the narrow phase is split into this many chunks of the sorted particles, whatever the thread count, so
+    // the contacts come out the same
+    static const int CHUNKS = 64;
+
+    SpatialHashGrid grid;
+    std::vector<Contact> chunkContacts[CHUNKS];
+    size_t chunkCandidates[CHUNKS];
+    std::vector<Contact> contacts;
+    std::vector<SortedParticle> sortedParticles;
+    std::vector<unsigned char> collided; // by particle, in this step
+    std::mt19937 random{ 5 };
+
+    void detect(const CollisionParticles& particles, float dt, ThreadPool* pool) {
+        size_t count = particles.size();
+        float maxRadius = 0.0f, maxSpeed2 = 0.0f;
+        for (size_t i = 0; i < count; ++i) {
+            maxRadius = std::max(maxRadius, particles.radius[i]);
+            if (RelativeSpeedLimit <= 0.0f)
+                maxSpeed2 = std::max(maxSpeed2, particles.vx[i] * particles.vx[i] + particles.vy[i] * particles.vy[i] + particles.vz[i] * particles.vz[i]);
+        }
+        float closing = RelativeSpeedLimit > 0.0f ? RelativeSpeedLimit : 2.0f * std::sqrt(maxSpeed2);
+        // two spheres that touch within the step start at most this far apart
+        float reach = 2.0f * maxRadius + closing * dt;
+        grid.build(particles.x.data(), particles.y.data(), particles.z.data(), count, std::max(reach, 1e-6f), pool);
+
+        const uint32_t* sorted = grid.sortedPoints();
+        if (sortedParticles.size() < count) sortedParticles.resize(count);
+        auto gather = [&](int begin, int end) {
+            for (size_t s = (size_t)begin; s < (size_t)end; ++s) {
+                uint32_t i = sorted[s];
+                sortedParticles[s] = { particles.position(i), particles.radius[i], particles.velocity(i), i };
+            }
+        };
+        if (pool) pool->parallelFor((int)count, gather, 16384);
+        else gather(0, (int)count);
+
+        auto sweep = [&](int begin, int end) {
+            for (int c = begin; c < end; ++c) {
+                std::vector<Contact>& found = chunkContacts[c];
+                found.clear();
+                size_t candidates = 0;
+                size_t last = count * (c + 1) / CHUNKS;
+                for (size_t s = count * c / CHUNKS; s < last; ++s) {
+                    const SortedParticle& a = sortedParticles[s];
+                    // every pair once: from the one earlier in sorted order
+                    grid.eachNeighbour(a.position.x, a.position.y, a.position.z, [&](size_t t) {
+                        if (t <= s) return;
+                        const SortedParticle& b = sortedParticles[t];
+                        ++candidates;
+                        float time;
+                        if (sweptSphereContact(b.position - a.position, b.velocity - a.velocity, a.radius + b.radius, dt, time))
+                            found.push_back({ std::min(a.index, b.index), std::max(a.index, b.index), time });
+                    });
+                }
+                chunkCandidates[c] = candidates;
+            }
+        };
+        if (pool) pool->parallelFor(CHUNKS, sweep);
+        else sweep(0, CHUNKS);
+
+        contacts.clear();
+        CandidatePairs = 0;
+        for (int c = 0; c < CHUNKS; ++c) {
+            contacts.insert(contacts.end(), chunkContacts[c].begin(), chunkContacts[c].end());
+            CandidatePairs += chunkCandidates[c];
+        }
+        Contacts = contacts.size();
+        std::sort(contacts.begin(), contacts.end(), [](const Contact& l, const Contact& r) {
+            return l.time != r.time ? l.time < r.time : l.a != r.a ? l.a < r.a : l.b < r.b;
+        });
+    }
+
+    void resolve(CollisionParticles& particles) {
+        size_t count = particles.size();
+        collided.assign(count, 0);
+        bool removed = false;
+        Collisions = 0;
+        for (const Contact& contact : contacts) {
+            if (collided[contact.a] || collided[contact.b]) continue;
+            collided[contact.a] = collided[contact.b] = 1;
+            ++Collisions;
+            if (Response == COLLISION_MERGE) {
+                merge(particles, contact);
+                removed = true;
+            }
+            else if (Response == COLLISION_FRAGMENT && fragmentRadius(particles, contact) >= MinFragmentRadius) {
+                fragment(particles, contact);
+            }
+            else {
+                bounce(particles, contact);
+            }
+        }
+        if (removed) compact(particles);
+    }
+
+    // a and b where they touch; everything below moves the spheres as they are at contact.time, and sets the
+    // position each would have had at the start of the step to end up there, so the drift stays the same for all
+    static void touching(const CollisionParticles& particles, const Contact& contact, glm::vec3& a, glm::vec3& b) {
+        a = particles.position(contact.a) + particles.velocity(contact.a) * contact.time;
+        b = particles.position(contact.b) + particles.velocity(contact.b) * contact.time;
+    }
+
+    void merge(CollisionParticles& particles, const Contact& contact) {
+        glm::vec3 a, b;
+        touching(particles, contact, a, b);
+        float ma = particles.mass[contact.a], mb = particles.mass[contact.b], m = ma + mb;
+        glm::vec3 velocity = (ma * particles.velocity(contact.a) + mb * particles.velocity(contact.b)) / m;
+        glm::vec3 position = (ma * a + mb * b) / m;
+        float ra = particles.radius[contact.a], rb = particles.radius[contact.b];
+        particles.set(contact.a, position - velocity * contact.time, velocity);
+        particles.radius[contact.a] = std::cbrt(ra * ra * ra + rb * rb * rb);
+        particles.mass[contact.a] = m;
+        particles.mass[contact.b] = 0.0f; // marks it for compact
+    }
+
+    void bounce(CollisionParticles& particles, const Contact& contact) {
+        glm::vec3 a, b;
+        touching(particles, contact, a, b);
+        glm::vec3 normal = b - a;
+        float length = glm::length(normal);
+        normal = length > 0.0f ? normal / length : glm::vec3(1.0f, 0.0f, 0.0f);
+        glm::vec3 va = particles.velocity(contact.a), vb = particles.velocity(contact.b);
+        float closing = glm::dot(vb - va, normal);
+        if (closing >= 0.0f) return;
+        float inverseA = 1.0f / particles.mass[contact.a], inverseB = 1.0f / particles.mass[contact.b];
+        float impulse = -(1.0f + Restitution) * closing / (inverseA + inverseB);
+        va -= impulse * inverseA * normal;
+        vb += impulse * inverseB * normal;
+        particles.set(contact.a, a - va * contact.time, va);
+        particles.set(contact.b, b - vb * contact.time, vb);
+    }
+
+    float fragmentRadius(const CollisionParticles& particles, const Contact& contact) const {
+        float smaller = std::min(particles.radius[contact.a], particles.radius[contact.b]);
+        return smaller / std::cbrt((float)std::max(FragmentPieces, 1));
+    }
+
+    // each sphere breaks into FragmentPieces of equal mass that share its volume, flying apart from the point
+    // where the two met at their common velocity plus an outward spread; the first piece keeps the sphere's place
+    void fragment(CollisionParticles& particles, const Contact& contact) {
+        glm::vec3 a, b;
+        touching(particles, contact, a, b);
+        glm::vec3 va = particles.velocity(contact.a), vb = particles.velocity(contact.b);
+        float ma = particles.mass[contact.a], mb = particles.mass[contact.b];
+        glm::vec3 common = (ma * va + mb * vb) / (ma + mb);
+        float spread = FragmentSpread * glm::length(vb - va);
+        int pieces = std::max(FragmentPieces, 1);
+        const uint32_t bodies[2] = { contact.a, contact.b };
+        const glm::vec3 centres[2] = { a, b };
+        for (int body = 0; body < 2; ++body) {
+            uint32_t i = bodies[body];
+            float r = particles.radius[i] / std::cbrt((float)pieces), m = particles.mass[i] / pieces;
+            for (int k = 0; k < pieces; ++k) {
+                glm::vec3 direction = randomDirection(random);
+                glm::vec3 position = centres[body] + direction * (particles.radius[i] - r);
+                glm::vec3 velocity = common + direction * spread;
+                if (k == 0) {
+                    particles.set(i, position - velocity * contact.time, velocity);
+                    continue;
+                }
+                particles.push_back(position - velocity * contact.time, velocity, r, m);
+            }
+            particles.radius[i] = r;
+            particles.mass[i] = m;
+        }
+    }
+
+    static void drift(CollisionParticles& particles, float dt, ThreadPool* pool) {
+        auto move = [&](int begin, int end) {
+            for (size_t i = (size_t)begin; i < (size_t)end; ++i) {
+                particles.x[i] += particles.vx[i] * dt;
+                particles.y[i] += particles.vy[i] * dt;
+                particles.z[i] += particles.vz[i] * dt;
+            }
+        };
+        if (pool) pool->parallelFor((int)particles.size(), move, 16384);
+        else move(0, (int)particles.size());
+    }
+
+    // drops the particles merged away, keeping the order of the rest; mass goes last, as it says which those are
+    static void compact(CollisionParticles& particles) {
+        size_t kept = 0;
+        for (std::vector<float>* component : { &particles.x, &particles.y, &particles.z, &particles.vx, &particles.vy, &particles.vz, &particles.radius, &particles.mass }) {
+            kept = 0;
+            for (size_t i = 0; i < particles.size(); ++i)
+                if (particles.mass[i] != 0.0f) (*component)[kept++] = (*component)[i];
+        }
+        particles.resize(kept);
+    }
+};
+
+#endif // !PARTICLE_COLLISIONS_H
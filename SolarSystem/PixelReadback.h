@@ -0,0 +1,112 @@
+#pragma once
+#ifndef PIXEL_READBACK_H
+#define PIXEL_READBACK_H
+
+#include <glad/glad.h>
+
+#include "MemoryLedger.h"
+
+#include <cstring>
+#include <vector>
+
+// Asynchronous framebuffer readback through a ring of pixel buffer objects. start() queues a glReadPixels
+// into the next PBO and a fence; collect() maps the oldest one once its fence has signalled, so the
+// GPU keeps rendering while earlier frames are copied out.
+class PixelReadback {
+
+public:
+    int width = 0;
+    int height = 0;
+
+    // RGBA8, rows bottom-up as glReadPixels returns them; reads of a smaller region are packed to their own width
+    size_t frameBytes() const {
+        return (size_t)width * height * 4;
+    }
+
+    void create(int w, int h, int ringSize = 3) {
+        DeleteBuffers();
+        width = w;
+        height = h;
+        slots.resize(ringSize);
+        for (Slot& slot : slots) {
+            glGenBuffers(1, &slot.PBO);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+            glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes(), NULL, GL_STREAM_READ);
+            gpuMemory().record(GPU_BUFFER, slot.PBO, MEMORY_RENDERER, "readback pixels", frameBytes());
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        head = tail = 0;
+    }
+
+    int pending() const {
+        return (int)(head - tail);
+    }
+    bool full() const {
+        return pending() == (int)slots.size();
+    }
+
+    // queues a read of the region (x, y, w, h) of the given framebuffer, by default width x height; the ring
+    // must not be full
+    void start(unsigned int framebuffer, int x = 0, int y = 0, int w = 0, int h = 0) {
+        Slot& slot = slots[head % slots.size()];
+        slot.bytes = (size_t)(w > 0 ? w : width) * (h > 0 ? h : height) * 4;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(x, y, w > 0 ? w : width, h > 0 ? h : height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        ++head;
+    }
+
+    // the oldest pending read has finished on the GPU, so collect() won't wait for it; never blocks
+    bool ready() const {
+        if (pending() == 0) return false;
+        GLenum status = glClientWaitSync(slots[tail % slots.size()].fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+    }
+
+    // copies the oldest pending read into dst (frameBytes() bytes for a full read). Without wait, returns false if the GPU
+    // hasn't finished it yet.
+    bool collect(unsigned char* dst, bool wait) {
+        if (pending() == 0) return false;
+        Slot& slot = slots[tail % slots.size()];
+        GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 10000000000ull : 0);
+        if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+            return false;
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+        void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.bytes, GL_MAP_READ_BIT);
+        if (mapped) {
+            std::memcpy(dst, mapped, slot.bytes);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        ++tail;
+        return mapped != nullptr;
+    }
+
+    void DeleteBuffers() {
+        for (Slot& slot : slots) {
+            if (slot.fence) glDeleteSync(slot.fence);
+            glDeleteBuffers(1, &slot.PBO);
+            gpuMemory().release(GPU_BUFFER, slot.PBO);
+        }
+        slots.clear();
+        head = tail = 0;
+    }
+
+private:
+    struct Slot {
+        unsigned int PBO = 0;
+        GLsync fence = 0;
+        size_t bytes = 0;
+    };
+    std::vector<Slot> slots;
+    unsigned long long head = 0;
+    unsigned long long tail = 0;
+};
+
+#endif // !PIXEL_READBACK_H
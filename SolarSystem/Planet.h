@@ -0,0 +1,77 @@
+#pragma once
+#ifndef PLANET_H
+#define PLANET_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "SinCos.h"
+
+#include <cmath>
+#include <vector>
+
+struct Planet {
+    float orbitRadius;
+    float orbitSpeed;    // orbits per earth day
+    float scale;
+    float rotationSpeed; // rotations per sim second at timeScaleRotation = 1
+    unsigned int textureID;
+};
+
+// the eight planets drawn around the sun; textureID is filled in once PLANET_TEXTURES are loaded
+const Planet SOLAR_SYSTEM_PLANETS[] = {
+    {5.0f, 1.0f, 0.00916f, 1.0f, 0},            // Earth
+    {7.0f, 1.62f, 0.0087f, 1.0f / 243.0f, 0},   // Venus
+    {15.0f, 0.53f, 0.00487f, 1.03f, 0},         // Mars
+    {30.0f, 0.08f, 0.1005f, 2.5f, 0},           // Jupiter
+    {40.0f, 0.03f, 0.0837f, 2.3f, 0},           // Saturn
+    {50.0f, 0.0119f, 0.0365f, 1.4f, 0},         // Uranus
+    {60.0f, 0.00606f, 0.0354f, 1.3f, 0},        // Neptune
+    {3.0f, 4.15f, 0.00351f, 1.0f / 58.6f, 0}    // Mercury
+};
+const char* const PLANET_TEXTURES[] = {
+    "earth.jpg", "venus.jpg", "mars.jpg", "jupiter.jpg", "saturn.jpg", "uranus.jpg", "neptune.jpg", "mercury.jpg"
+};
+const char* const SUN_TEXTURE = "sun.jpg";
+const int PLANET_COUNT = sizeof(SOLAR_SYSTEM_PLANETS) / sizeof(SOLAR_SYSTEM_PLANETS[0]);
+
+// position on the planet's circular orbit around the sun after simTimeInDays
+inline glm::vec3 planetOrbitPosition(const Planet& planet, double simTimeInDays)
+{
+    float s, c;
+    sinCos(turnsToRadians(simTimeInDays * planet.orbitSpeed), s, c);
+    return glm::vec3(s * planet.orbitRadius, 0.0f, c * planet.orbitRadius);
+}
+
+// the planet's spin around y time seconds into the sim, in radians
+inline float planetRotationAngle(const Planet& planet, double time, float timeScaleRotation)
+{
+    return turnsToRadians(time * timeScaleRotation * planet.rotationSpeed);
+}
+
+// model matrix used to draw the planet: orbit translation, spin around y, then scale
+inline glm::mat4 planetModelMatrix(const Planet& planet, double simTimeInDays, double time, float timeScaleRotation, float planetScale)
+{
+    float s, c, k = planet.scale * planetScale;
+    sinCos(planetRotationAngle(planet, time, timeScaleRotation), s, c);
+    glm::mat4 model;
+    model[0] = glm::vec4(c * k, 0.0f, -s * k, 0.0f);
+    model[1] = glm::vec4(0.0f, k, 0.0f, 0.0f);
+    model[2] = glm::vec4(s * k, 0.0f, c * k, 0.0f);
+    model[3] = glm::vec4(planetOrbitPosition(planet, simTimeInDays), 1.0f);
+    return model;
+}
+
+// model matrices of the sun (first, at the origin) and of every planet simTime seconds into the sim; the GL and
+// software renderers both draw from these
+inline void bodyModelMatrices(const std::vector<Planet>& planets, double simTime, float timeScaleDaysPerSecond, float timeScaleRotation, float planetScale, std::vector<glm::mat4>& models)
+{
+    double simTimeInDays = simTime / timeScaleDaysPerSecond;
+    models.resize(planets.size() + 1);
+    models[0] = glm::mat4(1.0f);
+    for (size_t i = 0; i < planets.size(); ++i)
+        models[i + 1] = planetModelMatrix(planets[i], simTimeInDays, simTime, timeScaleRotation, planetScale);
+}
+
+#endif // !PLANET_H
@@ -0,0 +1,147 @@
+#pragma once
+#ifndef POSTER_H
+#define POSTER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+#include "Scene.h"
+#include "Framebuffer.h"
+#include "PixelReadback.h"
+#include "ImageWriter.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Renders images larger than any framebuffer (and than memory) as a grid of tiles, each with its own off-axis
+// slice of the camera frustum, and streams them into an RGB PNG one row of tiles at a time. Tiles are read back
+// through a PBO ring while the next ones render, and a finished tile row is compressed on the thread pool while
+// the GPU works on the next row, so memory is a few tile rows whatever the poster size.
+class PosterRenderer {
+
+public:
+    int TileSize = 2048;
+
+    // stats of the last render
+    double RenderSeconds = 0.0;
+    double EncodeWaitSeconds = 0.0; // time spent waiting for the previous tile row to be compressed
+    size_t PeakRowBufferBytes = 0;
+    size_t FileBytes = 0;
+
+    bool render(Scene& scene, Camera& camera, double simTime, const std::string& path, int width, int height) {
+        auto start = std::chrono::steady_clock::now();
+        GLint maxTextureSize = 0, maxViewport[2] = { 0, 0 };
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+        glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewport);
+        int tileSize = std::max(16, std::min({ TileSize, (int)maxTextureSize, (int)maxViewport[0], (int)maxViewport[1] }));
+        int columns = (width + tileSize - 1) / tileSize;
+        int rows = (height + tileSize - 1) / tileSize;
+
+        Framebuffer framebuffer;
+        if (!framebuffer.create(tileSize, tileSize))
+            return false;
+        PixelReadback readback;
+        readback.create(tileSize, tileSize, 3);
+        PngWriter png;
+        if (!png.open(path, width, height, 3))
+            return false;
+        std::cout << "Rendering a " << width << "x" << height << " poster in " << columns << "x" << rows << " tiles of " << tileSize << std::endl;
+
+        // two RGB tile-row buffers: one being filled from the GPU, one being compressed
+        const size_t rowBytes = (size_t)width * 3;
+        std::vector<unsigned char> rowBuffers[2];
+        for (std::vector<unsigned char>& buffer : rowBuffers)
+            buffer.resize(rowBytes * tileSize);
+        PeakRowBufferBytes = rowBuffers[0].size() * 2;
+        std::vector<unsigned char> tilePixels(readback.frameBytes());
+        std::vector<int> tilesCollected(rows, 0);
+        ThreadPool pool;
+        EncodeWaitSeconds = 0.0;
+
+        struct Tile {
+            int column, row, x, y, w, h; // y and h in image rows from the top
+        };
+        std::deque<Tile> inFlight;
+        // false if the tile couldn't be read back; tilePixels would still hold the previous tile
+        auto collectOldest = [&]() {
+            Tile tile = inFlight.front();
+            inFlight.pop_front();
+            if (!readback.collect(tilePixels.data(), true)) {
+                std::cout << "ERROR::POSTER::READBACK_FAILED: tile " << tile.column << ", " << tile.row << " couldn't be read back, poster stopped" << std::endl;
+                return false;
+            }
+            // GL rows are bottom-up, the poster is written top-down
+            unsigned char* destination = rowBuffers[tile.row % 2].data() + (size_t)tile.x * 3;
+            for (int r = 0; r < tile.h; ++r) {
+                const unsigned char* source = tilePixels.data() + (size_t)(tile.h - 1 - r) * tile.w * 4;
+                unsigned char* out = destination + (size_t)r * rowBytes;
+                for (int x = 0; x < tile.w; ++x) {
+                    out[x * 3 + 0] = source[x * 4 + 0];
+                    out[x * 3 + 1] = source[x * 4 + 1];
+                    out[x * 3 + 2] = source[x * 4 + 2];
+                }
+            }
+            if (++tilesCollected[tile.row] == columns) {
+                // the previous row has to be in the file before this one, and its buffer is reused next
+                auto waitStart = std::chrono::steady_clock::now();
+                pool.wait();
+                EncodeWaitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+                const unsigned char* rowPixels = rowBuffers[tile.row % 2].data();
+                int rowHeight = tile.h;
+                pool.submit([&png, &pool, rowPixels, rowBytes, rowHeight]() {
+                    png.writeRows(rowPixels, (std::ptrdiff_t)rowBytes, rowHeight, &pool);
+                });
+            }
+            return true;
+        };
+
+        glm::mat4 view = camera.GetViewMatrix();
+        float aspect = (float)width / (float)height;
+        bool readbackFailed = false;
+        for (int row = 0; row < rows && !readbackFailed; ++row) {
+            for (int column = 0; column < columns; ++column) {
+                Tile tile;
+                tile.column = column;
+                tile.row = row;
+                tile.x = column * tileSize;
+                tile.y = row * tileSize;
+                tile.w = std::min(tileSize, width - tile.x);
+                tile.h = std::min(tileSize, height - tile.y);
+
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.FBO);
+                glViewport(0, 0, tile.w, tile.h);
+                glm::mat4 projection = Scene::tileProjectionMatrix(camera, aspect,
+                    (float)tile.x / width, 1.0f - (float)(tile.y + tile.h) / height,
+                    (float)(tile.x + tile.w) / width, 1.0f - (float)tile.y / height);
+                scene.render(view, projection, simTime);
+
+                if (readback.full() && !collectOldest()) {
+                    readbackFailed = true;
+                    break;
+                }
+                readback.start(framebuffer.FBO, 0, 0, tile.w, tile.h);
+                inFlight.push_back(tile);
+                glFlush();
+            }
+        }
+        while (!readbackFailed && !inFlight.empty())
+            readbackFailed = !collectOldest();
+        pool.wait();
+
+        // a poster cut short is closed as it stands and reported incomplete
+        bool written = png.close() && !readbackFailed;
+        FileBytes = png.fileSize();
+        readback.DeleteBuffers();
+        framebuffer.DeleteBuffers();
+        RenderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return written;
+    }
+};
+
+#endif // !POSTER_H
@@ -0,0 +1,31 @@
+#pragma once
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// Numbers for everything generated from a seed (the asteroid belt, moons, fragments, ring particles). They're
+// made from the generator's bits directly, unlike std::uniform_real_distribution, whose results differ between
+// standard libraries, so a seed gives the same scene on every platform.
+
+// [0, 1) with 24 bits of precision
+inline float uniform(std::mt19937& random)
+{
+    return (random() >> 8) * (1.0f / 16777216.0f);
+}
+
+// evenly spread over the unit sphere
+inline glm::vec3 randomDirection(std::mt19937& random)
+{
+    float z = 2.0f * uniform(random) - 1.0f;
+    float angle = uniform(random) * glm::two_pi<float>();
+    float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+    return glm::vec3(r * std::cos(angle), r * std::sin(angle), z);
+}
+
+#endif // !RANDOM_H
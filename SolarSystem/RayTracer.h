@@ -0,0 +1,385 @@
+#pragma once
+#ifndef RAY_TRACER_H
+#define RAY_TRACER_H
+
+#include <glm/glm.hpp>
+
+#include "Planet.h"
+#include "Scene.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+// An offline CPU ray tracer for the scene. The bodies are traced as exact spheres instead of the tessellated
+// mesh, placed by the same bodyModelMatrices and textured from the same decoded images with the mesh's UV mapping:
+// - the spheres are kept in a small BVH that packets of 2x2 rays walk together, with SIMD box and sphere tests
+// - Reference shading is the unlit texture color shader.fs draws, to check the rasterizers against
+// - Beauty shading lights the planets from the sun as a spherical area light, so shadows have penumbras and
+//   planets eclipse each other
+// Rendering is progressive: every pass adds one sample per pixel to a running average, so the first pass is
+// already a complete preview and later ones only refine it.
+class RayTracer {
+
+public:
+    enum Shading { Reference, Beauty };
+
+    // sim settings, same meaning as in Scene
+    float planetScale = 1.0f;
+    float timeScaleDaysPerSecond = 1.0f;
+    float timeScaleRotation = 1.0f;
+
+    Shading shading = Beauty;
+    float ambient = 0.03f; // light on the night side in beauty shading
+
+    int width = 0;
+    int height = 0;
+    int SamplesPerPixel = 0; // passes added since begin()
+    long long RaysTraced = 0;
+
+    RayTracer(const SceneAssets& assets, ThreadPool& threadPool) : pool(threadPool) {
+        images.push_back(&assets.sunImage);
+        for (const TextureImage& image : assets.planetImages)
+            images.push_back(&image);
+        planets.assign(SOLAR_SYSTEM_PLANETS, SOLAR_SYSTEM_PLANETS + PLANET_COUNT);
+    }
+
+    // places the bodies as they are simTime seconds into the sim and starts a new image
+    void begin(int w, int h, const glm::mat4& view, const glm::mat4& projection, double simTime) {
+        width = w;
+        height = h;
+        accumulation.assign((size_t)width * height, glm::vec3(0.0f));
+        SamplesPerPixel = 0;
+        RaysTraced = 0;
+        inverseViewProjection = glm::inverse(projection * view);
+
+        std::vector<glm::mat4> models;
+        bodyModelMatrices(planets, simTime, timeScaleDaysPerSecond, timeScaleRotation, planetScale, models);
+        bodies.resize(models.size());
+        for (size_t i = 0; i < models.size(); ++i) {
+            Body& body = bodies[i];
+            body.center = glm::vec3(models[i][3]);
+            body.radius = glm::length(glm::vec3(models[i][0]));
+            // model matrices are a rotation and a uniform scale, so the rotation's transpose undoes them
+            body.toLocal = glm::transpose(glm::mat3(models[i]) / body.radius);
+            body.image = images[i];
+        }
+        buildBvh();
+    }
+
+    // traces one more sample for every pixel
+    void addPass() {
+        const int packetColumns = (width + 1) / 2, packetRows = (height + 1) / 2;
+        const int pass = SamplesPerPixel;
+        std::atomic<long long> rays(0);
+        pool.parallelFor(packetRows, [&](int begin, int end) {
+            long long traced = 0;
+            for (int row = begin; row < end; ++row)
+                for (int column = 0; column < packetColumns; ++column)
+                    traced += tracePacket(column * 2, row * 2, pass);
+            rays += traced;
+        });
+        RaysTraced += rays;
+        SamplesPerPixel++;
+    }
+
+    // the average of the samples so far as 8-bit RGB, rows bottom-up like glReadPixels
+    void resolve(std::vector<unsigned char>& rgb) const {
+        rgb.resize((size_t)width * height * 3);
+        float scale = 255.0f / std::max(1, SamplesPerPixel);
+        for (size_t i = 0; i < accumulation.size(); ++i)
+            for (int c = 0; c < 3; ++c)
+                rgb[i * 3 + c] = (unsigned char)std::min(255.0f, accumulation[i][c] * scale + 0.5f);
+    }
+
+private:
+    struct Body {
+        glm::vec3 center;
+        float radius;
+        glm::mat3 toLocal; // world direction from the center to the sphere's own axes
+        const TextureImage* image;
+    };
+    struct Node {
+        glm::vec3 boundsMin, boundsMax;
+        int left;         // inner nodes: children at left and left + 1
+        int first, count; // leaves: bodyOrder[first, first + count); count is 0 for inner nodes
+    };
+    // four rays in SoA form; unit directions
+    struct Packet {
+        Float4 ox, oy, oz;
+        Float4 dx, dy, dz;
+        Float4 inverseDx, inverseDy, inverseDz;
+        Float4 t;    // the closest hit so far, or where the ray ends
+        int body[4]; // hit body per lane, -1 for none
+    };
+
+    // the GL clear color
+    static constexpr float BACKGROUND = 0.01f;
+
+    ThreadPool& pool;
+    std::vector<const TextureImage*> images; // sun, then planets
+    std::vector<Planet> planets;
+    std::vector<Body> bodies;
+    std::vector<Node> nodes;
+    std::vector<int> bodyOrder;
+    glm::mat4 inverseViewProjection;
+    std::vector<glm::vec3> accumulation; // sum of the samples per pixel, rows bottom-up
+
+    void buildBvh() {
+        bodyOrder.resize(bodies.size());
+        for (size_t i = 0; i < bodyOrder.size(); ++i)
+            bodyOrder[i] = (int)i;
+        nodes.clear();
+        nodes.emplace_back();
+        buildNode(0, 0, (int)bodies.size());
+    }
+
+    // splits at the median center along the longest axis until leaves hold two bodies
+    void buildNode(int index, int first, int count) {
+        glm::vec3 boundsMin(INFINITY), boundsMax(-INFINITY), centersMin(INFINITY), centersMax(-INFINITY);
+        for (int i = first; i < first + count; ++i) {
+            const Body& body = bodies[bodyOrder[i]];
+            boundsMin = glm::min(boundsMin, body.center - glm::vec3(body.radius));
+            boundsMax = glm::max(boundsMax, body.center + glm::vec3(body.radius));
+            centersMin = glm::min(centersMin, body.center);
+            centersMax = glm::max(centersMax, body.center);
+        }
+        nodes[index].boundsMin = boundsMin;
+        nodes[index].boundsMax = boundsMax;
+        if (count <= 2) {
+            nodes[index].first = first;
+            nodes[index].count = count;
+            return;
+        }
+        glm::vec3 extent = centersMax - centersMin;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        int half = count / 2;
+        std::nth_element(bodyOrder.begin() + first, bodyOrder.begin() + first + half, bodyOrder.begin() + first + count,
+                         [&](int a, int b) { return bodies[a].center[axis] < bodies[b].center[axis]; });
+        int left = (int)nodes.size();
+        nodes.resize(nodes.size() + 2);
+        nodes[index].left = left;
+        nodes[index].count = 0;
+        buildNode(left, first, half);
+        buildNode(left + 1, first + half, count - half);
+    }
+
+    // lanes whose ray enters the node's box before its current t
+    static int boxMask(const Node& node, const Packet& p, int lanes) {
+        Float4 x0 = (Float4(node.boundsMin.x) - p.ox) * p.inverseDx, x1 = (Float4(node.boundsMax.x) - p.ox) * p.inverseDx;
+        Float4 y0 = (Float4(node.boundsMin.y) - p.oy) * p.inverseDy, y1 = (Float4(node.boundsMax.y) - p.oy) * p.inverseDy;
+        Float4 z0 = (Float4(node.boundsMin.z) - p.oz) * p.inverseDz, z1 = (Float4(node.boundsMax.z) - p.oz) * p.inverseDz;
+        Float4 enter = max(max(min(x0, x1), min(y0, y1)), max(min(z0, z1), Float4(0.0f)));
+        Float4 exit = min(min(max(x0, x1), max(y0, y1)), min(max(z0, z1), p.t));
+        return lanes & greaterEqualMask(exit, enter);
+    }
+
+    // records hits closer than the lanes' t and returns their lanes
+    int intersectSphere(int index, Packet& p, int lanes) const {
+        const Body& body = bodies[index];
+        Float4 ocx = p.ox - Float4(body.center.x), ocy = p.oy - Float4(body.center.y), ocz = p.oz - Float4(body.center.z);
+        Float4 b = ocx * p.dx + ocy * p.dy + ocz * p.dz;
+        // r^2 minus the squared distance of the center from the ray: unlike b^2 - c this keeps its precision for
+        // spheres that are tiny compared to their distance
+        Float4 px = ocx - b * p.dx, py = ocy - b * p.dy, pz = ocz - b * p.dz;
+        Float4 discriminant = Float4(body.radius * body.radius) - (px * px + py * py + pz * pz);
+        lanes &= greaterEqualMask(discriminant, Float4(0.0f));
+        if (!lanes) return 0;
+        Float4 root = sqrt(max(discriminant, Float4(0.0f)));
+        Float4 nearT = Float4(0.0f) - b - root, farT = Float4(0.0f) - b + root;
+        // a ray starting inside (the camera in the sun) leaves through the far side
+        Float4 t = select(greaterMask(nearT, Float4(0.0f)), nearT, farT);
+        lanes &= greaterMask(t, Float4(0.0f)) & lessMask(t, p.t);
+        if (!lanes) return 0;
+        p.t = select(lanes, t, p.t);
+        for (int lane = 0; lane < 4; ++lane)
+            if (lanes & (1 << lane)) p.body[lane] = index;
+        return lanes;
+    }
+
+    // closest hits of the packet, or with anyHit the lanes blocked by any body other than skipBody
+    int traverse(Packet& p, int lanes, bool anyHit, int skipBody) const {
+        int blocked = 0;
+        int stack[64];
+        int depth = 0;
+        stack[depth++] = 0;
+        while (depth > 0) {
+            const Node& node = nodes[stack[--depth]];
+            int nodeLanes = boxMask(node, p, lanes);
+            if (!nodeLanes) continue;
+            if (node.count == 0) {
+                stack[depth++] = node.left + 1;
+                stack[depth++] = node.left;
+                continue;
+            }
+            for (int i = node.first; i < node.first + node.count; ++i) {
+                if (bodyOrder[i] == skipBody) continue;
+                int hits = intersectSphere(bodyOrder[i], p, nodeLanes);
+                if (anyHit) {
+                    blocked |= hits;
+                    lanes &= ~hits;
+                    nodeLanes &= ~hits;
+                }
+            }
+            if (anyHit && !lanes) break;
+        }
+        return blocked;
+    }
+
+    static void setRays(Packet& p, const glm::vec3* origins, const glm::vec3* directions, const float* lengths) {
+        p.ox = Float4(origins[0].x, origins[1].x, origins[2].x, origins[3].x);
+        p.oy = Float4(origins[0].y, origins[1].y, origins[2].y, origins[3].y);
+        p.oz = Float4(origins[0].z, origins[1].z, origins[2].z, origins[3].z);
+        p.dx = Float4(directions[0].x, directions[1].x, directions[2].x, directions[3].x);
+        p.dy = Float4(directions[0].y, directions[1].y, directions[2].y, directions[3].y);
+        p.dz = Float4(directions[0].z, directions[1].z, directions[2].z, directions[3].z);
+        p.inverseDx = Float4(1.0f) / p.dx;
+        p.inverseDy = Float4(1.0f) / p.dy;
+        p.inverseDz = Float4(1.0f) / p.dz;
+        p.t = Float4(lengths[0], lengths[1], lengths[2], lengths[3]);
+        std::fill(p.body, p.body + 4, -1);
+    }
+
+    // traces and shades the 2x2 pixels at (x0, y0) for one pass; returns the number of rays
+    int tracePacket(int x0, int y0, int pass) {
+        glm::vec3 origins[4], directions[4];
+        float lengths[4];
+        unsigned int pixels[4];
+        int active = 0;
+        for (int lane = 0; lane < 4; ++lane) {
+            int x = std::min(x0 + (lane & 1), width - 1), y = std::min(y0 + (lane >> 1), height - 1);
+            if (x == x0 + (lane & 1) && y == y0 + (lane >> 1))
+                active |= 1 << lane;
+            pixels[lane] = (unsigned int)(y * width + x);
+            // the first pass samples pixel centers like the rasterizers, later ones anywhere in the pixel
+            float jitterX = pass == 0 ? 0.5f : random(pixels[lane], pass, 0);
+            float jitterY = pass == 0 ? 0.5f : random(pixels[lane], pass, 1);
+            float ndcX = (x + jitterX) / width * 2.0f - 1.0f, ndcY = (y + jitterY) / height * 2.0f - 1.0f;
+            // from the near to the far plane, so the clipping matches the GL path
+            glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+            glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+            origins[lane] = glm::vec3(nearPoint) / nearPoint.w;
+            glm::vec3 ray = glm::vec3(farPoint) / farPoint.w - origins[lane];
+            lengths[lane] = glm::length(ray);
+            directions[lane] = ray / lengths[lane];
+        }
+        Packet primary;
+        setRays(primary, origins, directions, lengths);
+        traverse(primary, active, false, -1);
+        float hitT[4];
+        primary.t.store(hitT);
+        int rays = 0;
+
+        glm::vec3 colors[4], albedo[4], normals[4], shadowOrigins[4], shadowDirections[4];
+        float shadowLengths[4], cosines[4];
+        int lit = 0;
+        for (int lane = 0; lane < 4; ++lane) {
+            if (!(active & (1 << lane))) continue;
+            ++rays;
+            int index = primary.body[lane];
+            if (index < 0) {
+                colors[lane] = glm::vec3(BACKGROUND);
+                continue;
+            }
+            const Body& body = bodies[index];
+            glm::vec3 position = origins[lane] + directions[lane] * hitT[lane];
+            glm::vec3 normal = (position - body.center) / body.radius;
+            glm::vec3 texel = sampleTexture(*body.image, body.toLocal * normal);
+            // the sun is the light, and glows whatever the shading
+            if (shading == Reference || index == 0) {
+                colors[lane] = texel;
+                continue;
+            }
+            colors[lane] = texel * ambient;
+            // a random point on the half of the sun facing the planet: averaged over the passes this gives soft
+            // shadows and eclipses
+            const Body& sun = bodies[0];
+            float z = 1.0f - 2.0f * random(pixels[lane], pass, 2), angle = 6.2831853f * random(pixels[lane], pass, 3);
+            float ring = std::sqrt(std::max(0.0f, 1.0f - z * z));
+            glm::vec3 onSun(ring * std::cos(angle), ring * std::sin(angle), z);
+            if (glm::dot(onSun, position - sun.center) < 0.0f)
+                onSun = -onSun;
+            glm::vec3 toLight = sun.center + onSun * sun.radius - position;
+            float distance = glm::length(toLight);
+            toLight /= distance;
+            float cosine = glm::dot(normal, toLight);
+            if (cosine <= 0.0f) continue;
+            albedo[lane] = texel;
+            normals[lane] = normal;
+            cosines[lane] = cosine;
+            shadowOrigins[lane] = position + normal * (body.radius * 1e-3f);
+            shadowDirections[lane] = toLight;
+            shadowLengths[lane] = distance;
+            lit |= 1 << lane;
+        }
+        if (lit) {
+            for (int lane = 0; lane < 4; ++lane) {
+                if (lit & (1 << lane)) continue;
+                // idle lanes copy a lit one so the packet math stays finite
+                int source = lit & 1 ? 0 : lit & 2 ? 1 : lit & 4 ? 2 : 3;
+                shadowOrigins[lane] = shadowOrigins[source];
+                shadowDirections[lane] = shadowDirections[source];
+                shadowLengths[lane] = shadowLengths[source];
+            }
+            Packet shadow;
+            setRays(shadow, shadowOrigins, shadowDirections, shadowLengths);
+            int blocked = traverse(shadow, lit, true, 0);
+            for (int lane = 0; lane < 4; ++lane) {
+                if (!(lit & (1 << lane))) continue;
+                ++rays;
+                if (!(blocked & (1 << lane)))
+                    colors[lane] += albedo[lane] * ((1.0f - ambient) * cosines[lane]);
+            }
+        }
+        for (int lane = 0; lane < 4; ++lane)
+            if (active & (1 << lane)) accumulation[pixels[lane]] += colors[lane];
+        return rays;
+    }
+
+    // bilinear, GL_REPEAT, from the full resolution image; the jittered passes average out minification
+    static glm::vec3 sampleTexture(const TextureImage& image, const glm::vec3& local) {
+        if (image.pixels.empty())
+            return glm::vec3(0.0f); // an incomplete GL texture samples black
+        // Sphere::generateSphereData's mapping, with its 3.14 for pi
+        float u = std::atan2(local.z, local.x);
+        if (u < 0.0f) u += 6.2831853f;
+        u /= 2.0f * 3.14f;
+        float v = std::acos(std::max(-1.0f, std::min(1.0f, local.y))) / 3.14f;
+        float x = u * image.width - 0.5f, y = v * image.height - 0.5f;
+        float fx = std::floor(x), fy = std::floor(y);
+        float wx = x - fx, wy = y - fy;
+        int x0 = wrap((int)fx, image.width), x1 = wrap((int)fx + 1, image.width);
+        int y0 = wrap((int)fy, image.height), y1 = wrap((int)fy + 1, image.height);
+        glm::vec3 top = glm::mix(texel(image, x0, y0), texel(image, x1, y0), wx);
+        glm::vec3 bottom = glm::mix(texel(image, x0, y1), texel(image, x1, y1), wx);
+        return glm::mix(top, bottom, wy);
+    }
+
+    static int wrap(int i, int size) {
+        i %= size;
+        return i < 0 ? i + size : i;
+    }
+
+    static glm::vec3 texel(const TextureImage& image, int x, int y) {
+        const unsigned char* p = &image.pixels[((size_t)y * image.width + x) * image.components];
+        if (image.components < 3)
+            return glm::vec3(p[0] / 255.0f, 0.0f, 0.0f);
+        return glm::vec3(p[0], p[1], p[2]) / 255.0f;
+    }
+
+    // deterministic per pixel, pass and dimension, so a render can be reproduced exactly
+    static float random(unsigned int pixel, int pass, int dimension) {
+        unsigned int x = pixel * 0x9e3779b9u ^ (unsigned int)(pass * 4 + dimension) * 0x85ebca6bu;
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return (x >> 8) * (1.0f / 16777216.0f);
+    }
+};
+
+#endif // !RAY_TRACER_H
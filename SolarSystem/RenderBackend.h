@@ -0,0 +1,106 @@
+#pragma once
+#ifndef RENDER_BACKEND_H
+#define RENDER_BACKEND_H
+
+#include <glm/glm.hpp>
+
+#include "Texture.h"
+
+#include <string>
+#include <vector>
+
+// Backend objects are referred to by handle; 0 is never a valid handle.
+typedef unsigned int BufferHandle;
+typedef unsigned int TextureHandle;
+typedef unsigned int ProgramHandle;
+typedef unsigned int PipelineHandle;
+
+enum BufferType {
+    VERTEX_BUFFER,
+    INDEX_BUFFER   // 32-bit indices
+};
+
+enum RenderBackendType {
+    BACKEND_GL33,
+    BACKEND_GL45
+};
+
+// A program's shader files. Programs take view and projection uniforms, the model matrix as a per-instance
+// attribute at locations 2-5, and sample texture1; the multi-draw variant reads the model matrix and texture from
+// a storage buffer per draw instead (see shader_mdi.vs), for backends that submit many draws in one call.
+struct ProgramDesc {
+    const char* vertexPath;
+    const char* fragmentPath;
+    const char* multiDrawVertexPath;
+    const char* multiDrawFragmentPath;
+};
+
+// float vertex attribute at a byte offset into each vertex
+struct VertexAttribute {
+    unsigned int location;
+    int components;
+    size_t offset;
+};
+
+// everything fixed about a kind of draw: program, vertex format, geometry buffers and depth state
+struct PipelineDesc {
+    ProgramHandle program = 0;
+    BufferHandle vertexBuffer = 0;
+    BufferHandle indexBuffer = 0;
+    std::vector<VertexAttribute> attributes;
+    size_t stride = 0;
+    bool depthTest = true;
+};
+
+// one indexed triangle draw from a pipeline's buffers, with its own model matrix and texture
+struct DrawItem {
+    glm::mat4 model;
+    TextureHandle texture;
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    int baseVertex;
+    unsigned int occlusionQuery; // GL query the draw is conditional on, skipped when none of its samples passed; 0 always draws
+};
+
+// consecutive draws of the same mesh with the same texture and condition, which can go out as instances of one draw call
+inline bool sameMeshAndTexture(const DrawItem& a, const DrawItem& b)
+{
+    return a.texture == b.texture && a.firstIndex == b.firstIndex && a.indexCount == b.indexCount && a.baseVertex == b.baseVertex
+        && a.occlusionQuery == b.occlusionQuery;
+}
+
+// What the scene needs from a graphics API. Objects are created up front and destroyed together; a frame is a
+// clear followed by any number of submits, drawn in order into whatever framebuffer is bound.
+class RenderBackend {
+
+public:
+    // GL draw commands issued since the last clear(), whatever the number of draws they carried
+    int DrawCalls = 0;
+
+    virtual ~RenderBackend() {}
+
+    virtual std::string name() const = 0;
+
+    virtual BufferHandle createBuffer(BufferType type, const void* data, size_t bytes) = 0;
+    // RGB(A) or single channel 8-bit image, mipmapped and repeating; an empty image samples black
+    virtual TextureHandle createTexture(const TextureImage& image) = 0;
+    virtual ProgramHandle createProgram(const ProgramDesc& desc) = 0;
+    virtual PipelineHandle createPipeline(const PipelineDesc& desc) = 0;
+
+    // clears color and depth of the bound framebuffer
+    virtual void clear(const glm::vec4& color) = 0;
+    virtual void submit(PipelineHandle pipeline, const glm::mat4& view, const glm::mat4& projection, const DrawItem* draws, size_t count) = 0;
+
+    // deletes every object the backend created; call with its context current
+    virtual void destroy() = 0;
+};
+
+inline bool parseRenderBackend(const std::string& name, RenderBackendType& type)
+{
+    if (name == "gl33") type = BACKEND_GL33;
+    else if (name == "gl45") type = BACKEND_GL45;
+    else return false;
+    return true;
+}
+
+#endif // !RENDER_BACKEND_H
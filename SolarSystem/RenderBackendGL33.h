@@ -0,0 +1,180 @@
+#pragma once
+#ifndef RENDER_BACKEND_GL33_H
+#define RENDER_BACKEND_GL33_H
+
+#include <glad/glad.h>
+
+#include "RenderBackend.h"
+#include "Shader.h"
+#include "Texture.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// The GL 3.3 path: objects are edited through their binding points, model matrices are streamed into a mapped
+// buffer of per-instance attributes every submit, and each run of consecutive draws of the same mesh and texture is one
+// glDrawElementsInstancedBaseVertex. Runs on any GL 3.3 core context.
+class RenderBackendGL33 : public RenderBackend {
+
+public:
+    std::string name() const override {
+        return "gl33";
+    }
+
+    BufferHandle createBuffer(BufferType type, const void* data, size_t bytes) override {
+        GLenum target = type == INDEX_BUFFER ? GL_ELEMENT_ARRAY_BUFFER : GL_ARRAY_BUFFER;
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        // the element array binding belongs to the bound vertex array; keep whichever one that is untouched
+        glBindVertexArray(0);
+        glBindBuffer(target, buffer);
+        glBufferData(target, bytes, data, GL_STATIC_DRAW);
+        gpuMemory().record(GPU_BUFFER, buffer, MEMORY_MESHES, type == INDEX_BUFFER ? "mesh indices" : "mesh vertices", bytes);
+        glBindBuffer(target, 0);
+        buffers.push_back(buffer);
+        return (BufferHandle)buffers.size();
+    }
+
+    TextureHandle createTexture(const TextureImage& image) override {
+        textures.push_back(Texture(image).textureID);
+        return (TextureHandle)textures.size();
+    }
+
+    ProgramHandle createProgram(const ProgramDesc& desc) override {
+        programs.emplace_back(desc.vertexPath, desc.fragmentPath);
+        programs.back().use();
+        programs.back().setInt("texture1", 0);
+        return (ProgramHandle)programs.size();
+    }
+
+    PipelineHandle createPipeline(const PipelineDesc& desc) override {
+        Pipeline pipeline;
+        pipeline.program = desc.program;
+        pipeline.depthTest = desc.depthTest;
+        glGenVertexArrays(1, &pipeline.vertexArray);
+        glBindVertexArray(pipeline.vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[desc.vertexBuffer - 1]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[desc.indexBuffer - 1]);
+        for (const VertexAttribute& attribute : desc.attributes) {
+            glVertexAttribPointer(attribute.location, attribute.components, GL_FLOAT, GL_FALSE, (GLsizei)desc.stride, (void*)attribute.offset);
+            glEnableVertexAttribArray(attribute.location);
+        }
+        // the model matrix, a column per location; pointed at each run's matrices in submit()
+        glGenBuffers(1, &pipeline.instanceBuffer);
+        for (GLuint column = 0; column < 4; ++column) {
+            glEnableVertexAttribArray(MODEL_LOCATION + column);
+            glVertexAttribDivisor(MODEL_LOCATION + column, 1);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        pipelines.push_back(pipeline);
+        return (PipelineHandle)pipelines.size();
+    }
+
+    void clear(const glm::vec4& color) override {
+        glClearColor(color.r, color.g, color.b, color.a);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        DrawCalls = 0;
+    }
+
+    void submit(PipelineHandle handle, const glm::mat4& view, const glm::mat4& projection, const DrawItem* draws, size_t count) override {
+        if (count == 0) return;
+        const Pipeline& pipeline = pipelines[handle - 1];
+        const Shader& shader = programs[pipeline.program - 1];
+        if (pipeline.depthTest) glEnable(GL_DEPTH_TEST);
+        else glDisable(GL_DEPTH_TEST);
+
+        glBindBuffer(GL_ARRAY_BUFFER, pipeline.instanceBuffer);
+        // orphaned rather than overwritten, so this doesn't wait for the previous submit's draws, then mapped so
+        // the matrices are copied once, straight from the draws
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+        gpuMemory().record(GPU_BUFFER, pipeline.instanceBuffer, MEMORY_RENDERER, "instance matrices", count * sizeof(glm::mat4));
+        glm::mat4* instances = static_cast<glm::mat4*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        if (instances) {
+            for (size_t i = 0; i < count; ++i)
+                instances[i] = draws[i].model;
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        else {
+            if (!mapFailureReported)
+                std::cout << "ERROR::RENDER_BACKEND::MAP_FAILED: instance buffer of " << count << " matrices, uploading with glBufferSubData" << std::endl;
+            mapFailureReported = true;
+            // gathered a chunk at a time on the stack, the draws' matrices aren't contiguous
+            const size_t CHUNK = 64;
+            glm::mat4 chunk[CHUNK];
+            for (size_t first = 0; first < count; first += CHUNK) {
+                size_t n = std::min(CHUNK, count - first);
+                for (size_t i = 0; i < n; ++i)
+                    chunk[i] = draws[first + i].model;
+                glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(glm::mat4), n * sizeof(glm::mat4), chunk);
+            }
+        }
+
+        shader.use();
+        shader.setMat4("projection", projection);
+        shader.setMat4("view", view);
+        glActiveTexture(GL_TEXTURE0);
+        glBindVertexArray(pipeline.vertexArray);
+        TextureHandle boundTexture = 0;
+        for (size_t first = 0; first < count;) {
+            size_t end = first + 1;
+            while (end < count && sameMeshAndTexture(draws[end], draws[first]))
+                ++end;
+            const DrawItem& draw = draws[first];
+            if (draw.texture != boundTexture) {
+                glBindTexture(GL_TEXTURE_2D, textures[draw.texture - 1]);
+                boundTexture = draw.texture;
+            }
+            // GL 3.3 has no base instance, so the run's matrices are found by moving the attribute pointers
+            for (GLuint column = 0; column < 4; ++column)
+                glVertexAttribPointer(MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                                      (void*)(first * sizeof(glm::mat4) + column * sizeof(glm::vec4)));
+            if (draw.occlusionQuery) glBeginConditionalRender(draw.occlusionQuery, GL_QUERY_NO_WAIT);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)draw.indexCount, GL_UNSIGNED_INT,
+                                              (void*)(draw.firstIndex * sizeof(unsigned int)), (GLsizei)(end - first), draw.baseVertex);
+            if (draw.occlusionQuery) glEndConditionalRender();
+            ++DrawCalls;
+            first = end;
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void destroy() override {
+        for (const Pipeline& pipeline : pipelines) {
+            glDeleteVertexArrays(1, &pipeline.vertexArray);
+            glDeleteBuffers(1, &pipeline.instanceBuffer);
+            gpuMemory().release(GPU_BUFFER, pipeline.instanceBuffer);
+        }
+        for (const Shader& program : programs)
+            glDeleteProgram(program.ID);
+        if (!textures.empty()) glDeleteTextures((GLsizei)textures.size(), textures.data());
+        if (!buffers.empty()) glDeleteBuffers((GLsizei)buffers.size(), buffers.data());
+        gpuMemory().release(GPU_TEXTURE, (int)textures.size(), textures.data());
+        gpuMemory().release(GPU_BUFFER, (int)buffers.size(), buffers.data());
+        pipelines.clear();
+        programs.clear();
+        textures.clear();
+        buffers.clear();
+    }
+
+private:
+    struct Pipeline {
+        GLuint vertexArray;
+        GLuint instanceBuffer;
+        ProgramHandle program;
+        bool depthTest;
+    };
+
+    // aModel in shader.vs
+    static const GLuint MODEL_LOCATION = 2;
+
+    std::vector<GLuint> buffers;
+    std::vector<GLuint> textures;
+    std::vector<Shader> programs;
+    std::vector<Pipeline> pipelines;
+    bool mapFailureReported = false; // once, not every frame
+};
+
+#endif // !RENDER_BACKEND_GL33_H
@@ -0,0 +1,351 @@
+#pragma once
+#ifndef RENDER_BACKEND_GL45_H
+#define RENDER_BACKEND_GL45_H
+
+#include <glad/glad.h>
+
+#include "RenderBackend.h"
+#include "Shader.h"
+#include "Texture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// The GL 4.5 fast path on direct state access: objects are created and edited by name without disturbing any
+// binding, buffers and textures get immutable storage, and a submit goes out as multi-draw indirect commands that
+// read their model matrix and texture from a storage buffer by gl_DrawID:
+// - with ARB_bindless_texture, a whole submit is one glMultiDrawElementsIndirect
+// - without it, one per run of consecutive draws that share a texture
+// - without ARB_shader_draw_parameters, one instanced draw per run of consecutive draws of the same mesh and
+//   texture, indexed by gl_InstanceID instead
+// Per-draw data and commands are written straight into persistently mapped ring buffers, fenced so the CPU never
+// overwrites what the GPU may still be reading.
+class RenderBackendGL45 : public RenderBackend {
+
+public:
+    // loader is the one glad was loaded with; ARB_bindless_texture isn't in the generated loader, so its entry
+    // points are looked up through it
+    explicit RenderBackendGL45(GLADloadproc loader = nullptr) {
+        multiDraw = hasExtension("GL_ARB_shader_draw_parameters");
+        if (multiDraw && loader && hasExtension("GL_ARB_bindless_texture")) {
+            getTextureHandle = (GetTextureHandleProc)loader("glGetTextureHandleARB");
+            makeHandleResident = (TextureHandleProc)loader("glMakeTextureHandleResidentARB");
+            makeHandleNonResident = (TextureHandleProc)loader("glMakeTextureHandleNonResidentARB");
+            bindless = getTextureHandle && makeHandleResident && makeHandleNonResident;
+        }
+        GLint alignment = 256;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        storageAlignment = std::max(1, (int)alignment);
+    }
+
+    std::string name() const override {
+        if (bindless) return "gl45 (bindless multi-draw indirect)";
+        if (multiDraw) return "gl45 (multi-draw indirect)";
+        return "gl45 (instanced)";
+    }
+
+    BufferHandle createBuffer(BufferType type, const void* data, size_t bytes) override {
+        GLuint buffer;
+        glCreateBuffers(1, &buffer);
+        glNamedBufferStorage(buffer, bytes, data, 0);
+        gpuMemory().record(GPU_BUFFER, buffer, MEMORY_MESHES, type == INDEX_BUFFER ? "mesh indices" : "mesh vertices", bytes);
+        buffers.push_back(buffer);
+        return (BufferHandle)buffers.size();
+    }
+
+    TextureHandle createTexture(const TextureImage& image) override {
+        TextureObject texture;
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture.name);
+        if (image.pixels.empty()) {
+            // an incomplete texture samples black, but has no bindless handle; store the black instead
+            const unsigned char black[4] = { 0, 0, 0, 255 };
+            glTextureStorage2D(texture.name, 1, GL_RGBA8, 1, 1);
+            glTextureSubImage2D(texture.name, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, black);
+            gpuMemory().record(GPU_TEXTURE, texture.name, MEMORY_TEXTURES, image.source.c_str(), 4);
+        }
+        else {
+            GLenum format = image.components == 1 ? GL_RED : image.components == 4 ? GL_RGBA : GL_RGB;
+            GLenum internalFormat = image.components == 1 ? GL_R8 : image.components == 4 ? GL_RGBA8 : GL_RGB8;
+            int levels = 1;
+            while ((std::max(image.width, image.height) >> levels) > 0)
+                ++levels;
+            glTextureStorage2D(texture.name, levels, internalFormat, image.width, image.height);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTextureSubImage2D(texture.name, 0, 0, 0, image.width, image.height, format, GL_UNSIGNED_BYTE, image.pixels.data());
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glGenerateTextureMipmap(texture.name);
+            gpuMemory().record(GPU_TEXTURE, texture.name, MEMORY_TEXTURES, image.source.c_str(), estimateTextureBytes(image.width, image.height, image.components == 1 ? 1 : 4, true));
+        }
+        glTextureParameteri(texture.name, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTextureParameteri(texture.name, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTextureParameteri(texture.name, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTextureParameteri(texture.name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        if (bindless) {
+            texture.handle = getTextureHandle(texture.name);
+            makeHandleResident(texture.handle);
+        }
+        textures.push_back(texture);
+        return (TextureHandle)textures.size();
+    }
+
+    ProgramHandle createProgram(const ProgramDesc& desc) override {
+        ProgramObject program;
+        const char* defines = bindless ? "#define BINDLESS 1\n" : multiDraw ? "" : "#define INSTANCED 1\n";
+        program.id = Shader(desc.multiDrawVertexPath, desc.multiDrawFragmentPath, defines).ID;
+        program.view = glGetUniformLocation(program.id, "view");
+        program.projection = glGetUniformLocation(program.id, "projection");
+        program.drawOffset = glGetUniformLocation(program.id, "drawOffset");
+        glProgramUniform1i(program.id, glGetUniformLocation(program.id, "texture1"), 0);
+        programs.push_back(program);
+        return (ProgramHandle)programs.size();
+    }
+
+    PipelineHandle createPipeline(const PipelineDesc& desc) override {
+        Pipeline pipeline;
+        pipeline.program = desc.program;
+        pipeline.depthTest = desc.depthTest;
+        glCreateVertexArrays(1, &pipeline.vertexArray);
+        glVertexArrayVertexBuffer(pipeline.vertexArray, 0, buffers[desc.vertexBuffer - 1], 0, (GLsizei)desc.stride);
+        glVertexArrayElementBuffer(pipeline.vertexArray, buffers[desc.indexBuffer - 1]);
+        for (const VertexAttribute& attribute : desc.attributes) {
+            glEnableVertexArrayAttrib(pipeline.vertexArray, attribute.location);
+            glVertexArrayAttribFormat(pipeline.vertexArray, attribute.location, attribute.components, GL_FLOAT, GL_FALSE, (GLuint)attribute.offset);
+            glVertexArrayAttribBinding(pipeline.vertexArray, attribute.location, 0);
+        }
+        pipelines.push_back(pipeline);
+        return (PipelineHandle)pipelines.size();
+    }
+
+    void clear(const glm::vec4& color) override {
+        GLint framebuffer = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+        const float depth = 1.0f;
+        glClearNamedFramebufferfv(framebuffer, GL_COLOR, 0, &color[0]);
+        glClearNamedFramebufferfv(framebuffer, GL_DEPTH, 0, &depth);
+        DrawCalls = 0;
+    }
+
+    void submit(PipelineHandle handle, const glm::mat4& view, const glm::mat4& projection, const DrawItem* draws, size_t count) override {
+        if (count == 0) return;
+        const Pipeline& pipeline = pipelines[handle - 1];
+        const ProgramObject& program = programs[pipeline.program - 1];
+        if (pipeline.depthTest) glEnable(GL_DEPTH_TEST);
+        else glDisable(GL_DEPTH_TEST);
+        glUseProgram(program.id);
+        glProgramUniformMatrix4fv(program.id, program.view, 1, GL_FALSE, &view[0][0]);
+        glProgramUniformMatrix4fv(program.id, program.projection, 1, GL_FALSE, &projection[0][0]);
+        glBindVertexArray(pipeline.vertexArray);
+
+        size_t region = reserveRegion(count);
+        DrawData* data = reinterpret_cast<DrawData*>(drawMapping + region * drawRegionBytes);
+        DrawCommand* commands = reinterpret_cast<DrawCommand*>(commandMapping + region * commandRegionBytes);
+        for (size_t i = 0; i < count; ++i) {
+            const DrawItem& draw = draws[i];
+            data[i].model = draw.model;
+            data[i].texture = textures[draw.texture - 1].handle;
+            data[i].padding = 0;
+            commands[i].count = draw.indexCount;
+            commands[i].instanceCount = 1;
+            commands[i].firstIndex = draw.firstIndex;
+            commands[i].baseVertex = draw.baseVertex;
+            commands[i].baseInstance = 0;
+        }
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, drawBuffer, (GLintptr)(region * drawRegionBytes), (GLsizeiptr)(count * sizeof(DrawData)));
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        const size_t commandOffset = region * commandRegionBytes;
+        if (bindless) {
+            // one call, unless some draws are conditional: a condition covers a whole call
+            for (size_t first = 0; first < count;) {
+                size_t end = first + 1;
+                while (end < count && draws[end].occlusionQuery == draws[first].occlusionQuery)
+                    ++end;
+                beginCondition(draws[first]);
+                glProgramUniform1ui(program.id, program.drawOffset, (GLuint)first);
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(commandOffset + first * sizeof(DrawCommand)), (GLsizei)(end - first), 0);
+                endCondition(draws[first]);
+                ++DrawCalls;
+                first = end;
+            }
+        }
+        else if (multiDraw) {
+            // gl_DrawID restarts at 0 with every call, drawOffset says where in the storage buffer it starts
+            for (size_t first = 0; first < count;) {
+                size_t end = first + 1;
+                while (end < count && draws[end].texture == draws[first].texture && draws[end].occlusionQuery == draws[first].occlusionQuery)
+                    ++end;
+                glBindTextureUnit(0, textures[draws[first].texture - 1].name);
+                glProgramUniform1ui(program.id, program.drawOffset, (GLuint)first);
+                beginCondition(draws[first]);
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(commandOffset + first * sizeof(DrawCommand)), (GLsizei)(end - first), 0);
+                endCondition(draws[first]);
+                ++DrawCalls;
+                first = end;
+            }
+        }
+        else {
+            TextureHandle boundTexture = 0;
+            for (size_t first = 0; first < count;) {
+                size_t end = first + 1;
+                while (end < count && sameMeshAndTexture(draws[end], draws[first]))
+                    ++end;
+                const DrawItem& draw = draws[first];
+                if (draw.texture != boundTexture) {
+                    glBindTextureUnit(0, textures[draw.texture - 1].name);
+                    boundTexture = draw.texture;
+                }
+                glProgramUniform1ui(program.id, program.drawOffset, (GLuint)first);
+                beginCondition(draw);
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)draw.indexCount, GL_UNSIGNED_INT,
+                                                  (void*)(draw.firstIndex * sizeof(unsigned int)), (GLsizei)(end - first), draw.baseVertex);
+                endCondition(draw);
+                ++DrawCalls;
+                first = end;
+            }
+        }
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
+    void destroy() override {
+        destroyRing();
+        for (const TextureObject& texture : textures) {
+            if (texture.handle) makeHandleNonResident(texture.handle);
+            glDeleteTextures(1, &texture.name);
+            gpuMemory().release(GPU_TEXTURE, texture.name);
+        }
+        for (const Pipeline& pipeline : pipelines)
+            glDeleteVertexArrays(1, &pipeline.vertexArray);
+        for (const ProgramObject& program : programs)
+            glDeleteProgram(program.id);
+        if (!buffers.empty()) glDeleteBuffers((GLsizei)buffers.size(), buffers.data());
+        gpuMemory().release(GPU_BUFFER, (int)buffers.size(), buffers.data());
+        textures.clear();
+        pipelines.clear();
+        programs.clear();
+        buffers.clear();
+    }
+
+private:
+    typedef GLuint64(APIENTRYP GetTextureHandleProc)(GLuint texture);
+    typedef void(APIENTRYP TextureHandleProc)(GLuint64 handle);
+
+    // std430 layout of shader_mdi.vs's Draw
+    struct DrawData {
+        glm::mat4 model;
+        GLuint64 texture; // bindless handle, a uvec2 in the shader
+        GLuint64 padding;
+    };
+    // layout glMultiDrawElementsIndirect reads
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+    struct TextureObject {
+        GLuint name = 0;
+        GLuint64 handle = 0;
+    };
+    struct ProgramObject {
+        GLuint id;
+        GLint view, projection, drawOffset;
+    };
+    struct Pipeline {
+        GLuint vertexArray;
+        ProgramHandle program;
+        bool depthTest;
+    };
+
+    // submits in flight before the CPU waits for the oldest one
+    static const int RING_REGIONS = 4;
+
+    bool multiDraw = false;
+    bool bindless = false;
+    GetTextureHandleProc getTextureHandle = nullptr;
+    TextureHandleProc makeHandleResident = nullptr;
+    TextureHandleProc makeHandleNonResident = nullptr;
+    size_t storageAlignment = 256;
+
+    std::vector<GLuint> buffers;
+    std::vector<TextureObject> textures;
+    std::vector<ProgramObject> programs;
+    std::vector<Pipeline> pipelines;
+
+    GLuint drawBuffer = 0, commandBuffer = 0;
+    unsigned char* drawMapping = nullptr;
+    unsigned char* commandMapping = nullptr;
+    size_t regionCapacity = 0; // draws per region
+    size_t drawRegionBytes = 0, commandRegionBytes = 0;
+    GLsync fences[RING_REGIONS] = {};
+    int nextRegion = 0;
+
+    static bool hasExtension(const char* extension) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i)
+            if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), extension) == 0)
+                return true;
+        return false;
+    }
+
+    // occlusion culling: the GPU skips the draw when last frame's query saw no samples pass, and draws it if that
+    // result isn't in yet rather than wait
+    static void beginCondition(const DrawItem& draw) {
+        if (draw.occlusionQuery) glBeginConditionalRender(draw.occlusionQuery, GL_QUERY_NO_WAIT);
+    }
+
+    static void endCondition(const DrawItem& draw) {
+        if (draw.occlusionQuery) glEndConditionalRender();
+    }
+
+    // the next ring region, once the GPU is done with the submit that last used it
+    size_t reserveRegion(size_t count) {
+        if (count > regionCapacity)
+            createRing(std::max(count, regionCapacity * 2));
+        int region = nextRegion;
+        nextRegion = (nextRegion + 1) % RING_REGIONS;
+        if (fences[region]) {
+            while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+            glDeleteSync(fences[region]);
+            fences[region] = 0;
+        }
+        return (size_t)region;
+    }
+
+    void createRing(size_t capacity) {
+        destroyRing();
+        regionCapacity = std::max<size_t>(capacity, 64);
+        drawRegionBytes = (regionCapacity * sizeof(DrawData) + storageAlignment - 1) / storageAlignment * storageAlignment;
+        commandRegionBytes = regionCapacity * sizeof(DrawCommand);
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glCreateBuffers(1, &drawBuffer);
+        glNamedBufferStorage(drawBuffer, drawRegionBytes * RING_REGIONS, nullptr, flags);
+        drawMapping = (unsigned char*)glMapNamedBufferRange(drawBuffer, 0, drawRegionBytes * RING_REGIONS, flags);
+        gpuMemory().record(GPU_BUFFER, drawBuffer, MEMORY_RENDERER, "draw data ring", drawRegionBytes * RING_REGIONS);
+        glCreateBuffers(1, &commandBuffer);
+        glNamedBufferStorage(commandBuffer, commandRegionBytes * RING_REGIONS, nullptr, flags);
+        commandMapping = (unsigned char*)glMapNamedBufferRange(commandBuffer, 0, commandRegionBytes * RING_REGIONS, flags);
+        gpuMemory().record(GPU_BUFFER, commandBuffer, MEMORY_RENDERER, "draw command ring", commandRegionBytes * RING_REGIONS);
+        nextRegion = 0;
+    }
+
+    // the buffers may still be in use: GL only frees them once the GPU is done
+    void destroyRing() {
+        for (GLsync& fence : fences) {
+            if (fence) glDeleteSync(fence);
+            fence = 0;
+        }
+        if (drawBuffer) glDeleteBuffers(1, &drawBuffer);
+        if (commandBuffer) glDeleteBuffers(1, &commandBuffer);
+        gpuMemory().release(GPU_BUFFER, drawBuffer);
+        gpuMemory().release(GPU_BUFFER, commandBuffer);
+        drawBuffer = commandBuffer = 0;
+        drawMapping = commandMapping = nullptr;
+        regionCapacity = 0;
+    }
+};
+
+#endif // !RENDER_BACKEND_GL45_H
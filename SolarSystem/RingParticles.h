@@ -0,0 +1,294 @@
+#pragma once
+#ifndef RING_PARTICLES_H
+#define RING_PARTICLES_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "SinCos.h"
+#include "ThreadPool.h"
+#include "ParticleCollisions.h"
+#include "MemoryLedger.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <vector>
+
+// Saturn's main rings, from the inner edge of the C ring to the outer edge of the A ring, in Saturn radii
+const float RING_INNER_RADIUS = 1.24f;
+const float RING_OUTER_RADIUS = 2.27f;
+// how far a particle's orbit strays from the ring plane, at most
+const float RING_THICKNESS = 0.004f;
+
+// how densely the rings are filled at a radius in Saturn radii, from 0 to 1: the faint C ring, the B ring
+// (densest in its middle), the Cassini division, and the A ring with the Encke gap
+inline float ringDensity(float radius)
+{
+    if (radius < RING_INNER_RADIUS || radius > RING_OUTER_RADIUS) return 0.0f;
+    if (radius < 1.53f) return 0.15f;
+    if (radius < 1.95f) return 0.7f + 0.3f * std::sin((radius - 1.53f) / 0.42f * glm::pi<float>());
+    if (radius < 2.03f) return 0.06f;
+    if (radius > 2.21f && radius < 2.222f) return 0.04f;
+    return 0.55f;
+}
+
+// Saturn's rings as particles, each on a circular Keplerian orbit tilted just enough to give the ring some
+// thickness. Lengths are in Saturn radii, around Saturn's centre, and the ring plane is its equator (local xz);
+// times are sim seconds times timeScaleRotation, as for the planets' spins. With no collisions a particle's place
+// depends on the time alone, so any number of them can be placed for any moment without stepping the rest. They
+// are stored in random order, so the first n are an even sample of the whole ring for every n.
+//
+// Collisions need every particle, every update: they are found and resolved over the time since the last update
+// with the particles moving in straight lines, as ParticleCollisions does, then each particle goes on along the
+// circular orbit through where it was left. Rings are that flat because collisions damp everything else, so the
+// orbits lose no more than they would.
+class RingParticles {
+
+public:
+    // orbits per sim second, at timeScaleRotation 1, at radius 1; Kepler's third law gives the rest
+    float TurnsPerSecondAtSurface = 1.0f;
+    float Cover = 0.5f;
+    SinCosPrecision Precision = SinCosPrecision::Medium;
+    // with Collisions, each update collides every particle over at most MaxCollisionStep since the last; a longer
+    // step widens the grid cells with the distance neighbours shear past each other, and the pairs with them
+    bool Collisions = false;
+    float MaxCollisionStep = 1.0f / 240.0f;
+    ParticleCollisions collisions;
+    // of the last update
+    size_t Placed = 0;
+
+    size_t size() const {
+        return orbitRadius.size();
+    }
+
+    // count particles covering about Cover of the ring where it's densest, and less elsewhere as ringDensity has
+    // it: the more particles, the smaller each one
+    void generate(int count, float turnsPerSecondAtSurface, unsigned int seed = 1) {
+        MemoryScope scope(MEMORY_RINGS);
+        TurnsPerSecondAtSurface = turnsPerSecondAtSurface;
+        count = std::max(count, 0);
+        resizeElements(count);
+        std::mt19937 random(seed);
+        const float inner2 = RING_INNER_RADIUS * RING_INNER_RADIUS, outer2 = RING_OUTER_RADIUS * RING_OUTER_RADIUS;
+        double sizes2 = 0.0;
+        for (int i = 0; i < count; ++i) {
+            // even over the ring's area, thinned out by its density
+            float r;
+            do r = std::sqrt(inner2 + uniform(random) * (outer2 - inner2));
+            while (uniform(random) > ringDensity(r));
+            float height = RING_THICKNESS * uniform(random) * uniform(random), node = uniform(random) * glm::two_pi<float>();
+            float size = 1.0f + 3.0f * uniform(random) * uniform(random) * uniform(random); // mostly small, a few large
+            sizes2 += size * size;
+            orbitRadius[i] = r;
+            angularSpeed[i] = keplerAngularSpeed(r);
+            phase[i] = uniform(random) * glm::two_pi<float>();
+            heightSin[i] = height * std::cos(node);
+            heightCos[i] = -height * std::sin(node);
+            particleRadius[i] = size;
+        }
+        // the ring's area weighted by its density, which the particles' cross sections are to cover Cover of
+        double area = 0.0;
+        const int STEPS = 1024;
+        for (int i = 0; i < STEPS; ++i) {
+            float r = RING_INNER_RADIUS + (RING_OUTER_RADIUS - RING_INNER_RADIUS) * (i + 0.5f) / STEPS;
+            area += ringDensity(r) * glm::two_pi<float>() * r * (RING_OUTER_RADIUS - RING_INNER_RADIUS) / STEPS;
+        }
+        float sizeScale = count > 0 ? (float)std::sqrt(Cover * area / (glm::pi<double>() * sizes2)) : 1.0f;
+        for (int i = 0; i < count; ++i) {
+            particleRadius[i] *= sizeScale;
+            mass[i] = particleRadius[i] * particleRadius[i] * particleRadius[i];
+        }
+
+        epoch = 0.0;
+        collisionTime = -1.0;
+        // no smaller than the smallest generated, or a ring this crowded grinds itself to dust within a few orbits
+        collisions.MinFragmentRadius = sizeScale;
+        // fragments add particles; a quarter more is room for a good many, though a ring left fragmenting for a
+        // while grows past it, if only a few times
+        for (std::vector<float>* element : { &orbitRadius, &angularSpeed, &phase, &heightSin, &heightCos, &particleRadius, &mass })
+            element->reserve(count + count / 4);
+    }
+
+    // starts update(time, count, out) on the pool, to run alongside whatever the caller does next; without a
+    // pool it runs here and now. Call wait() before reading out or touching the particles.
+    void updateAsync(double time, size_t count, float* out, ThreadPool* pool) {
+        if (!pool) {
+            update(time, count, out, nullptr);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            jobRunning = true;
+        }
+        jobTime = time;
+        jobCount = count;
+        jobOut = out;
+        jobPool = pool;
+        // just the pointer, which std::function keeps without allocating
+        pool->submit([this]() {
+            update(jobTime, jobCount, jobOut, jobPool);
+            {
+                std::lock_guard<std::mutex> lock(jobMutex);
+                jobRunning = false;
+            }
+            jobDone.notify_all();
+        });
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(jobMutex);
+        jobDone.wait(lock, [this]() { return !jobRunning; });
+    }
+
+    // With Collisions, collides every particle over the time since the last update. Then places the first count
+    // particles as they are at time, writing x, y, z and radius of each to out.
+    void update(double time, size_t count, float* out, ThreadPool* pool = nullptr) {
+        MemoryScope scope(MEMORY_RINGS);
+        // far from the epoch the angles would lose their precision in floats
+        if (std::abs(time - epoch) > 256.0)
+            rebase(time);
+        if (Collisions) {
+            double from = collisionTime < 0.0 ? time : std::max(collisionTime, time - std::min(MaxCollisionStep, maxCollisionStep()));
+            if (time > from)
+                collide(from, (float)(time - from), pool);
+            collisionTime = time;
+        }
+        count = std::min(count, size());
+        const size_t BLOCK = 1024;
+        auto place = [&](int begin, int end) {
+            float angles[BLOCK], sines[BLOCK], cosines[BLOCK];
+            float t = (float)(time - epoch);
+            for (size_t first = (size_t)begin * BLOCK; first < std::min(count, (size_t)end * BLOCK); first += BLOCK) {
+                size_t n = std::min(BLOCK, count - first);
+                const float* p = &phase[first];
+                const float* w = &angularSpeed[first];
+                for (size_t i = 0; i < n; ++i)
+                    angles[i] = p[i] + w[i] * t;
+                sinCos(angles, sines, cosines, n, Precision);
+                float* o = out + first * 4;
+                for (size_t i = 0; i < n; ++i) {
+                    size_t k = first + i;
+                    o[4 * i] = orbitRadius[k] * sines[i];
+                    o[4 * i + 1] = heightSin[k] * sines[i] + heightCos[k] * cosines[i];
+                    o[4 * i + 2] = orbitRadius[k] * cosines[i];
+                    o[4 * i + 3] = particleRadius[k];
+                }
+            }
+        };
+        int blocks = (int)((count + BLOCK - 1) / BLOCK);
+        if (pool) pool->parallelFor(blocks, place, 16);
+        else place(0, blocks);
+        Placed = count;
+    }
+
+private:
+    // per particle
+    std::vector<float> orbitRadius;
+    std::vector<float> angularSpeed; // radians per unit of time
+    std::vector<float> phase;        // angle at the epoch; 0 is +z, growing towards +x, as the planets' orbits
+    std::vector<float> heightSin;    // y is heightSin * sin(angle) + heightCos * cos(angle)
+    std::vector<float> heightCos;
+    std::vector<float> particleRadius;
+    std::vector<float> mass;
+
+    double epoch = 0.0;
+    double collisionTime = -1.0; // of the last update with Collisions; -1 before the first
+    CollisionParticles cartesian;
+
+    double jobTime = 0.0;
+    size_t jobCount = 0;
+    float* jobOut = nullptr;
+    ThreadPool* jobPool = nullptr;
+    bool jobRunning = false;
+    std::mutex jobMutex;
+    std::condition_variable jobDone;
+
+    void resizeElements(size_t count) {
+        for (std::vector<float>* element : { &orbitRadius, &angularSpeed, &phase, &heightSin, &heightCos, &particleRadius, &mass })
+            element->resize(count);
+    }
+
+    float keplerAngularSpeed(float radius) const {
+        return glm::two_pi<float>() * TurnsPerSecondAtSurface / (radius * std::sqrt(radius));
+    }
+
+    // the step over which neighbours a grid cell apart shear past each other by no more than half the cell
+    float maxCollisionStep() const {
+        return 1.0f / (3.0f * keplerAngularSpeed(RING_INNER_RADIUS));
+    }
+
+    void rebase(double time) {
+        for (size_t i = 0; i < size(); ++i)
+            phase[i] = (float)std::fmod(phase[i] + angularSpeed[i] * (time - epoch), 2.0 * glm::pi<double>());
+        epoch = time;
+    }
+
+    // collides the particles over [from, from + dt], then puts every one on the circular orbit through where it
+    // was left at from
+    void collide(double from, float dt, ThreadPool* pool) {
+        size_t count = size();
+        // made the first time, with the same room for fragments as the particles have
+        cartesian.reserve(orbitRadius.capacity());
+        cartesian.resize(count);
+        float t = (float)(from - epoch);
+        const size_t BLOCK = 1024;
+        float angles[BLOCK], sines[BLOCK], cosines[BLOCK];
+        float largestRadius = 0.0f;
+        for (size_t first = 0; first < count; first += BLOCK) {
+            size_t n = std::min(BLOCK, count - first);
+            for (size_t i = 0; i < n; ++i)
+                angles[i] = phase[first + i] + angularSpeed[first + i] * t;
+            sinCos(angles, sines, cosines, n, Precision);
+            for (size_t i = 0; i < n; ++i) {
+                size_t k = first + i;
+                float r = orbitRadius[k], w = angularSpeed[k], s = sines[i], c = cosines[i];
+                cartesian.x[k] = r * s;
+                cartesian.y[k] = heightSin[k] * s + heightCos[k] * c;
+                cartesian.z[k] = r * c;
+                cartesian.vx[k] = w * r * c;
+                cartesian.vy[k] = w * (heightSin[k] * c - heightCos[k] * s);
+                cartesian.vz[k] = -w * r * s;
+                cartesian.radius[k] = particleRadius[k];
+                cartesian.mass[k] = mass[k];
+                largestRadius = std::max(largestRadius, particleRadius[k]);
+            }
+        }
+
+        // how fast neighbours can close in: up and down through the ring, and the orbits shearing past each other,
+        // at up to the fastest orbit's angular speed times their distance, which is at most the reach itself;
+        // solved for reach = 2 * largest radius + closing speed * dt
+        float fastest = keplerAngularSpeed(RING_INNER_RADIUS), vertical = 2.0f * fastest * RING_THICKNESS, shear = 1.5f * fastest;
+        float reach = (2.0f * largestRadius + vertical * dt) / (1.0f - shear * dt);
+        collisions.RelativeSpeedLimit = vertical + shear * reach;
+        // a crowded ring has a contact for every few particles each step
+        collisions.reserveContacts(count / 2);
+        collisions.collide(cartesian, dt, pool);
+
+        // merges and fragments change the particles; every one is rebuilt from where it is now
+        count = cartesian.size();
+        resizeElements(count);
+        for (size_t k = 0; k < count; ++k) {
+            float x = cartesian.x[k], y = cartesian.y[k], z = cartesian.z[k];
+            float r = std::max(std::sqrt(x * x + z * z), 1e-3f);
+            float w = keplerAngularSpeed(r), angle = std::atan2(x, z);
+            float s = x / r, c = z / r, verticalSpeed = cartesian.vy[k] / w;
+            orbitRadius[k] = r;
+            angularSpeed[k] = w;
+            phase[k] = angle - w * t;
+            float hs = y * s + verticalSpeed * c, hc = y * c - verticalSpeed * s;
+            // the in-plane part of every knock is lost to the circular orbit, so the damping that keeps real rings
+            // thin never gets to work on the rest; the ring is held to its thickness instead
+            float height = std::sqrt(hs * hs + hc * hc), keep = height > RING_THICKNESS ? RING_THICKNESS / height : 1.0f;
+            heightSin[k] = hs * keep;
+            heightCos[k] = hc * keep;
+            particleRadius[k] = cartesian.radius[k];
+            mass[k] = cartesian.mass[k];
+        }
+    }
+};
+
+#endif // !RING_PARTICLES_H
@@ -0,0 +1,232 @@
+#pragma once
+#ifndef SATURN_RINGS_H
+#define SATURN_RINGS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "RingParticles.h"
+#include "Shader.h"
+#include "MemoryLedger.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+const int SATURN = 4; // index into SOLAR_SYSTEM_PLANETS
+// where an orbit keeps pace with Saturn's spin, in Saturn radii
+const float RING_SYNCHRONOUS_RADIUS = 1.86f;
+
+// Draws Saturn's rings as RingParticles, one point sprite each, shaded as a little sphere. Every frame the
+// particles are placed on the pool, straight into a mapped stream buffer, while the rest of the scene is drawn.
+// How many are placed follows the ring's size on screen: about ParticlesPerPixel for each pixel it covers, drawn
+// larger the fewer there are so the ring stays as full. Under AnnulusPixels across its outer radius nothing is
+// placed or uploaded at all: the ring is one textured annulus, with the ring's density as its opacity. Collisions,
+// if on, pause with it; they'd cost every particle every frame for a ring a few dozen pixels across.
+class SaturnRings {
+
+public:
+    float AnnulusPixels = 64.0f;
+    float ParticlesPerPixel = 1.0f;
+    RingParticles particles;
+
+    // of the last frame
+    size_t ParticlesDrawn = 0;
+    bool DrewAnnulus = false;
+    int DrawCalls = 0;
+
+    // count particles on orbits that keep pace with Saturn's spin, in turns per sim second at timeScaleRotation 1,
+    // at RING_SYNCHRONOUS_RADIUS
+    bool create(int count, float spin) {
+        MemoryScope scope(MEMORY_RINGS);
+        particles.generate(count, spin * std::pow(RING_SYNCHRONOUS_RADIUS, 1.5f));
+        capacity = std::max<size_t>(particles.size(), 1);
+
+        glBindVertexArray(0);
+        glGenBuffers(1, &particleBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, particleBuffer);
+        glBufferData(GL_ARRAY_BUFFER, capacity * PARTICLE_BYTES, nullptr, GL_STREAM_DRAW);
+        gpuMemory().record(GPU_BUFFER, particleBuffer, MEMORY_RINGS, "ring particles", capacity * PARTICLE_BYTES);
+        glGenVertexArrays(1, &particleVertexArray);
+        glBindVertexArray(particleVertexArray);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, PARTICLE_BYTES, (void*)0);
+        glEnableVertexAttribArray(0);
+
+        // inner and outer edge in turn, all the way round, in Saturn radii
+        std::vector<float> strip;
+        for (int i = 0; i <= ANNULUS_SEGMENTS; ++i) {
+            float angle = glm::two_pi<float>() * i / ANNULUS_SEGMENTS;
+            for (float radius : { RING_INNER_RADIUS, RING_OUTER_RADIUS }) {
+                strip.push_back(radius * std::sin(angle));
+                strip.push_back(radius * std::cos(angle));
+            }
+        }
+        glGenBuffers(1, &annulusBuffer);
+        glGenVertexArrays(1, &annulusVertexArray);
+        glBindVertexArray(annulusVertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, annulusBuffer);
+        glBufferData(GL_ARRAY_BUFFER, strip.size() * sizeof(float), strip.data(), GL_STATIC_DRAW);
+        gpuMemory().record(GPU_BUFFER, annulusBuffer, MEMORY_RINGS, "ring annulus", strip.size() * sizeof(float));
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // the rings' color and density from the inner edge to the outer
+        std::vector<unsigned char> profile(PROFILE_TEXELS * 4);
+        for (int i = 0; i < PROFILE_TEXELS; ++i) {
+            float radius = RING_INNER_RADIUS + (RING_OUTER_RADIUS - RING_INNER_RADIUS) * (i + 0.5f) / PROFILE_TEXELS;
+            float density = ringDensity(radius);
+            profile[4 * i] = (unsigned char)(210 + 30 * density);
+            profile[4 * i + 1] = (unsigned char)(180 + 30 * density);
+            profile[4 * i + 2] = (unsigned char)(140 + 20 * density);
+            profile[4 * i + 3] = (unsigned char)(255 * std::min(1.0f, 1.2f * density));
+        }
+        glGenTextures(1, &profileTexture);
+        glBindTexture(GL_TEXTURE_2D, profileTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, PROFILE_TEXELS, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, profile.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        gpuMemory().record(GPU_TEXTURE, profileTexture, MEMORY_RINGS, "ring profile", estimateTextureBytes(PROFILE_TEXELS, 1, 4, false));
+
+        particleShader.reset(new Shader("ring_particle.vs", "ring_particle.fs"));
+        annulusShader.reset(new Shader("ring_annulus.vs", "ring_annulus.fs"));
+        annulusShader->use();
+        annulusShader->setInt("profile", 0);
+        annulusShader->setVec2("radii", RING_INNER_RADIUS, RING_OUTER_RADIUS);
+        return true;
+    }
+
+    // Chooses between particles and annulus for the ring around center, scale world units to a Saturn radius, and
+    // for particles maps the stream buffer and starts placing them for rotationTime (sim seconds times
+    // timeScaleRotation) on the pool. Everything up to render() runs alongside; render() waits for them.
+    void beginFrame(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& center, float scale, double rotationTime, ThreadPool* pool) {
+        this->center = center;
+        this->scale = scale;
+        ParticlesDrawn = 0;
+        mapped = nullptr;
+        if (!particleShader) return;
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        pixelsPerUnit = projection[1][1] * viewport[3] * 0.5f;
+        // the outer edge as seen from its nearest point; from inside the ring that is everything
+        float outer = RING_OUTER_RADIUS * scale;
+        float distance = glm::length(glm::vec3(view * glm::vec4(center, 1.0f)));
+        float pixels = distance > outer + 1e-3f ? outer * pixelsPerUnit / (distance - outer) : 3.4e38f;
+        DrewAnnulus = pixels < AnnulusPixels || particles.size() == 0;
+        if (DrewAnnulus) return;
+
+        double budget = ParticlesPerPixel * glm::pi<double>() * (double)pixels * pixels;
+        // fragments can outnumber what the buffer was made for; the first capacity are as even a sample as any
+        size_t count = (size_t)std::min<double>((double)std::min(particles.size(), capacity), budget);
+        glBindBuffer(GL_ARRAY_BUFFER, particleBuffer);
+        // orphaned, so placing this frame's never waits for last frame's draw
+        glBufferData(GL_ARRAY_BUFFER, capacity * PARTICLE_BYTES, nullptr, GL_STREAM_DRAW);
+        mapped = static_cast<float*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, std::max<size_t>(count, 1) * PARTICLE_BYTES, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (!mapped) {
+            DrewAnnulus = true;
+            return;
+        }
+        particles.updateAsync(rotationTime, count, mapped, pool);
+        ParticlesDrawn = count;
+    }
+
+    // draws what beginFrame chose into the bound framebuffer, after the opaque bodies
+    void render(const glm::mat4& view, const glm::mat4& projection) {
+        DrawCalls = 0;
+        if (!particleShader) return;
+        glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), center), glm::vec3(scale));
+
+        if (!DrewAnnulus) {
+            particles.wait();
+            // merges can leave fewer particles than were asked for
+            ParticlesDrawn = particles.Placed;
+            glBindBuffer(GL_ARRAY_BUFFER, particleBuffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            mapped = nullptr;
+            glEnable(GL_DEPTH_TEST);
+            glEnable(GL_PROGRAM_POINT_SIZE);
+            particleShader->use();
+            particleShader->setMat4("projection", projection);
+            particleShader->setMat4("view", view);
+            particleShader->setMat4("model", model);
+            particleShader->setFloat("pixelsPerUnit", pixelsPerUnit);
+            // fewer particles cover as much ring by being bigger
+            particleShader->setFloat("sizeScale", scale * std::sqrt((float)particles.size() / std::max<size_t>(ParticlesDrawn, 1)));
+            glBindVertexArray(particleVertexArray);
+            glDrawArrays(GL_POINTS, 0, (GLsizei)ParticlesDrawn);
+            glBindVertexArray(0);
+            glDisable(GL_PROGRAM_POINT_SIZE);
+            ++DrawCalls;
+            return;
+        }
+
+        // see-through: blended over what's behind, and hiding nothing drawn after
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+        annulusShader->use();
+        annulusShader->setMat4("projection", projection);
+        annulusShader->setMat4("view", view);
+        annulusShader->setMat4("model", model);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, profileTexture);
+        glBindVertexArray(annulusVertexArray);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 2 * (ANNULUS_SEGMENTS + 1));
+        glBindVertexArray(0);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+        ++DrawCalls;
+    }
+
+    void DeleteBuffers() {
+        if (!particleShader) return;
+        if (mapped) {
+            particles.wait();
+            glBindBuffer(GL_ARRAY_BUFFER, particleBuffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            mapped = nullptr;
+        }
+        glDeleteProgram(particleShader->ID);
+        glDeleteProgram(annulusShader->ID);
+        particleShader.reset();
+        annulusShader.reset();
+        glDeleteTextures(1, &profileTexture);
+        gpuMemory().release(GPU_TEXTURE, profileTexture);
+        glDeleteVertexArrays(1, &particleVertexArray);
+        glDeleteVertexArrays(1, &annulusVertexArray);
+        GLuint buffers[] = { particleBuffer, annulusBuffer };
+        glDeleteBuffers(2, buffers);
+        gpuMemory().release(GPU_BUFFER, 2, buffers);
+    }
+
+private:
+    static const GLsizei PARTICLE_BYTES = 16; // x, y, z, radius, as RingParticles::update writes them
+    static const int ANNULUS_SEGMENTS = 128;
+    static const int PROFILE_TEXELS = 256;
+
+    size_t capacity = 1;
+    glm::vec3 center = glm::vec3(0.0f);
+    float scale = 1.0f;
+    float pixelsPerUnit = 1.0f;
+    float* mapped = nullptr; // the stream buffer, while the pool places particles into it
+
+    std::unique_ptr<Shader> particleShader, annulusShader;
+    GLuint particleBuffer = 0, annulusBuffer = 0;
+    GLuint particleVertexArray = 0, annulusVertexArray = 0;
+    GLuint profileTexture = 0;
+};
+
+#endif // !SATURN_RINGS_H
@@ -0,0 +1,338 @@
+#pragma once
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Camera.h"
+#include "Sphere.h"
+#include "Texture.h"
+#include "Planet.h"
+#include "Moons.h"
+#include "TransformHierarchy.h"
+#include "RenderBackend.h"
+#include "RenderBackendGL33.h"
+#include "RenderBackendGL45.h"
+#include "MeshBuffer.h"
+#include "AsteroidBelt.h"
+#include "ImpactFragments.h"
+#include "AsteroidCuller.h"
+#include "OcclusionCuller.h"
+#include "SaturnRings.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Everything the scene loads from disk or generates on the CPU. Decoded once and shared read-only by any
+// number of scenes, e.g. one per GL context in batch rendering.
+struct SceneAssets {
+    TextureImage sunImage;
+    std::vector<TextureImage> planetImages;
+    SphereMesh sphereMesh;
+    std::vector<SphereMesh> asteroidShapes;
+    std::vector<std::vector<SphereMesh>> asteroidLodShapes; // for GPU culling
+
+    SceneAssets() : sunImage(SUN_TEXTURE), asteroidShapes(AsteroidBelt::generateShapes()), asteroidLodShapes(AsteroidCuller::generateLodShapes()) {
+        MemoryScope scope(MEMORY_TEXTURES);
+        for (int i = 0; i < PLANET_COUNT; ++i)
+            planetImages.emplace_back(PLANET_TEXTURES[i]);
+    }
+
+    // frees the decoded images and meshes once every scene that needs them has been created (and enableGpuCulling
+    // called); the GPU has its own copies
+    void release() {
+        sunImage = TextureImage();
+        std::vector<TextureImage>().swap(planetImages);
+        std::vector<float>().swap(sphereMesh.vertices);
+        std::vector<unsigned int>().swap(sphereMesh.indices);
+        std::vector<SphereMesh>().swap(asteroidShapes);
+        std::vector<std::vector<SphereMesh>>().swap(asteroidLodShapes);
+    }
+};
+
+// gl45 needs a GL 4.5 context and falls back to gl33 on anything older. loader is the one glad was loaded with,
+// for extension entry points glad doesn't know.
+inline std::unique_ptr<RenderBackend> createRenderBackend(RenderBackendType type, GLADloadproc loader = nullptr)
+{
+    MemoryScope scope(MEMORY_RENDERER);
+    if (type == BACKEND_GL45) {
+        if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 5))
+            return std::unique_ptr<RenderBackend>(new RenderBackendGL45(loader));
+        std::cout << "ERROR::RENDER_BACKEND::GL45_UNAVAILABLE: context is GL " << GLVersion.major << "." << GLVersion.minor << ", drawing with gl33" << std::endl;
+    }
+    return std::unique_ptr<RenderBackend>(new RenderBackendGL33());
+}
+
+// The sun and planets with everything needed to draw them. Shared by the windowed and headless paths so both
+// run the same sim and render code; the caller owns the GL context and the framebuffer being drawn into.
+class Scene {
+
+public:
+    // sim settings, edited by the ui
+    float planetScale = 1.0f;
+    float timeScaleDaysPerSecond = 1.0f;
+    float timeScaleRotation = 1.0f;
+
+    std::unique_ptr<RenderBackend> backend;
+    std::vector<Planet> planets;
+    std::vector<Moon> moons; // none unless set with setMoons
+    AsteroidBelt asteroidBelt; // empty unless generated
+    ImpactFragments impactFragments; // empty unless spawned with spawnImpact
+    std::vector<glm::mat4> models; // sun, then planets, then moons; refilled every frame
+    // the sun; under it each planet's orbit position, with the planet's spinning body and its moons under that
+    TransformHierarchy transforms;
+    std::unique_ptr<AsteroidCuller> asteroidCuller; // set by enableGpuCulling
+    std::unique_ptr<OcclusionCuller> occlusionCuller; // set by enableOcclusionCulling
+    std::unique_ptr<SaturnRings> saturnRings; // set by enableRings
+    ThreadPool* pool = nullptr; // shares out the belt's sorts and places the ring particles, if set
+
+    Scene() : Scene(SceneAssets()) {}
+
+    explicit Scene(const SceneAssets& assets, RenderBackendType backendType = BACKEND_GL33, GLADloadproc loader = nullptr)
+        : backend(createRenderBackend(backendType, loader)) {
+        MemoryScope scope(MEMORY_SCENE);
+        ProgramDesc programDesc = { "shader.vs", "shader.fs", "shader_mdi.vs", "shader_mdi.fs" };
+        MeshBuffer meshes;
+        sphereMesh = meshes.add(assets.sphereMesh.vertices, assets.sphereMesh.indices);
+        for (const SphereMesh& shape : assets.asteroidShapes)
+            asteroidMeshes.push_back(meshes.add(shape.vertices, shape.indices));
+        meshPipeline = meshes.createPipeline(*backend, backend->createProgram(programDesc));
+
+        sunTexture = backend->createTexture(assets.sunImage);
+        planets.assign(SOLAR_SYSTEM_PLANETS, SOLAR_SYSTEM_PLANETS + PLANET_COUNT);
+        for (int i = 0; i < PLANET_COUNT; ++i)
+            planets[i].textureID = backend->createTexture(assets.planetImages[i]);
+        buildTransforms();
+    }
+
+    void setMoons(const std::vector<Moon>& catalogue) {
+        MemoryScope scope(MEMORY_SCENE);
+        moons = catalogue;
+        buildTransforms();
+    }
+
+    // moves, culls and draws the asteroids on the GPU from now on instead of the backend; call after generating the belt
+    bool enableGpuCulling(const SceneAssets& assets) {
+        MemoryScope scope(MEMORY_ASTEROIDS);
+        asteroidCuller.reset(new AsteroidCuller());
+        if (!asteroidCuller->create(asteroidBelt, assets.asteroidLodShapes, assets.planetImages.back())) {
+            asteroidCuller->DeleteBuffers();
+            asteroidCuller.reset();
+            return false;
+        }
+        return true;
+    }
+
+    // skips the bodies hidden behind the sun or a planet from now on
+    bool enableOcclusionCulling() {
+        MemoryScope scope(MEMORY_RENDERER);
+        occlusionCuller.reset(new OcclusionCuller());
+        return occlusionCuller->create();
+    }
+
+    // gives Saturn a ring of count particles from now on
+    bool enableRings(int count) {
+        MemoryScope scope(MEMORY_RINGS);
+        saturnRings.reset(new SaturnRings());
+        return saturnRings->create(count, planets[SATURN].rotationSpeed);
+    }
+
+    // room for a steady stream of perFrame impact fragments every frameSeconds, and for drawing them, so that
+    // spawnImpact and render never have to grow anything for them
+    void reserveImpactFragments(int perFrame, float frameSeconds) {
+        MemoryScope scope(MEMORY_SCENE);
+        impactFragments.reserve(perFrame, frameSeconds);
+        draws.reserve(bodyNodes.size() + asteroidBelt.asteroids.size() + impactFragments.fragments.capacity());
+    }
+
+    // count fragments thrown off the sun-facing side of planet, as it is simTime seconds into the simulation
+    void spawnImpact(int planet, int count, double simTime) {
+        if (planet < 0 || planet >= (int)planets.size() || count <= 0) return;
+        MemoryScope scope(MEMORY_SCENE);
+        glm::vec3 center = planetOrbitPosition(planets[planet], simTime / timeScaleDaysPerSecond);
+        impactFragments.spawn(center, planets[planet].scale * planetScale, -glm::normalize(center), count, simTime);
+    }
+
+    // of the last render
+    int drawCalls() const {
+        return backend->DrawCalls + (asteroidCuller ? asteroidCuller->DrawCalls : 0) + (saturnRings ? saturnRings->DrawCalls : 0);
+    }
+
+    static constexpr float Z_NEAR = 0.1f;
+    static constexpr float Z_FAR = 100.0f;
+
+    static glm::mat4 projectionMatrix(const Camera& camera, float aspect) {
+        return glm::perspective(glm::radians(camera.Zoom), aspect, Z_NEAR, Z_FAR);
+    }
+
+    // the off-axis part [left, right] x [bottom, top] of projectionMatrix's frustum, in 0..1 across the image with
+    // y up, for rendering an image larger than a framebuffer in tiles
+    static glm::mat4 tileProjectionMatrix(const Camera& camera, float aspect, float left, float bottom, float right, float top) {
+        float halfHeight = Z_NEAR * std::tan(glm::radians(camera.Zoom) * 0.5f);
+        float halfWidth = halfHeight * aspect;
+        return glm::frustum(-halfWidth + 2.0f * halfWidth * left, -halfWidth + 2.0f * halfWidth * right,
+                            -halfHeight + 2.0f * halfHeight * bottom, -halfHeight + 2.0f * halfHeight * top, Z_NEAR, Z_FAR);
+    }
+
+    // clears the bound framebuffer and draws the scene as it is simTime seconds into the simulation
+    void render(const glm::mat4& view, const glm::mat4& projection, double simTime) {
+        MemoryScope scope(MEMORY_SCENE);
+        backend->clear(glm::vec4(0.01f, 0.01f, 0.01f, 1.0f));
+
+        updateTransforms(simTime);
+        impactFragments.expire(simTime);
+
+        if (occlusionCuller)
+            occlusionCuller->beginFrame(view, projection, models);
+        // the ring particles are placed on the pool while everything else is drawn
+        if (saturnRings) {
+            glm::vec3 saturn = planetOrbitPosition(planets[SATURN], simTime / timeScaleDaysPerSecond);
+            saturnRings->beginFrame(view, projection, saturn, planets[SATURN].scale * planetScale, simTime * timeScaleRotation, pool);
+        }
+
+        // every mesh comes from the same buffers, so one submit takes them all; the moons, asteroids and fragments
+        // wear the texture of Mercury, drawn last of the planets, so a multi-draw backend adds no calls for them
+        // however many shapes there are. Bodies the occlusion culler tests go after the rest, so their proxies can be
+        // drawn in between.
+        size_t asteroidCount = asteroidCuller ? 0 : asteroidBelt.asteroids.size();
+        size_t fragmentCount = impactFragments.fragments.size();
+        draws.resize(models.size() + asteroidCount + fragmentCount);
+        size_t placed = 0, occluders = 0;
+        for (int conditional = 0; conditional < 2; ++conditional) {
+            for (size_t i = 0; i < models.size(); ++i) {
+                bool tested = occlusionCuller && occlusionCuller->isTested(i);
+                if (tested != (conditional != 0)) continue;
+                setDraw(draws[placed], models[i], bodyTexture(i), sphereMesh);
+                draws[placed++].occlusionQuery = tested ? occlusionCuller->query(i) : 0;
+            }
+            if (!conditional) occluders = placed;
+        }
+        if (asteroidCount > 0) {
+            // the belt writes its matrices straight into the draws
+            DrawItem* asteroidDraws = draws.data() + models.size();
+            asteroidBelt.updateOrder(pool);
+            asteroidBelt.modelMatrices(simTime, timeScaleDaysPerSecond, timeScaleRotation, planetScale, &asteroidDraws[0].model[0][0], sizeof(DrawItem) / sizeof(float));
+            TextureHandle asteroidTexture = planets.back().textureID;
+            size_t first = 0;
+            asteroidBelt.asteroids.eachChunk<BodyShape>([&](size_t rows, const Entity*, const BodyShape* shapes) {
+                for (size_t i = 0; i < rows; ++i)
+                    setDraw(asteroidDraws[first + i], asteroidTexture, asteroidMeshes[shapes[i].mesh]);
+                first += rows;
+            });
+        }
+        if (fragmentCount > 0) {
+            DrawItem* fragmentDraws = draws.data() + models.size() + asteroidCount;
+            impactFragments.modelMatrices(simTime, &fragmentDraws[0].model[0][0], sizeof(DrawItem) / sizeof(float));
+            TextureHandle fragmentTexture = planets.back().textureID;
+            size_t i = 0;
+            for (int s = 0; s < AsteroidBelt::SHAPE_COUNT; ++s)
+                for (size_t n = 0; n < impactFragments.ShapeCounts[s]; ++n)
+                    setDraw(fragmentDraws[i++], fragmentTexture, asteroidMeshes[s]);
+        }
+        if (occlusionCuller) {
+            backend->submit(meshPipeline, view, projection, draws.data(), occluders);
+            occlusionCuller->drawProxies(view, projection, models);
+            backend->submit(meshPipeline, view, projection, draws.data() + occluders, draws.size() - occluders);
+        }
+        else {
+            backend->submit(meshPipeline, view, projection, draws.data(), draws.size());
+        }
+        if (asteroidCuller)
+            asteroidCuller->render(view, projection, simTime, timeScaleDaysPerSecond, timeScaleRotation, planetScale);
+        if (saturnRings)
+            saturnRings->render(view, projection);
+    }
+
+    void DeleteBuffers() {
+        if (asteroidCuller) asteroidCuller->DeleteBuffers();
+        if (saturnRings) saturnRings->DeleteBuffers();
+        if (occlusionCuller) occlusionCuller->DeleteBuffers();
+        backend->destroy();
+    }
+
+private:
+    PipelineHandle meshPipeline;
+    MeshRange sphereMesh;
+    std::vector<MeshRange> asteroidMeshes; // by AsteroidBelt shape
+    TextureHandle sunTexture;
+    std::vector<int> bodyNodes; // the transforms node of each of models
+    std::vector<int> planetOrbitNodes;
+    // what the transforms were last set for; rendering the same moment again (poster tiles, a paused sim) only
+    // runs the update, which finds nothing dirty
+    bool transformsSet = false;
+    double transformsTime = 0.0;
+    glm::vec3 transformsScales;
+    std::vector<DrawItem> draws; // refilled every frame
+
+    TextureHandle bodyTexture(size_t body) const {
+        if (body == 0) return sunTexture;
+        return body <= planets.size() ? planets[body - 1].textureID : planets.back().textureID;
+    }
+
+    void buildTransforms() {
+        transforms.clear();
+        bodyNodes.clear();
+        planetOrbitNodes.clear();
+        int sun = transforms.add(-1);
+        bodyNodes.push_back(sun);
+        for (size_t i = 0; i < planets.size(); ++i) {
+            planetOrbitNodes.push_back(transforms.add(sun));
+            bodyNodes.push_back(transforms.add(planetOrbitNodes.back()));
+        }
+        for (const Moon& moon : moons)
+            bodyNodes.push_back(transforms.add(planetOrbitNodes[moon.planet]));
+        transformsSet = false;
+    }
+
+    // the same orbits and spins as bodyModelMatrices, moons riding along with their planets
+    void updateTransforms(double simTime) {
+        glm::vec3 scales(timeScaleDaysPerSecond, timeScaleRotation, planetScale);
+        if (!transformsSet || simTime != transformsTime || scales != transformsScales) {
+            double simTimeInDays = simTime / timeScaleDaysPerSecond;
+            const glm::quat identity(1.0f, 0.0f, 0.0f, 0.0f);
+            for (size_t i = 0; i < planets.size(); ++i) {
+                const Planet& planet = planets[i];
+                // the spin as a quaternion around y: cos and sin of half the angle
+                float s, c;
+                sinCos(0.5f * planetRotationAngle(planet, simTime, timeScaleRotation), s, c);
+                transforms.setLocal(planetOrbitNodes[i], planetOrbitPosition(planet, simTimeInDays), identity, 1.0f);
+                transforms.setLocal(bodyNodes[i + 1], glm::vec3(0.0f), glm::quat(c, 0.0f, s, 0.0f), planet.scale * planetScale);
+            }
+            glm::vec3 position;
+            glm::quat rotation;
+            float scale;
+            for (size_t i = 0; i < moons.size(); ++i) {
+                moonLocalTransform(moons[i], simTimeInDays, planetScale, position, rotation, scale);
+                transforms.setLocal(bodyNodes[1 + planets.size() + i], position, rotation, scale);
+            }
+            transformsSet = true;
+            transformsTime = simTime;
+            transformsScales = scales;
+        }
+        transforms.update();
+        models.resize(bodyNodes.size());
+        for (size_t i = 0; i < bodyNodes.size(); ++i)
+            models[i] = transforms.world(bodyNodes[i]);
+    }
+
+    static void setDraw(DrawItem& draw, const glm::mat4& model, TextureHandle texture, const MeshRange& mesh) {
+        draw.model = model;
+        setDraw(draw, texture, mesh);
+    }
+
+    // all but the model matrix
+    static void setDraw(DrawItem& draw, TextureHandle texture, const MeshRange& mesh) {
+        draw.texture = texture;
+        draw.firstIndex = mesh.firstIndex;
+        draw.indexCount = mesh.indexCount;
+        draw.baseVertex = mesh.baseVertex;
+        draw.occlusionQuery = 0;
+    }
+};
+
+#endif // !SCENE_H
@@ -0,0 +1,171 @@
+#pragma once
+#ifndef SCREENSHOT_H
+#define SCREENSHOT_H
+
+#include <glad/glad.h>
+
+#include "Framebuffer.h"
+#include "PixelReadback.h"
+#include "ImageWriter.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Screenshots at 1-4x the window resolution without stalling a frame. The frame that takes one renders the
+// scene a second time into an offscreen framebuffer and queues an asynchronous readback; a later frame picks
+// the pixels up once the GPU is done and a worker thread encodes the PNG.
+class ScreenshotCapture {
+
+public:
+    int Scale = 1;
+    std::string OutputDirectory = ".";
+
+    // stats of the last finished capture
+    int CaptureCount = 0;
+    std::string LastPath;
+    int LastWidth = 0;
+    int LastHeight = 0;
+    double LastReadbackMs = 0.0; // capture frame to pixels in memory
+    double LastEncodeMs = 0.0;
+    double LastTotalMs = 0.0;    // capture frame to file written
+    size_t LastFileBytes = 0;
+
+    ~ScreenshotCapture() {
+        if (pool) pool->wait();
+    }
+
+    void request() {
+        requested = true;
+    }
+
+    // a capture is being read back or encoded
+    bool busy() const {
+        return readback.pending() > 0 || encoding;
+    }
+
+    // binds the capture framebuffer, sized for the given window, if a capture is due this frame; render the scene
+    // and call end() when it returns true
+    bool begin(int windowWidth, int windowHeight) {
+        if (!requested || busy() || windowWidth <= 0 || windowHeight <= 0)
+            return false;
+        requested = false;
+        if (!pool)
+            pool.reset(new ThreadPool());
+
+        GLint maxTextureSize = 0, maxRenderbufferSize = 0, maxViewport[2] = { 0, 0 };
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+        glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxRenderbufferSize);
+        glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewport);
+        int maxSize = std::min({ maxTextureSize, maxRenderbufferSize, maxViewport[0], maxViewport[1] });
+        int scale = std::max(1, std::min(Scale, 4));
+        while (scale > 1 && std::max(windowWidth, windowHeight) * scale > maxSize)
+            --scale;
+        int width = windowWidth * scale, height = windowHeight * scale;
+
+        if (framebuffer.width != width || framebuffer.height != height) {
+            if (!framebuffer.create(width, height))
+                return false;
+            readback.create(width, height, 1);
+            // kept for every capture of this size; not touched again until the last one's PNG is written
+            pixels.resize(readback.frameBytes());
+        }
+        captureStart = std::chrono::steady_clock::now();
+        framebuffer.bind();
+        return true;
+    }
+
+    // queues the readback and goes back to drawing into the window
+    void end(int windowWidth, int windowHeight) {
+        readback.start(framebuffer.FBO);
+        glFlush();
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, windowWidth, windowHeight);
+    }
+
+    // call once per frame: hands a finished readback to the encoder and publishes finished captures, never waiting
+    void poll() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (finished) {
+                CaptureCount++;
+                LastPath = finished->path;
+                LastWidth = finished->width;
+                LastHeight = finished->height;
+                LastReadbackMs = finished->readbackMs;
+                LastEncodeMs = finished->encodeMs;
+                LastTotalMs = finished->totalMs;
+                LastFileBytes = finished->fileBytes;
+                finished.reset();
+                encoding = false;
+            }
+        }
+        // the fence is tested first, so the frames in between cost nothing
+        if (!readback.ready())
+            return;
+        if (!readback.collect(pixels.data(), false)) {
+            std::cout << "ERROR::SCREENSHOT::READBACK_FAILED: the capture couldn't be read back" << std::endl;
+            return;
+        }
+
+        auto start = captureStart;
+        double readbackMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        int width = readback.width, height = readback.height;
+        std::string path = OutputDirectory + "/screenshot_" + std::to_string((long long)std::time(nullptr)) + "_" + std::to_string(CaptureCount) + ".png";
+        encoding = true;
+        pool->submit([this, width, height, path, start, readbackMs]() {
+            auto encodeStart = std::chrono::steady_clock::now();
+            PngWriter png;
+            bool written = png.open(path, width, height, 4);
+            if (written) {
+                const std::ptrdiff_t rowBytes = (std::ptrdiff_t)width * 4;
+                png.writeRows(pixels.data() + (height - 1) * rowBytes, -rowBytes, height, pool.get());
+                written = png.close();
+            }
+            auto done = std::chrono::steady_clock::now();
+            std::unique_ptr<Result> result(new Result());
+            result->path = written ? path : "(failed) " + path;
+            result->width = width;
+            result->height = height;
+            result->readbackMs = readbackMs;
+            result->encodeMs = std::chrono::duration<double, std::milli>(done - encodeStart).count();
+            result->totalMs = std::chrono::duration<double, std::milli>(done - start).count();
+            result->fileBytes = written ? png.fileSize() : 0;
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = std::move(result);
+        });
+    }
+
+    // call with the GL context current; waits for a PNG that is still being encoded
+    void DeleteBuffers() {
+        if (pool) pool->wait();
+        readback.DeleteBuffers();
+        framebuffer.DeleteBuffers();
+    }
+
+private:
+    struct Result {
+        std::string path;
+        int width, height;
+        double readbackMs, encodeMs, totalMs;
+        size_t fileBytes;
+    };
+
+    Framebuffer framebuffer;
+    PixelReadback readback;
+    std::vector<unsigned char> pixels; // the capture being encoded
+    std::unique_ptr<ThreadPool> pool; // created with the first capture
+    std::mutex mutex;
+    std::unique_ptr<Result> finished;
+    bool requested = false;
+    bool encoding = false;
+    std::chrono::steady_clock::time_point captureStart;
+};
+
+#endif // !SCREENSHOT_H
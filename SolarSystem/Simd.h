@@ -0,0 +1,164 @@
+#pragma once
+#ifndef SIMD_H
+#define SIMD_H
+
+// SSE2 is always there on x64 and on x86 builds with /arch:SSE2, NEON on 64-bit ARM; other targets get the plain
+// C++ versions.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOLAR_HAS_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#define SOLAR_HAS_NEON 1
+#include <arm_neon.h>
+#include <cstdint>
+#else
+#include <cmath>
+#endif
+
+// Wider kernels are compiled on every x86 target and picked at run time with cpuHasAvx2(), so one binary still
+// runs on CPUs without them. SOLAR_TARGET_AVX2 marks a function that may use AVX2 and FMA instructions.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SOLAR_HAS_AVX2_KERNELS 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define SOLAR_TARGET_AVX2
+#else
+#define SOLAR_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+// AVX2 and FMA on the CPU, with the OS saving the YMM registers
+inline bool cpuHasAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    bool fma = (info[2] & (1 << 12)) != 0, osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+    if (!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+// Four floats processed together. Comparisons return a 4-bit lane mask (bit i = lane i).
+struct Float4 {
+#ifdef SOLAR_HAS_SSE2
+    __m128 v;
+
+    Float4() : v(_mm_setzero_ps()) {}
+    Float4(float x) : v(_mm_set1_ps(x)) {}
+    Float4(__m128 x) : v(x) {}
+    Float4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+
+    float operator[](int i) const {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, v);
+        return lanes[i];
+    }
+    static Float4 load(const float* in) { return _mm_loadu_ps(in); }
+    void store(float* out) const { _mm_storeu_ps(out, v); }
+    void storeTruncated(int* out) const { _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_cvttps_epi32(v)); }
+
+    friend Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+    friend Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+    friend Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+    friend Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+    friend Float4 min(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+    friend Float4 max(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+    // for values within int range
+    friend Float4 floor(Float4 a) {
+        __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+        return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a.v), _mm_set1_ps(1.0f)));
+    }
+    friend Float4 sqrt(Float4 a) { return _mm_sqrt_ps(a.v); }
+    friend Float4 abs(Float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+    // lanes of a where mask has their bit set, of b elsewhere
+    friend Float4 select(int mask, Float4 a, Float4 b) {
+        __m128 lanes = _mm_castsi128_ps(_mm_setr_epi32(-(mask & 1), -((mask >> 1) & 1), -((mask >> 2) & 1), -((mask >> 3) & 1)));
+        return _mm_or_ps(_mm_and_ps(lanes, a.v), _mm_andnot_ps(lanes, b.v));
+    }
+    friend int lessMask(Float4 a, Float4 b) { return _mm_movemask_ps(_mm_cmplt_ps(a.v, b.v)); }
+    friend int greaterMask(Float4 a, Float4 b) { return _mm_movemask_ps(_mm_cmpgt_ps(a.v, b.v)); }
+    friend int greaterEqualMask(Float4 a, Float4 b) { return _mm_movemask_ps(_mm_cmpge_ps(a.v, b.v)); }
+#elif defined(SOLAR_HAS_NEON)
+    float32x4_t v;
+
+    Float4() : v(vdupq_n_f32(0.0f)) {}
+    Float4(float x) : v(vdupq_n_f32(x)) {}
+    Float4(float32x4_t x) : v(x) {}
+    Float4(float a, float b, float c, float d) {
+        alignas(16) float lanes[4] = { a, b, c, d };
+        v = vld1q_f32(lanes);
+    }
+
+    float operator[](int i) const {
+        alignas(16) float lanes[4];
+        vst1q_f32(lanes, v);
+        return lanes[i];
+    }
+    static Float4 load(const float* in) { return vld1q_f32(in); }
+    void store(float* out) const { vst1q_f32(out, v); }
+    void storeTruncated(int* out) const { vst1q_s32(out, vcvtq_s32_f32(v)); }
+
+    // bit i of each lane, to go between the 4-bit masks and NEON's all-ones lanes
+    static uint32x4_t laneBits() {
+        static const uint32_t bits[4] = { 1, 2, 4, 8 };
+        return vld1q_u32(bits);
+    }
+    static int movemask(uint32x4_t lanes) { return (int)vaddvq_u32(vandq_u32(lanes, laneBits())); }
+
+    friend Float4 operator+(Float4 a, Float4 b) { return vaddq_f32(a.v, b.v); }
+    friend Float4 operator-(Float4 a, Float4 b) { return vsubq_f32(a.v, b.v); }
+    friend Float4 operator*(Float4 a, Float4 b) { return vmulq_f32(a.v, b.v); }
+    friend Float4 operator/(Float4 a, Float4 b) { return vdivq_f32(a.v, b.v); }
+    friend Float4 min(Float4 a, Float4 b) { return vminq_f32(a.v, b.v); }
+    friend Float4 max(Float4 a, Float4 b) { return vmaxq_f32(a.v, b.v); }
+    friend Float4 floor(Float4 a) { return vrndmq_f32(a.v); }
+    friend Float4 sqrt(Float4 a) { return vsqrtq_f32(a.v); }
+    friend Float4 abs(Float4 a) { return vabsq_f32(a.v); }
+    friend Float4 select(int mask, Float4 a, Float4 b) { return vbslq_f32(vtstq_u32(vdupq_n_u32((uint32_t)mask), laneBits()), a.v, b.v); }
+    friend int lessMask(Float4 a, Float4 b) { return movemask(vcltq_f32(a.v, b.v)); }
+    friend int greaterMask(Float4 a, Float4 b) { return movemask(vcgtq_f32(a.v, b.v)); }
+    friend int greaterEqualMask(Float4 a, Float4 b) { return movemask(vcgeq_f32(a.v, b.v)); }
+#else
+    float v[4];
+
+    Float4() : v{ 0.0f, 0.0f, 0.0f, 0.0f } {}
+    Float4(float x) : v{ x, x, x, x } {}
+    Float4(float a, float b, float c, float d) : v{ a, b, c, d } {}
+
+    float operator[](int i) const { return v[i]; }
+    static Float4 load(const float* in) { return Float4(in[0], in[1], in[2], in[3]); }
+    void store(float* out) const { for (int i = 0; i < 4; ++i) out[i] = v[i]; }
+    void storeTruncated(int* out) const { for (int i = 0; i < 4; ++i) out[i] = (int)v[i]; }
+
+    template <typename Op>
+    static Float4 apply(Float4 a, Float4 b, Op op) {
+        return Float4(op(a.v[0], b.v[0]), op(a.v[1], b.v[1]), op(a.v[2], b.v[2]), op(a.v[3], b.v[3]));
+    }
+    template <typename Op>
+    static int mask(Float4 a, Float4 b, Op op) {
+        return (op(a.v[0], b.v[0]) ? 1 : 0) | (op(a.v[1], b.v[1]) ? 2 : 0) | (op(a.v[2], b.v[2]) ? 4 : 0) | (op(a.v[3], b.v[3]) ? 8 : 0);
+    }
+    friend Float4 operator+(Float4 a, Float4 b) { return apply(a, b, [](float x, float y) { return x + y; }); }
+    friend Float4 operator-(Float4 a, Float4 b) { return apply(a, b, [](float x, float y) { return x - y; }); }
+    friend Float4 operator*(Float4 a, Float4 b) { return apply(a, b, [](float x, float y) { return x * y; }); }
+    friend Float4 operator/(Float4 a, Float4 b) { return apply(a, b, [](float x, float y) { return x / y; }); }
+    friend Float4 min(Float4 a, Float4 b) { return apply(a, b, [](float x, float y) { return x < y ? x : y; }); }
+    friend Float4 max(Float4 a, Float4 b) { return apply(a, b, [](float x, float y) { return x > y ? x : y; }); }
+    friend Float4 floor(Float4 a) { return Float4(std::floor(a.v[0]), std::floor(a.v[1]), std::floor(a.v[2]), std::floor(a.v[3])); }
+    friend Float4 sqrt(Float4 a) { return Float4(std::sqrt(a.v[0]), std::sqrt(a.v[1]), std::sqrt(a.v[2]), std::sqrt(a.v[3])); }
+    friend Float4 abs(Float4 a) { return Float4(std::abs(a.v[0]), std::abs(a.v[1]), std::abs(a.v[2]), std::abs(a.v[3])); }
+    friend Float4 select(int mask, Float4 a, Float4 b) {
+        return Float4((mask & 1) ? a.v[0] : b.v[0], (mask & 2) ? a.v[1] : b.v[1], (mask & 4) ? a.v[2] : b.v[2], (mask & 8) ? a.v[3] : b.v[3]);
+    }
+    friend int lessMask(Float4 a, Float4 b) { return mask(a, b, [](float x, float y) { return x < y; }); }
+    friend int greaterMask(Float4 a, Float4 b) { return mask(a, b, [](float x, float y) { return x > y; }); }
+    friend int greaterEqualMask(Float4 a, Float4 b) { return mask(a, b, [](float x, float y) { return x >= y; }); }
+#endif
+};
+
+#endif // !SIMD_H
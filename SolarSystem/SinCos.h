@@ -0,0 +1,230 @@
+#pragma once
+#ifndef SIN_COS_H
+#define SIN_COS_H
+
+#include "Simd.h"
+
+#include <cmath>
+#include <cstddef>
+
+// Sine and cosine together, one float or a whole vector of them at a time. The angle is brought into
+// [-pi/4, pi/4] by subtracting the nearest multiple of pi/2 (Cody-Waite: pi/2 split into three floats, the first
+// two short enough that multiples of them are exact), then a polynomial gives sin and cos there, and the quadrant
+// swaps and flips them. Angles past SINCOS_REDUCTION_LIMIT, where the split runs out of bits, go through the C
+// library's double sin and cos, which reduce with the full bits of 2/pi (Payne-Hanek). Orbits shouldn't get there:
+// turnsToRadians keeps their angles small however long the sim has run.
+enum class SinCosPrecision {
+    Fast,   // absolute error under 4e-4
+    Medium, // under 1e-6
+    Full    // under 1e-7, a float rounding or two
+};
+
+const float SINCOS_REDUCTION_LIMIT = 8192.0f;
+const float SINCOS_TWO_OVER_PI = 0.636619772367581343f;
+const float SINCOS_PI_OVER_2_A = 1.5703125f;
+const float SINCOS_PI_OVER_2_B = 4.837512969970703125e-4f;
+const float SINCOS_PI_OVER_2_C = 7.54978995489188216e-8f;
+
+// On [-pi/4, pi/4]: sin(r) = r + r^3 * (S[0] + r^2 * (S[1] + ...)), cos(r) = 1 + r^2 * (C[0] + r^2 * (C[1] + ...)),
+// by SinCosPrecision. The fast and medium coefficients are minimax fits; the full ones are Cephes' sinf and cosf.
+const int SINCOS_SIN_TERMS[] = { 1, 2, 3 };
+const int SINCOS_COS_TERMS[] = { 2, 3, 4 };
+const float SINCOS_SIN_COEFFICIENTS[3][3] = {
+    { -1.622601329e-1f },
+    { -1.666283440e-1f, 8.153006089e-3f },
+    { -1.6666654611e-1f, 8.3321608736e-3f, -1.9515295891e-4f }
+};
+const float SINCOS_COS_COEFFICIENTS[3][4] = {
+    { -4.997763555e-1f, 4.048906103e-2f },
+    { -4.999989479e-1f, 4.165629543e-2f, -1.359783488e-3f },
+    { -0.5f, 4.166664568298827e-2f, -1.388731625493765e-3f, 2.443315711809948e-5f }
+};
+
+// Horner over the precision's coefficients; T is float or Float4
+template <SinCosPrecision P, typename T>
+inline T sinPolynomial(T r2) {
+    const int tier = (int)P, terms = SINCOS_SIN_TERMS[tier];
+    T sum(SINCOS_SIN_COEFFICIENTS[tier][terms - 1]);
+    for (int k = terms - 2; k >= 0; --k)
+        sum = sum * r2 + T(SINCOS_SIN_COEFFICIENTS[tier][k]);
+    return sum;
+}
+
+template <SinCosPrecision P, typename T>
+inline T cosPolynomial(T r2) {
+    const int tier = (int)P, terms = SINCOS_COS_TERMS[tier];
+    T sum(SINCOS_COS_COEFFICIENTS[tier][terms - 1]);
+    for (int k = terms - 2; k >= 0; --k)
+        sum = sum * r2 + T(SINCOS_COS_COEFFICIENTS[tier][k]);
+    return sum;
+}
+
+// an angle in turns (whole revolutions) as radians in [-pi, pi]. Taking the fraction in double before anything is
+// rounded to float keeps an orbit as smooth after a thousand simulated years as on the first day.
+inline float turnsToRadians(double turns)
+{
+    return static_cast<float>((turns - std::floor(turns + 0.5)) * 6.283185307179586);
+}
+
+template <SinCosPrecision P>
+inline void sinCos(float x, float& s, float& c)
+{
+    if (!(std::abs(x) <= SINCOS_REDUCTION_LIMIT)) {
+        s = static_cast<float>(std::sin(static_cast<double>(x)));
+        c = static_cast<float>(std::cos(static_cast<double>(x)));
+        return;
+    }
+    float q = std::floor(x * SINCOS_TWO_OVER_PI + 0.5f);
+    float r = ((x - q * SINCOS_PI_OVER_2_A) - q * SINCOS_PI_OVER_2_B) - q * SINCOS_PI_OVER_2_C;
+    float r2 = r * r;
+    float sine = r + r * r2 * sinPolynomial<P>(r2);
+    float cosine = 1.0f + r2 * cosPolynomial<P>(r2);
+    int quadrant = (int)q;
+    if (quadrant & 1) {
+        float swap = sine;
+        sine = cosine;
+        cosine = -swap;
+    }
+    if (quadrant & 2) {
+        sine = -sine;
+        cosine = -cosine;
+    }
+    s = sine;
+    c = cosine;
+}
+
+inline void sinCos(float x, float& s, float& c, SinCosPrecision precision = SinCosPrecision::Full)
+{
+    switch (precision) {
+    case SinCosPrecision::Fast: sinCos<SinCosPrecision::Fast>(x, s, c); break;
+    case SinCosPrecision::Medium: sinCos<SinCosPrecision::Medium>(x, s, c); break;
+    default: sinCos<SinCosPrecision::Full>(x, s, c); break;
+    }
+}
+
+// Four at a time with SSE2 or NEON (or plain C++). The quadrant stays a float, so it needs nothing but Float4.
+template <SinCosPrecision P>
+inline void sinCos(Float4 x, Float4& s, Float4& c)
+{
+    Float4 q = floor(x * Float4(SINCOS_TWO_OVER_PI) + Float4(0.5f));
+    Float4 r = ((x - q * Float4(SINCOS_PI_OVER_2_A)) - q * Float4(SINCOS_PI_OVER_2_B)) - q * Float4(SINCOS_PI_OVER_2_C);
+    Float4 r2 = r * r;
+    Float4 sine = r + r * r2 * sinPolynomial<P>(r2);
+    Float4 cosine = Float4(1.0f) + r2 * cosPolynomial<P>(r2);
+    // quadrant 0..3: odd ones swap sine and cosine, 2 and 3 flip the sine, 1 and 2 the cosine
+    Float4 quadrant = q - Float4(4.0f) * floor(q * Float4(0.25f));
+    int odd = lessMask(abs(abs(quadrant - Float4(2.0f)) - Float4(1.0f)), Float4(0.5f));
+    int sineFlips = greaterMask(quadrant, Float4(1.5f));
+    int cosineFlips = lessMask(abs(quadrant - Float4(1.5f)), Float4(1.0f));
+    Float4 swappedSine = select(odd, cosine, sine), swappedCosine = select(odd, sine, cosine);
+    s = select(sineFlips, Float4(0.0f) - swappedSine, swappedSine);
+    c = select(cosineFlips, Float4(0.0f) - swappedCosine, swappedCosine);
+
+    int far = 15 & ~greaterEqualMask(Float4(SINCOS_REDUCTION_LIMIT), abs(x)); // NaNs too
+    if (far) {
+        float lanes[4], sines[4], cosines[4];
+        x.store(lanes);
+        s.store(sines);
+        c.store(cosines);
+        for (int i = 0; i < 4; ++i)
+            if (far & (1 << i)) sinCos<P>(lanes[i], sines[i], cosines[i]);
+        s = Float4::load(sines);
+        c = Float4::load(cosines);
+    }
+}
+
+#ifdef SOLAR_HAS_AVX2_KERNELS
+// Eight at a time; the same steps with an integer quadrant, FMA and sign-bit flips. Only call when cpuHasAvx2().
+template <SinCosPrecision P>
+SOLAR_TARGET_AVX2 inline void sinCosAvx2(__m256 x, __m256& s, __m256& c)
+{
+    const int tier = (int)P;
+    __m256 q = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(SINCOS_TWO_OVER_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(q, _mm256_set1_ps(SINCOS_PI_OVER_2_A), x);
+    r = _mm256_fnmadd_ps(q, _mm256_set1_ps(SINCOS_PI_OVER_2_B), r);
+    r = _mm256_fnmadd_ps(q, _mm256_set1_ps(SINCOS_PI_OVER_2_C), r);
+    __m256 r2 = _mm256_mul_ps(r, r);
+
+    __m256 sinSum = _mm256_set1_ps(SINCOS_SIN_COEFFICIENTS[tier][SINCOS_SIN_TERMS[tier] - 1]);
+    for (int k = SINCOS_SIN_TERMS[tier] - 2; k >= 0; --k)
+        sinSum = _mm256_fmadd_ps(sinSum, r2, _mm256_set1_ps(SINCOS_SIN_COEFFICIENTS[tier][k]));
+    __m256 cosSum = _mm256_set1_ps(SINCOS_COS_COEFFICIENTS[tier][SINCOS_COS_TERMS[tier] - 1]);
+    for (int k = SINCOS_COS_TERMS[tier] - 2; k >= 0; --k)
+        cosSum = _mm256_fmadd_ps(cosSum, r2, _mm256_set1_ps(SINCOS_COS_COEFFICIENTS[tier][k]));
+    __m256 sine = _mm256_fmadd_ps(_mm256_mul_ps(r, r2), sinSum, r);
+    __m256 cosine = _mm256_fmadd_ps(r2, cosSum, _mm256_set1_ps(1.0f));
+
+    __m256i quadrant = _mm256_cvtps_epi32(q);
+    __m256 odd = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+    __m256 sineSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(2)), 30));
+    __m256 cosineSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+    s = _mm256_xor_ps(_mm256_blendv_ps(sine, cosine, odd), sineSign);
+    c = _mm256_xor_ps(_mm256_blendv_ps(cosine, sine, odd), cosineSign);
+
+    __m256 absolute = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x);
+    int far = 0xff & ~_mm256_movemask_ps(_mm256_cmp_ps(absolute, _mm256_set1_ps(SINCOS_REDUCTION_LIMIT), _CMP_LE_OQ));
+    if (far) {
+        alignas(32) float lanes[8], sines[8], cosines[8];
+        _mm256_store_ps(lanes, x);
+        _mm256_store_ps(sines, s);
+        _mm256_store_ps(cosines, c);
+        for (int i = 0; i < 8; ++i)
+            if (far & (1 << i)) sinCos<P>(lanes[i], sines[i], cosines[i]);
+        s = _mm256_load_ps(sines);
+        c = _mm256_load_ps(cosines);
+    }
+}
+
+template <SinCosPrecision P>
+SOLAR_TARGET_AVX2 inline void sinCosAvx2(const float* angles, float* sines, float* cosines, size_t count)
+{
+    size_t whole = count - count % 8;
+    for (size_t i = 0; i < whole; i += 8) {
+        __m256 s, c;
+        sinCosAvx2<P>(_mm256_loadu_ps(angles + i), s, c);
+        _mm256_storeu_ps(sines + i, s);
+        _mm256_storeu_ps(cosines + i, c);
+    }
+    for (size_t i = whole; i < count; ++i)
+        sinCos<P>(angles[i], sines[i], cosines[i]);
+}
+#endif
+
+template <SinCosPrecision P>
+inline void sinCosFloat4(const float* angles, float* sines, float* cosines, size_t count)
+{
+    size_t whole = count - count % 4;
+    for (size_t i = 0; i < whole; i += 4) {
+        Float4 s, c;
+        sinCos<P>(Float4::load(angles + i), s, c);
+        s.store(sines + i);
+        c.store(cosines + i);
+    }
+    for (size_t i = whole; i < count; ++i)
+        sinCos<P>(angles[i], sines[i], cosines[i]);
+}
+
+template <SinCosPrecision P>
+inline void sinCos(const float* angles, float* sines, float* cosines, size_t count)
+{
+#ifdef SOLAR_HAS_AVX2_KERNELS
+    static const bool avx2 = cpuHasAvx2();
+    if (avx2) {
+        sinCosAvx2<P>(angles, sines, cosines, count);
+        return;
+    }
+#endif
+    sinCosFloat4<P>(angles, sines, cosines, count);
+}
+
+// count angles at once, with the widest kernel the CPU runs
+inline void sinCos(const float* angles, float* sines, float* cosines, size_t count, SinCosPrecision precision = SinCosPrecision::Full)
+{
+    switch (precision) {
+    case SinCosPrecision::Fast: sinCos<SinCosPrecision::Fast>(angles, sines, cosines, count); break;
+    case SinCosPrecision::Medium: sinCos<SinCosPrecision::Medium>(angles, sines, cosines, count); break;
+    default: sinCos<SinCosPrecision::Full>(angles, sines, cosines, count); break;
+    }
+}
+
+#endif // !SIN_COS_H
@@ -0,0 +1,136 @@
+#pragma once
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A handle to a value in a SlotMap. Once the value is erased the handle stops resolving, even after its slot is
+// reused: the slot's generation has moved on.
+struct SlotHandle {
+    uint32_t index = 0xffffffffu;
+    uint32_t generation = 0;
+
+    bool operator==(const SlotHandle& other) const {
+        return index == other.index && generation == other.generation;
+    }
+    bool operator!=(const SlotHandle& other) const {
+        return !(*this == other);
+    }
+};
+
+// Values packed densely for iteration, found through generational handles. Each handle points at a slot, and the
+// slot at the value's position in the dense array. Erasing moves the last value into the hole and repoints its
+// slot, so insert and erase are O(1) and the values never have gaps. Freed slots are chained into a free list
+// through the slots themselves. Once the map has been reserved, or has grown to its working size, inserting and
+// erasing never touch the heap.
+template <typename T>
+class SlotMap {
+
+public:
+    // times an insert had to grow the storage; stays put in steady state
+    int Growths = 0;
+
+    void reserve(size_t count) {
+        values.reserve(count);
+        owners.reserve(count);
+        slots.reserve(count);
+    }
+
+    SlotHandle insert(const T& value) {
+        bool newSlot = freeHead == NO_SLOT;
+        if (values.size() == values.capacity() || (newSlot && slots.size() == slots.capacity()))
+            ++Growths;
+        uint32_t index;
+        if (newSlot) {
+            index = (uint32_t)slots.size();
+            slots.push_back(Slot());
+        }
+        else {
+            index = freeHead;
+            freeHead = slots[index].position;
+        }
+        slots[index].position = (uint32_t)values.size();
+        values.push_back(value);
+        owners.push_back(index);
+        return SlotHandle{ index, slots[index].generation };
+    }
+
+    // false when the handle no longer resolves
+    bool erase(SlotHandle handle) {
+        if (!contains(handle)) return false;
+        eraseAt(slots[handle.index].position);
+        return true;
+    }
+
+    // erases the value at dense position i, moving the last value into it; erasing while walking the values from
+    // the back visits every value once
+    void eraseAt(size_t i) {
+        uint32_t index = owners[i];
+        size_t last = values.size() - 1;
+        if (i != last) {
+            values[i] = values[last];
+            owners[i] = owners[last];
+            slots[owners[i]].position = (uint32_t)i;
+        }
+        values.pop_back();
+        owners.pop_back();
+        ++slots[index].generation;
+        slots[index].position = freeHead;
+        freeHead = index;
+    }
+
+    bool contains(SlotHandle handle) const {
+        // a free slot's generation moved on when its value was erased, so no handle matches it until it's reused
+        return handle.index < slots.size() && slots[handle.index].generation == handle.generation;
+    }
+
+    // the value, or nullptr when the handle no longer resolves; valid until the next insert or erase
+    T* get(SlotHandle handle) {
+        return contains(handle) ? &values[slots[handle.index].position] : nullptr;
+    }
+    const T* get(SlotHandle handle) const {
+        return contains(handle) ? &values[slots[handle.index].position] : nullptr;
+    }
+
+    // the handle of the value at dense position i
+    SlotHandle handleAt(size_t i) const {
+        return SlotHandle{ owners[i], slots[owners[i]].generation };
+    }
+
+    // the values, densely, in no particular order
+    T* data() { return values.data(); }
+    const T* data() const { return values.data(); }
+    T& operator[](size_t i) { return values[i]; }
+    const T& operator[](size_t i) const { return values[i]; }
+    typename std::vector<T>::iterator begin() { return values.begin(); }
+    typename std::vector<T>::iterator end() { return values.end(); }
+    typename std::vector<T>::const_iterator begin() const { return values.begin(); }
+    typename std::vector<T>::const_iterator end() const { return values.end(); }
+
+    size_t size() const { return values.size(); }
+    bool empty() const { return values.empty(); }
+    size_t capacity() const { return values.capacity(); }
+
+    // erases everything and keeps the storage; every handle stops resolving
+    void clear() {
+        for (size_t i = values.size(); i > 0; --i)
+            eraseAt(i - 1);
+    }
+
+private:
+    static const uint32_t NO_SLOT = 0xffffffffu;
+
+    struct Slot {
+        uint32_t position = 0;  // of the value in values; of the next free slot while free
+        uint32_t generation = 0;
+    };
+
+    std::vector<T> values;
+    std::vector<uint32_t> owners; // the slot of each value
+    std::vector<Slot> slots;
+    uint32_t freeHead = NO_SLOT;
+};
+
+#endif // !SLOT_MAP_H
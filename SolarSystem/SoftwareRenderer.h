@@ -0,0 +1,576 @@
+#pragma once
+#ifndef SOFTWARE_RENDERER_H
+#define SOFTWARE_RENDERER_H
+
+#include <glm/glm.hpp>
+
+#include "Planet.h"
+#include "Scene.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// A CPU renderer for this scene, for hosts without a GPU. It draws the same textured spheres as Scene::render
+// and produces the same image as the GL path within a few values per channel:
+// - vertices are transformed and clipped against the near and far planes per body, in parallel, and the
+//   triangles are binned into 64x64 pixel tiles, all of it on the frame arena of the worker doing the body
+// - each tile is rasterized by one worker, 2x2 pixel quads at a time with SIMD edge functions and depth test
+// - quads outside a triangle's edges are skipped a tile and a quad row at a time before any edge test
+// - texture coordinates are interpolated perspective-correct and sampled bilinearly from one mip level per
+//   triangle, from mipmaps built from the same decoded images
+// The color buffer is RGBA8 with rows bottom-up, matching what glReadPixels returns for the GL path.
+class SoftwareRenderer {
+
+public:
+    static const int TILE_SIZE = 64;
+
+    // sim settings, same meaning as in Scene
+    float planetScale = 1.0f;
+    float timeScaleDaysPerSecond = 1.0f;
+    float timeScaleRotation = 1.0f;
+
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> color;
+
+    // stats of the last frame
+    int TrianglesBinned = 0;
+
+    SoftwareRenderer(const SceneAssets& assets, ThreadPool& threadPool) : mesh(assets.sphereMesh), pool(threadPool) {
+        MemoryScope scope(MEMORY_TEXTURES);
+        textures.resize(PLANET_COUNT + 1);
+        buildMipmaps(assets.sunImage, textures[0]);
+        for (int i = 0; i < PLANET_COUNT; ++i)
+            buildMipmaps(assets.planetImages[i], textures[i + 1]);
+        planets.assign(SOLAR_SYSTEM_PLANETS, SOLAR_SYSTEM_PLANETS + PLANET_COUNT);
+    }
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        MemoryScope scope(MEMORY_RENDERER);
+        color.assign((size_t)width * height * 4, 0);
+        tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    }
+
+    // draws the scene as it is simTime seconds into the simulation, like Scene::render; beginFrameArenas() has to
+    // be called between frames
+    void render(const glm::mat4& view, const glm::mat4& projection, double simTime) {
+        bodyModelMatrices(planets, simTime, timeScaleDaysPerSecond, timeScaleRotation, planetScale, models);
+        batches.resize(models.size());
+        glm::mat4 viewProjection = projection * view;
+        glm::vec3 eye = glm::vec3(glm::inverse(view)[3]);
+
+        pool.parallelFor((int)models.size(), [&](int begin, int end) {
+            for (int body = begin; body < end; ++body) {
+                // the spheres are closed and convex: from outside (with room for the near plane) their back faces
+                // are always hidden, so they can be skipped without changing the image
+                float radius = glm::length(glm::vec3(models[body][0]));
+                bool cullBackFaces = glm::length(eye - glm::vec3(models[body][3])) > radius + 4.0f * Scene::Z_NEAR;
+                setupBody(batches[body], viewProjection * models[body], &textures[body], cullBackFaces);
+            }
+        });
+        TrianglesBinned = 0;
+        for (const Batch& batch : batches)
+            TrianglesBinned += (int)batch.triangles.size();
+
+        pool.parallelFor(tilesX * tilesY, [&](int begin, int end) {
+            for (int tile = begin; tile < end; ++tile)
+                rasterizeTile(tile);
+        });
+    }
+
+private:
+    struct MipLevel {
+        int width, height;
+        std::vector<unsigned int> texels; // RGBA8, first row is t = 0 like glTexImage2D
+    };
+    struct MipTexture {
+        std::vector<MipLevel> levels; // empty when the image failed to load: samples black, like an incomplete GL texture
+    };
+    struct ClipVertex {
+        glm::vec4 position;
+        float u, v;
+    };
+    // screen-space triangle, counter-clockwise; attributes are stored as value at vertex 0 plus the change per
+    // unit of the edge functions of vertices 1 and 2, so a = a0 + e1 * a1 + e2 * a2
+    struct Triangle {
+        float x[3], y[3];
+        float edgeA[3], edgeB[3];
+        double edgeC[3];
+        bool topLeft[3];
+        float z[3], invW[3], uOverW[3], vOverW[3];
+        int minX, minY, maxX, maxY;
+        const MipTexture* texture;
+        int level; // mip level it samples
+    };
+    // on the frame arena of the thread that set the body up
+    struct Batch {
+        FrameVector<Triangle> triangles;
+        FrameVector<FrameVector<int>> bins; // triangle indices per tile, in draw order
+        FrameVector<ClipVertex> clipVertices;
+    };
+
+    const SphereMesh& mesh;
+    ThreadPool& pool;
+    std::vector<MipTexture> textures; // sun, then planets
+    std::vector<Planet> planets;
+    std::vector<glm::mat4> models;
+    std::vector<Batch> batches;
+    int tilesX = 0;
+    int tilesY = 0;
+
+    static void buildMipmaps(const TextureImage& image, MipTexture& texture) {
+        if (image.pixels.empty()) return;
+        MipLevel base;
+        base.width = image.width;
+        base.height = image.height;
+        base.texels.resize((size_t)image.width * image.height);
+        for (size_t i = 0; i < base.texels.size(); ++i) {
+            const unsigned char* p = &image.pixels[i * image.components];
+            unsigned int r = p[0], g = 0, b = 0, a = 255;
+            if (image.components >= 3) {
+                g = p[1];
+                b = p[2];
+            }
+            if (image.components == 4) a = p[3];
+            base.texels[i] = r | g << 8 | b << 16 | a << 24;
+        }
+        texture.levels.push_back(std::move(base));
+        // box filter down to 1x1, the way glGenerateMipmap does
+        while (texture.levels.back().width > 1 || texture.levels.back().height > 1) {
+            const MipLevel& src = texture.levels.back();
+            MipLevel level;
+            level.width = std::max(1, src.width / 2);
+            level.height = std::max(1, src.height / 2);
+            level.texels.resize((size_t)level.width * level.height);
+            for (int y = 0; y < level.height; ++y) {
+                for (int x = 0; x < level.width; ++x) {
+                    int x0 = std::min(2 * x, src.width - 1), x1 = std::min(2 * x + 1, src.width - 1);
+                    int y0 = std::min(2 * y, src.height - 1), y1 = std::min(2 * y + 1, src.height - 1);
+                    unsigned int t[4] = { src.texels[(size_t)y0 * src.width + x0], src.texels[(size_t)y0 * src.width + x1],
+                                          src.texels[(size_t)y1 * src.width + x0], src.texels[(size_t)y1 * src.width + x1] };
+                    unsigned int out = 0;
+                    for (int c = 0; c < 32; c += 8) {
+                        unsigned int sum = ((t[0] >> c) & 255) + ((t[1] >> c) & 255) + ((t[2] >> c) & 255) + ((t[3] >> c) & 255);
+                        out |= ((sum + 2) / 4) << c;
+                    }
+                    level.texels[(size_t)y * level.width + x] = out;
+                }
+            }
+            texture.levels.push_back(std::move(level));
+        }
+    }
+
+    // transforms, clips and bins one body's sphere
+    void setupBody(Batch& batch, const glm::mat4& mvp, const MipTexture* texture, bool cullBackFaces) {
+        FrameArena& arena = frameArena();
+        batch.triangles = FrameVector<Triangle>(ArenaAllocator<Triangle>(arena));
+        batch.triangles.reserve(mesh.indices.size() / 3);
+        batch.bins = FrameVector<FrameVector<int>>(tilesX * tilesY, FrameVector<int>(ArenaAllocator<int>(arena)), ArenaAllocator<FrameVector<int>>(arena));
+
+        const size_t vertexCount = mesh.vertices.size() / 5;
+        batch.clipVertices = FrameVector<ClipVertex>(vertexCount, ClipVertex(), ArenaAllocator<ClipVertex>(arena));
+        for (size_t i = 0; i < vertexCount; ++i) {
+            const float* v = &mesh.vertices[i * 5];
+            batch.clipVertices[i].position = mvp * glm::vec4(v[0], v[1], v[2], 1.0f);
+            batch.clipVertices[i].u = v[3];
+            batch.clipVertices[i].v = v[4];
+        }
+
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            ClipVertex polygon[5] = { batch.clipVertices[mesh.indices[i]], batch.clipVertices[mesh.indices[i + 1]], batch.clipVertices[mesh.indices[i + 2]] };
+            // trivially outside one of the frustum planes
+            bool outside = false;
+            for (int axis = 0; axis < 3 && !outside; ++axis) {
+                bool allBelow = true, allAbove = true;
+                for (int k = 0; k < 3; ++k) {
+                    allBelow = allBelow && polygon[k].position[axis] < -polygon[k].position.w;
+                    allAbove = allAbove && polygon[k].position[axis] > polygon[k].position.w;
+                }
+                outside = allBelow || allAbove;
+            }
+            if (outside) continue;
+
+            int count = 3;
+            bool needsClipping = false;
+            for (int k = 0; k < 3; ++k)
+                needsClipping = needsClipping || std::abs(polygon[k].position.z) > polygon[k].position.w;
+            if (needsClipping) {
+                count = clipPolygon(polygon, count, 1.0f);  // near: z >= -w
+                count = clipPolygon(polygon, count, -1.0f); // far: z <= w
+            }
+            for (int k = 1; k + 1 < count; ++k)
+                setupTriangle(batch, polygon[0], polygon[k], polygon[k + 1], texture, cullBackFaces);
+        }
+    }
+
+    // Sutherland-Hodgman against the plane sign * z + w >= 0; a triangle clipped by two planes has at most 5 vertices
+    static int clipPolygon(ClipVertex* polygon, int count, float sign) {
+        ClipVertex input[5];
+        std::copy(polygon, polygon + count, input);
+        int outCount = 0;
+        for (int k = 0; k < count; ++k) {
+            const ClipVertex& a = input[k];
+            const ClipVertex& b = input[(k + 1) % count];
+            float da = sign * a.position.z + a.position.w;
+            float db = sign * b.position.z + b.position.w;
+            if (da >= 0.0f)
+                polygon[outCount++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f) && outCount < 5) {
+                float t = da / (da - db);
+                ClipVertex& v = polygon[outCount++];
+                v.position = a.position + (b.position - a.position) * t;
+                v.u = a.u + (b.u - a.u) * t;
+                v.v = a.v + (b.v - a.v) * t;
+            }
+        }
+        return outCount;
+    }
+
+    void setupTriangle(Batch& batch, const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, const MipTexture* texture, bool cullBackFaces) {
+        const ClipVertex* v[3] = { &a, &b, &c };
+        Triangle t;
+        for (int k = 0; k < 3; ++k) {
+            float invW = 1.0f / v[k]->position.w;
+            // snapped to 1/256 pixel like GL rasterizers
+            t.x[k] = std::round((v[k]->position.x * invW * 0.5f + 0.5f) * width * 256.0f) / 256.0f;
+            t.y[k] = std::round((v[k]->position.y * invW * 0.5f + 0.5f) * height * 256.0f) / 256.0f;
+            t.z[k] = v[k]->position.z * invW;
+            t.invW[k] = invW;
+            t.uOverW[k] = v[k]->u * invW;
+            t.vOverW[k] = v[k]->v * invW;
+        }
+        float area = (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (t.x[2] - t.x[0]) * (t.y[1] - t.y[0]);
+        if (area == 0.0f || !std::isfinite(area)) return;
+        // the sphere's outside faces are clockwise on screen (its indices wind inward)
+        if (cullBackFaces && area > 0.0f) return;
+        if (area < 0.0f) {
+            // GL draws both faces here; make every triangle counter-clockwise
+            std::swap(t.x[1], t.x[2]);
+            std::swap(t.y[1], t.y[2]);
+            std::swap(t.z[1], t.z[2]);
+            std::swap(t.invW[1], t.invW[2]);
+            std::swap(t.uOverW[1], t.uOverW[2]);
+            std::swap(t.vOverW[1], t.vOverW[2]);
+            area = -area;
+        }
+
+        float minX = std::min({ t.x[0], t.x[1], t.x[2] }), maxX = std::max({ t.x[0], t.x[1], t.x[2] });
+        float minY = std::min({ t.y[0], t.y[1], t.y[2] }), maxY = std::max({ t.y[0], t.y[1], t.y[2] });
+        // pixels whose center can be inside
+        t.minX = (int)std::max(0.0f, std::ceil(minX - 0.5f));
+        t.maxX = (int)std::min((float)width - 1, std::floor(maxX - 0.5f));
+        t.minY = (int)std::max(0.0f, std::ceil(minY - 0.5f));
+        t.maxY = (int)std::min((float)height - 1, std::floor(maxY - 0.5f));
+        if (t.minX > t.maxX || t.minY > t.maxY) return;
+
+        // edge k is opposite vertex k: e_k(p) = edgeA * px + edgeB * py + edgeC, positive inside
+        for (int k = 0; k < 3; ++k) {
+            int from = (k + 1) % 3, to = (k + 2) % 3;
+            double dx = (double)t.x[to] - t.x[from], dy = (double)t.y[to] - t.y[from];
+            t.edgeA[k] = (float)-dy;
+            t.edgeB[k] = (float)dx;
+            t.edgeC[k] = dy * t.x[from] - dx * t.y[from];
+            // fill rule: pixels exactly on a left or top edge belong to the triangle
+            t.topLeft[k] = dy < 0.0 || (dy == 0.0 && dx < 0.0);
+        }
+        t.texture = texture;
+        t.level = textureLevel(t, area);
+
+        // attributes per unit of e1 and e2 (barycentrics are e1 / area and e2 / area)
+        float invArea = 1.0f / area;
+        float* attributes[4] = { t.z, t.invW, t.uOverW, t.vOverW };
+        for (float* attribute : attributes) {
+            float a0 = attribute[0];
+            attribute[1] = (attribute[1] - a0) * invArea;
+            attribute[2] = (attribute[2] - a0) * invArea;
+        }
+
+        int index = (int)batch.triangles.size();
+        batch.triangles.push_back(t);
+        for (int ty = t.minY / TILE_SIZE; ty <= t.maxY / TILE_SIZE; ++ty)
+            for (int tx = t.minX / TILE_SIZE; tx <= t.maxX / TILE_SIZE; ++tx)
+                batch.bins[ty * tilesX + tx].push_back(index);
+    }
+
+    // The mip level for a whole triangle, picked like GL_LINEAR_MIPMAP_NEAREST from the level of detail GL computes
+    // per quad: the texel footprint of a pixel, here from the gradients of the texture coordinates over the
+    // triangle taken as linear, which perspective barely bends across the few pixels a sphere's triangle covers.
+    static int textureLevel(const Triangle& t, float area) {
+        const MipTexture& texture = *t.texture;
+        if (texture.levels.empty()) return 0;
+        float u[3], v[3];
+        for (int k = 0; k < 3; ++k) {
+            u[k] = t.uOverW[k] / t.invW[k] * texture.levels[0].width;
+            v[k] = t.vOverW[k] / t.invW[k] * texture.levels[0].height;
+        }
+        float x1 = t.x[1] - t.x[0], y1 = t.y[1] - t.y[0], x2 = t.x[2] - t.x[0], y2 = t.y[2] - t.y[0];
+        float u1 = u[1] - u[0], v1 = v[1] - v[0], u2 = u[2] - u[0], v2 = v[2] - v[0];
+        float dudx = (u1 * y2 - u2 * y1) / area, dvdx = (v1 * y2 - v2 * y1) / area;
+        float dudy = (u2 * x1 - u1 * x2) / area, dvdy = (v2 * x1 - v1 * x2) / area;
+        float rho2 = std::max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy);
+        if (!(rho2 > 1.0f)) return 0; // magnified, or NaN
+        // level of detail log2(rho), rounded to the nearest level
+        int level = (int)std::floor(0.5f * std::log2(rho2) + 0.5f);
+        return std::min(level, (int)texture.levels.size() - 1);
+    }
+
+    void rasterizeTile(int tile) {
+        const int tileX = (tile % tilesX) * TILE_SIZE, tileY = (tile / tilesX) * TILE_SIZE;
+        const int tileWidth = std::min(TILE_SIZE, width - tileX), tileHeight = std::min(TILE_SIZE, height - tileY);
+        float depth[TILE_SIZE * TILE_SIZE];
+        std::fill(depth, depth + TILE_SIZE * TILE_SIZE, 1.0f);
+        // the same clear color as Scene::render, as GL rounds it to 8 bits
+        const unsigned int clearColor = 3u | 3u << 8 | 3u << 16 | 255u << 24;
+        for (int y = 0; y < tileHeight; ++y) {
+            unsigned int* row = reinterpret_cast<unsigned int*>(&color[((size_t)(tileY + y) * width + tileX) * 4]);
+            std::fill(row, row + tileWidth, clearColor);
+        }
+        for (const Batch& batch : batches)
+            for (int index : batch.bins[tile])
+                rasterizeTriangle(batch.triangles[index], tileX, tileY, tileWidth, tileHeight, depth);
+    }
+
+    void rasterizeTriangle(const Triangle& t, int tileX, int tileY, int tileWidth, int tileHeight, float* depth) {
+        const int x0 = std::max(t.minX, tileX), x1 = std::min(t.maxX, tileX + tileWidth - 1);
+        const int y0 = std::max(t.minY, tileY), y1 = std::min(t.maxY, tileY + tileHeight - 1);
+        if (x0 > x1 || y0 > y1) return;
+
+        // Trivial reject and accept against the pixel centers of the rectangle, in double. Only pixels whose edge
+        // value is below -tolerance are treated as outside, well past what the float edge values below can be
+        // rounded by, so the pixels that are drawn are exactly those the edge tests alone would draw.
+        double tolerance[3];
+        bool inside = true;
+        for (int k = 0; k < 3; ++k) {
+            double a = t.edgeA[k], b = t.edgeB[k];
+            tolerance[k] = 1e-4 * (std::abs(a) + std::abs(b));
+            double largest = a * ((a > 0.0 ? x1 : x0) + 0.5) + b * ((b > 0.0 ? y1 : y0) + 0.5) + t.edgeC[k];
+            double smallest = a * ((a > 0.0 ? x0 : x1) + 0.5) + b * ((b > 0.0 ? y0 : y1) + 0.5) + t.edgeC[k];
+            if (largest < -tolerance[k]) return; // the whole rectangle is outside this edge
+            inside = inside && smallest > tolerance[k];
+        }
+
+        // quads start on even pixels, the way a GPU lines them up
+        const int quadX0 = x0 & ~1, quadY0 = y0 & ~1;
+
+        // edge functions at the first quad's pixel centers, in double so large coordinates keep their precision
+        const Float4 laneX(0.0f, 1.0f, 0.0f, 1.0f), laneY(0.0f, 0.0f, 1.0f, 1.0f);
+        Float4 edgeBase[3], edgeA[3], edgeB[3];
+        int topLeftMask[3];
+        for (int k = 0; k < 3; ++k) {
+            float base = (float)(t.edgeA[k] * (quadX0 + 0.5) + t.edgeB[k] * (quadY0 + 0.5) + t.edgeC[k]);
+            edgeA[k] = Float4(t.edgeA[k]);
+            edgeB[k] = Float4(t.edgeB[k]);
+            edgeBase[k] = Float4(base) + edgeA[k] * laneX + edgeB[k] * laneY;
+            topLeftMask[k] = t.topLeft[k] ? 15 : 0;
+        }
+        const Float4 zero(0.0f);
+        const MipTexture& texture = *t.texture;
+        const MipLevel* level = texture.levels.empty() ? nullptr : &texture.levels[t.level];
+
+        for (int qy = quadY0; qy <= y1; qy += 2) {
+            Float4 offsetY((float)(qy - quadY0));
+            int rowMask = (qy >= y0 ? 3 : 0) | (qy + 1 <= y1 ? 12 : 0);
+            const int rowY0 = std::max(qy, y0), rowY1 = std::min(qy + 1, y1);
+
+            // the pixels of this quad row that can be inside all three edges; quads off this span are skipped
+            // without their edge tests
+            int spanX0 = x0, spanX1 = x1;
+            for (int k = 0; k < 3 && !inside && spanX0 <= spanX1; ++k) {
+                double a = t.edgeA[k], b = t.edgeB[k];
+                // pixel x is outside where a * (x + 0.5) + rest < 0
+                double rest = b * ((b > 0.0 ? rowY1 : rowY0) + 0.5) + t.edgeC[k] + tolerance[k];
+                if (a > 0.0)
+                    spanX0 = std::max(spanX0, (int)std::min(std::ceil(-rest / a - 0.5), (double)x1 + 1));
+                else if (a < 0.0)
+                    spanX1 = std::min(spanX1, (int)std::max(std::floor(-rest / a - 0.5), (double)x0 - 1));
+                else if (rest < 0.0)
+                    spanX1 = spanX0 - 1;
+            }
+
+            for (int qx = std::max(quadX0, spanX0 & ~1); qx <= spanX1; qx += 2) {
+                Float4 offsetX((float)(qx - quadX0));
+                int laneMask = rowMask & ((qx >= x0 ? 5 : 0) | (qx + 1 <= x1 ? 10 : 0));
+                Float4 e[3];
+                int coverage = laneMask;
+                if (inside) {
+                    for (int k = 1; k < 3; ++k)
+                        e[k] = edgeBase[k] + edgeA[k] * offsetX + edgeB[k] * offsetY;
+                } else {
+                    for (int k = 0; k < 3; ++k) {
+                        e[k] = edgeBase[k] + edgeA[k] * offsetX + edgeB[k] * offsetY;
+                        coverage &= greaterMask(e[k], zero) | (greaterEqualMask(e[k], zero) & topLeftMask[k]);
+                    }
+                    if (!coverage) continue;
+                }
+
+                Float4 z = Float4(t.z[0]) + e[1] * Float4(t.z[1]) + e[2] * Float4(t.z[2]);
+                int localX = qx - tileX, localY = qy - tileY;
+                float* depthRow0 = depth + localY * TILE_SIZE + localX;
+                float* depthRow1 = depthRow0 + TILE_SIZE;
+                // lanes outside the tile are masked out of coverage, so their depth is never read
+                Float4 stored((coverage & 1) ? depthRow0[0] : 0.0f, (coverage & 2) ? depthRow0[1] : 0.0f,
+                              (coverage & 4) ? depthRow1[0] : 0.0f, (coverage & 8) ? depthRow1[1] : 0.0f);
+                coverage &= lessMask(z, stored);
+                if (!coverage) continue;
+
+                // perspective-correct texture coordinates
+                Float4 invW = Float4(t.invW[0]) + e[1] * Float4(t.invW[1]) + e[2] * Float4(t.invW[2]);
+                Float4 w = Float4(1.0f) / invW;
+                Float4 u = (Float4(t.uOverW[0]) + e[1] * Float4(t.uOverW[1]) + e[2] * Float4(t.uOverW[2])) * w;
+                Float4 v = (Float4(t.vOverW[0]) + e[1] * Float4(t.vOverW[1]) + e[2] * Float4(t.vOverW[2])) * w;
+                float zLanes[4];
+                z.store(zLanes);
+
+                unsigned int texels[4];
+                sampleQuad(level, u, v, texels);
+                for (int lane = 0; lane < 4; ++lane) {
+                    if (!(coverage & (1 << lane))) continue;
+                    int px = qx + (lane & 1), py = qy + (lane >> 1);
+                    depth[(py - tileY) * TILE_SIZE + (px - tileX)] = zLanes[lane];
+                    std::memcpy(&color[((size_t)py * width + px) * 4], &texels[lane], 4);
+                }
+            }
+        }
+    }
+
+    // Filtering uses 8-bit fixed point weights (0..256), the precision texture units filter with, so a weighted
+    // sum of two 0..255 channels still fits 16 bits.
+#ifdef SOLAR_HAS_SSE2
+    // The four pixels of a quad are filtered together: a pair of __m128i, lanes 0 and 1 in the first and lanes 2
+    // and 3 in the second, each with its four channels as 16-bit values.
+
+    // (a * (256 - w) + b * w + 128) / 256 per 16-bit channel
+    static __m128i lerp16(__m128i a, __m128i b, __m128i w) {
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a, _mm_sub_epi16(_mm_set1_epi16(256), w)), _mm_mullo_epi16(b, w));
+        return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8);
+    }
+    // four per-lane weights spread over the channels of each lane: lanes 0 and 1 into low, 2 and 3 into high
+    static void spreadWeights(const int* weights, __m128i& low, __m128i& high) {
+        __m128i packed = _mm_packs_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(weights)), _mm_setzero_si128());
+        __m128i pairs = _mm_unpacklo_epi16(packed, packed);
+        low = _mm_unpacklo_epi32(pairs, pairs);
+        high = _mm_unpackhi_epi32(pairs, pairs);
+    }
+
+    // GL_LINEAR filtering of the triangle's mip level with GL_REPEAT wrapping, for the four pixels of a quad at once
+    static void sampleQuad(const MipLevel* level, Float4 u, Float4 v, unsigned int* texels) {
+        if (!level) {
+            std::fill(texels, texels + 4, 255u << 24);
+            return;
+        }
+        // lanes outside the triangle extrapolate and can be huge or NaN; the clamp keeps their texel reads in range
+        u = max(min(u - floor(u), Float4(1.0f)), Float4(0.0f));
+        v = max(min(v - floor(v), Float4(1.0f)), Float4(0.0f));
+        __m128i low, high;
+        sampleLevel(*level, u, v, low, high);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(texels), _mm_packus_epi16(low, high));
+    }
+
+    // bilinear samples of one level; u and v already wrapped into [0, 1]
+    static void sampleLevel(const MipLevel& level, Float4 u, Float4 v, __m128i& low, __m128i& high) {
+        Float4 x = u * Float4((float)level.width) - Float4(0.5f), y = v * Float4((float)level.height) - Float4(0.5f);
+        Float4 fx = floor(x), fy = floor(y);
+        int xa[4], ya[4], wx[4], wy[4];
+        fx.storeTruncated(xa);
+        fy.storeTruncated(ya);
+        ((x - fx) * Float4(256.0f) + Float4(0.5f)).storeTruncated(wx);
+        ((y - fy) * Float4(256.0f) + Float4(0.5f)).storeTruncated(wy);
+        alignas(16) unsigned int t00[4], t10[4], t01[4], t11[4];
+        for (int lane = 0; lane < 4; ++lane) {
+            int x0 = xa[lane], y0 = ya[lane];
+            int x1 = x0 + 1, y1 = y0 + 1;
+            if (x0 < 0) x0 += level.width;
+            if (x1 >= level.width) x1 -= level.width;
+            if (y0 < 0) y0 += level.height;
+            if (y1 >= level.height) y1 -= level.height;
+            const unsigned int* row0 = &level.texels[(size_t)y0 * level.width];
+            const unsigned int* row1 = &level.texels[(size_t)y1 * level.width];
+            t00[lane] = row0[x0];
+            t10[lane] = row0[x1];
+            t01[lane] = row1[x0];
+            t11[lane] = row1[x1];
+        }
+        const __m128i zero = _mm_setzero_si128();
+        __m128i a00 = _mm_load_si128(reinterpret_cast<const __m128i*>(t00)), a10 = _mm_load_si128(reinterpret_cast<const __m128i*>(t10));
+        __m128i a01 = _mm_load_si128(reinterpret_cast<const __m128i*>(t01)), a11 = _mm_load_si128(reinterpret_cast<const __m128i*>(t11));
+        __m128i wxLow, wxHigh, wyLow, wyHigh;
+        spreadWeights(wx, wxLow, wxHigh);
+        spreadWeights(wy, wyLow, wyHigh);
+        // down the columns, then across
+        low = lerp16(lerp16(_mm_unpacklo_epi8(a00, zero), _mm_unpacklo_epi8(a01, zero), wyLow),
+                     lerp16(_mm_unpacklo_epi8(a10, zero), _mm_unpacklo_epi8(a11, zero), wyLow), wxLow);
+        high = lerp16(lerp16(_mm_unpackhi_epi8(a00, zero), _mm_unpackhi_epi8(a01, zero), wyHigh),
+                      lerp16(_mm_unpackhi_epi8(a10, zero), _mm_unpackhi_epi8(a11, zero), wyHigh), wxHigh);
+    }
+#else
+    // a filtered texel: four channels as values in 0..255
+    struct Texel {
+        unsigned int c[4];
+    };
+
+    static Texel lerpTexels(Texel a, Texel b, int w) {
+        Texel t;
+        for (int i = 0; i < 4; ++i)
+            t.c[i] = (a.c[i] * (256 - w) + b.c[i] * w + 128) >> 8;
+        return t;
+    }
+    static Texel filterTexels(unsigned int t00, unsigned int t10, unsigned int t01, unsigned int t11, int wx, int wy) {
+        Texel left, right;
+        for (int i = 0; i < 4; ++i) {
+            left.c[i] = (((t00 >> (8 * i)) & 255) * (256 - wy) + ((t01 >> (8 * i)) & 255) * wy + 128) >> 8;
+            right.c[i] = (((t10 >> (8 * i)) & 255) * (256 - wy) + ((t11 >> (8 * i)) & 255) * wy + 128) >> 8;
+        }
+        return lerpTexels(left, right, wx);
+    }
+    static unsigned int packTexel(Texel t) {
+        return t.c[0] | t.c[1] << 8 | t.c[2] << 16 | t.c[3] << 24;
+    }
+
+    // GL_LINEAR filtering of the triangle's mip level with GL_REPEAT wrapping, for the four pixels of a quad at once
+    static void sampleQuad(const MipLevel* level, Float4 u, Float4 v, unsigned int* texels) {
+        if (!level) {
+            std::fill(texels, texels + 4, 255u << 24);
+            return;
+        }
+        // lanes outside the triangle extrapolate and can be huge or NaN; the clamp keeps their texel reads in range
+        u = max(min(u - floor(u), Float4(1.0f)), Float4(0.0f));
+        v = max(min(v - floor(v), Float4(1.0f)), Float4(0.0f));
+        Texel colors[4];
+        sampleLevel(*level, u, v, colors);
+        for (int lane = 0; lane < 4; ++lane)
+            texels[lane] = packTexel(colors[lane]);
+    }
+
+    // bilinear samples of one level; u and v already wrapped into [0, 1]
+    static void sampleLevel(const MipLevel& level, Float4 u, Float4 v, Texel* colors) {
+        Float4 x = u * Float4((float)level.width) - Float4(0.5f), y = v * Float4((float)level.height) - Float4(0.5f);
+        Float4 fx = floor(x), fy = floor(y);
+        int xa[4], ya[4], wx[4], wy[4];
+        fx.storeTruncated(xa);
+        fy.storeTruncated(ya);
+        ((x - fx) * Float4(256.0f) + Float4(0.5f)).storeTruncated(wx);
+        ((y - fy) * Float4(256.0f) + Float4(0.5f)).storeTruncated(wy);
+        for (int lane = 0; lane < 4; ++lane) {
+            int x0 = xa[lane], y0 = ya[lane];
+            int x1 = x0 + 1, y1 = y0 + 1;
+            if (x0 < 0) x0 += level.width;
+            if (x1 >= level.width) x1 -= level.width;
+            if (y0 < 0) y0 += level.height;
+            if (y1 >= level.height) y1 -= level.height;
+            const unsigned int* row0 = &level.texels[(size_t)y0 * level.width];
+            const unsigned int* row1 = &level.texels[(size_t)y1 * level.width];
+            colors[lane] = filterTexels(row0[x0], row0[x1], row1[x0], row1[x1], wx[lane], wy[lane]);
+        }
+    }
+#endif
+};
+
+#endif // !SOFTWARE_RENDERER_H
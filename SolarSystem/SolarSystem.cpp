@@ -9,12 +9,36 @@
 #include "Camera.h"
 #include "Sphere.h"
 #include "Texture.h"
+#include "Planet.h"
+#include "Scene.h"
+#include "Framebuffer.h"
+#include "HeadlessContext.h"
+#include "ImageWriter.h"
+#include "PixelReadback.h"
+#include "VideoExport.h"
+#include "ThreadPool.h"
+#include "Screenshot.h"
+#include "Poster.h"
+#include "BatchRenderer.h"
+#include "SoftwareRenderer.h"
+#include "RayTracer.h"
+#include "VulkanRenderer.h"
+#include "FlightRecorder.h"
+#include "InputRecorder.h"
+#include "CameraPath.h"
+#include "FrameStats.h"
+#include "FrameArena.h"
+#define HEAP_CHECK_IMPLEMENTATION
+#include "HeapCheck.h"
+#include "MemoryLedger.h"
 
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_glfw.h"
 #include "imgui/imgui_impl_opengl3.h"
 
 #include <iostream>
+#include <string>
+#include <vector>
 
 #define M_PI 3.14159265358979323846
 
@@ -22,9 +46,63 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
+void handleMouseMove(float xpos, float ypos);
+// ImGui allocates through these, so its memory is counted under MEMORY_UI
+void* imguiAllocate(size_t size, void* userData);
+void imguiFree(void* block, void* userData);
+
+struct AppOptions {
+    std::string recordPath, replayPath, cameraPathFile, frameLogPath;
+    float fixedDeltaTime = 1.0f / 60.0f;
+    int warmupFrames = 10;
+    RenderBackendType backend = BACKEND_GL33;
+    int asteroids = 0;
+    bool gpuCulling = false;
+    bool occlusionCulling = false;
+    std::string moons = "none"; // none, major or all
+    int fragments = 0; // impact fragments spawned per frame
+    int impactPlanet = 3; // Jupiter
+    int ringParticles = 0;
+    bool ringCollisions = false;
+    CollisionResponse ringResponse = COLLISION_BOUNCE;
+    std::string memoryReportPath;
+    double memoryReportSeconds = 10.0; // of sim time in headless runs
+    // headless mode
+    bool headless = false;
+    int width = 1920;
+    int height = 1080;
+    int frames = 1;
+    float planetScale = 1.0f;
+    std::string outputPath;
+    // video export
+    std::string exportPath;
+    int fps = 60;
+    // tiled poster
+    std::string posterPath;
+    int posterWidth = 16384;
+    int posterHeight = 9216;
+    int tileSize = 2048;
+    // batch stills
+    std::string batchPath;
+    int workers = 0;
+    std::string renderer = "gl"; // gl, software or vulkan
+    bool lighting = false;
+    // ray traced still
+    std::string tracePath;
+    int samples = 64;
+    bool referenceShading = false;
+    std::string comparePath;
+};
+int runOffscreen(const AppOptions& options);
+int runSoftware(const AppOptions& options);
+int runVulkan(const AppOptions& options);
+int runBatch(const AppOptions& options);
+int runTrace(const AppOptions& options);
 
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 float lastX = SCR_WIDTH / 2.0f;
@@ -36,23 +114,102 @@ float lastFrame = 0.0f;
 
 bool mouseVisibility = false;
 
-struct Planet {
-    float orbitRadius;
-    float orbitSpeed;
-    float scale;
-    float rotationSpeed;
-    GLuint textureID;
-};
+FlightRecorder flightRecorder;
+InputRecorder inputRecorder;
+CameraPath cameraPath;
+FrameStats frameStats;
+ScreenshotCapture screenshot;
 
-int main()
+int main(int argc, char** argv)
 {
+    AppOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--record" && hasValue) options.recordPath = argv[++i];
+        else if (arg == "--replay" && hasValue) options.replayPath = argv[++i];
+        else if (arg == "--camera-path" && hasValue) options.cameraPathFile = argv[++i];
+        else if (arg == "--fixed-dt" && hasValue) options.fixedDeltaTime = std::stof(argv[++i]);
+        else if (arg == "--frame-log" && hasValue) options.frameLogPath = argv[++i];
+        else if (arg == "--warmup-frames" && hasValue) options.warmupFrames = std::stoi(argv[++i]);
+        else if (arg == "--headless") options.headless = true;
+        else if (arg == "--width" && hasValue) options.width = std::stoi(argv[++i]);
+        else if (arg == "--height" && hasValue) options.height = std::stoi(argv[++i]);
+        else if (arg == "--frames" && hasValue) options.frames = std::stoi(argv[++i]);
+        else if (arg == "--output" && hasValue) options.outputPath = argv[++i];
+        else if (arg == "--planet-scale" && hasValue) options.planetScale = std::stof(argv[++i]);
+        else if (arg == "--export" && hasValue) options.exportPath = argv[++i];
+        else if (arg == "--fps" && hasValue) options.fps = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--poster" && hasValue) options.posterPath = argv[++i];
+        else if (arg == "--poster-width" && hasValue) options.posterWidth = std::stoi(argv[++i]);
+        else if (arg == "--poster-height" && hasValue) options.posterHeight = std::stoi(argv[++i]);
+        else if (arg == "--tile-size" && hasValue) options.tileSize = std::stoi(argv[++i]);
+        else if (arg == "--batch" && hasValue) options.batchPath = argv[++i];
+        else if (arg == "--workers" && hasValue) options.workers = std::stoi(argv[++i]);
+        else if (arg == "--renderer" && hasValue && (std::string(argv[i + 1]) == "gl" || std::string(argv[i + 1]) == "software" || std::string(argv[i + 1]) == "vulkan"))
+            options.renderer = argv[++i];
+        else if (arg == "--lighting") options.lighting = true;
+        else if (arg == "--trace" && hasValue) options.tracePath = argv[++i];
+        else if (arg == "--samples" && hasValue) options.samples = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--shading" && hasValue && (std::string(argv[i + 1]) == "beauty" || std::string(argv[i + 1]) == "reference"))
+            options.referenceShading = std::string(argv[++i]) == "reference";
+        else if (arg == "--compare" && hasValue) options.comparePath = argv[++i];
+        else if (arg == "--backend" && hasValue && parseRenderBackend(argv[i + 1], options.backend)) ++i;
+        else if (arg == "--asteroids" && hasValue) options.asteroids = std::stoi(argv[++i]);
+        else if (arg == "--gpu-culling") options.gpuCulling = true;
+        else if (arg == "--occlusion-culling") options.occlusionCulling = true;
+        else if (arg == "--fragments" && hasValue) options.fragments = std::max(0, std::stoi(argv[++i]));
+        else if (arg == "--impact-planet" && hasValue) options.impactPlanet = std::min(std::max(0, std::stoi(argv[++i])), PLANET_COUNT - 1);
+        else if (arg == "--ring-particles" && hasValue) options.ringParticles = std::max(0, std::stoi(argv[++i]));
+        else if (arg == "--ring-collisions" && hasValue && parseCollisionResponse(argv[i + 1], options.ringResponse)) {
+            options.ringCollisions = true;
+            ++i;
+        }
+        else if (arg == "--memory-report" && hasValue) options.memoryReportPath = argv[++i];
+        else if (arg == "--memory-report-interval" && hasValue) options.memoryReportSeconds = std::max(0.0, std::stod(argv[++i]));
+        else if (arg == "--moons" && hasValue && (std::string(argv[i + 1]) == "none" || std::string(argv[i + 1]) == "major" || std::string(argv[i + 1]) == "all"))
+            options.moons = argv[++i];
+        else {
+            std::cout << "usage: " << argv[0] << " [--record file | --replay file | --camera-path file [--fixed-dt seconds]]"
+                      << " [--frame-log file.csv] [--warmup-frames N] [--backend gl33|gl45] [--asteroids N [--gpu-culling]] [--occlusion-culling] [--moons none|major|all] [--fragments N [--impact-planet P]]"
+                      << " [--ring-particles N [--ring-collisions merge|bounce|fragment]]"
+                      << " [--memory-report file.json [--memory-report-interval seconds]]\n"
+                      << "       " << argv[0] << " --headless [--renderer gl|software|vulkan [--lighting]] [--width W] [--height H] [--frames N] [--planet-scale S] [--output last_frame.ppm]"
+                      << " [--camera-path file] [--fixed-dt seconds] [--frame-log file.csv] [--backend gl33|gl45] [--asteroids N [--gpu-culling]] [--occlusion-culling] [--moons none|major|all] [--fragments N [--impact-planet P]]"
+                      << " [--ring-particles N [--ring-collisions merge|bounce|fragment]]"
+                      << " [--memory-report file.json [--memory-report-interval seconds]]\n"
+                      << "       " << argv[0] << " --export video.y4m|frames.yuv|- [--fps F] [--width W] [--height H] [--frames N | --camera-path file]\n"
+                      << "       " << argv[0] << " --poster poster.png [--poster-width W] [--poster-height H] [--tile-size N] [--headless options]\n"
+                      << "       " << argv[0] << " --batch jobs.txt [--workers N] [--planet-scale S]\n"
+                      << "       " << argv[0] << " --trace still.png|still.ppm [--samples N] [--shading beauty|reference] [--compare gl_frame.ppm] [--headless options]" << std::endl;
+            return arg == "--help" ? 0 : -1;
+        }
+    }
+    if (!options.batchPath.empty())
+        return runBatch(options);
+    if (!options.tracePath.empty())
+        return runTrace(options);
+    if (options.renderer == "software")
+        return runSoftware(options);
+    if (options.renderer == "vulkan")
+        return runVulkan(options);
+    if (options.headless || !options.exportPath.empty() || !options.posterPath.empty())
+        return runOffscreen(options);
+
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    bool gl45 = options.backend == BACKEND_GL45;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, gl45 ? 4 : 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, gl45 ? 5 : 3);
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Solar System Simulation", NULL, NULL);
+    if (!window && gl45) {
+        // no GL 4.5 here; the scene falls back to the gl33 backend
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Solar System Simulation", NULL, NULL);
+    }
     if (!window) {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -70,94 +227,113 @@ int main()
     }
     glEnable(GL_DEPTH_TEST);
 
+    if (!options.recordPath.empty() && !inputRecorder.startRecording(options.recordPath))
+        return -1;
+    if (!options.replayPath.empty() && !inputRecorder.loadReplay(options.replayPath))
+        return -1;
+    if (!options.cameraPathFile.empty() && !cameraPath.load(options.cameraPathFile))
+        return -1;
+    // replays and camera paths are benchmark runs: no vsync, and frame times are always measured
+    bool scriptedRun = inputRecorder.mode == InputRecorder::REPLAY || !cameraPath.keyframes.empty();
+    bool measureFrames = scriptedRun || !options.frameLogPath.empty();
+    if (scriptedRun)
+        glfwSwapInterval(0);
+    if (measureFrames) {
+        frameStats.init();
+        std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+    }
+
     IMGUI_CHECKVERSION();
+    ImGui::SetAllocatorFunctions(imguiAllocate, imguiFree);
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO(); (void)io;
     ImGui::StyleColorsDark();
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330");
 
-    Shader planetShader("shader.vs", "shader.fs");
+    SceneAssets assets;
+    Scene scene(assets, options.backend, (GLADloadproc)glfwGetProcAddress);
+    ThreadPool pool;
+    scene.pool = &pool;
+    scene.asteroidBelt.generate(options.asteroids);
+    if (options.moons != "none")
+        scene.setMoons(moonCatalogue(options.moons == "all"));
+    if (options.gpuCulling)
+        scene.enableGpuCulling(assets);
+    assets.release();
+    if (options.occlusionCulling)
+        scene.enableOcclusionCulling();
+    if (options.ringParticles > 0 && scene.enableRings(options.ringParticles)) {
+        scene.saturnRings->particles.Collisions = options.ringCollisions;
+        scene.saturnRings->particles.collisions.Response = options.ringResponse;
+    }
+    if (measureFrames)
+        std::cout << "Backend: " << scene.backend->name() << std::endl;
     Shader lightingShader("lighting_shader.vs", "lighting_shader.fs");
-    Sphere sphere;
-
-    Texture sunTexture("sun.jpg");
-    Texture mercuryTexture("mercury.jpg");
-    Texture venusTexture("venus.jpg");
-    Texture earthTexture("earth.jpg");
-    Texture marsTexture("mars.jpg");
-    Texture jupiterTexture("jupiter.jpg");
-    Texture saturnTexture("saturn.jpg");
-    Texture uranusTexture("uranus.jpg");
-    Texture neptuneTexture("neptune.jpg");
-
-    planetShader.use();
-    planetShader.setInt("texture1", 0);
-
-    std::vector<Planet> planets = {
-        {5.0f, 1.0f, 0.00916f, 1.0f, earthTexture.textureID},           // Earth
-        {7.0f, 1.62f, 0.0087f, 1.0f / 243.0f, venusTexture.textureID},  // Venus
-        {15.0f, 0.53f, 0.00487f, 1.03f, marsTexture.textureID},         // Mars
-        {30.0f, 0.08f, 0.1005f, 2.5f, jupiterTexture.textureID},        // Jupiter
-        {40.0f, 0.03f, 0.0837f, 2.3f, saturnTexture.textureID},         // Saturn
-        {50.0f, 0.0119f, 0.0365f, 1.4f, uranusTexture.textureID},       // Uranus
-        {60.0f, 0.00606f, 0.0354f, 1.3f, neptuneTexture.textureID},     // Neptune
-        {3.0f, 4.15f, 0.00351f, 1.0f / 58.6f, mercuryTexture.textureID} // Mercury
-    };
 
-    float planetScale = 1.0f;
+    float& planetScale = scene.planetScale;
     static const char* timeModes[] = { "1 sec = 1 year", "1 sec = 1 month", "1 sec = 1 week", "1 sec = 1 day" };
     static int currentMode = 0; // default: 1 sec = 1 day
-    float timeScaleDaysPerSecond = 1.0f; // ensure it's synced with currentMode
-    float timeScaleRotation = 1.0f;
+    float& timeScaleDaysPerSecond = scene.timeScaleDaysPerSecond; // ensure it's synced with currentMode
+    float& timeScaleRotation = scene.timeScaleRotation;
+
+    int fragmentsPerFrame = options.fragments, impactPlanet = options.impactPlanet;
+    scene.reserveImpactFragments(fragmentsPerFrame, 1.0f / 60.0f);
 
+    // sim time only advances by deltaTime, so replays with recorded or fixed steps are deterministic
+    double simTime = 0.0;
+    lastFrame = static_cast<float>(glfwGetTime());
+
+    FrameHeapCheck heapCheck;
+    heapCheck.WarmupFrames = options.warmupFrames;
+    MemoryReportWriter memoryReport;
+    memoryReport.Path = options.memoryReportPath;
+    memoryReport.IntervalSeconds = options.memoryReportSeconds;
 
     while (!glfwWindowShouldClose(window))
     {
+        beginFrameArenas();
+        heapCheck.beginFrame();
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
-        processInput(window);
-        glClearColor(0.01f, 0.01f, 0.01f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glActiveTexture(GL_TEXTURE0);
-
-        float time = glfwGetTime();
-        float simTimeInDays = time / timeScaleDaysPerSecond;
-        int earthDayCounter = static_cast<int>(simTimeInDays);
-
-        glBindTexture(GL_TEXTURE_2D, sunTexture.textureID);
-        glm::mat4 model = glm::mat4(1.0f);
-        planetShader.setMat4("model", model);
-        sphere.renderSphere();
-
-        for (const auto& planet : planets) {
-
-
-            float orbitAngle = simTimeInDays * planet.orbitSpeed * 2.0f * M_PI;
-            float rotationAngle = ( planet.rotationSpeed * 2.0f * M_PI )  * timeScaleRotation * time;
-
-            glm::vec3 position = glm::vec3(
-                sin(orbitAngle) * planet.orbitRadius,
-                0.0f,
-                cos(orbitAngle) * planet.orbitRadius
-            );
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, position);
-            model = glm::rotate(model, rotationAngle, glm::vec3(0, 1, 0));
-            model = glm::scale(model, glm::vec3(planet.scale) * planetScale);
-
-            glBindTexture(GL_TEXTURE_2D, planet.textureID);
-            planetShader.setMat4("model", model);
-            sphere.renderSphere();
+        if (!cameraPath.keyframes.empty()) {
+            if (simTime > cameraPath.duration())
+                break;
+            deltaTime = options.fixedDeltaTime;
+            cameraPath.apply(camera, static_cast<float>(simTime));
+        }
+        if (!inputRecorder.beginFrame(deltaTime, planetScale, timeScaleDaysPerSecond, timeScaleRotation))
+            break;
+        if (inputRecorder.mode == InputRecorder::REPLAY) {
+            const InputRecorder::Frame& frame = inputRecorder.frame();
+            deltaTime = frame.deltaTime;
+            planetScale = frame.planetScale;
+            timeScaleDaysPerSecond = frame.timeScaleDaysPerSecond;
+            timeScaleRotation = frame.timeScaleRotation;
         }
+        flightRecorder.beginFrame(deltaTime);
+        if (measureFrames)
+            frameStats.beginFrame();
 
-        planetShader.use();
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        planetShader.setMat4("projection", projection);
-        glm::mat4 view = camera.GetViewMatrix();
-        planetShader.setMat4("view", view);
+        {
+            FlightRecorder::Scope scope(flightRecorder, "input");
+            processInput(window);
+        }
+        scene.spawnImpact(impactPlanet, fragmentsPerFrame, simTime);
+        {
+            FlightRecorder::Scope scope(flightRecorder, "planets");
+            glm::mat4 projection = Scene::projectionMatrix(camera, (float)framebufferWidth / (float)std::max(framebufferHeight, 1));
+            scene.render(camera.GetViewMatrix(), projection, simTime);
+        }
+        if (screenshot.begin(framebufferWidth, framebufferHeight)) {
+            FlightRecorder::Scope scope(flightRecorder, "screenshot");
+            glm::mat4 projection = Scene::projectionMatrix(camera, (float)framebufferWidth / (float)std::max(framebufferHeight, 1));
+            scene.render(camera.GetViewMatrix(), projection, simTime);
+            screenshot.end(framebufferWidth, framebufferHeight);
+        }
+        screenshot.poll();
 
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
@@ -175,16 +351,136 @@ int main()
             case 3: timeScaleDaysPerSecond = 365.0f; timeScaleRotation = 1.0f; break;
             }
         }
+        if (ImGui::CollapsingHeader("Flight recorder")) {
+            ImGui::Checkbox("Record", &flightRecorder.Enabled);
+            ImGui::SliderFloat("Spike threshold (x median)", &flightRecorder.SpikeFactor, 1.2f, 10.0f);
+            ImGui::SliderFloat("Dump cooldown (s)", &flightRecorder.CooldownSeconds, 1.0f, 120.0f);
+            ImGui::Text("Median frame: %.2f ms", flightRecorder.LastMedian * 1000.0f);
+            ImGui::Text("Dumps: %d %s", flightRecorder.DumpCount, flightRecorder.LastDumpPath.c_str());
+        }
+        if (scene.occlusionCuller && ImGui::CollapsingHeader("Occlusion culling")) {
+            ImGui::SliderFloat("Occluder radius (px)", &scene.occlusionCuller->OccluderPixels, 8.0f, 512.0f);
+            ImGui::Text("Hidden: %d of %d tested bodies", scene.occlusionCuller->Hidden, scene.occlusionCuller->Tested);
+        }
+        if (scene.asteroidBelt.asteroids.size() > 0 && !scene.asteroidCuller && ImGui::CollapsingHeader("Asteroid belt")) {
+            ImGui::SliderFloat("Re-sort at (x sorted spacing)", &scene.asteroidBelt.ResortFactor, 1.05f, 4.0f);
+            ImGui::Text("Sorted %d times; spacing %.3f, %.3f after the last sort", scene.asteroidBelt.Sorts, scene.asteroidBelt.Spacing,
+                        scene.asteroidBelt.SortedSpacing);
+        }
+        if (scene.saturnRings && ImGui::CollapsingHeader("Saturn rings")) {
+            SaturnRings& rings = *scene.saturnRings;
+            ImGui::SliderFloat("Annulus under (px)", &rings.AnnulusPixels, 0.0f, 512.0f);
+            ImGui::SliderFloat("Particles per pixel", &rings.ParticlesPerPixel, 0.05f, 4.0f);
+            ImGui::Checkbox("Collisions", &rings.particles.Collisions);
+            int response = rings.particles.collisions.Response;
+            if (ImGui::Combo("Response", &response, "merge\0bounce\0fragment\0"))
+                rings.particles.collisions.Response = (CollisionResponse)response;
+            if (rings.DrewAnnulus)
+                ImGui::Text("Annulus; %zu particles resting", rings.particles.size());
+            else
+                ImGui::Text("%zu of %zu particles drawn, %zu collisions last step", rings.ParticlesDrawn, rings.particles.size(),
+                            rings.particles.collisions.Collisions);
+        }
+        if (ImGui::CollapsingHeader("Impact fragments")) {
+            ImGui::SliderInt("Per frame", &fragmentsPerFrame, 0, 10000);
+            ImGui::SliderInt("Planet", &impactPlanet, 0, PLANET_COUNT - 1);
+            ImGui::SliderFloat("Lifetime (s)", &scene.impactFragments.Lifetime, 0.1f, 10.0f);
+            ImGui::Text("%zu live, room for %zu, storage grew %d times", scene.impactFragments.fragments.size(),
+                        scene.impactFragments.fragments.capacity(), scene.impactFragments.fragments.Growths);
+            if (ImGui::Button("Clear"))
+                scene.impactFragments.fragments.clear();
+        }
+        if (ImGui::CollapsingHeader("Memory")) {
+            if (heapTrackingEnabled()) {
+                ImGui::Text("Heap: %.2f MB", heapBytes() / (1024.0 * 1024.0));
+                for (int t = 0; t < MEMORY_TAG_COUNT; ++t) {
+                    const HeapTagUsage& usage = heapTagUsage()[t];
+                    ImGui::Text("  %-12s %8.2f MB, peak %8.2f MB, %lld blocks", memoryTagName((MemoryTag)t), usage.bytes.load() / (1024.0 * 1024.0),
+                                usage.peakBytes.load() / (1024.0 * 1024.0), usage.allocations.load());
+                }
+            }
+            else {
+                ImGui::TextUnformatted("Heap: not tracked (build with SOLAR_MEMORY_TRACKING)");
+            }
+            GpuMemoryLedger& gpu = gpuMemory();
+            ImGui::Text("GPU (estimated): %.2f MB, peak %.2f MB", gpu.totalBytes() / (1024.0 * 1024.0), gpu.PeakBytes / (1024.0 * 1024.0));
+            for (int t = 0; t < MEMORY_TAG_COUNT; ++t)
+                if (size_t bytes = gpu.bytes((MemoryTag)t))
+                    ImGui::Text("  %-12s %8.2f MB", memoryTagName((MemoryTag)t), bytes / (1024.0 * 1024.0));
+            if (ImGui::TreeNode("GPU objects")) {
+                gpu.eachObject([](const GpuMemoryLedger::Object& object) {
+                    ImGui::Text("%s %u, %s: %s, %.1f KB", gpuObjectKindName(object.kind), object.name, memoryTagName(object.tag), object.label, object.bytes / 1024.0);
+                });
+                ImGui::TreePop();
+            }
+            if (ImGui::Button("Write report")) {
+                // from then on it's kept up to date like one asked for with --memory-report
+                if (memoryReport.Path.empty())
+                    memoryReport.Path = "memory_report.json";
+                memoryReport.write(glfwGetTime());
+            }
+            if (memoryReport.ReportsWritten > 0) {
+                ImGui::SameLine();
+                ImGui::Text("%s, every %.0f s", memoryReport.Path.c_str(), memoryReport.IntervalSeconds);
+            }
+        }
+        if (ImGui::CollapsingHeader("Screenshot (F12)")) {
+            ImGui::SliderInt("Resolution scale", &screenshot.Scale, 1, 4);
+            if (ImGui::Button("Capture"))
+                screenshot.request();
+            if (screenshot.busy()) {
+                ImGui::SameLine();
+                ImGui::Text("capturing...");
+            }
+            if (screenshot.CaptureCount > 0) {
+                ImGui::TextUnformatted(screenshot.LastPath.c_str());
+                ImGui::Text("%dx%d, %.1f MB", screenshot.LastWidth, screenshot.LastHeight, screenshot.LastFileBytes / (1024.0 * 1024.0));
+                ImGui::Text("Readback %.1f ms, encode %.1f ms, total %.1f ms", screenshot.LastReadbackMs, screenshot.LastEncodeMs, screenshot.LastTotalMs);
+            }
+        }
         ImGui::End();
 
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        {
+            FlightRecorder::Scope scope(flightRecorder, "imgui");
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+        if (measureFrames)
+            frameStats.endFrame();
+        {
+            FlightRecorder::Scope scope(flightRecorder, "swap");
+            glfwSwapBuffers(window);
+            if (measureFrames)
+                frameStats.framePresented();
+            glfwPollEvents();
+        }
+        if (inputRecorder.mode == InputRecorder::REPLAY) {
+            const InputRecorder::Event* events = inputRecorder.frameEvents();
+            for (size_t i = 0; i < inputRecorder.frame().eventCount; ++i) {
+                if (events[i].type == InputRecorder::MOUSE)
+                    handleMouseMove(static_cast<float>(events[i].x), static_cast<float>(events[i].y));
+                else
+                    camera.ProcessMouseScroll(static_cast<float>(events[i].y));
+            }
+        }
+        inputRecorder.endFrame();
+        simTime += deltaTime;
+        heapCheck.endFrame();
+        memoryReport.update(glfwGetTime());
+    }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    if (measureFrames) {
+        frameStats.finish();
+        if (!options.frameLogPath.empty())
+            frameStats.writeCsv(options.frameLogPath);
+        frameStats.writeSummary(std::cout, options.warmupFrames);
     }
 
-    sphere.DeleteBuffers();
+    if (!memoryReport.Path.empty())
+        memoryReport.write(glfwGetTime());
+
+    screenshot.DeleteBuffers();
+    scene.DeleteBuffers();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -192,21 +488,476 @@ int main()
     return 0;
 }
 
+// offscreen runs use a surfaceless EGL context where available (render servers), otherwise an invisible window.
+// The gl45 backend asks for a GL 4.5 context and settles for 3.3; loader is what glad was loaded with.
+bool createOffscreenContext(HeadlessContext& context, GLFWwindow*& hiddenWindow, RenderBackendType backend, GLADloadproc& loader)
+{
+    bool gl45 = backend == BACKEND_GL45;
+#ifdef SOLAR_HAS_EGL
+    (void)hiddenWindow;
+    if (!(gl45 && context.create(4, 5)) && !context.create(3, 3))
+        return false;
+    if (!context.makeCurrent())
+        return false;
+    loader = (GLADloadproc)HeadlessContext::getProcAddress;
+    if (!gladLoadGLLoader(loader)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return false;
+    }
+#else
+    (void)context;
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, gl45 ? 4 : 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, gl45 ? 5 : 3);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    hiddenWindow = glfwCreateWindow(64, 64, "Solar System Offscreen", NULL, NULL);
+    if (!hiddenWindow && gl45) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        hiddenWindow = glfwCreateWindow(64, 64, "Solar System Offscreen", NULL, NULL);
+    }
+    if (!hiddenWindow) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(hiddenWindow);
+    loader = (GLADloadproc)glfwGetProcAddress;
+    if (!gladLoadGLLoader(loader)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return false;
+    }
+#endif
+    std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+    return true;
+}
+
+void destroyOffscreenContext(HeadlessContext& context, GLFWwindow* hiddenWindow)
+{
+    context.releaseCurrent();
+    if (hiddenWindow) {
+        glfwDestroyWindow(hiddenWindow);
+        glfwTerminate();
+    }
+}
+
+// renders the same scene into an offscreen framebuffer with no window or input: --headless frames, or
+// --export, which steps sim time by one video frame per output frame and streams the frames to a video file
+int runOffscreen(const AppOptions& options)
+{
+    bool exporting = !options.exportPath.empty();
+    if (exporting && options.exportPath == "-") {
+        // stdout carries the video, so everything we would print goes to stderr instead
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
+    HeadlessContext context;
+    GLFWwindow* hiddenWindow = nullptr;
+    GLADloadproc loader = nullptr;
+    if (!createOffscreenContext(context, hiddenWindow, options.backend, loader))
+        return -1;
+    glEnable(GL_DEPTH_TEST);
+
+    float frameDeltaTime = exporting ? 1.0f / options.fps : options.fixedDeltaTime;
+    if (!options.cameraPathFile.empty() && !cameraPath.load(options.cameraPathFile))
+        return -1;
+    int frameCount = cameraPath.keyframes.empty() ? options.frames : (int)(cameraPath.duration() / frameDeltaTime) + 1;
+
+    Framebuffer framebuffer;
+    if (!framebuffer.create(options.width, options.height))
+        return -1;
+    SceneAssets assets;
+    Scene scene(assets, options.backend, loader);
+    scene.planetScale = options.planetScale;
+    scene.asteroidBelt.generate(options.asteroids);
+    if (options.moons != "none")
+        scene.setMoons(moonCatalogue(options.moons == "all"));
+    if (options.gpuCulling)
+        scene.enableGpuCulling(assets);
+    assets.release();
+    if (options.occlusionCulling)
+        scene.enableOcclusionCulling();
+    if (options.ringParticles > 0 && scene.enableRings(options.ringParticles)) {
+        scene.saturnRings->particles.Collisions = options.ringCollisions;
+        scene.saturnRings->particles.collisions.Response = options.ringResponse;
+    }
+    scene.reserveImpactFragments(options.fragments, frameDeltaTime);
+    std::cout << "Backend: " << scene.backend->name() << std::endl;
+    frameStats.init();
+
+    ThreadPool pool;
+    scene.pool = &pool;
+    VideoExporter video;
+    PixelReadback readback;
+    if (exporting) {
+        if (!video.open(options.exportPath, options.width, options.height, options.fps, pool))
+            return -1;
+        readback.create(options.width, options.height, 3);
+    }
+    auto exportStart = std::chrono::steady_clock::now();
+
+    FrameHeapCheck heapCheck;
+    heapCheck.WarmupFrames = options.warmupFrames;
+    heapCheck.Fatal = cameraPath.keyframes.empty(); // along a camera path, what's on screen keeps changing
+    frameStats.frames.reserve(frameCount);
+    MemoryReportWriter memoryReport;
+    memoryReport.Path = options.memoryReportPath;
+    memoryReport.IntervalSeconds = options.memoryReportSeconds;
+
+    double simTime = 0.0;
+    bool readbackFailed = false;
+    int framesRead = 0;
+    for (int frame = 0; frame < frameCount && !readbackFailed; ++frame) {
+        beginFrameArenas();
+        heapCheck.beginFrame();
+        if (!cameraPath.keyframes.empty())
+            cameraPath.apply(camera, static_cast<float>(simTime));
+        frameStats.beginFrame();
+        framebuffer.bind();
+        scene.spawnImpact(options.impactPlanet, options.fragments, simTime);
+        glm::mat4 projection = Scene::projectionMatrix(camera, (float)options.width / (float)options.height);
+        scene.render(camera.GetViewMatrix(), projection, simTime);
+        frameStats.endFrame();
+        if (exporting) {
+            // the oldest read in the ring finished while this and the previous frames were rendered
+            if (readback.full()) {
+                unsigned char* rgba = video.acquireFrame();
+                if (readback.collect(rgba, true)) {
+                    video.submitFrame(rgba);
+                    ++framesRead;
+                }
+                else {
+                    video.releaseFrame(rgba);
+                    readbackFailed = true;
+                }
+            }
+            readback.start(framebuffer.FBO);
+            glFlush();
+        }
+        else {
+            // no swap to wait on: finishing the frame is what completes it
+            glFinish();
+        }
+        frameStats.framePresented();
+        simTime += frameDeltaTime;
+        heapCheck.endFrame();
+        memoryReport.update(simTime);
+    }
+
+    if (exporting) {
+        while (!readbackFailed && readback.pending() > 0) {
+            unsigned char* rgba = video.acquireFrame();
+            if (readback.collect(rgba, true)) {
+                video.submitFrame(rgba);
+                ++framesRead;
+            }
+            else {
+                video.releaseFrame(rgba);
+                readbackFailed = true;
+            }
+        }
+        // a skipped frame would shift every later one in time, so the export stops at the first that can't be read
+        if (readbackFailed)
+            std::cout << "ERROR::VIDEO_EXPORT::READBACK_FAILED: frame " << framesRead << " couldn't be read back, export stopped" << std::endl;
+        video.close();
+        readback.DeleteBuffers();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - exportStart).count();
+        std::cout << "Exported " << video.FramesWritten << " frames of " << options.width << "x" << options.height << " in " << seconds << " s ("
+                  << video.FramesWritten / seconds << " fps); convert " << video.ConvertSeconds << " s, write " << video.WriteSeconds
+                  << " s, render thread waited " << video.StallSeconds << " s for the encoder" << std::endl;
+    }
+    bool posterFailed = false;
+    if (!options.posterPath.empty()) {
+        // the poster shows the last rendered frame
+        PosterRenderer poster;
+        poster.TileSize = options.tileSize;
+        posterFailed = !poster.render(scene, camera, std::max(0.0, simTime - frameDeltaTime), options.posterPath, options.posterWidth, options.posterHeight);
+        if (!posterFailed)
+            std::cout << "Wrote " << options.posterPath << " (" << poster.FileBytes / (1024.0 * 1024.0) << " MB) in " << poster.RenderSeconds << " s, "
+                      << poster.EncodeWaitSeconds << " s waiting for compression, " << poster.PeakRowBufferBytes / (1024.0 * 1024.0) << " MB of tile rows" << std::endl;
+    }
+    if (!exporting && !options.outputPath.empty()) {
+        std::vector<unsigned char> pixels((size_t)options.width * options.height * 3);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer.FBO);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, options.width, options.height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+        if (writePPM(options.outputPath, options.width, options.height, pixels.data()))
+            std::cout << "Wrote " << options.outputPath << std::endl;
+    }
+
+    frameStats.finish();
+    if (!options.frameLogPath.empty())
+        frameStats.writeCsv(options.frameLogPath);
+    frameStats.writeSummary(std::cout, std::min(options.warmupFrames, frameCount - 1));
+    std::cout << "Draw calls per frame: " << scene.drawCalls() << std::endl;
+    if (!scene.moons.empty())
+        std::cout << "Transform hierarchy: " << scene.transforms.size() << " nodes for " << scene.moons.size() << " moons, "
+                  << scene.transforms.LastUpdated << " updated in the last frame" << std::endl;
+    if (options.fragments > 0)
+        std::cout << "Impact fragments: " << scene.impactFragments.fragments.size() << " live, room for " << scene.impactFragments.fragments.capacity()
+                  << ", storage grew " << scene.impactFragments.fragments.Growths << " times" << std::endl;
+    if (scene.asteroidBelt.Sorts > 0)
+        std::cout << "Asteroid order: sorted " << scene.asteroidBelt.Sorts << " times, mean spacing " << scene.asteroidBelt.Spacing << " (" << scene.asteroidBelt.SortedSpacing
+                  << " after the last sort)" << std::endl;
+    if (scene.saturnRings) {
+        SaturnRings& rings = *scene.saturnRings;
+        std::cout << "Saturn rings: " << (rings.DrewAnnulus ? std::string("annulus") : std::to_string(rings.ParticlesDrawn) + " particles drawn") << " of "
+                  << rings.particles.size() << " in the last frame";
+        if (rings.particles.Collisions)
+            std::cout << ", " << collisionResponseName(rings.particles.collisions.Response) << " collisions, " << rings.particles.collisions.Collisions << " in the last step";
+        std::cout << std::endl;
+    }
+    if (scene.asteroidCuller) {
+        std::vector<unsigned int> lods = scene.asteroidCuller->lodCounts();
+        std::cout << "GPU culling: " << lods[0] + lods[1] + lods[2] << " of " << scene.asteroidBelt.asteroids.size() << " asteroids drawn, "
+                  << lods[0] << " / " << lods[1] << " / " << lods[2] << " at each level of detail, " << scene.asteroidCuller->CullPasses
+                  << " cull passes, counts " << (scene.asteroidCuller->IndirectCounts ? "written into indirect draws on the GPU" : "read back from queries") << std::endl;
+    }
+    if (scene.occlusionCuller) {
+        OcclusionCuller& occlusion = *scene.occlusionCuller;
+        occlusion.collectStats(true);
+        std::cout << "Occlusion culling: " << (occlusion.FramesCounted ? (double)occlusion.TotalHidden / occlusion.FramesCounted : 0.0) << " of "
+                  << (occlusion.FramesCounted ? (double)occlusion.TotalTested / occlusion.FramesCounted : 0.0) << " tested bodies hidden per frame over "
+                  << occlusion.FramesCounted << " frames; last frame " << occlusion.Hidden << " of " << occlusion.Tested << std::endl;
+    }
+    writeMemorySummary(std::cout);
+    if (!memoryReport.Path.empty() && memoryReport.write(simTime))
+        std::cout << "Wrote " << memoryReport.Path << std::endl;
+
+    scene.DeleteBuffers();
+    framebuffer.DeleteBuffers();
+    destroyOffscreenContext(context, hiddenWindow);
+    return readbackFailed || posterFailed ? -1 : 0;
+}
+
+// the --headless and --export frame loop of the renderers that draw into an RGBA color buffer in memory, rows
+// bottom-up (software, Vulkan)
+template <typename ColorBufferRenderer>
+int renderColorBufferFrames(const AppOptions& options, ColorBufferRenderer& renderer, ThreadPool& pool)
+{
+    bool exporting = !options.exportPath.empty();
+    float frameDeltaTime = exporting ? 1.0f / options.fps : options.fixedDeltaTime;
+    if (!options.cameraPathFile.empty() && !cameraPath.load(options.cameraPathFile))
+        return -1;
+    int frameCount = cameraPath.keyframes.empty() ? options.frames : (int)(cameraPath.duration() / frameDeltaTime) + 1;
+
+    VideoExporter video;
+    if (exporting && !video.open(options.exportPath, options.width, options.height, options.fps, pool))
+        return -1;
+    frameStats.init(false);
+    FrameHeapCheck heapCheck;
+    heapCheck.WarmupFrames = options.warmupFrames;
+    heapCheck.Fatal = cameraPath.keyframes.empty(); // along a camera path, what's on screen keeps changing
+    frameStats.frames.reserve(frameCount);
+    MemoryReportWriter memoryReport;
+    memoryReport.Path = options.memoryReportPath;
+    memoryReport.IntervalSeconds = options.memoryReportSeconds;
+
+    double simTime = 0.0;
+    for (int frame = 0; frame < frameCount; ++frame) {
+        beginFrameArenas();
+        heapCheck.beginFrame();
+        if (!cameraPath.keyframes.empty())
+            cameraPath.apply(camera, static_cast<float>(simTime));
+        frameStats.beginFrame();
+        glm::mat4 projection = Scene::projectionMatrix(camera, (float)options.width / (float)options.height);
+        renderer.render(camera.GetViewMatrix(), projection, simTime);
+        frameStats.endFrame();
+        if (exporting) {
+            unsigned char* rgba = video.acquireFrame();
+            std::memcpy(rgba, renderer.color.data(), renderer.color.size());
+            video.submitFrame(rgba);
+        }
+        frameStats.framePresented();
+        simTime += frameDeltaTime;
+        heapCheck.endFrame();
+        memoryReport.update(simTime);
+    }
+    if (exporting) {
+        video.close();
+        std::cout << "Exported " << video.FramesWritten << " frames" << std::endl;
+    }
+    else if (!options.outputPath.empty()) {
+        std::vector<unsigned char> pixels((size_t)options.width * options.height * 3);
+        for (size_t i = 0; i < (size_t)options.width * options.height; ++i)
+            std::memcpy(&pixels[i * 3], &renderer.color[i * 4], 3);
+        if (writePPM(options.outputPath, options.width, options.height, pixels.data()))
+            std::cout << "Wrote " << options.outputPath << std::endl;
+    }
+
+    frameStats.finish();
+    if (!options.frameLogPath.empty())
+        frameStats.writeCsv(options.frameLogPath);
+    frameStats.writeSummary(std::cout, std::min(options.warmupFrames, frameCount - 1));
+    if (!memoryReport.Path.empty() && memoryReport.write(simTime))
+        std::cout << "Wrote " << memoryReport.Path << std::endl;
+    return 0;
+}
+
+// the --headless and --export runs on the CPU renderer, without any GL context
+int runSoftware(const AppOptions& options)
+{
+    if (options.exportPath == "-")
+        std::cout.rdbuf(std::cerr.rdbuf());
+    if (!options.posterPath.empty())
+        std::cout << "ERROR::SOFTWARE_RENDERER::NO_POSTER: posters need the GL renderer" << std::endl;
+
+    ThreadPool pool;
+    SceneAssets assets;
+    SoftwareRenderer renderer(assets, pool);
+    renderer.planetScale = options.planetScale;
+    renderer.resize(options.width, options.height);
+    std::cout << "Renderer: software, " << pool.threadCount() + 1 << " threads" << std::endl;
+    return renderColorBufferFrames(options, renderer, pool);
+}
+
+// the --headless and --export runs on Vulkan, with command buffers recorded on all cores
+int runVulkan(const AppOptions& options)
+{
+    if (options.exportPath == "-")
+        std::cout.rdbuf(std::cerr.rdbuf());
+    if (!options.posterPath.empty())
+        std::cout << "ERROR::VULKAN::NO_POSTER: posters need the GL renderer" << std::endl;
+
+    ThreadPool pool;
+    SceneAssets assets;
+    VulkanRenderer renderer(assets, pool);
+    renderer.planetScale = options.planetScale;
+    renderer.lighting = options.lighting;
+    if (!renderer.init(options.width, options.height))
+        return -1;
+    std::cout << "Renderer: Vulkan, " << renderer.DeviceName << ", recording on " << pool.threadCount() + 1 << " threads" << std::endl;
+    int result = renderColorBufferFrames(options, renderer, pool);
+    std::cout << "Secondary command buffers per frame: " << renderer.CommandBuffersRecorded << ", recorded in " << renderer.RecordMs << " ms" << std::endl;
+    return result;
+}
+
+// renders every still of a job file on several headless contexts at once
+int runBatch(const AppOptions& options)
+{
+    std::vector<BatchJob> jobs;
+    if (!loadBatchJobs(options.batchPath, jobs))
+        return -1;
+    if (jobs.empty())
+        return 0;
+    SceneAssets assets;
+    BatchRenderer batch;
+    int workers = options.workers > 0 ? options.workers : std::max(1, (int)std::thread::hardware_concurrency());
+    auto start = std::chrono::steady_clock::now();
+    bool ok = batch.run(jobs, workers, assets, options.planetScale);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int frames = 0;
+    for (size_t i = 0; i < batch.workerStats.size(); ++i) {
+        const BatchRenderer::WorkerStats& stats = batch.workerStats[i];
+        frames += stats.frames;
+        std::cout << "worker " << i << ": " << stats.frames << " frames in " << stats.seconds << " s ("
+                  << (stats.seconds > 0.0 ? stats.frames / stats.seconds : 0.0) << " frames/s), setup " << stats.setupSeconds << " s" << std::endl;
+    }
+    std::cout << frames << " of " << jobs.size() << " stills in " << seconds << " s (" << frames / seconds << " frames/s)";
+    if (batch.failedJobs > 0)
+        std::cout << ", " << batch.failedJobs << " failed";
+    std::cout << std::endl;
+    return ok ? 0 : -1;
+}
+
+// ray traces the frame a --headless run with the same options ends on, writing a refined preview after 1, 2, 4, ...
+// samples per pixel; with --compare, checks an image of that frame against it
+int runTrace(const AppOptions& options)
+{
+    if (!options.cameraPathFile.empty() && !cameraPath.load(options.cameraPathFile))
+        return -1;
+    int frameCount = cameraPath.keyframes.empty() ? options.frames : (int)(cameraPath.duration() / options.fixedDeltaTime) + 1;
+    double simTime = 0.0;
+    for (int frame = 1; frame < frameCount; ++frame)
+        simTime += options.fixedDeltaTime;
+    if (!cameraPath.keyframes.empty())
+        cameraPath.apply(camera, static_cast<float>(simTime));
+
+    ThreadPool pool;
+    SceneAssets assets;
+    RayTracer tracer(assets, pool);
+    tracer.planetScale = options.planetScale;
+    tracer.shading = options.referenceShading ? RayTracer::Reference : RayTracer::Beauty;
+    glm::mat4 projection = Scene::projectionMatrix(camera, (float)options.width / (float)options.height);
+    tracer.begin(options.width, options.height, camera.GetViewMatrix(), projection, simTime);
+    std::cout << "Tracing " << options.width << "x" << options.height << " at " << options.samples << " samples per pixel on "
+              << pool.threadCount() + 1 << " threads" << std::endl;
+
+    const std::string& path = options.tracePath;
+    bool png = path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0;
+    std::vector<unsigned char> pixels;
+    auto start = std::chrono::steady_clock::now();
+    double traceSeconds = 0.0;
+    int nextPreview = 1;
+    while (tracer.SamplesPerPixel < options.samples) {
+        auto passStart = std::chrono::steady_clock::now();
+        tracer.addPass();
+        traceSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - passStart).count();
+        if (tracer.SamplesPerPixel == nextPreview || tracer.SamplesPerPixel == options.samples) {
+            nextPreview *= 2;
+            tracer.resolve(pixels);
+            if (!(png ? writePNG(path, options.width, options.height, 3, pixels.data(), &pool) : writePPM(path, options.width, options.height, pixels.data())))
+                return -1;
+            std::cout << "Wrote " << path << " at " << tracer.SamplesPerPixel << " samples, "
+                      << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+        }
+    }
+    std::cout << "Traced " << tracer.RaysTraced / 1e6 << " M rays in " << traceSeconds << " s (" << tracer.RaysTraced / 1e6 / traceSeconds << " M rays/s)" << std::endl;
+
+    if (options.comparePath.empty())
+        return 0;
+    int compareWidth = 0, compareHeight = 0;
+    std::vector<unsigned char> compared;
+    if (!readPPM(options.comparePath, compareWidth, compareHeight, compared))
+        return -1;
+    if (compareWidth != options.width || compareHeight != options.height) {
+        std::cout << "ERROR::TRACE::SIZE_MISMATCH: " << options.comparePath << " is " << compareWidth << "x" << compareHeight << std::endl;
+        return -1;
+    }
+    // the exact spheres and supersampled textures differ from a rasterizer's mesh and mipmaps by a few values, and
+    // its aliased silhouettes by up to a pixel; a value is only off when no value of the trace's 3x3 neighborhood
+    // is within 32 of it, and more than 0.05% of those is a regression
+    int maxDifference = 0;
+    double totalDifference = 0.0;
+    size_t offValues = 0;
+    for (int y = 0; y < options.height; ++y) {
+        for (int x = 0; x < options.width; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                size_t i = ((size_t)y * options.width + x) * 3 + c;
+                int difference = std::abs((int)pixels[i] - (int)compared[i]);
+                maxDifference = std::max(maxDifference, difference);
+                totalDifference += difference;
+                int nearest = difference;
+                for (int ny = std::max(0, y - 1); ny <= std::min(options.height - 1, y + 1); ++ny)
+                    for (int nx = std::max(0, x - 1); nx <= std::min(options.width - 1, x + 1); ++nx)
+                        nearest = std::min(nearest, std::abs((int)pixels[((size_t)ny * options.width + nx) * 3 + c] - (int)compared[i]));
+                if (nearest > 32) ++offValues;
+            }
+        }
+    }
+    double offShare = (double)offValues / pixels.size();
+    bool matches = offShare <= 0.0005;
+    std::cout << "Compared with " << options.comparePath << ": max difference " << maxDifference << ", mean " << totalDifference / pixels.size()
+              << ", " << offShare * 100.0 << "% of values off (" << (matches ? "match" : "MISMATCH") << ")" << std::endl;
+    return matches ? 0 : 1;
+}
+
 void processInput(GLFWwindow* window)
 {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    if (inputRecorder.isKeyPressed(window, GLFW_KEY_ESCAPE))
         glfwSetWindowShouldClose(window, true);
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    if (inputRecorder.isKeyPressed(window, GLFW_KEY_W))
         camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    if (inputRecorder.isKeyPressed(window, GLFW_KEY_S))
         camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    if (inputRecorder.isKeyPressed(window, GLFW_KEY_A))
         camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    if (inputRecorder.isKeyPressed(window, GLFW_KEY_D))
         camera.ProcessKeyboard(RIGHT, deltaTime);
 
     static bool tabPressedLastFrame = false;
-    bool tabPressed = glfwGetKey(window, GLFW_KEY_TAB) == GLFW_PRESS;
+    bool tabPressed = inputRecorder.isKeyPressed(window, GLFW_KEY_TAB);
     if (tabPressed && !tabPressedLastFrame) {
         mouseVisibility = !mouseVisibility;
         glfwSetInputMode(window, GLFW_CURSOR, mouseVisibility ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
@@ -214,18 +965,32 @@ void processInput(GLFWwindow* window)
         lastY = SCR_HEIGHT / 2.0f;
     }
     tabPressedLastFrame = tabPressed;
+
+    static bool screenshotPressedLastFrame = false;
+    bool screenshotPressed = inputRecorder.isKeyPressed(window, GLFW_KEY_F12);
+    if (screenshotPressed && !screenshotPressedLastFrame)
+        screenshot.request();
+    screenshotPressedLastFrame = screenshotPressed;
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
+    framebufferWidth = width;
+    framebufferHeight = height;
     glViewport(0, 0, width, height);
 }
 
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
+{
+    // during a replay the camera only follows the recorded events
+    if (inputRecorder.mode == InputRecorder::REPLAY) return;
+    inputRecorder.recordMouse(xposIn, yposIn);
+    handleMouseMove(static_cast<float>(xposIn), static_cast<float>(yposIn));
+}
+
+void handleMouseMove(float xpos, float ypos)
 {
     if (mouseVisibility) return;
-    float xpos = static_cast<float>(xposIn);
-    float ypos = static_cast<float>(yposIn);
     if (firstMouse) {
         lastX = xpos;
         lastY = ypos;
@@ -240,5 +1005,18 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
+    if (inputRecorder.mode == InputRecorder::REPLAY) return;
+    inputRecorder.recordScroll(yoffset);
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
+
+void* imguiAllocate(size_t size, void* /*userData*/)
+{
+    MemoryScope scope(MEMORY_UI);
+    return ::operator new(size);
+}
+
+void imguiFree(void* block, void* /*userData*/)
+{
+    ::operator delete(block);
+}
@@ -0,0 +1,148 @@
+#pragma once
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include "MortonOrder.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Points in a uniform grid of cubic cells, hashed into a table with about two slots per point so that an unbounded
+// grid costs no more than the points in it. Rebuilt from scratch every step: the points' slots are sorted with
+// radixSortByKey, which is a counting sort per digit spread over the pool, and each slot records where its run of
+// sorted points starts. Only a row's y and z are hashed, with x added on, so the cells along x are consecutive
+// slots and their points consecutive in sorted order: a query reads 9 runs of 3 cells rather than 27 cells, each
+// of them likely a cache miss. Cells that hash to the same slot share it, so a query sees some points from far
+// away too and has to check the distance itself.
+class SpatialHashGrid {
+
+public:
+    // builds the grid over points [0, count); nothing is allocated once it has seen count points
+    void build(const float* x, const float* y, const float* z, size_t count, float cellSize, ThreadPool* pool = nullptr) {
+        inverseCellSize = 1.0f / cellSize;
+        slotBits = 10;
+        while (((size_t)1 << slotBits) < 2 * count) ++slotBits;
+        size_t slots = (size_t)1 << slotBits;
+        if (slotStart.size() < slots + 1) slotStart.resize(slots + 1);
+        if (keys.size() < count) {
+            keys.resize(count);
+            keyScratch.resize(count);
+            sorted.resize(count);
+            sortedScratch.resize(count);
+        }
+        this->count = count;
+
+        const int grain = 16384;
+        parallel(pool, count, grain, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                keys[i] = slot(cell(x[i]), cell(y[i]), cell(z[i]));
+                sorted[i] = (uint32_t)i;
+            }
+        });
+        radixSortByKey(keys.data(), sorted.data(), keyScratch.data(), sortedScratch.data(), count, slotBits, pool);
+        // the slots from just after the one before a point's up to its own start there; each is written once
+        parallel(pool, count, grain, [&](size_t begin, size_t end) {
+            for (size_t s = begin; s < end; ++s) {
+                size_t first = s == 0 ? 0 : (size_t)keys[s - 1] + 1;
+                for (size_t k = first; k <= keys[s]; ++k)
+                    slotStart[k] = (uint32_t)s;
+            }
+        });
+        size_t first = count == 0 ? 0 : (size_t)keys[count - 1] + 1;
+        std::fill(slotStart.begin() + first, slotStart.begin() + slots + 1, (uint32_t)count);
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    // the points by slot: sortedPoints()[s] is the point at sorted position s
+    const uint32_t* sortedPoints() const {
+        return sorted.data();
+    }
+
+    // calls f(s) for the sorted position s of every point in the slots of the 27 cells around (x, y, z), once
+    // each, even where rows of cells hash to overlapping slots
+    template <typename F>
+    void eachNeighbour(float x, float y, float z, F f) const {
+        int cx = cell(x), cy = cell(y), cz = cell(z);
+        size_t slots = (size_t)1 << slotBits;
+        // runs of sorted positions, two for a row that wraps around the end of the table
+        uint32_t begins[18], ends[18];
+        int runs = 0;
+        for (int dz = -1; dz <= 1; ++dz)
+            for (int dy = -1; dy <= 1; ++dy) {
+                size_t s = slot(cx - 1, cy + dy, cz + dz);
+                size_t last = s + 3;
+                if (last > slots) {
+                    addRun(begins, ends, runs, slotStart[0], slotStart[last - slots]);
+                    last = slots;
+                }
+                addRun(begins, ends, runs, slotStart[s], slotStart[last]);
+            }
+        for (int r = 0; r < runs; ++r)
+            for (uint32_t p = begins[r]; p < ends[r]; ++p)
+                f((size_t)p);
+    }
+
+private:
+    float inverseCellSize = 1.0f;
+    int slotBits = 10;
+    size_t count = 0;
+    std::vector<uint32_t> slotStart; // the sorted position of each slot's first point, and the count at the end
+    std::vector<uint64_t> keys, keyScratch;   // the slot of each sorted point
+    std::vector<uint32_t> sorted, sortedScratch;
+
+    int cell(float v) const {
+        return (int)std::floor(v * inverseCellSize);
+    }
+
+    uint32_t slot(int cx, int cy, int cz) const {
+        uint32_t h = ((uint32_t)cy * 19349663u ^ (uint32_t)cz * 83492791u) + (uint32_t)cx;
+        return h & (((uint32_t)1 << slotBits) - 1);
+    }
+
+    // adds [begin, end) to the runs, merged with any it overlaps, keeping them apart and in order
+    static void addRun(uint32_t* begins, uint32_t* ends, int& runs, uint32_t begin, uint32_t end) {
+        if (begin >= end) return;
+        int r = 0;
+        while (r < runs && ends[r] < begin) ++r;
+        int merged = r;
+        while (merged < runs && begins[merged] <= end) {
+            begin = std::min(begin, begins[merged]);
+            end = std::max(end, ends[merged]);
+            ++merged;
+        }
+        // runs [r, merged) become the one run at r
+        int shift = 1 - (merged - r);
+        if (shift > 0)
+            for (int i = runs - 1; i >= merged; --i) {
+                begins[i + shift] = begins[i];
+                ends[i + shift] = ends[i];
+            }
+        else if (shift < 0)
+            for (int i = merged; i < runs; ++i) {
+                begins[i + shift] = begins[i];
+                ends[i + shift] = ends[i];
+            }
+        begins[r] = begin;
+        ends[r] = end;
+        runs += shift;
+    }
+
+    template <typename Body>
+    static void parallel(ThreadPool* pool, size_t count, int grain, const Body& body) {
+        auto chunks = [&](int begin, int end) {
+            body((size_t)begin * grain, std::min(count, (size_t)end * grain));
+        };
+        int chunkCount = (int)((count + grain - 1) / grain);
+        if (pool) pool->parallelFor(chunkCount, chunks);
+        else chunks(0, chunkCount);
+    }
+};
+
+#endif // !SPATIAL_HASH_H
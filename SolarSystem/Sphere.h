@@ -9,21 +9,23 @@
 #include <numbers>
 #include <iostream>
 
+#include "MemoryLedger.h"
+
+struct SphereMesh;
 
 class Sphere {
 
 private:
     // Sphere Parameters
-    const int LATITUDE_DIVISIONS = 40;
-    const int LONGITUDE_DIVISIONS = 40;
+    const int LATITUDE_DIVISIONS;
+    const int LONGITUDE_DIVISIONS;
     const float RADIUS = 1.0f;
     unsigned int textureID;
 	unsigned int VAO, VBO, EBO;
-	std::vector<float> vertices;
-	std::vector<unsigned int> indices;
-public:
-    Sphere() {
-        generateSphereData();
+    size_t indexCount = 0;
+
+    void upload(const std::vector<float>& vertexData, const std::vector<unsigned int>& indexData) {
+        indexCount = indexData.size();
 
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -32,10 +34,12 @@ public:
         glBindVertexArray(VAO);
 
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(float), vertexData.data(), GL_STATIC_DRAW);
+        gpuMemory().record(GPU_BUFFER, VBO, MEMORY_MESHES, "sphere vertices", vertexData.size() * sizeof(float));
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexData.size() * sizeof(unsigned int), indexData.data(), GL_STATIC_DRAW);
+        gpuMemory().record(GPU_BUFFER, EBO, MEMORY_MESHES, "sphere indices", indexData.size() * sizeof(unsigned int));
 
         // Position attribute (layout = 0)
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -47,18 +51,33 @@ public:
 
         glBindVertexArray(0);
     }
+public:
+    // the mesh is only kept on the GPU
+    Sphere(int latitudeDivisions = 40, int longitudeDivisions = 40) : LATITUDE_DIVISIONS(latitudeDivisions), LONGITUDE_DIVISIONS(longitudeDivisions) {
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+        {
+            MemoryScope scope(MEMORY_MESHES);
+            generateSphereData(vertices, indices, LATITUDE_DIVISIONS, LONGITUDE_DIVISIONS, RADIUS);
+        }
+        upload(vertices, indices);
+    }
+
+    // uploads mesh data generated once and shared, e.g. by several GL contexts
+    explicit Sphere(const SphereMesh& mesh);
 
-    void generateSphereData() {
-        for (int lat = 0; lat <= LATITUDE_DIVISIONS; ++lat) {
-            for (int lon = 0; lon <= LONGITUDE_DIVISIONS; ++lon) {
-                float theta = lat * 3.14 / LATITUDE_DIVISIONS;
-                float phi = lon * 2.0f * 3.14 / LONGITUDE_DIVISIONS;
+    // fills interleaved position + UV vertices and triangle indices; needs no GL context
+    static void generateSphereData(std::vector<float>& vertices, std::vector<unsigned int>& indices, int latitudeDivisions, int longitudeDivisions, float radius) {
+        for (int lat = 0; lat <= latitudeDivisions; ++lat) {
+            for (int lon = 0; lon <= longitudeDivisions; ++lon) {
+                float theta = lat * 3.14 / latitudeDivisions;
+                float phi = lon * 2.0f * 3.14 / longitudeDivisions;
 
-                float x = RADIUS * sin(theta) * cos(phi);
-                float y = RADIUS * cos(theta);
-                float z = RADIUS * sin(theta) * sin(phi);
-                float u = (float)lon / LONGITUDE_DIVISIONS;
-                float v = (float)lat / LATITUDE_DIVISIONS;
+                float x = radius * sin(theta) * cos(phi);
+                float y = radius * cos(theta);
+                float z = radius * sin(theta) * sin(phi);
+                float u = (float)lon / longitudeDivisions;
+                float v = (float)lat / latitudeDivisions;
 
                 // Push vertex data (position + UV)
                 vertices.push_back(x);
@@ -68,10 +87,10 @@ public:
                 vertices.push_back(v);
             }
         }
-        for (int lat = 0; lat < LATITUDE_DIVISIONS; ++lat) {
-            for (int lon = 0; lon < LONGITUDE_DIVISIONS; ++lon) {
-                int current = lat * (LONGITUDE_DIVISIONS + 1) + lon;
-                int next = current + LONGITUDE_DIVISIONS + 1;
+        for (int lat = 0; lat < latitudeDivisions; ++lat) {
+            for (int lon = 0; lon < longitudeDivisions; ++lon) {
+                int current = lat * (longitudeDivisions + 1) + lon;
+                int next = current + longitudeDivisions + 1;
 
                 // Triangle 1
                 indices.push_back(current);
@@ -88,15 +107,35 @@ public:
 
     void renderSphere() {
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, (GLsizei)indexCount, GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
     }
     void DeleteBuffers() {
         glDeleteVertexArrays(1, &VAO);
         glDeleteBuffers(1, &VBO);
         glDeleteBuffers(1, &EBO);
+        gpuMemory().release(GPU_BUFFER, VBO);
+        gpuMemory().release(GPU_BUFFER, EBO);
     }
 
 
 };
+
+// sphere vertices and indices on the CPU, for sharing between GL contexts
+struct SphereMesh {
+    int latitudeDivisions;
+    int longitudeDivisions;
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+
+    SphereMesh(int latitudeDivisions = 40, int longitudeDivisions = 40) : latitudeDivisions(latitudeDivisions), longitudeDivisions(longitudeDivisions) {
+        MemoryScope scope(MEMORY_MESHES);
+        Sphere::generateSphereData(vertices, indices, latitudeDivisions, longitudeDivisions, 1.0f);
+    }
+};
+
+inline Sphere::Sphere(const SphereMesh& mesh) : LATITUDE_DIVISIONS(mesh.latitudeDivisions), LONGITUDE_DIVISIONS(mesh.longitudeDivisions) {
+    upload(mesh.vertices, mesh.indices);
+}
+
 #endif // !SPHERE_H
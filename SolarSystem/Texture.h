@@ -7,8 +7,31 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#include "MemoryLedger.h"
+
 #include <iostream>
 #include <string>
+#include <vector>
+
+// A decoded image in memory, so several GL contexts can upload the same file without decoding it again.
+struct TextureImage {
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    std::vector<unsigned char> pixels;
+    std::string source; // the file, for the memory ledger
+
+    TextureImage() {}
+    explicit TextureImage(const std::string& filePath) : source(filePath) {
+        MemoryScope scope(MEMORY_TEXTURES);
+        unsigned char* data = stbi_load(filePath.c_str(), &width, &height, &components, 0);
+        if (data)
+            pixels.assign(data, data + (size_t)width * height * components);
+        else
+            std::cout << "Texture failed to load at path: " << filePath.c_str() << std::endl;
+        stbi_image_free(data);
+    }
+};
 
 class Texture {
     
@@ -16,36 +39,34 @@ class Texture {
 public:
     unsigned int textureID;
 
-	Texture(std::string filePath) {
+	Texture(std::string filePath) : Texture(TextureImage(filePath)) {
+	}
+
+    // uploads an already decoded image; an empty image leaves an empty texture
+    explicit Texture(const TextureImage& image) {
         glGenTextures(1, &textureID);
 
-        int width, height, nrComponents;
-        unsigned char* data = stbi_load(filePath.c_str(), &width, &height, &nrComponents, 0);
-        if (data)
+        if (!image.pixels.empty())
         {
-            GLenum format;
-            if (nrComponents == 1)
+            GLenum format = GL_RGB;
+            if (image.components == 1)
                 format = GL_RED;
-            else if (nrComponents == 3)
+            else if (image.components == 3)
                 format = GL_RGB;
-            else if (nrComponents == 4)
+            else if (image.components == 4)
                 format = GL_RGBA;
 
             glBindTexture(GL_TEXTURE_2D, textureID);
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.data());
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
             glGenerateMipmap(GL_TEXTURE_2D);
+            gpuMemory().record(GPU_TEXTURE, textureID, MEMORY_TEXTURES, image.source.c_str(), estimateTextureBytes(image.width, image.height, image.components == 1 ? 1 : 4, true));
 
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Texture failed to load at path: " << filePath.c_str() << std::endl;
-            stbi_image_free(data);
         }
 	}
 
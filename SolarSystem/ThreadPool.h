@@ -0,0 +1,204 @@
+#pragma once
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads for CPU-side jobs (pixel conversion, encoding, simulation kernels).
+class ThreadPool {
+
+public:
+    // threadCount = 0 uses one worker per hardware thread, minus the calling thread
+    explicit ThreadPool(int threadCount = 0) {
+        if (threadCount <= 0)
+            threadCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+        for (int i = 0; i < threadCount; ++i)
+            workers.emplace_back([this]() { workerLoop(); });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    int threadCount() const {
+        return (int)workers.size();
+    }
+
+    // runs task on a worker thread
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pushTask(std::move(task));
+            ++unfinished;
+        }
+        wake.notify_one();
+    }
+
+    // blocks until every submitted task has finished
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this]() { return unfinished == 0; });
+    }
+
+    // calls body(begin, end) over [0, count) in chunks of at least grain items, on the workers and the
+    // calling thread; returns once every chunk is done. The caller never waits for a worker to pick the job up,
+    // so this is safe to call from inside another pool task. Once the pool has seen as many jobs at a time as it
+    // gets, this doesn't allocate.
+    template <typename Body>
+    void parallelFor(int count, const Body& body, int grain = 1) {
+        if (count <= 0) return;
+        grain = std::max(grain, 1);
+        int helpers = std::min((count + grain - 1) / grain - 1, threadCount());
+        {
+            // tasks still queued mean the workers are behind (e.g. descheduled); more helpers would only make the
+            // queue, and the jobs it holds on to, grow
+            std::lock_guard<std::mutex> lock(mutex);
+            helpers = std::min(helpers, threadCount() - (int)taskCount);
+        }
+        if (helpers <= 0) {
+            body(0, count);
+            return;
+        }
+        Job* job = acquireJob();
+        job->body = &body;
+        job->invoke = [](const void* body, int begin, int end) { (*static_cast<const Body*>(body))(begin, end); };
+        job->count = count;
+        // a few chunks per thread so uneven work still balances
+        job->chunkSize = std::max(grain, count / ((helpers + 1) * 4));
+        job->next = 0;
+        job->completed = 0;
+        // each helper's, and the caller's, released only once it's done waiting below
+        job->references = helpers + 1;
+        // two pointers, which std::function keeps without allocating
+        for (int i = 0; i < helpers; ++i)
+            submit([this, job]() { drain(job); });
+        runChunks(job);
+        {
+            std::unique_lock<std::mutex> lock(job->mutex);
+            job->done.wait(lock, [&]() { return job->completed.load() == count; });
+        }
+        releaseJob(job);
+    }
+
+private:
+    // a parallelFor in flight; recycled once the caller and every helper are done with it
+    struct Job {
+        std::atomic<int> next{ 0 };
+        std::atomic<int> completed{ 0 };
+        std::atomic<int> references{ 0 };
+        std::mutex mutex;
+        std::condition_variable done;
+        const void* body = nullptr;
+        void (*invoke)(const void*, int, int) = nullptr;
+        int count = 0;
+        int chunkSize = 1;
+    };
+
+    std::vector<std::thread> workers;
+    // ring buffer of the queued tasks, taskCount of them from taskHead; grows when full
+    std::vector<std::function<void()>> tasks;
+    size_t taskHead = 0;
+    size_t taskCount = 0;
+    std::vector<std::unique_ptr<Job>> jobs;
+    std::vector<Job*> spareJobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    int unfinished = 0;
+    bool stopping = false;
+
+    // a helper's share of the job, after which it lets go of the job
+    void drain(Job* job) {
+        runChunks(job);
+        releaseJob(job);
+    }
+
+    // helpers that start after the last chunk was taken only touch the job's counters, never the body
+    void runChunks(Job* job) {
+        for (int begin = job->next.fetch_add(job->chunkSize); begin < job->count; begin = job->next.fetch_add(job->chunkSize)) {
+            int end = std::min(begin + job->chunkSize, job->count);
+            job->invoke(job->body, begin, end);
+            if (job->completed.fetch_add(end - begin) + (end - begin) == job->count) {
+                std::lock_guard<std::mutex> lock(job->mutex);
+                job->done.notify_all();
+            }
+        }
+    }
+
+    Job* acquireJob() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (spareJobs.empty()) {
+            jobs.emplace_back(new Job());
+            spareJobs.reserve(jobs.size());
+            return jobs.back().get();
+        }
+        Job* job = spareJobs.back();
+        spareJobs.pop_back();
+        return job;
+    }
+
+    void releaseJob(Job* job) {
+        if (job->references.fetch_sub(1) != 1) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        spareJobs.push_back(job);
+    }
+
+    // with mutex held
+    void pushTask(std::function<void()>&& task) {
+        if (taskCount == tasks.size()) {
+            std::vector<std::function<void()>> grown(std::max<size_t>(16, tasks.size() * 2));
+            for (size_t i = 0; i < taskCount; ++i)
+                grown[i] = std::move(tasks[(taskHead + i) % tasks.size()]);
+            tasks.swap(grown);
+            taskHead = 0;
+        }
+        tasks[(taskHead + taskCount) % tasks.size()] = std::move(task);
+        ++taskCount;
+    }
+
+    // with mutex held, and a task queued
+    std::function<void()> popTask() {
+        std::function<void()> task = std::move(tasks[taskHead]);
+        tasks[taskHead] = nullptr;
+        taskHead = (taskHead + 1) % tasks.size();
+        --taskCount;
+        return task;
+    }
+
+    void workerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stopping || taskCount > 0; });
+                if (stopping && taskCount == 0)
+                    return;
+                task = popTask();
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--unfinished == 0)
+                    idle.notify_all();
+            }
+        }
+    }
+};
+
+#endif // !THREAD_POOL_H
@@ -0,0 +1,119 @@
+#pragma once
+#ifndef TRANSFORM_HIERARCHY_H
+#define TRANSFORM_HIERARCHY_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Simd.h"
+
+#include <iostream>
+#include <vector>
+
+// Nodes with a local translation, rotation and uniform scale relative to their parent, kept in flat arrays with
+// every parent before its children. Nodes are only ever appended, so that order holds by construction, and one
+// front-to-back pass brings every world matrix up to date. A node is recomputed only when its local transform
+// was set since the last update or its parent's world matrix changed in this one, so subtrees nobody touched
+// cost a flag test each.
+class TransformHierarchy {
+
+public:
+    // nodes whose world matrix the last update recomputed
+    int LastUpdated = 0;
+
+    size_t size() const {
+        return parents.size();
+    }
+
+    void clear() {
+        parents.clear();
+        positions.clear();
+        rotations.clear();
+        scales.clear();
+        locals.clear();
+        worlds.clear();
+        dirty.clear();
+        moved.clear();
+    }
+
+    // appends a node under parent (-1 for a root) and returns its index; parent has to exist already
+    int add(int parent, const glm::vec3& position = glm::vec3(0.0f), const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), float scale = 1.0f) {
+        if (parent < -1 || parent >= (int)parents.size()) {
+            std::cout << "ERROR::TRANSFORM_HIERARCHY::NO_PARENT: node " << parent << " doesn't exist" << std::endl;
+            return -1;
+        }
+        parents.push_back(parent);
+        positions.push_back(position);
+        rotations.push_back(rotation);
+        scales.push_back(scale);
+        locals.push_back(glm::mat4(1.0f));
+        worlds.push_back(glm::mat4(1.0f));
+        dirty.push_back(1);
+        moved.push_back(0);
+        return (int)parents.size() - 1;
+    }
+
+    void setLocal(int node, const glm::vec3& position, const glm::quat& rotation, float scale) {
+        positions[node] = position;
+        rotations[node] = rotation;
+        scales[node] = scale;
+        dirty[node] = 1;
+    }
+
+    int parent(int node) const {
+        return parents[node];
+    }
+
+    const glm::mat4& world(int node) const {
+        return worlds[node];
+    }
+
+    void update() {
+        LastUpdated = 0;
+        for (size_t i = 0; i < parents.size(); ++i) {
+            int parent = parents[i];
+            if (!dirty[i] && (parent < 0 || !moved[parent])) {
+                moved[i] = 0;
+                continue;
+            }
+            if (dirty[i]) {
+                compose(positions[i], rotations[i], scales[i], locals[i]);
+                dirty[i] = 0;
+            }
+            if (parent < 0) worlds[i] = locals[i];
+            else multiply(worlds[parent], locals[i], worlds[i]);
+            moved[i] = 1;
+            ++LastUpdated;
+        }
+    }
+
+    // translation * rotation * scale
+    static void compose(const glm::vec3& position, const glm::quat& rotation, float scale, glm::mat4& out) {
+        glm::mat3 r = glm::mat3_cast(rotation);
+        out[0] = glm::vec4(r[0] * scale, 0.0f);
+        out[1] = glm::vec4(r[1] * scale, 0.0f);
+        out[2] = glm::vec4(r[2] * scale, 0.0f);
+        out[3] = glm::vec4(position, 1.0f);
+    }
+
+    // out = a * b, a column of out at a time
+    static void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+        Float4 c0 = Float4::load(&a[0][0]), c1 = Float4::load(&a[1][0]), c2 = Float4::load(&a[2][0]), c3 = Float4::load(&a[3][0]);
+        for (int j = 0; j < 4; ++j) {
+            Float4 column = c0 * Float4(b[j][0]) + c1 * Float4(b[j][1]) + c2 * Float4(b[j][2]) + c3 * Float4(b[j][3]);
+            column.store(&out[j][0]);
+        }
+    }
+
+private:
+    std::vector<int> parents;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<float> scales;
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> worlds;
+    std::vector<unsigned char> dirty; // local transform set since the last update
+    std::vector<unsigned char> moved; // world matrix recomputed by the last update
+};
+
+#endif // !TRANSFORM_HIERARCHY_H
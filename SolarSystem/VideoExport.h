@@ -0,0 +1,246 @@
+#pragma once
+#ifndef VIDEO_EXPORT_H
+#define VIDEO_EXPORT_H
+
+#include "Simd.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// RGBA8 -> planar YUV 4:2:0 (BT.601 limited range) for chroma rows [chromaBegin, chromaEnd).
+// The source rows are bottom-up as read from GL and come out top-down; width and height must be even.
+inline void convertRGBAToI420(const unsigned char* rgba, int width, int height, unsigned char* yPlane, unsigned char* uPlane, unsigned char* vPlane, int chromaBegin, int chromaEnd)
+{
+    const int chromaWidth = width / 2;
+    for (int cy = chromaBegin; cy < chromaEnd; ++cy) {
+        const unsigned char* row0 = rgba + (size_t)(height - 1 - 2 * cy) * width * 4;
+        const unsigned char* row1 = rgba + (size_t)(height - 2 - 2 * cy) * width * 4;
+        unsigned char* y0 = yPlane + (size_t)(2 * cy) * width;
+        unsigned char* y1 = y0 + width;
+        unsigned char* u = uPlane + (size_t)cy * chromaWidth;
+        unsigned char* v = vPlane + (size_t)cy * chromaWidth;
+        int x = 0;
+#ifdef SOLAR_HAS_SSE2
+        // 8 pixels of both rows per iteration: 16 luma and 4 chroma samples
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i yCoef = _mm_set_epi16(0, 25, 129, 66, 0, 25, 129, 66);
+        const __m128i uCoef = _mm_set_epi16(0, 112, -74, -38, 0, 112, -74, -38);
+        const __m128i vCoef = _mm_set_epi16(0, -18, -94, 112, 0, -18, -94, 112);
+        // adds the two halves of each madd result pair: [a0+a1, a2+a3, b0+b1, b2+b3]
+        auto pairSum = [](__m128i a, __m128i b) {
+            __m128 fa = _mm_castsi128_ps(a), fb = _mm_castsi128_ps(b);
+            return _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0))),
+                                 _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1))));
+        };
+        auto luma4 = [&](__m128i px) {
+            __m128i sum = pairSum(_mm_madd_epi16(_mm_unpacklo_epi8(px, zero), yCoef), _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), yCoef));
+            return _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8), _mm_set1_epi32(16));
+        };
+        // 2x2 block sums of RGBA as 16 bit lanes: columns summed over both rows, then neighbouring columns
+        auto blockSums = [&](__m128i top, __m128i bottom) {
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+            return _mm_unpacklo_epi64(_mm_add_epi16(lo, _mm_srli_si128(lo, 8)), _mm_add_epi16(hi, _mm_srli_si128(hi, 8)));
+        };
+        auto chroma4 = [&](__m128i blocks01, __m128i blocks23, __m128i coef) {
+            __m128i sum = pairSum(_mm_madd_epi16(blocks01, coef), _mm_madd_epi16(blocks23, coef));
+            return _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(512)), 10), _mm_set1_epi32(128));
+        };
+        for (; x + 8 <= width; x += 8) {
+            __m128i a0 = _mm_loadu_si128((const __m128i*)(row0 + x * 4));
+            __m128i a1 = _mm_loadu_si128((const __m128i*)(row0 + x * 4 + 16));
+            __m128i b0 = _mm_loadu_si128((const __m128i*)(row1 + x * 4));
+            __m128i b1 = _mm_loadu_si128((const __m128i*)(row1 + x * 4 + 16));
+
+            __m128i ya = _mm_packs_epi32(luma4(a0), luma4(a1));
+            __m128i yb = _mm_packs_epi32(luma4(b0), luma4(b1));
+            _mm_storel_epi64((__m128i*)(y0 + x), _mm_packus_epi16(ya, ya));
+            _mm_storel_epi64((__m128i*)(y1 + x), _mm_packus_epi16(yb, yb));
+
+            __m128i blocks01 = blockSums(a0, b0);
+            __m128i blocks23 = blockSums(a1, b1);
+            __m128i u4 = chroma4(blocks01, blocks23, uCoef);
+            __m128i v4 = chroma4(blocks01, blocks23, vCoef);
+            int uBytes = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(u4, u4), zero));
+            int vBytes = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(v4, v4), zero));
+            std::memcpy(u + x / 2, &uBytes, 4);
+            std::memcpy(v + x / 2, &vBytes, 4);
+        }
+#endif
+        for (; x < width; x += 2) {
+            const unsigned char* p[4] = { row0 + x * 4, row0 + x * 4 + 4, row1 + x * 4, row1 + x * 4 + 4 };
+            unsigned char* yOut[4] = { y0 + x, y0 + x + 1, y1 + x, y1 + x + 1 };
+            int r = 0, g = 0, b = 0;
+            for (int i = 0; i < 4; ++i) {
+                *yOut[i] = (unsigned char)(((66 * p[i][0] + 129 * p[i][1] + 25 * p[i][2] + 128) >> 8) + 16);
+                r += p[i][0];
+                g += p[i][1];
+                b += p[i][2];
+            }
+            u[x / 2] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+            v[x / 2] = (unsigned char)(((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+        }
+    }
+}
+
+// Streams rendered frames as YUV4MPEG2 (.y4m, or "-" for stdout so it can be piped into an encoder) or as raw
+// I420 for any other path. The caller fills RGBA buffers from acquireFrame() and hands them back with
+// submitFrame(); a background thread converts them on the thread pool and writes them in order.
+class VideoExporter {
+
+public:
+    // stats
+    long long FramesWritten = 0;
+    double ConvertSeconds = 0.0;
+    double WriteSeconds = 0.0;
+    double StallSeconds = 0.0; // time the render thread waited for a free frame buffer
+
+    ~VideoExporter() {
+        close();
+    }
+
+    bool open(const std::string& path, int w, int h, int fps, ThreadPool& threadPool, int maxFramesInFlight = 4) {
+        if (w % 2 || h % 2) {
+            std::cout << "ERROR::VIDEO_EXPORT::ODD_SIZE: 4:2:0 needs an even width and height" << std::endl;
+            return false;
+        }
+        if (path == "-") {
+#ifdef _WIN32
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+            file = stdout;
+        }
+        else {
+            file = std::fopen(path.c_str(), "wb");
+        }
+        if (!file) {
+            std::cout << "ERROR::VIDEO_EXPORT::CANNOT_WRITE: " << path << std::endl;
+            return false;
+        }
+        width = w;
+        height = h;
+        pool = &threadPool;
+        y4m = path == "-" || (path.size() >= 4 && path.compare(path.size() - 4, 4, ".y4m") == 0);
+        if (y4m)
+            std::fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+
+        buffers.assign(maxFramesInFlight, std::vector<unsigned char>((size_t)width * height * 4));
+        for (std::vector<unsigned char>& buffer : buffers)
+            freeFrames.push_back(buffer.data());
+        yuv.resize((size_t)width * height * 3 / 2);
+        stopping = false;
+        encoder = std::thread([this]() { encodeLoop(); });
+        return true;
+    }
+
+    // an RGBA buffer of width * height * 4 bytes to read the next frame into; waits while every buffer is queued
+    unsigned char* acquireFrame() {
+        auto start = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mutex);
+        frameFreed.wait(lock, [this]() { return !freeFrames.empty(); });
+        unsigned char* frame = freeFrames.front();
+        freeFrames.pop_front();
+        StallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return frame;
+    }
+
+    // hands back a buffer from acquireFrame() that won't be submitted
+    void releaseFrame(unsigned char* rgba) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeFrames.push_back(rgba);
+        }
+        frameFreed.notify_one();
+    }
+
+    void submitFrame(unsigned char* rgba) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queuedFrames.push_back(rgba);
+        }
+        frameQueued.notify_one();
+    }
+
+    // writes every queued frame and closes the output
+    void close() {
+        if (!encoder.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        frameQueued.notify_one();
+        encoder.join();
+        if (file && file != stdout)
+            std::fclose(file);
+        else if (file)
+            std::fflush(file);
+        file = nullptr;
+    }
+
+private:
+    std::FILE* file = nullptr;
+    int width = 0;
+    int height = 0;
+    bool y4m = true;
+    ThreadPool* pool = nullptr;
+    std::vector<std::vector<unsigned char>> buffers;
+    std::vector<unsigned char> yuv;
+    std::deque<unsigned char*> freeFrames;
+    std::deque<unsigned char*> queuedFrames;
+    std::mutex mutex;
+    std::condition_variable frameQueued;
+    std::condition_variable frameFreed;
+    std::thread encoder;
+    bool stopping = false;
+
+    void encodeLoop() {
+        while (true) {
+            unsigned char* rgba;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                frameQueued.wait(lock, [this]() { return stopping || !queuedFrames.empty(); });
+                if (queuedFrames.empty())
+                    return;
+                rgba = queuedFrames.front();
+                queuedFrames.pop_front();
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            unsigned char* yPlane = yuv.data();
+            unsigned char* uPlane = yPlane + (size_t)width * height;
+            unsigned char* vPlane = uPlane + (size_t)width * height / 4;
+            pool->parallelFor(height / 2, [&](int begin, int end) {
+                convertRGBAToI420(rgba, width, height, yPlane, uPlane, vPlane, begin, end);
+            }, 8);
+            auto converted = std::chrono::steady_clock::now();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                freeFrames.push_back(rgba);
+            }
+            frameFreed.notify_one();
+
+            if (y4m)
+                std::fputs("FRAME\n", file);
+            std::fwrite(yuv.data(), 1, yuv.size(), file);
+            ++FramesWritten;
+            ConvertSeconds += std::chrono::duration<double>(converted - start).count();
+            WriteSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - converted).count();
+        }
+    }
+};
+
+#endif // !VIDEO_EXPORT_H
@@ -0,0 +1,909 @@
+#pragma once
+#ifndef VULKAN_RENDERER_H
+#define VULKAN_RENDERER_H
+
+// An offscreen Vulkan renderer for the same scene, for scenes too big for GL's single submitting thread:
+// - the bodies are split into batches and each batch's secondary command buffer is recorded on its own worker,
+//   from its own command pool, then executed by one primary command buffer per frame
+// - descriptor sets are written once at startup (one per frame uniform buffer, one per texture) and only
+//   rebound afterwards; model matrices go in push constants
+// - pipelines are built through a pipeline cache that is loaded from and saved to disk
+// Shaders are SPIR-V compiled from planet_vk.vert, planet_vk.frag and lighting_vk.frag:
+//   glslc planet_vk.vert -o planet_vk.vert.spv  (same for the other two)
+// Builds with SOLAR_VULKAN defined and the Vulkan loader linked; runs on any Vulkan 1.1 device, including
+// Mesa's lavapipe on machines without a GPU. The color buffer is RGBA8 with rows bottom-up, like SoftwareRenderer.
+#include <glm/glm.hpp>
+
+#include "Planet.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef SOLAR_VULKAN
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#endif
+
+class VulkanRenderer {
+
+public:
+    // sim settings, same meaning as in Scene
+    float planetScale = 1.0f;
+    float timeScaleDaysPerSecond = 1.0f;
+    float timeScaleRotation = 1.0f;
+    // lights the planets from the sun with the port of lighting_shader.fs; off draws the same image as Scene
+    bool lighting = false;
+
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> color;
+
+    std::string DeviceName;
+    // stats of the last frame
+    int CommandBuffersRecorded = 0;
+    double RecordMs = 0.0;
+
+    VulkanRenderer(const SceneAssets& sceneAssets, ThreadPool& threadPool) : assets(sceneAssets), pool(threadPool) {}
+    VulkanRenderer(const VulkanRenderer&) = delete;
+    VulkanRenderer& operator=(const VulkanRenderer&) = delete;
+    ~VulkanRenderer() { destroy(); }
+
+#ifdef SOLAR_VULKAN
+    // creates the device and everything the scene needs at the given resolution; the pipeline cache is read
+    // from cachePath if it's there and written back by destroy()
+    bool init(int w, int h, const std::string& cachePath = "vulkan_pipeline.cache") {
+        width = w;
+        height = h;
+        color.assign((size_t)width * height * 4, 0);
+        pipelineCachePath = cachePath;
+        planets.assign(SOLAR_SYSTEM_PLANETS, SOLAR_SYSTEM_PLANETS + PLANET_COUNT);
+        ready = createDevice() && createTargets() && createGeometry() && createTextures() && createDescriptors()
+            && createPipelines() && createCommandBuffers();
+        return ready;
+    }
+
+    // draws the scene as it is simTime seconds into the simulation, like Scene::render, and reads it back
+    // into color
+    void render(const glm::mat4& view, const glm::mat4& projection, double simTime) {
+        if (!ready) return;
+        bodyModelMatrices(planets, simTime, timeScaleDaysPerSecond, timeScaleRotation, planetScale, models);
+
+        // glm builds GL clip space; Vulkan's depth range is 0..1 (y is flipped by the viewport instead)
+        const glm::mat4 depthRange(1.0f, 0.0f, 0.0f, 0.0f,
+                                   0.0f, 1.0f, 0.0f, 0.0f,
+                                   0.0f, 0.0f, 0.5f, 0.0f,
+                                   0.0f, 0.0f, 0.5f, 1.0f);
+        FrameUniforms* frame = static_cast<FrameUniforms*>(frameUniforms.mapped);
+        frame->view = view;
+        frame->projection = depthRange * projection;
+        frame->viewPos = glm::vec4(glm::vec3(glm::inverse(view)[3]), 1.0f);
+        frame->lightAmbient = glm::vec4(0.05f);
+        frame->lightDiffuse = glm::vec4(1.0f);
+        frame->lightSpecular = glm::vec4(0.3f, 0.3f, 0.3f, 32.0f);
+
+        // contiguous runs of bodies, one per worker; every batch records from its own pool
+        int bodyCount = (int)models.size();
+        int batchCount = std::min((int)batches.size(), bodyCount);
+        auto recordStart = std::chrono::steady_clock::now();
+        pool.parallelFor(batchCount, [&](int begin, int end) {
+            for (int batch = begin; batch < end; ++batch)
+                recordBatch(batches[batch], bodyCount * batch / batchCount, bodyCount * (batch + 1) / batchCount);
+        });
+        RecordMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+        CommandBuffersRecorded = batchCount;
+
+        std::vector<VkCommandBuffer> secondaries;
+        for (int batch = 0; batch < batchCount; ++batch)
+            secondaries.push_back(batches[batch].commandBuffer);
+        recordPrimary(secondaries);
+
+        VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submit.commandBufferCount = 1;
+        submit.pCommandBuffers = &primaryCommandBuffer;
+        if (!check(vkQueueSubmit(queue, 1, &submit, frameFence), "QUEUE_SUBMIT"))
+            return;
+        vkWaitForFences(device, 1, &frameFence, VK_TRUE, UINT64_MAX);
+        vkResetFences(device, 1, &frameFence);
+
+        // Vulkan's first row is the top one
+        const unsigned char* pixels = static_cast<const unsigned char*>(readback.mapped);
+        size_t rowBytes = (size_t)width * 4;
+        for (int y = 0; y < height; ++y)
+            std::memcpy(&color[(size_t)y * rowBytes], pixels + (size_t)(height - 1 - y) * rowBytes, rowBytes);
+    }
+
+    // waits for the device, saves the pipeline cache and releases everything; safe to call more than once
+    void destroy() {
+        if (device != VK_NULL_HANDLE) {
+            vkDeviceWaitIdle(device);
+            savePipelineCache();
+            for (Batch& batch : batches)
+                vkDestroyCommandPool(device, batch.commandPool, nullptr);
+            batches.clear();
+            vkDestroyCommandPool(device, commandPool, nullptr);
+            vkDestroyFence(device, frameFence, nullptr);
+            vkDestroyPipeline(device, unlitPipeline, nullptr);
+            vkDestroyPipeline(device, litPipeline, nullptr);
+            vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+            vkDestroyPipelineCache(device, pipelineCache, nullptr);
+            vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+            vkDestroyDescriptorSetLayout(device, frameSetLayout, nullptr);
+            vkDestroyDescriptorSetLayout(device, textureSetLayout, nullptr);
+            vkDestroySampler(device, sampler, nullptr);
+            for (Image& texture : textures)
+                destroyImage(texture);
+            textures.clear();
+            destroyBuffer(frameUniforms);
+            destroyBuffer(vertexBuffer);
+            destroyBuffer(indexBuffer);
+            destroyBuffer(readback);
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+            vkDestroyRenderPass(device, renderPass, nullptr);
+            destroyImage(colorTarget);
+            destroyImage(depthTarget);
+            vkDestroyDevice(device, nullptr);
+            device = VK_NULL_HANDLE;
+            ready = false;
+        }
+        if (instance != VK_NULL_HANDLE) {
+            vkDestroyInstance(instance, nullptr);
+            instance = VK_NULL_HANDLE;
+        }
+    }
+
+private:
+    struct Buffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+    };
+    struct Image {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+    };
+    struct Batch {
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    };
+    // std140 layout of Frame in planet_vk.vert and lighting_vk.frag
+    struct FrameUniforms {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec4 viewPos;
+        glm::vec4 lightAmbient;
+        glm::vec4 lightDiffuse;
+        glm::vec4 lightSpecular;
+    };
+
+    static const VkFormat COLOR_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+    const SceneAssets& assets;
+    ThreadPool& pool;
+    std::vector<Planet> planets;
+    std::vector<glm::mat4> models; // sun, then planets; refilled every frame
+    std::string pipelineCachePath;
+    bool ready = false;
+
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    uint32_t queueFamily = 0;
+    VkPhysicalDeviceMemoryProperties memoryProperties = {};
+
+    VkFormat depthFormat = VK_FORMAT_D32_SFLOAT;
+    Image colorTarget, depthTarget;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    Buffer readback;
+
+    Buffer vertexBuffer, indexBuffer;
+    uint32_t indexCount = 0;
+    std::vector<Image> textures; // sun, then planets
+    VkSampler sampler = VK_NULL_HANDLE;
+
+    Buffer frameUniforms;
+    VkDescriptorSetLayout frameSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout textureSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet frameSet = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> textureSets;
+
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline unlitPipeline = VK_NULL_HANDLE;
+    VkPipeline litPipeline = VK_NULL_HANDLE;
+
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer primaryCommandBuffer = VK_NULL_HANDLE;
+    VkFence frameFence = VK_NULL_HANDLE;
+    std::vector<Batch> batches;
+
+    static bool check(VkResult result, const char* what) {
+        if (result == VK_SUCCESS) return true;
+        std::cout << "ERROR::VULKAN::" << what << ": VkResult " << result << std::endl;
+        return false;
+    }
+
+    bool createDevice() {
+        VkApplicationInfo application = { VK_STRUCTURE_TYPE_APPLICATION_INFO };
+        application.pApplicationName = "Solar System Simulation";
+        application.apiVersion = VK_API_VERSION_1_1;
+        VkInstanceCreateInfo instanceInfo = { VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO };
+        instanceInfo.pApplicationInfo = &application;
+        if (!check(vkCreateInstance(&instanceInfo, nullptr, &instance), "CREATE_INSTANCE"))
+            return false;
+
+        // the first device with a graphics queue, GPUs before CPU implementations like lavapipe
+        uint32_t deviceCount = 0;
+        vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+        std::vector<VkPhysicalDevice> devices(deviceCount);
+        vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+        int bestRank = -1;
+        for (VkPhysicalDevice candidate : devices) {
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(candidate, &properties);
+            uint32_t familyCount = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, nullptr);
+            std::vector<VkQueueFamilyProperties> families(familyCount);
+            vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, families.data());
+            for (uint32_t family = 0; family < familyCount; ++family) {
+                if (!(families[family].queueFlags & VK_QUEUE_GRAPHICS_BIT)) continue;
+                int rank = properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU ? 3
+                         : properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU ? 2
+                         : properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU ? 0 : 1;
+                if (rank > bestRank && properties.apiVersion >= VK_API_VERSION_1_1) {
+                    bestRank = rank;
+                    physicalDevice = candidate;
+                    queueFamily = family;
+                    DeviceName = properties.deviceName;
+                }
+                break;
+            }
+        }
+        if (physicalDevice == VK_NULL_HANDLE) {
+            std::cout << "ERROR::VULKAN::NO_DEVICE: no Vulkan 1.1 device with a graphics queue" << std::endl;
+            return false;
+        }
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+        float priority = 1.0f;
+        VkDeviceQueueCreateInfo queueInfo = { VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO };
+        queueInfo.queueFamilyIndex = queueFamily;
+        queueInfo.queueCount = 1;
+        queueInfo.pQueuePriorities = &priority;
+        VkDeviceCreateInfo deviceInfo = { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
+        deviceInfo.queueCreateInfoCount = 1;
+        deviceInfo.pQueueCreateInfos = &queueInfo;
+        if (!check(vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device), "CREATE_DEVICE"))
+            return false;
+        vkGetDeviceQueue(device, queueFamily, 0, &queue);
+
+        VkCommandPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = queueFamily;
+        return check(vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool), "CREATE_COMMAND_POOL");
+    }
+
+    // index of a memory type allowed by typeBits with all of the given properties, or -1
+    int findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const {
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+            if ((typeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+                return (int)i;
+        return -1;
+    }
+
+    bool allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, VkDeviceMemory& memory) {
+        int type = findMemoryType(requirements.memoryTypeBits, properties);
+        if (type < 0) {
+            std::cout << "ERROR::VULKAN::NO_MEMORY_TYPE: 0x" << std::hex << properties << std::dec << std::endl;
+            return false;
+        }
+        VkMemoryAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+        allocateInfo.allocationSize = requirements.size;
+        allocateInfo.memoryTypeIndex = (uint32_t)type;
+        return check(vkAllocateMemory(device, &allocateInfo, nullptr, &memory), "ALLOCATE_MEMORY");
+    }
+
+    // host visible buffers stay mapped for their whole life
+    bool createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, Buffer& buffer) {
+        VkBufferCreateInfo bufferInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (!check(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer.buffer), "CREATE_BUFFER"))
+            return false;
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(device, buffer.buffer, &requirements);
+        if (!allocate(requirements, properties, buffer.memory))
+            return false;
+        vkBindBufferMemory(device, buffer.buffer, buffer.memory, 0);
+        if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+            return check(vkMapMemory(device, buffer.memory, 0, size, 0, &buffer.mapped), "MAP_MEMORY");
+        return true;
+    }
+
+    void destroyBuffer(Buffer& buffer) {
+        vkDestroyBuffer(device, buffer.buffer, nullptr);
+        vkFreeMemory(device, buffer.memory, nullptr); // unmaps
+        buffer = Buffer();
+    }
+
+    bool createImage(uint32_t w, uint32_t h, uint32_t levels, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect, Image& image) {
+        VkImageCreateInfo imageInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent = { w, h, 1 };
+        imageInfo.mipLevels = levels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = usage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (!check(vkCreateImage(device, &imageInfo, nullptr, &image.image), "CREATE_IMAGE"))
+            return false;
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(device, image.image, &requirements);
+        if (!allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image.memory))
+            return false;
+        vkBindImageMemory(device, image.image, image.memory, 0);
+
+        VkImageViewCreateInfo viewInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+        viewInfo.image = image.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange = { aspect, 0, levels, 0, 1 };
+        return check(vkCreateImageView(device, &viewInfo, nullptr, &image.view), "CREATE_IMAGE_VIEW");
+    }
+
+    void destroyImage(Image& image) {
+        vkDestroyImageView(device, image.view, nullptr);
+        vkDestroyImage(device, image.image, nullptr);
+        vkFreeMemory(device, image.memory, nullptr);
+        image = Image();
+    }
+
+    // records commands into a throwaway command buffer and waits for the queue to run them; for uploads
+    bool submitOnce(const std::function<void(VkCommandBuffer)>& record) {
+        VkCommandBufferAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        allocateInfo.commandPool = commandPool;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocateInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        if (!check(vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer), "ALLOCATE_COMMAND_BUFFERS"))
+            return false;
+        VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        record(commandBuffer);
+        vkEndCommandBuffer(commandBuffer);
+        VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submit.commandBufferCount = 1;
+        submit.pCommandBuffers = &commandBuffer;
+        bool submitted = check(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE), "QUEUE_SUBMIT");
+        vkQueueWaitIdle(queue);
+        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+        return submitted;
+    }
+
+    // color and depth images, the render pass drawing into them and the host buffer the color is copied to
+    bool createTargets() {
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_D32_SFLOAT, &formatProperties);
+        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT))
+            depthFormat = VK_FORMAT_D24_UNORM_S8_UINT;
+        if (!createImage(width, height, 1, COLOR_FORMAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT, colorTarget)
+            || !createImage(width, height, 1, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                            depthFormat == VK_FORMAT_D32_SFLOAT ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT, depthTarget))
+            return false;
+
+        VkAttachmentDescription attachments[2] = {};
+        attachments[0].format = COLOR_FORMAT;
+        attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        attachments[1] = attachments[0];
+        attachments[1].format = depthFormat;
+        attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorReference;
+        subpass.pDepthStencilAttachment = &depthReference;
+        // the previous frame's copy and depth test are done before this frame clears the attachments, and
+        // the copy after the render pass waits for the color writes
+        VkSubpassDependency dependencies[2] = {};
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependencies[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        VkRenderPassCreateInfo renderPassInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+        renderPassInfo.attachmentCount = 2;
+        renderPassInfo.pAttachments = attachments;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 2;
+        renderPassInfo.pDependencies = dependencies;
+        if (!check(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass), "CREATE_RENDER_PASS"))
+            return false;
+
+        VkImageView views[2] = { colorTarget.view, depthTarget.view };
+        VkFramebufferCreateInfo framebufferInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = 2;
+        framebufferInfo.pAttachments = views;
+        framebufferInfo.width = width;
+        framebufferInfo.height = height;
+        framebufferInfo.layers = 1;
+        if (!check(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer), "CREATE_FRAMEBUFFER"))
+            return false;
+
+        VkDeviceSize readbackBytes = (VkDeviceSize)width * height * 4;
+        VkMemoryPropertyFlags hostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        // cached memory reads back much faster where the device has it
+        VkMemoryPropertyFlags cached = hostMemory | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        bool hasCached = false;
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+            hasCached = hasCached || (memoryProperties.memoryTypes[i].propertyFlags & cached) == cached;
+        return createBuffer(readbackBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT, hasCached ? cached : hostMemory, readback);
+    }
+
+    // copies data into a new device local buffer through a staging buffer
+    bool uploadBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, Buffer& buffer) {
+        Buffer staging;
+        if (!createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging))
+            return false;
+        std::memcpy(staging.mapped, data, (size_t)size);
+        bool uploaded = createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer)
+            && submitOnce([&](VkCommandBuffer commandBuffer) {
+                VkBufferCopy region = { 0, 0, size };
+                vkCmdCopyBuffer(commandBuffer, staging.buffer, buffer.buffer, 1, &region);
+            });
+        destroyBuffer(staging);
+        return uploaded;
+    }
+
+    bool createGeometry() {
+        const SphereMesh& mesh = assets.sphereMesh;
+        indexCount = (uint32_t)mesh.indices.size();
+        return uploadBuffer(mesh.vertices.data(), mesh.vertices.size() * sizeof(float), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBuffer)
+            && uploadBuffer(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer);
+    }
+
+    // RGBA8 with a full mip chain blitted on the device; single channel images read as red like GL_R8, and
+    // an empty image is black like an incomplete GL texture
+    bool uploadTexture(const TextureImage& source, Image& texture) {
+        uint32_t w = 1, h = 1;
+        std::vector<unsigned char> rgba(4, 0);
+        rgba[3] = 255;
+        if (!source.pixels.empty()) {
+            w = source.width;
+            h = source.height;
+            rgba.assign((size_t)w * h * 4, 0);
+            for (size_t i = 0; i < (size_t)w * h; ++i) {
+                const unsigned char* texel = &source.pixels[i * source.components];
+                rgba[i * 4] = texel[0];
+                rgba[i * 4 + 1] = source.components >= 3 ? texel[1] : 0;
+                rgba[i * 4 + 2] = source.components >= 3 ? texel[2] : 0;
+                rgba[i * 4 + 3] = source.components == 4 ? texel[3] : 255;
+            }
+        }
+        uint32_t levels = 1;
+        while ((std::max(w, h) >> levels) > 0)
+            ++levels;
+
+        Buffer staging;
+        if (!createBuffer(rgba.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging))
+            return false;
+        std::memcpy(staging.mapped, rgba.data(), rgba.size());
+        bool uploaded = createImage(w, h, levels, COLOR_FORMAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                    VK_IMAGE_ASPECT_COLOR_BIT, texture)
+            && submitOnce([&](VkCommandBuffer commandBuffer) {
+                VkImageMemoryBarrier barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.image = texture.image;
+                barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1 };
+                barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+                VkBufferImageCopy copy = {};
+                copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+                copy.imageExtent = { w, h, 1 };
+                vkCmdCopyBufferToImage(commandBuffer, staging.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+                // each level is filtered down from the one above, which then becomes read only
+                barrier.subresourceRange.levelCount = 1;
+                for (uint32_t level = 1; level < levels; ++level) {
+                    barrier.subresourceRange.baseMipLevel = level - 1;
+                    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+                    VkImageBlit blit = {};
+                    blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+                    blit.srcOffsets[1] = { (int32_t)std::max(w >> (level - 1), 1u), (int32_t)std::max(h >> (level - 1), 1u), 1 };
+                    blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+                    blit.dstOffsets[1] = { (int32_t)std::max(w >> level, 1u), (int32_t)std::max(h >> level, 1u), 1 };
+                    vkCmdBlitImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   1, &blit, VK_FILTER_LINEAR);
+
+                    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+                }
+                barrier.subresourceRange.baseMipLevel = levels - 1;
+                barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+            });
+        destroyBuffer(staging);
+        return uploaded;
+    }
+
+    bool createTextures() {
+        textures.resize(PLANET_COUNT + 1);
+        if (!uploadTexture(assets.sunImage, textures[0]))
+            return false;
+        for (int i = 0; i < PLANET_COUNT; ++i)
+            if (!uploadTexture(assets.planetImages[i], textures[i + 1]))
+                return false;
+
+        VkSamplerCreateInfo samplerInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        return check(vkCreateSampler(device, &samplerInfo, nullptr, &sampler), "CREATE_SAMPLER");
+    }
+
+    // every descriptor set is allocated and written here, once
+    bool createDescriptors() {
+        if (!createBuffer(sizeof(FrameUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frameUniforms))
+            return false;
+
+        VkDescriptorSetLayoutBinding frameBinding = { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+        VkDescriptorSetLayoutBinding textureBinding = { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+        VkDescriptorSetLayoutCreateInfo layoutInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &frameBinding;
+        if (!check(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &frameSetLayout), "CREATE_DESCRIPTOR_SET_LAYOUT"))
+            return false;
+        layoutInfo.pBindings = &textureBinding;
+        if (!check(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &textureSetLayout), "CREATE_DESCRIPTOR_SET_LAYOUT"))
+            return false;
+
+        uint32_t textureCount = (uint32_t)textures.size();
+        VkDescriptorPoolSize poolSizes[2] = {
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCount }
+        };
+        VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+        poolInfo.maxSets = textureCount + 1;
+        poolInfo.poolSizeCount = 2;
+        poolInfo.pPoolSizes = poolSizes;
+        if (!check(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool), "CREATE_DESCRIPTOR_POOL"))
+            return false;
+
+        std::vector<VkDescriptorSetLayout> layouts(textureCount + 1, textureSetLayout);
+        layouts[0] = frameSetLayout;
+        std::vector<VkDescriptorSet> sets(layouts.size());
+        VkDescriptorSetAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        allocateInfo.descriptorPool = descriptorPool;
+        allocateInfo.descriptorSetCount = (uint32_t)layouts.size();
+        allocateInfo.pSetLayouts = layouts.data();
+        if (!check(vkAllocateDescriptorSets(device, &allocateInfo, sets.data()), "ALLOCATE_DESCRIPTOR_SETS"))
+            return false;
+        frameSet = sets[0];
+        textureSets.assign(sets.begin() + 1, sets.end());
+
+        VkDescriptorBufferInfo frameInfo = { frameUniforms.buffer, 0, sizeof(FrameUniforms) };
+        std::vector<VkDescriptorImageInfo> imageInfos(textureCount);
+        std::vector<VkWriteDescriptorSet> writes(textureCount + 1, VkWriteDescriptorSet{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET });
+        writes[0].dstSet = frameSet;
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writes[0].pBufferInfo = &frameInfo;
+        for (uint32_t i = 0; i < textureCount; ++i) {
+            imageInfos[i] = { sampler, textures[i].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+            writes[i + 1].dstSet = textureSets[i];
+            writes[i + 1].descriptorCount = 1;
+            writes[i + 1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[i + 1].pImageInfo = &imageInfos[i];
+        }
+        vkUpdateDescriptorSets(device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+        return true;
+    }
+
+    VkShaderModule loadShader(const char* path) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) {
+            std::cout << "ERROR::VULKAN::SHADER_NOT_FOUND: " << path << " (compile it with glslc)" << std::endl;
+            return VK_NULL_HANDLE;
+        }
+        std::vector<uint32_t> code(((size_t)in.tellg() + 3) / 4);
+        in.seekg(0);
+        in.read(reinterpret_cast<char*>(code.data()), code.size() * 4);
+        VkShaderModuleCreateInfo moduleInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+        moduleInfo.codeSize = code.size() * 4;
+        moduleInfo.pCode = code.data();
+        VkShaderModule module = VK_NULL_HANDLE;
+        check(vkCreateShaderModule(device, &moduleInfo, nullptr, &module), "CREATE_SHADER_MODULE");
+        return module;
+    }
+
+    // a cache from another driver or version is ignored by the driver, which then starts empty
+    void loadPipelineCache() {
+        std::vector<char> data;
+        std::ifstream in(pipelineCachePath, std::ios::binary);
+        if (in)
+            data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        VkPipelineCacheCreateInfo cacheInfo = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+        cacheInfo.initialDataSize = data.size();
+        cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+        if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+            cacheInfo.initialDataSize = 0;
+            cacheInfo.pInitialData = nullptr;
+            check(vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache), "CREATE_PIPELINE_CACHE");
+        }
+    }
+
+    void savePipelineCache() {
+        if (pipelineCache == VK_NULL_HANDLE || pipelineCachePath.empty()) return;
+        size_t size = 0;
+        vkGetPipelineCacheData(device, pipelineCache, &size, nullptr);
+        std::vector<char> data(size);
+        if (size == 0 || vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) != VK_SUCCESS)
+            return;
+        std::ofstream out(pipelineCachePath, std::ios::binary);
+        out.write(data.data(), size);
+        if (!out)
+            std::cout << "ERROR::VULKAN::PIPELINE_CACHE_NOT_SAVED: " << pipelineCachePath << std::endl;
+    }
+
+    // unlit for the sun (and the planets when lighting is off), lit for the planets
+    bool createPipelines() {
+        loadPipelineCache();
+
+        VkDescriptorSetLayout setLayouts[2] = { frameSetLayout, textureSetLayout };
+        VkPushConstantRange pushConstants = { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4) };
+        VkPipelineLayoutCreateInfo layoutInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        layoutInfo.setLayoutCount = 2;
+        layoutInfo.pSetLayouts = setLayouts;
+        layoutInfo.pushConstantRangeCount = 1;
+        layoutInfo.pPushConstantRanges = &pushConstants;
+        if (!check(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &pipelineLayout), "CREATE_PIPELINE_LAYOUT"))
+            return false;
+
+        VkShaderModule vertexShader = loadShader("planet_vk.vert.spv");
+        VkShaderModule unlitShader = loadShader("planet_vk.frag.spv");
+        VkShaderModule litShader = loadShader("lighting_vk.frag.spv");
+        bool created = vertexShader && unlitShader && litShader
+            && createPipeline(vertexShader, unlitShader, unlitPipeline) && createPipeline(vertexShader, litShader, litPipeline);
+        vkDestroyShaderModule(device, vertexShader, nullptr);
+        vkDestroyShaderModule(device, unlitShader, nullptr);
+        vkDestroyShaderModule(device, litShader, nullptr);
+        return created;
+    }
+
+    bool createPipeline(VkShaderModule vertexShader, VkShaderModule fragmentShader, VkPipeline& pipeline) {
+        VkPipelineShaderStageCreateInfo stages[2] = {
+            { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO },
+            { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO }
+        };
+        stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        stages[0].module = vertexShader;
+        stages[0].pName = "main";
+        stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        stages[1].module = fragmentShader;
+        stages[1].pName = "main";
+
+        // the sphere mesh's interleaved position + UV vertices
+        VkVertexInputBindingDescription binding = { 0, 5 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX };
+        VkVertexInputAttributeDescription attributes[2] = {
+            { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 },
+            { 1, 0, VK_FORMAT_R32G32_SFLOAT, 3 * sizeof(float) }
+        };
+        VkPipelineVertexInputStateCreateInfo vertexInput = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+        vertexInput.vertexBindingDescriptionCount = 1;
+        vertexInput.pVertexBindingDescriptions = &binding;
+        vertexInput.vertexAttributeDescriptionCount = 2;
+        vertexInput.pVertexAttributeDescriptions = attributes;
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        VkPipelineViewportStateCreateInfo viewportState = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+        viewportState.viewportCount = 1;
+        viewportState.scissorCount = 1;
+        // no culling, as in the GL path
+        VkPipelineRasterizationStateCreateInfo rasterization = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+        rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterization.cullMode = VK_CULL_MODE_NONE;
+        rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        rasterization.lineWidth = 1.0f;
+        VkPipelineMultisampleStateCreateInfo multisample = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+        multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        VkPipelineDepthStencilStateCreateInfo depthStencil = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+        depthStencil.depthTestEnable = VK_TRUE;
+        depthStencil.depthWriteEnable = VK_TRUE;
+        depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+        VkPipelineColorBlendAttachmentState blendAttachment = {};
+        blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        VkPipelineColorBlendStateCreateInfo colorBlend = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+        colorBlend.attachmentCount = 1;
+        colorBlend.pAttachments = &blendAttachment;
+        VkDynamicState dynamicStates[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+        VkPipelineDynamicStateCreateInfo dynamicState = { VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+        dynamicState.dynamicStateCount = 2;
+        dynamicState.pDynamicStates = dynamicStates;
+
+        VkGraphicsPipelineCreateInfo pipelineInfo = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+        pipelineInfo.stageCount = 2;
+        pipelineInfo.pStages = stages;
+        pipelineInfo.pVertexInputState = &vertexInput;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterization;
+        pipelineInfo.pMultisampleState = &multisample;
+        pipelineInfo.pDepthStencilState = &depthStencil;
+        pipelineInfo.pColorBlendState = &colorBlend;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = pipelineLayout;
+        pipelineInfo.renderPass = renderPass;
+        pipelineInfo.subpass = 0;
+        return check(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline), "CREATE_GRAPHICS_PIPELINES");
+    }
+
+    // the primary command buffer, and one pool with a secondary command buffer per worker
+    bool createCommandBuffers() {
+        VkCommandBufferAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        allocateInfo.commandPool = commandPool;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocateInfo.commandBufferCount = 1;
+        if (!check(vkAllocateCommandBuffers(device, &allocateInfo, &primaryCommandBuffer), "ALLOCATE_COMMAND_BUFFERS"))
+            return false;
+        VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+        if (!check(vkCreateFence(device, &fenceInfo, nullptr, &frameFence), "CREATE_FENCE"))
+            return false;
+
+        batches.resize(pool.threadCount() + 1);
+        for (Batch& batch : batches) {
+            VkCommandPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            poolInfo.queueFamilyIndex = queueFamily;
+            if (!check(vkCreateCommandPool(device, &poolInfo, nullptr, &batch.commandPool), "CREATE_COMMAND_POOL"))
+                return false;
+            allocateInfo.commandPool = batch.commandPool;
+            allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            if (!check(vkAllocateCommandBuffers(device, &allocateInfo, &batch.commandBuffer), "ALLOCATE_COMMAND_BUFFERS"))
+                return false;
+        }
+        return true;
+    }
+
+    // records the draws of bodies [firstBody, endBody) into the batch's secondary command buffer; runs on a
+    // worker, touching nothing but the batch's own pool
+    void recordBatch(Batch& batch, int firstBody, int endBody) {
+        vkResetCommandPool(device, batch.commandPool, 0);
+        VkCommandBufferInheritanceInfo inheritance = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+        inheritance.renderPass = renderPass;
+        inheritance.subpass = 0;
+        inheritance.framebuffer = framebuffer;
+        VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritance;
+        VkCommandBuffer commandBuffer = batch.commandBuffer;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        // a negative height flips y so glm's GL projection keeps the image upright
+        VkViewport viewport = { 0.0f, (float)height, (float)width, -(float)height, 0.0f, 1.0f };
+        VkRect2D scissor = { { 0, 0 }, { (uint32_t)width, (uint32_t)height } };
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        VkDeviceSize vertexOffset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, &vertexOffset);
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+        VkPipeline bound = VK_NULL_HANDLE;
+        for (int body = firstBody; body < endBody; ++body) {
+            VkPipeline pipeline = lighting && body > 0 ? litPipeline : unlitPipeline;
+            if (pipeline != bound) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+                if (bound == VK_NULL_HANDLE)
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameSet, 0, nullptr);
+                bound = pipeline;
+            }
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &textureSets[body], 0, nullptr);
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &models[body][0][0]);
+            vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+        }
+        vkEndCommandBuffer(commandBuffer);
+    }
+
+    // clears, runs the batches and copies the color image to the readback buffer
+    void recordPrimary(const std::vector<VkCommandBuffer>& secondaries) {
+        vkResetCommandBuffer(primaryCommandBuffer, 0);
+        VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(primaryCommandBuffer, &beginInfo);
+
+        // the same clear color as Scene::render
+        VkClearValue clearValues[2] = {};
+        clearValues[0].color = { { 0.01f, 0.01f, 0.01f, 1.0f } };
+        clearValues[1].depthStencil = { 1.0f, 0 };
+        VkRenderPassBeginInfo renderPassBegin = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+        renderPassBegin.renderPass = renderPass;
+        renderPassBegin.framebuffer = framebuffer;
+        renderPassBegin.renderArea = { { 0, 0 }, { (uint32_t)width, (uint32_t)height } };
+        renderPassBegin.clearValueCount = 2;
+        renderPassBegin.pClearValues = clearValues;
+        vkCmdBeginRenderPass(primaryCommandBuffer, &renderPassBegin, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        if (!secondaries.empty())
+            vkCmdExecuteCommands(primaryCommandBuffer, (uint32_t)secondaries.size(), secondaries.data());
+        vkCmdEndRenderPass(primaryCommandBuffer);
+
+        VkBufferImageCopy copy = {};
+        copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        copy.imageExtent = { (uint32_t)width, (uint32_t)height, 1 };
+        vkCmdCopyImageToBuffer(primaryCommandBuffer, colorTarget.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &copy);
+        VkBufferMemoryBarrier hostRead = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+        hostRead.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        hostRead.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        hostRead.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        hostRead.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        hostRead.buffer = readback.buffer;
+        hostRead.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(primaryCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostRead, 0, nullptr);
+        vkEndCommandBuffer(primaryCommandBuffer);
+    }
+#else
+    bool init(int, int, const std::string& = "vulkan_pipeline.cache") {
+        std::cout << "ERROR::VULKAN::NOT_BUILT: build with SOLAR_VULKAN defined and link the Vulkan loader" << std::endl;
+        return false;
+    }
+    void render(const glm::mat4&, const glm::mat4&, double) {}
+    void destroy() {}
+
+private:
+    const SceneAssets& assets;
+    ThreadPool& pool;
+#endif
+};
+
+#endif // !VULKAN_RENDERER_H
@@ -0,0 +1,22 @@
+#version 330 core
+layout (points) in;
+layout (points, max_vertices = 1) out;
+
+in vec4 vPositionScale[];
+in vec4 vRotation[];
+flat in int vKeep[];
+
+// captured by transform feedback
+out vec4 outPositionScale;
+out vec4 outRotation;
+
+// a vertex shader writes every vertex it runs on, so dropping the culled ones takes a geometry shader
+void main()
+{
+	if (vKeep[0] != 0) {
+		outPositionScale = vPositionScale[0];
+		outRotation = vRotation[0];
+		EmitVertex();
+		EndPrimitive();
+	}
+}
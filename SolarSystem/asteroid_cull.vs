@@ -0,0 +1,39 @@
+#version 330 core
+layout (location = 0) in vec4 aOrbit;    // radius, orbits per earth day, phase, rotations per sim second
+layout (location = 1) in vec4 aOrbitU;   // orbit plane axis, w = scale
+layout (location = 2) in vec3 aOrbitV;   // the other orbit plane axis
+layout (location = 3) in vec3 aSpinAxis;
+
+out vec4 vPositionScale;
+out vec4 vRotation;
+flat out int vKeep;
+
+uniform float simTimeInDays;
+uniform float rotationTime; // sim seconds * timeScaleRotation
+uniform float planetScale;
+uniform vec4 frustumPlanes[6]; // world space, normalized, pointing inwards
+uniform vec3 cameraPosition;
+uniform float pixelsPerUnit;   // projected radius in pixels of a unit radius at unit distance
+uniform vec2 lodPixelRange;    // this pass keeps projected radii in [x, y)
+uniform float boundingRadius;  // of the shape's meshes at scale 1
+
+const float TWO_PI = 6.28318530718;
+
+// the same orbit and spin as AsteroidBelt::modelMatrices
+void main()
+{
+	float orbitAngle = aOrbit.z + simTimeInDays * aOrbit.y * TWO_PI;
+	vec3 position = aOrbit.x * (sin(orbitAngle) * aOrbitU.xyz + cos(orbitAngle) * aOrbitV);
+	float scale = aOrbitU.w * planetScale;
+	float radius = scale * boundingRadius;
+
+	bool visible = true;
+	for (int i = 0; i < 6; ++i)
+		visible = visible && dot(frustumPlanes[i].xyz, position) + frustumPlanes[i].w > -radius;
+	float pixels = radius * pixelsPerUnit / max(distance(position, cameraPosition), 1e-6);
+	vKeep = visible && pixels >= lodPixelRange.x && pixels < lodPixelRange.y ? 1 : 0;
+
+	float rotationAngle = aOrbit.w * TWO_PI * rotationTime;
+	vPositionScale = vec4(position, scale);
+	vRotation = vec4(aSpinAxis * sin(0.5 * rotationAngle), cos(0.5 * rotationAngle));
+}
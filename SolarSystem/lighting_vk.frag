@@ -0,0 +1,41 @@
+#version 450
+layout (location = 0) in vec2 TexCoord;
+layout (location = 1) in vec3 FragPos;
+layout (location = 2) in vec3 Normal;
+
+layout (location = 0) out vec4 FragColor;
+
+layout (set = 0, binding = 0) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	vec4 viewPos;
+	vec4 lightAmbient;
+	vec4 lightDiffuse;
+	vec4 lightSpecular; // w: shininess
+} frame;
+
+layout (set = 1, binding = 0) uniform sampler2D texture1;
+
+// lighting_shader.fs with the sun at the origin as a point light; the planets have no specular map, so the
+// diffuse texture stands in for it
+void main()
+{
+	vec3 color = texture(texture1, TexCoord).rgb;
+
+	// ambient
+	vec3 ambient = frame.lightAmbient.rgb * color;
+
+	// diffuse
+	vec3 norm = normalize(Normal);
+	vec3 lightDir = normalize(-FragPos);
+	float diff = max(dot(norm, lightDir), 0.0);
+	vec3 diffuse = frame.lightDiffuse.rgb * diff * color;
+
+	// specular
+	vec3 viewDir = normalize(frame.viewPos.xyz - FragPos);
+	vec3 reflectDir = reflect(-lightDir, norm);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), frame.lightSpecular.w);
+	vec3 specular = frame.lightSpecular.rgb * spec * color;
+
+	FragColor = vec4(ambient + diffuse + specular, 1.0);
+}
\ No newline at end of file
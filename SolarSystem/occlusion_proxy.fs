@@ -0,0 +1,6 @@
+#version 330 core
+
+// only depth-tested for an occlusion query; color writes are off
+void main()
+{
+}
@@ -0,0 +1,11 @@
+#version 450
+layout (location = 0) in vec2 TexCoord;
+
+layout (location = 0) out vec4 FragColor;
+
+layout (set = 1, binding = 0) uniform sampler2D texture1;
+
+void main()
+{
+	FragColor = texture(texture1, TexCoord);
+}
\ No newline at end of file
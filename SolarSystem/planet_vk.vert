@@ -0,0 +1,30 @@
+#version 450
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+
+layout (location = 0) out vec2 TexCoord;
+layout (location = 1) out vec3 FragPos;
+layout (location = 2) out vec3 Normal;
+
+// written once per frame, bound through a descriptor set that never changes
+layout (set = 0, binding = 0) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	vec4 viewPos;
+	vec4 lightAmbient;
+	vec4 lightDiffuse;
+	vec4 lightSpecular; // w: shininess
+} frame;
+
+layout (push_constant) uniform Body {
+	mat4 model;
+} body;
+
+void main()
+{
+	FragPos = vec3(body.model * vec4(aPos, 1.0));
+	// the bodies are unit spheres scaled uniformly, so the model matrix carries the position over as the normal
+	Normal = mat3(body.model) * aPos;
+	TexCoord = aTexCoord;
+	gl_Position = frame.projection * frame.view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 RingPosition;
+
+uniform sampler2D profile; // color and density from the inner edge to the outer
+uniform vec2 radii;        // of the inner and outer edge
+
+void main()
+{
+	float radius = length(RingPosition);
+	FragColor = texture(profile, vec2((radius - radii.x) / (radii.y - radii.x), 0.5));
+}
@@ -0,0 +1,14 @@
+#version 330 core
+layout (location = 0) in vec2 aPos; // x and z in Saturn radii, around Saturn
+
+out vec2 RingPosition;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat4 model;
+
+void main()
+{
+	gl_Position = projection * view * model * vec4(aPos.x, 0.0, aPos.y, 1.0);
+	RingPosition = aPos;
+}
@@ -0,0 +1,14 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 Tint;
+
+void main()
+{
+	// a disc inside the point's square, shaded as the sphere facing the camera
+	vec2 offset = gl_PointCoord * 2.0 - 1.0;
+	float distance2 = dot(offset, offset);
+	if (distance2 > 1.0)
+		discard;
+	FragColor = vec4(Tint * (0.6 + 0.4 * sqrt(1.0 - distance2)), 1.0);
+}
@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) in vec4 aPositionRadius; // in Saturn radii, around Saturn, written by RingParticles
+
+out vec3 Tint;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat4 model;           // Saturn's position, and its radius in world units
+uniform float pixelsPerUnit;  // at a distance of 1
+uniform float sizeScale;      // world units per Saturn radius, larger when fewer particles are drawn
+
+void main()
+{
+	vec4 viewPosition = view * model * vec4(aPositionRadius.xyz, 1.0);
+	gl_Position = projection * viewPosition;
+	// under a pixel it would flicker in and out between pixel centers
+	gl_PointSize = max(2.0 * aPositionRadius.w * sizeScale * pixelsPerUnit / max(-viewPosition.z, 1e-3), 1.0);
+	// a little variety between particles, from where each one is in its orbit's plane
+	float shade = fract(sin(dot(aPositionRadius.xz, vec2(12.9898, 78.233))) * 43758.5453);
+	Tint = mix(vec3(0.72, 0.64, 0.52), vec3(0.90, 0.84, 0.72), shade);
+}
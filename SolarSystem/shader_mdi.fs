@@ -0,0 +1,21 @@
+#version 450 core
+#ifdef BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
+out vec4 FragColor;
+
+in vec2 TexCoord;
+flat in uvec2 TextureHandle;
+
+#ifndef BINDLESS
+uniform sampler2D texture1;
+#endif
+
+void main()
+{
+#ifdef BINDLESS
+	FragColor = texture(sampler2D(TextureHandle), TexCoord);
+#else
+	FragColor = texture(texture1, TexCoord);
+#endif
+}
\ No newline at end of file
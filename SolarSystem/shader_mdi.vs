@@ -0,0 +1,37 @@
+#version 450 core
+#ifndef INSTANCED
+#extension GL_ARB_shader_draw_parameters : require
+#endif
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+
+out vec2 TexCoord;
+flat out uvec2 TextureHandle;
+
+// one per draw of a multi-draw call; texture is a bindless handle when the fragment shader is built with BINDLESS
+struct Draw {
+	mat4 model;
+	uvec2 texture;
+};
+
+layout (std430, binding = 0) readonly buffer Draws {
+	Draw draws[];
+};
+
+uniform mat4 view;
+uniform mat4 projection;
+// index of this call's first draw, as gl_DrawIDARB (or gl_InstanceID when built with INSTANCED, for drivers
+// without shader draw parameters) starts at 0 in every call
+uniform uint drawOffset;
+
+void main()
+{
+#ifdef INSTANCED
+	Draw draw = draws[drawOffset + uint(gl_InstanceID)];
+#else
+	Draw draw = draws[drawOffset + uint(gl_DrawIDARB)];
+#endif
+	gl_Position = projection * view * draw.model * vec4(aPos, 1.0f);
+	TexCoord = aTexCoord;
+	TextureHandle = draw.texture;
+}
\ No newline at end of file